@@ -0,0 +1,37 @@
+#include "benchShow.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+uint8_t * benchShowCreate(const BenchShowConfiguration *configuration, size_t *showSize) {
+    uint32_t busCount = configuration->busCount > 0 ? configuration->busCount : 1;
+    size_t cueOffset = fusesFormatCueOffset(configuration->deviceCount);
+    *showSize = cueOffset + (size_t)configuration->cueCount * sizeof(FusesCue);
+    uint8_t *show = NULL;
+    if (posix_memalign((void**)&show, FUSES_CUE_ALIGNMENT, *showSize) != 0) { return NULL; }
+    memset(show, 0, *showSize);
+
+    FusesHeaderV2 *header = (FusesHeaderV2*)show;
+    memcpy(header->fusesMagic, FUSES_V2_MAGIC, FUSES_MAGIC_SIZE);
+    header->version = FUSES_FORMAT_VERSION_2;
+    header->headerSize = sizeof(FusesHeaderV2);
+    header->deviceCount = configuration->deviceCount;
+    header->dataItemCount = configuration->cueCount;
+    header->cueOffset = cueOffset;
+    header->headerChecksum = fusesFormatChecksum(header, FUSES_HEADER_V2_CHECKSUM_SIZE);
+
+    FusesDevice *devices = (FusesDevice*)(show + sizeof(FusesHeaderV2));
+    for (uint32_t i = 0; i < configuration->deviceCount; ++i) {
+        devices[i].deviceAddress = configuration->baseDeviceAddress | (i / busCount);
+        devices[i].busIndex = i % busCount;
+    }
+    FusesCue *cues = (FusesCue*)(show + cueOffset);
+    for (uint32_t i = 0; i < configuration->cueCount; ++i) {
+        configuration->cuePattern(configuration->context, i, &cues[i]);
+    }
+    return show;
+}
+
+FusesCue * benchShowGetCues(void *show) {
+    return (FusesCue*)((uint8_t*)show + ((FusesHeaderV2*)show)->cueOffset);
+}
@@ -0,0 +1,34 @@
+#ifndef __BENCH_SHOW_H__
+#define __BENCH_SHOW_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../src/fusesFormat.h"
+
+/**
+ * @brief Builds the version 2 shows the benchmarks play.
+ *
+ * The header and the device table are the same for every benchmark,
+ * only the cues differ: the pattern is called once per cue in order,
+ * so it may keep state in its context. Device i gets the address
+ * baseDeviceAddress | (i / busCount) on bus i % busCount.
+*/
+
+typedef void (*BenchShowCuePattern)(void *context, uint32_t cueIndex, FusesCue *cue);
+
+typedef struct {
+    uint32_t deviceCount;
+    uint32_t cueCount;
+    uint8_t baseDeviceAddress;
+    // 0 puts every device on bus 0
+    uint32_t busCount;
+    BenchShowCuePattern cuePattern;
+    void *context;
+} BenchShowConfiguration;
+
+// zeroed and aligned to FUSES_CUE_ALIGNMENT, release with free(); NULL without memory
+uint8_t * benchShowCreate(const BenchShowConfiguration *configuration, size_t *showSize);
+FusesCue * benchShowGetCues(void *show);
+
+#endif // __BENCH_SHOW_H__
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/fuses.h"
+#include "../src/fusesFormat.h"
+#include "i2cDevStub.h"
+
+/**
+ * Spreads the same 32 devices over 1, 2, 4 and 8 simulated buses through
+ * FusesConfiguration.busNames and a device map, and plays salvos that
+ * fire every fuse at once while each stub transaction takes a fixed time.
+ * Prints how long the slowest bus needed to get a salvo's writes out and
+ * the aggregate register write throughput while draining.
+ *
+ * Build: make bench, run: bin/busScalingBenchmark [transactionDelay]
+*/
+
+#define DEVICE_COUNT (32)
+#define FUSE_COUNT_PER_DEVICE (16)
+#define FUSE_REGISTER_COUNT (4)
+#define SALVO_SIZE (DEVICE_COUNT * FUSE_COUNT_PER_DEVICE)
+#define SALVO_COUNT (4)
+#define SALVO_SPACING (250)
+#define FUSE_DURATION (100)
+#define DEFAULT_TRANSACTION_DELAY (200)
+#define MAX_BUS_COUNT (8)
+#define BASE_DEVICE_ADDRESS (0x40)
+#define POLL_INTERVAL (1000)
+#define NANOSECONDS_PER_MILLISECOND (1000000)
+
+static const uint32_t busCounts[] = { 1, 2, 4, 8 };
+static uint32_t _transactionDelay = DEFAULT_TRANSACTION_DELAY;
+
+static char *busNames[MAX_BUS_COUNT] = {
+    "/dev/i2c-1", "/dev/i2c-2", "/dev/i2c-3", "/dev/i2c-4",
+    "/dev/i2c-5", "/dev/i2c-6", "/dev/i2c-7", "/dev/i2c-8"
+};
+
+typedef struct {
+    FusesHeaderV2 header;
+    FusesDevice devices[DEVICE_COUNT];
+    FusesCue cues[SALVO_COUNT * SALVO_SIZE];
+} __attribute__((aligned(FUSES_CUE_ALIGNMENT))) Show;
+
+static void _createShow(Show *show) {
+    memset(show, 0, sizeof(Show));
+    memcpy(show->header.fusesMagic, FUSES_V2_MAGIC, FUSES_MAGIC_SIZE);
+    show->header.version = FUSES_FORMAT_VERSION_2;
+    show->header.headerSize = sizeof(FusesHeaderV2);
+    show->header.deviceCount = DEVICE_COUNT;
+    show->header.dataItemCount = SALVO_COUNT * SALVO_SIZE;
+    // 32 four-byte devices end on a cue boundary, so the struct layout matches.
+    show->header.cueOffset = fusesFormatCueOffset(DEVICE_COUNT);
+    show->header.headerChecksum = fusesFormatChecksum(&show->header, FUSES_HEADER_V2_CHECKSUM_SIZE);
+    // The show's own table is replaced by the device map of each run.
+    for (int i = 0; i < DEVICE_COUNT; ++i) {
+        show->devices[i].deviceAddress = BASE_DEVICE_ADDRESS + i;
+    }
+    for (int i = 0; i < SALVO_COUNT * SALVO_SIZE; ++i) {
+        show->cues[i].timestamp = (uint64_t)(i / SALVO_SIZE) * SALVO_SPACING * NANOSECONDS_PER_MILLISECOND;
+        show->cues[i].i2cDeviceIndex = (i % SALVO_SIZE) / FUSE_COUNT_PER_DEVICE;
+        show->cues[i].fuseIndex = i % FUSE_COUNT_PER_DEVICE;
+    }
+}
+
+static int _run(Show *show, uint32_t busCount, double *singleBusThroughput) {
+    FusesDevice deviceMap[DEVICE_COUNT];
+    for (uint32_t i = 0; i < DEVICE_COUNT; ++i) {
+        deviceMap[i].busIndex = i % busCount;
+        deviceMap[i].deviceAddress = BASE_DEVICE_ADDRESS + i / busCount;
+    }
+    FusesConfiguration configuration = {
+        .rawData = show,
+        .rawDataSize = sizeof(Show),
+        .busNames = busNames,
+        .busCount = busCount,
+        .deviceMap = deviceMap,
+        .deviceMapSize = DEVICE_COUNT,
+        .fuseDuration = FUSE_DURATION
+    };
+    i2cStubSetTransactionDelay(0);
+    FusesObject *fuses = fusesInit(&configuration);
+    if (fuses == NULL || fusesGetError(fuses)->level == FUSES_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "fusesInit failed: %s\n", fuses ? fusesGetErrorString(fusesGetError(fuses)) : "");
+        return EXIT_FAILURE;
+    }
+
+    i2cStubSetTransactionDelay(_transactionDelay);
+    fusesPlay(fuses, NULL);
+    while (fusesGetIsPlaying(fuses)) {
+        usleep(POLL_INTERVAL);
+    }
+    usleep(2 * FUSE_DURATION * 1000);
+
+    uint64_t writes = 0;
+    uint64_t slowestDrain = 0;
+    for (uint32_t i = 0; i < busCount; ++i) {
+        BusWorkerStatistics bus = fusesGetBusStatistics(fuses, i);
+        writes += bus.writes;
+        uint64_t drain = bus.maximumQueueDelay + bus.maximumServiceTime;
+        if (drain > slowestDrain) { slowestDrain = drain; }
+    }
+    fusesDestroy(fuses);
+
+    // Every salvo edge writes all registers once, the slowest bus decides
+    // when the edge is complete.
+    double edgeWrites = (double)DEVICE_COUNT * FUSE_REGISTER_COUNT;
+    double throughput = edgeWrites / (slowestDrain / 1e9);
+    if (busCount == 1) { *singleBusThroughput = throughput; }
+    printf(
+        "%6u %10llu %14.2f %14.0f %10.2f\n",
+        busCount, (unsigned long long)writes, slowestDrain / 1e6,
+        throughput, throughput / *singleBusThroughput
+    );
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) { _transactionDelay = (uint32_t)atoi(argv[1]); }
+    Show *show = NULL;
+    if (posix_memalign((void**)&show, FUSES_CUE_ALIGNMENT, sizeof(Show)) != 0) { return EXIT_FAILURE; }
+    _createShow(show);
+    if (show->header.cueOffset != offsetof(Show, cues)) { return EXIT_FAILURE; }
+
+    printf(
+        "%d devices, salvos of %d fuses, %u us per bus transaction\n",
+        DEVICE_COUNT, SALVO_SIZE, _transactionDelay
+    );
+    printf("%6s %10s %14s %14s %10s\n", "buses", "writes", "salvoDrain[ms]", "writes/s", "speedup");
+    double singleBusThroughput = 1;
+    int result = EXIT_SUCCESS;
+    for (size_t i = 0; i < sizeof(busCounts) / sizeof(busCounts[0]) && result == EXIT_SUCCESS; ++i) {
+        result = _run(show, busCounts[i], &singleBusThroughput);
+    }
+    free(show);
+    return result;
+}
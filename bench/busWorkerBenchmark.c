@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/fuses.h"
+#include "../src/fusesFormat.h"
+#include "i2cDevStub.h"
+
+/**
+ * Plays a show with scattered cues and two 64-fuse salvos while the
+ * i2c-dev stand-in makes every bus transaction take a fixed time. The
+ * timing thread only posts writes to the bus worker, so its ignite
+ * lateness has to stay flat while the bus worker's queue delay grows
+ * with the transaction time.
+ *
+ * Build: make bench, run: bin/busWorkerBenchmark [transactionDelay...]
+*/
+
+#define DEVICE_COUNT (4)
+#define FUSE_COUNT_PER_DEVICE (16)
+#define SALVO_SIZE (DEVICE_COUNT * FUSE_COUNT_PER_DEVICE)
+#define SALVO_COUNT (2)
+#define CUE_COUNT (255)
+#define SCATTERED_CUE_COUNT (CUE_COUNT - SALVO_COUNT * SALVO_SIZE)
+#define SALVO_INTERVAL (SCATTERED_CUE_COUNT / (SALVO_COUNT + 1))
+#define SHOW_DURATION (3000)
+#define FUSE_DURATION (50)
+#define POLL_INTERVAL (1000)
+#define BUS_NAME ("/dev/i2c-1")
+
+static const uint32_t defaultDelays[] = { 0, 100, 300, 1000 };
+
+typedef struct __attribute__((packed)) {
+    FusesHeader header;
+    FusesDataItem items[CUE_COUNT];
+} Show;
+
+static void _createShow(Show *show) {
+    memcpy(show->header.fusesMagic, FUSES_V1_MAGIC, FUSES_MAGIC_SIZE);
+    show->header.dataItemCount = CUE_COUNT;
+    show->header.i2cDeviceIndexMask = (1 << DEVICE_COUNT) - 1;
+    srand(1);
+    int index = 0;
+    uint32_t timestamp = 0;
+    for (int i = 0; i < SCATTERED_CUE_COUNT; ++i) {
+        timestamp += rand() % (2 * SHOW_DURATION / SCATTERED_CUE_COUNT) + 1;
+        if (i > 0 && i % SALVO_INTERVAL == 0 && i / SALVO_INTERVAL <= SALVO_COUNT) {
+            for (int j = 0; j < SALVO_SIZE; ++j, ++index) {
+                show->items[index].timestamp = timestamp;
+                show->items[index].i2cDeviceIndex = j / FUSE_COUNT_PER_DEVICE;
+                show->items[index].fuseIndex = j % FUSE_COUNT_PER_DEVICE;
+            }
+        }
+        show->items[index].timestamp = timestamp;
+        show->items[index].i2cDeviceIndex = i % DEVICE_COUNT;
+        show->items[index].fuseIndex = i % FUSE_COUNT_PER_DEVICE;
+        ++index;
+    }
+}
+
+static int _run(uint32_t transactionDelay) {
+    Show show;
+    _createShow(&show);
+    FusesConfiguration configuration = {
+        .rawData = &show,
+        .rawDataSize = sizeof(show),
+        .busName = BUS_NAME,
+        .busNameLength = strlen(BUS_NAME),
+        .fuseDuration = FUSE_DURATION,
+        .measureLateness = true
+    };
+    i2cStubSetTransactionDelay(0);
+    FusesObject *fuses = fusesInit(&configuration);
+    if (fuses == NULL || fusesGetError(fuses)->level == FUSES_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "fusesInit failed: %s\n", fuses ? fusesGetErrorString(fusesGetError(fuses)) : "");
+        return EXIT_FAILURE;
+    }
+
+    i2cStubSetTransactionDelay(transactionDelay);
+    fusesPlay(fuses, NULL);
+    while (fusesGetIsPlaying(fuses)) {
+        usleep(POLL_INTERVAL);
+    }
+    usleep(2 * FUSE_DURATION * 1000);
+    FusesLatenessReport report = fusesGetLatenessReport(fuses);
+    BusWorkerStatistics bus = fusesGetBusStatistics(fuses, 0);
+    fusesDestroy(fuses);
+
+    double writes = bus.writes > 0 ? bus.writes : 1;
+    printf(
+        "%8u %8.3f %8.3f %8.3f %8llu %8zu %10.1f %10.1f %10.1f %10.1f\n",
+        transactionDelay, report.median / 1e3, report.p99 / 1e3, report.maximum / 1e3,
+        (unsigned long long)bus.writes, bus.maximumQueueDepth,
+        bus.totalServiceTime / writes / 1e3, bus.maximumServiceTime / 1e3,
+        bus.totalQueueDelay / writes / 1e3, bus.maximumQueueDelay / 1e3
+    );
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    printf("ignite lateness of the timing thread in ms, bus worker times in us\n");
+    printf(
+        "%8s %8s %8s %8s %8s %8s %10s %10s %10s %10s\n",
+        "delay", "p50", "p99", "max", "writes", "depth",
+        "service", "maxServ", "queued", "maxQueued"
+    );
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) {
+            if (_run((uint32_t)atoi(argv[i])) != EXIT_SUCCESS) { return EXIT_FAILURE; }
+        }
+    } else {
+        for (size_t i = 0; i < sizeof(defaultDelays) / sizeof(defaultDelays[0]); ++i) {
+            if (_run(defaultDelays[i]) != EXIT_SUCCESS) { return EXIT_FAILURE; }
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/fuses.h"
+#include "../src/fusesFormat.h"
+#include "../src/i2cSimulation.h"
+#include "benchShow.h"
+
+/**
+ * Measures command-to-effect latency of the control channel. While a
+ * long show plays on the simulated bus, pause and play alternate every
+ * few milliseconds, in both loop modes:
+ *
+ *   post     fusesPostCommand returning (fire-and-forget)
+ *   effect   post until the main loop applied the command, taken from
+ *            the trace event of the command
+ *   ack      post until fusesWaitCommand returned
+ *   blocking fusesPause / fusesPlay round trip
+ *
+ * Times are in microseconds.
+ *
+ * Build: make bench, run: bin/commandBenchmark
+*/
+
+#define COMMAND_COUNT (400)
+#define COMMAND_INTERVAL (2)
+#define CUE_COUNT (4096)
+#define CUE_SPACING (5)
+#define FUSE_DURATION (50)
+#define DEVICE_COUNT (4)
+#define BASE_DEVICE_ADDRESS (0b1100000)
+#define BUS_NAME ("/dev/i2c-1")
+#define TIME_RESOLUTION (10)
+#define TRACE_CAPACITY (65536)
+#define ACK_TIMEOUT (100000)
+#define NANOSECONDS_PER_SECOND (1000000000)
+#define NANOSECONDS_PER_MILLISECOND (1000000)
+#define NANOSECONDS_PER_MICROSECOND (1000)
+
+typedef struct {
+    const char *name;
+    enum FusesLoopMode loopMode;
+} Mode;
+
+static const Mode modes[] = {
+    { "deadline", FUSES_LOOP_DEADLINE },
+    { "polling", FUSES_LOOP_POLLING }
+};
+
+typedef struct {
+    int64_t values[COMMAND_COUNT];
+    size_t count;
+} Samples;
+
+static FusesTraceEvent _events[TRACE_CAPACITY];
+
+static uint64_t _getCurrentTimeNanoseconds(void) {
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    return (uint64_t)currentTime.tv_sec * NANOSECONDS_PER_SECOND + currentTime.tv_nsec;
+}
+
+static int _compareSamples(const void *a, const void *b) {
+    int64_t x = *(const int64_t*)a;
+    int64_t y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void _printSamples(const char *mode, const char *name, Samples *samples) {
+    size_t count = samples->count;
+    if (count == 0) { return; }
+    qsort(samples->values, count, sizeof(int64_t), _compareSamples);
+    printf(
+        "%-9s %-9s %6zu %9.1f %9.1f %9.1f %9.1f\n",
+        mode, name, count, samples->values[0] / 1e3, samples->values[count / 2] / 1e3,
+        samples->values[count * 99 / 100] / 1e3, samples->values[count - 1] / 1e3
+    );
+}
+
+static void _setCue(void *context, uint32_t cueIndex, FusesCue *cue) {
+    cue->timestamp = (uint64_t)cueIndex * CUE_SPACING * NANOSECONDS_PER_MILLISECOND;
+    cue->i2cDeviceIndex = cueIndex % DEVICE_COUNT;
+    cue->fuseIndex = (cueIndex / DEVICE_COUNT) % 16;
+}
+
+// time of the last trace event of command, 0 if there is none
+static uint64_t _commandTime(FusesObject *fuses, enum FusesTraceCommand command) {
+    uint64_t timestamp = 0;
+    size_t count = fusesDrainTrace(fuses, _events, TRACE_CAPACITY);
+    for (size_t i = 0; i < count; ++i) {
+        if (_events[i].type == FUSES_TRACE_COMMAND && _events[i].command == command) {
+            timestamp = _events[i].timestamp;
+        }
+    }
+    return timestamp;
+}
+
+static bool _run(const Mode *mode, uint8_t *show, size_t showSize) {
+    I2cSimulationConfiguration simulationConfiguration = { .clockFrequency = I2C_FAST_MODE_FREQUENCY };
+    I2cTransport *simulation = i2cSimulationInit(&simulationConfiguration);
+    FusesConfiguration configuration = {
+        .rawData = show,
+        .rawDataSize = showSize,
+        .busName = BUS_NAME,
+        .busNameLength = strlen(BUS_NAME),
+        .transport = simulation,
+        .fuseDuration = FUSE_DURATION,
+        .timeResolution = TIME_RESOLUTION,
+        .loopMode = mode->loopMode,
+        .traceCapacity = TRACE_CAPACITY
+    };
+    FusesObject *fuses = fusesInit(&configuration);
+    if (fuses == NULL || fusesGetError(fuses)->level == FUSES_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "fusesInit failed: %s\n", fuses ? fusesGetErrorString(fusesGetError(fuses)) : "");
+        return false;
+    }
+
+    Samples post = { .count = 0 };
+    Samples effect = { .count = 0 };
+    Samples ack = { .count = 0 };
+    Samples blocking = { .count = 0 };
+    fusesPlay(fuses, NULL);
+    for (int i = 0; i < COMMAND_COUNT; ++i) {
+        usleep(COMMAND_INTERVAL * 1000);
+        bool pause = i % 2 == 0;
+        _commandTime(fuses, FUSES_TRACE_COMMAND_PLAY);
+
+        FusesCommandTicket ticket;
+        uint64_t start = _getCurrentTimeNanoseconds();
+        if (!fusesPostCommand(fuses, pause ? FUSES_COMMAND_PAUSE : FUSES_COMMAND_PLAY, 0, &ticket)) { continue; }
+        uint64_t posted = _getCurrentTimeNanoseconds();
+        bool acknowledged = fusesWaitCommand(fuses, ticket, ACK_TIMEOUT);
+        uint64_t acknowledgedTime = _getCurrentTimeNanoseconds();
+        uint64_t effectTime = _commandTime(fuses, pause ? FUSES_TRACE_COMMAND_PAUSE : FUSES_TRACE_COMMAND_PLAY);
+        post.values[post.count++] = posted - start;
+        if (acknowledged) {
+            ack.values[ack.count++] = acknowledgedTime - start;
+        }
+        if (effectTime != 0) {
+            effect.values[effect.count++] = effectTime - start;
+        }
+    }
+    for (int i = 0; i < COMMAND_COUNT; ++i) {
+        usleep(COMMAND_INTERVAL * 1000);
+        uint64_t start = _getCurrentTimeNanoseconds();
+        bool applied = fusesGetIsPlaying(fuses) ? fusesPause(fuses, NULL) : fusesPlay(fuses, NULL);
+        if (applied) {
+            blocking.values[blocking.count++] = _getCurrentTimeNanoseconds() - start;
+        }
+    }
+    fusesStop(fuses, NULL);
+
+    _printSamples(mode->name, "post", &post);
+    _printSamples(mode->name, "effect", &effect);
+    _printSamples(mode->name, "ack", &ack);
+    _printSamples(mode->name, "blocking", &blocking);
+    fusesDestroy(fuses);
+    i2cSimulationDestroy(simulation);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    BenchShowConfiguration showConfiguration = {
+        .deviceCount = DEVICE_COUNT,
+        .cueCount = CUE_COUNT,
+        .baseDeviceAddress = BASE_DEVICE_ADDRESS,
+        .cuePattern = _setCue
+    };
+    size_t showSize;
+    uint8_t *show = benchShowCreate(&showConfiguration, &showSize);
+    if (show == NULL) { return EXIT_FAILURE; }
+
+    printf("%-9s %-9s %6s %9s %9s %9s %9s\n", "loop", "latency", "count", "min", "median", "p99", "max");
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+        if (!_run(&modes[i], show, showSize)) {
+            free(show);
+            return EXIT_FAILURE;
+        }
+    }
+    free(show);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,134 @@
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/fuses.h"
+#include "../src/fusesFormat.h"
+#include "../src/i2cSimulation.h"
+#include "benchShow.h"
+
+/**
+ * Compares two ways for a host to follow a show on the simulated bus:
+ * spinning on fusesGetIsPlaying, as bin/fusePlayer used to, and blocking
+ * in poll on the event descriptor. Prints the CPU time the waiting
+ * thread burned and, for events, the delay from raising a cue event to
+ * the host reading it (microseconds) and whether SHOW_FINISHED arrived.
+ *
+ * Build: make bench, run: bin/eventBenchmark
+*/
+
+#define CUE_COUNT (400)
+#define CUE_SPACING (5)
+#define FUSE_DURATION (50)
+#define DEVICE_COUNT (4)
+#define BASE_DEVICE_ADDRESS (0b1100000)
+#define BUS_NAME ("/dev/i2c-1")
+#define EVENT_CAPACITY (1024)
+#define EVENT_BATCH_SIZE (64)
+#define NO_TIMEOUT (-1)
+#define NANOSECONDS_PER_SECOND (1000000000)
+#define NANOSECONDS_PER_MILLISECOND (1000000)
+
+static uint64_t _getTimeNanoseconds(clockid_t clock) {
+    struct timespec currentTime;
+    clock_gettime(clock, &currentTime);
+    return (uint64_t)currentTime.tv_sec * NANOSECONDS_PER_SECOND + currentTime.tv_nsec;
+}
+
+static int _compareSamples(const void *a, const void *b) {
+    int64_t x = *(const int64_t*)a;
+    int64_t y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void _setCue(void *context, uint32_t cueIndex, FusesCue *cue) {
+    cue->timestamp = (uint64_t)cueIndex * CUE_SPACING * NANOSECONDS_PER_MILLISECOND;
+    cue->i2cDeviceIndex = cueIndex % DEVICE_COUNT;
+    cue->fuseIndex = (cueIndex / DEVICE_COUNT) % 16;
+}
+
+static bool _run(bool useEvents, uint8_t *show, size_t showSize) {
+    I2cSimulationConfiguration simulationConfiguration = { .clockFrequency = I2C_FAST_MODE_FREQUENCY };
+    I2cTransport *simulation = i2cSimulationInit(&simulationConfiguration);
+    FusesConfiguration configuration = {
+        .rawData = show,
+        .rawDataSize = showSize,
+        .busName = BUS_NAME,
+        .busNameLength = strlen(BUS_NAME),
+        .transport = simulation,
+        .fuseDuration = FUSE_DURATION,
+        .eventCapacity = useEvents ? EVENT_CAPACITY : 0
+    };
+    FusesObject *fuses = fusesInit(&configuration);
+    if (fuses == NULL || fusesGetError(fuses)->level == FUSES_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "fusesInit failed: %s\n", fuses ? fusesGetErrorString(fusesGetError(fuses)) : "");
+        return false;
+    }
+
+    int64_t delays[CUE_COUNT];
+    size_t delayCount = 0;
+    bool finished = false;
+    uint64_t cpuStart = _getTimeNanoseconds(CLOCK_THREAD_CPUTIME_ID);
+    uint64_t wallStart = _getTimeNanoseconds(CLOCK_MONOTONIC);
+    fusesPlay(fuses, NULL);
+    if (useEvents) {
+        struct pollfd eventDescriptor = { .fd = fusesGetEventFileDescriptor(fuses), .events = POLLIN };
+        FusesEvent events[EVENT_BATCH_SIZE];
+        while (!finished && poll(&eventDescriptor, 1, NO_TIMEOUT) > 0) {
+            size_t count;
+            while ((count = fusesReadEvents(fuses, events, EVENT_BATCH_SIZE)) > 0) {
+                uint64_t now = _getTimeNanoseconds(CLOCK_MONOTONIC);
+                for (size_t i = 0; i < count; ++i) {
+                    if (events[i].type == FUSES_EVENT_CUE_FIRED && delayCount < CUE_COUNT) {
+                        delays[delayCount++] = now - events[i].timestamp;
+                    } else if (events[i].type == FUSES_EVENT_SHOW_FINISHED) {
+                        finished = true;
+                    }
+                }
+            }
+        }
+    } else {
+        while (fusesGetIsPlaying(fuses));
+    }
+    uint64_t wall = _getTimeNanoseconds(CLOCK_MONOTONIC) - wallStart;
+    uint64_t cpu = _getTimeNanoseconds(CLOCK_THREAD_CPUTIME_ID) - cpuStart;
+
+    printf(
+        "%-16s %9.1f %9.1f %5.1f%%", useEvents ? "poll on events" : "spin on getter",
+        wall / 1e6, cpu / 1e6, 100.0 * cpu / wall
+    );
+    if (delayCount > 0) {
+        qsort(delays, delayCount, sizeof(int64_t), _compareSamples);
+        printf(
+            " %6zu %9.1f %9.1f %9.1f %s", delayCount, delays[delayCount / 2] / 1e3,
+            delays[delayCount * 99 / 100] / 1e3, delays[delayCount - 1] / 1e3, finished ? "yes" : "no"
+        );
+    }
+    printf("\n");
+    fusesDestroy(fuses);
+    i2cSimulationDestroy(simulation);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    BenchShowConfiguration showConfiguration = {
+        .deviceCount = DEVICE_COUNT,
+        .cueCount = CUE_COUNT,
+        .baseDeviceAddress = BASE_DEVICE_ADDRESS,
+        .cuePattern = _setCue
+    };
+    size_t showSize;
+    uint8_t *show = benchShowCreate(&showConfiguration, &showSize);
+    if (show == NULL) { return EXIT_FAILURE; }
+
+    printf(
+        "%-16s %9s %9s %6s %6s %9s %9s %9s %s\n",
+        "host waits by", "wall[ms]", "cpu[ms]", "cpu", "events", "median", "p99", "max", "finished"
+    );
+    bool success = _run(false, show, showSize) && _run(true, show, showSize);
+    free(show);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,319 @@
+#include "i2cDevStub.h"
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+#include <linux/i2c-dev.h>
+#include <linux/i2c.h>
+
+#define STUB_BUS_PREFIX ("/dev/i2c-")
+#define STUB_BUS_COUNT (16)
+#define STUB_ADDRESS_COUNT (128)
+#define STUB_REGISTER_COUNT (256)
+#define STUB_MAX_FILE_DESCRIPTORS (4096)
+#define NO_DEVICE_SELECTED (-1)
+
+int __real_open(const char *path, int flags, ...);
+int __real_close(int fileDescriptor);
+int __real_ioctl(int fileDescriptor, unsigned long request, ...);
+ssize_t __real_read(int fileDescriptor, void *buffer, size_t count);
+ssize_t __real_write(int fileDescriptor, const void *buffer, size_t count);
+
+typedef struct {
+    bool isStub;
+    int busNumber;
+    int selectedAddress;
+} _StubFile;
+
+static _StubFile _files[STUB_MAX_FILE_DESCRIPTORS];
+static uint8_t _registers[STUB_BUS_COUNT][STUB_ADDRESS_COUNT][STUB_REGISTER_COUNT];
+// Like the real boards every device keeps its own auto-incrementing pointer.
+static uint8_t _registerPointers[STUB_BUS_COUNT][STUB_ADDRESS_COUNT];
+static bool _absent[STUB_BUS_COUNT][STUB_ADDRESS_COUNT];
+static I2cStubCounters _counters;
+static bool _combinedTransfers = true;
+static uint32_t _transactionDelay = 0;
+static pthread_mutex_t _lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Blocks the caller like a transaction on a real wire would.
+ * Called without _lock held, so transactions on different buses overlap.
+*/
+static void _delayTransaction(void) {
+    uint32_t delay = __atomic_load_n(&_transactionDelay, __ATOMIC_RELAXED);
+    if (delay == 0) { return; }
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    uint64_t nanoseconds = (uint64_t)end.tv_nsec + (uint64_t)delay * 1000;
+    end.tv_sec += nanoseconds / 1000000000;
+    end.tv_nsec = nanoseconds % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &end, NULL) == EINTR);
+}
+
+static _StubFile * _stubFile(int fileDescriptor) {
+    if (fileDescriptor < 0 || fileDescriptor >= STUB_MAX_FILE_DESCRIPTORS) { return NULL; }
+    return _files[fileDescriptor].isStub ? &_files[fileDescriptor] : NULL;
+}
+
+int __wrap_open(const char *path, int flags, ...) {
+    if (strncmp(path, STUB_BUS_PREFIX, strlen(STUB_BUS_PREFIX)) != 0) {
+        mode_t mode = 0;
+        if (flags & O_CREAT) {
+            va_list arguments;
+            va_start(arguments, flags);
+            mode = va_arg(arguments, mode_t);
+            va_end(arguments);
+        }
+        return __real_open(path, flags, mode);
+    }
+
+    int busNumber = atoi(path + strlen(STUB_BUS_PREFIX));
+    if (busNumber < 0 || busNumber >= STUB_BUS_COUNT) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    // A real descriptor keeps numbers unique and makes close() cost a syscall.
+    int fileDescriptor = __real_open("/dev/null", O_RDWR);
+    if (fileDescriptor < 0 || fileDescriptor >= STUB_MAX_FILE_DESCRIPTORS) {
+        errno = EMFILE;
+        return -1;
+    }
+    pthread_mutex_lock(&_lock);
+    ++_counters.open;
+    _files[fileDescriptor] = (_StubFile){
+        .isStub = true,
+        .busNumber = busNumber,
+        .selectedAddress = NO_DEVICE_SELECTED
+    };
+    pthread_mutex_unlock(&_lock);
+    return fileDescriptor;
+}
+
+int __wrap_close(int fileDescriptor) {
+    pthread_mutex_lock(&_lock);
+    _StubFile *file = _stubFile(fileDescriptor);
+    if (file != NULL) {
+        ++_counters.close;
+        file->isStub = false;
+    }
+    pthread_mutex_unlock(&_lock);
+    return __real_close(fileDescriptor);
+}
+
+static int _transferMessages(_StubFile *file, struct i2c_rdwr_ioctl_data *transaction) {
+    if (transaction->nmsgs > I2C_RDWR_IOCTL_MAX_MSGS) {
+        errno = EINVAL;
+        return -1;
+    }
+    ++_counters.transactions;
+    for (uint32_t i = 0; i < transaction->nmsgs; ++i) {
+        struct i2c_msg *message = &transaction->msgs[i];
+        if (message->addr >= STUB_ADDRESS_COUNT) {
+            errno = EINVAL;
+            return -1;
+        }
+        if (_absent[file->busNumber][message->addr]) {
+            errno = ENXIO;
+            return -1;
+        }
+        uint8_t *bank = _registers[file->busNumber][message->addr];
+        uint8_t *pointer = &_registerPointers[file->busNumber][message->addr];
+        if (message->flags & I2C_M_RD) {
+            for (uint16_t j = 0; j < message->len; ++j) {
+                message->buf[j] = bank[(*pointer)++];
+            }
+            continue;
+        }
+        if (message->len > 0) {
+            *pointer = message->buf[0];
+        }
+        for (uint16_t j = 1; j < message->len; ++j) {
+            bank[(*pointer)++] = message->buf[j];
+        }
+    }
+    return (int)transaction->nmsgs;
+}
+
+/**
+ * @brief The quick write and byte read of a probe.
+*/
+static int _smbusTransfer(_StubFile *file, struct i2c_smbus_ioctl_data *transaction) {
+    if (file->selectedAddress == NO_DEVICE_SELECTED) {
+        errno = EREMOTEIO;
+        return -1;
+    }
+    ++_counters.transactions;
+    if (_absent[file->busNumber][file->selectedAddress]) {
+        errno = ENXIO;
+        return -1;
+    }
+    if (transaction->size == I2C_SMBUS_QUICK) { return 0; }
+    if (transaction->size == I2C_SMBUS_BYTE && transaction->read_write == I2C_SMBUS_READ) {
+        uint8_t *pointer = &_registerPointers[file->busNumber][file->selectedAddress];
+        transaction->data->byte = _registers[file->busNumber][file->selectedAddress][(*pointer)++];
+        return 0;
+    }
+    errno = EOPNOTSUPP;
+    return -1;
+}
+
+int __wrap_ioctl(int fileDescriptor, unsigned long request, ...) {
+    va_list arguments;
+    va_start(arguments, request);
+    unsigned long argument = va_arg(arguments, unsigned long);
+    va_end(arguments);
+
+    pthread_mutex_lock(&_lock);
+    _StubFile *file = _stubFile(fileDescriptor);
+    if (file == NULL) {
+        pthread_mutex_unlock(&_lock);
+        return __real_ioctl(fileDescriptor, request, argument);
+    }
+    ++_counters.ioctl;
+    int result = 0;
+    switch (request) {
+        case I2C_SLAVE:
+        case I2C_SLAVE_FORCE:
+            if (argument >= STUB_ADDRESS_COUNT) {
+                errno = EINVAL;
+                result = -1;
+                break;
+            }
+            file->selectedAddress = (int)argument;
+            break;
+
+        case I2C_FUNCS:
+            *(unsigned long*)argument = I2C_FUNC_SMBUS_QUICK | I2C_FUNC_SMBUS_BYTE
+                | (_combinedTransfers ? I2C_FUNC_I2C : 0);
+            break;
+
+        case I2C_SMBUS:
+            result = _smbusTransfer(file, (struct i2c_smbus_ioctl_data*)argument);
+            break;
+
+        case I2C_RDWR:
+            if (!_combinedTransfers) {
+                errno = EOPNOTSUPP;
+                result = -1;
+                break;
+            }
+            result = _transferMessages(file, (struct i2c_rdwr_ioctl_data*)argument);
+            break;
+
+        default:
+            errno = ENOTTY;
+            result = -1;
+            break;
+    }
+    pthread_mutex_unlock(&_lock);
+    // A probe occupies the wire whether the device answers or not.
+    if ((request == I2C_RDWR && result >= 0) || request == I2C_SMBUS) {
+        _delayTransaction();
+    }
+    return result;
+}
+
+ssize_t __wrap_read(int fileDescriptor, void *buffer, size_t count) {
+    pthread_mutex_lock(&_lock);
+    _StubFile *file = _stubFile(fileDescriptor);
+    if (file == NULL) {
+        pthread_mutex_unlock(&_lock);
+        return __real_read(fileDescriptor, buffer, count);
+    }
+    ++_counters.read;
+    ++_counters.transactions;
+    if (file->selectedAddress == NO_DEVICE_SELECTED || _absent[file->busNumber][file->selectedAddress]) {
+        pthread_mutex_unlock(&_lock);
+        errno = file->selectedAddress == NO_DEVICE_SELECTED ? EREMOTEIO : ENXIO;
+        return -1;
+    }
+    uint8_t *bank = _registers[file->busNumber][file->selectedAddress];
+    uint8_t *pointer = &_registerPointers[file->busNumber][file->selectedAddress];
+    for (size_t i = 0; i < count; ++i) {
+        ((uint8_t*)buffer)[i] = bank[(*pointer)++];
+    }
+    pthread_mutex_unlock(&_lock);
+    _delayTransaction();
+    return (ssize_t)count;
+}
+
+ssize_t __wrap_write(int fileDescriptor, const void *buffer, size_t count) {
+    pthread_mutex_lock(&_lock);
+    _StubFile *file = _stubFile(fileDescriptor);
+    if (file == NULL) {
+        pthread_mutex_unlock(&_lock);
+        return __real_write(fileDescriptor, buffer, count);
+    }
+    ++_counters.write;
+    ++_counters.transactions;
+    if (file->selectedAddress == NO_DEVICE_SELECTED || _absent[file->busNumber][file->selectedAddress]) {
+        pthread_mutex_unlock(&_lock);
+        errno = file->selectedAddress == NO_DEVICE_SELECTED ? EREMOTEIO : ENXIO;
+        return -1;
+    }
+    uint8_t *bank = _registers[file->busNumber][file->selectedAddress];
+    uint8_t *pointer = &_registerPointers[file->busNumber][file->selectedAddress];
+    const uint8_t *bytes = (const uint8_t*)buffer;
+    if (count > 0) {
+        *pointer = bytes[0];
+    }
+    for (size_t i = 1; i < count; ++i) {
+        bank[(*pointer)++] = bytes[i];
+    }
+    pthread_mutex_unlock(&_lock);
+    _delayTransaction();
+    return (ssize_t)count;
+}
+
+void i2cStubResetCounters(void) {
+    pthread_mutex_lock(&_lock);
+    memset(&_counters, 0, sizeof(_counters));
+    pthread_mutex_unlock(&_lock);
+}
+
+I2cStubCounters i2cStubGetCounters(void) {
+    pthread_mutex_lock(&_lock);
+    I2cStubCounters counters = _counters;
+    pthread_mutex_unlock(&_lock);
+    return counters;
+}
+
+uint64_t i2cStubGetTotalSyscalls(I2cStubCounters *counters) {
+    return counters->open + counters->close + counters->ioctl
+        + counters->read + counters->write;
+}
+
+void i2cStubSetCombinedTransfers(bool enabled) {
+    pthread_mutex_lock(&_lock);
+    _combinedTransfers = enabled;
+    pthread_mutex_unlock(&_lock);
+}
+
+void i2cStubSetTransactionDelay(uint32_t microseconds) {
+    __atomic_store_n(&_transactionDelay, microseconds, __ATOMIC_RELAXED);
+}
+
+uint8_t i2cStubGetRegister(int busNumber, uint8_t deviceAddress, uint8_t registerAddress) {
+    pthread_mutex_lock(&_lock);
+    uint8_t value = _registers[busNumber][deviceAddress][registerAddress];
+    pthread_mutex_unlock(&_lock);
+    return value;
+}
+
+void i2cStubSetRegister(int busNumber, uint8_t deviceAddress, uint8_t registerAddress, uint8_t value) {
+    pthread_mutex_lock(&_lock);
+    _registers[busNumber][deviceAddress][registerAddress] = value;
+    pthread_mutex_unlock(&_lock);
+}
+
+void i2cStubSetDevicePresent(int busNumber, uint8_t deviceAddress, bool present) {
+    pthread_mutex_lock(&_lock);
+    _absent[busNumber][deviceAddress] = !present;
+    pthread_mutex_unlock(&_lock);
+}
@@ -0,0 +1,41 @@
+#ifndef __I2C_DEV_STUB_H__
+#define __I2C_DEV_STUB_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief In-process stand-in for the Linux i2c-dev driver.
+ *
+ * Linking with -Wl,--wrap=open,--wrap=close,--wrap=ioctl,--wrap=read,--wrap=write
+ * routes every /dev/i2c-N descriptor into a simulated register bank while all
+ * other descriptors are passed through to the real system calls. Every call
+ * that reaches the stand-in is counted so benchmarks can report syscalls.
+*/
+
+typedef struct {
+    uint64_t open;
+    uint64_t close;
+    uint64_t ioctl;
+    uint64_t read;
+    uint64_t write;
+    // START..STOP sequences on the simulated wire
+    uint64_t transactions;
+} I2cStubCounters;
+
+void i2cStubResetCounters(void);
+I2cStubCounters i2cStubGetCounters(void);
+uint64_t i2cStubGetTotalSyscalls(I2cStubCounters *counters);
+
+// Adapters without I2C_FUNC_I2C reject I2C_RDWR, like SMBus-only controllers.
+void i2cStubSetCombinedTransfers(bool enabled);
+
+// Every read, write, I2C_RDWR and I2C_SMBUS blocks its caller for this long.
+void i2cStubSetTransactionDelay(uint32_t microseconds);
+
+uint8_t i2cStubGetRegister(int busNumber, uint8_t deviceAddress, uint8_t registerAddress);
+void i2cStubSetRegister(int busNumber, uint8_t deviceAddress, uint8_t registerAddress, uint8_t value);
+// every address answers until it is set missing; a missing device NACKs with ENXIO
+void i2cStubSetDevicePresent(int busNumber, uint8_t deviceAddress, bool present);
+
+#endif // __I2C_DEV_STUB_H__
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+
+#include "../src/i2c.h"
+#include "i2cDevStub.h"
+
+/**
+ * Compares the syscalls needed to fire one cue (read-modify-write to light
+ * the fuse, read-modify-write to extinguish it) with the original
+ * open/ioctl/close-per-byte access and with persistent bus handles, both
+ * on an adapter limited to read()/write() and on one that takes I2C_RDWR.
+ * A second table compares updating all four fuse registers byte by byte
+ * with a single block write.
+ *
+ * Build: make bench, run: bin/i2cHandleBenchmark [cueCount] [deviceCount]
+*/
+
+#define BUS_NAME ("/dev/i2c-1")
+#define BASE_DEVICE_ADDRESS (0b1100000)
+#define FUSE_REGISTER_BASE_ADDRESS (0x14)
+#define FUSES_PER_REGISTER (4)
+#define MAX_FUSE_COUNT_PER_DEVICE (16)
+#define DEFAULT_CUE_COUNT (100000)
+#define DEFAULT_DEVICE_COUNT (4)
+#define MAX_DEVICE_COUNT (16)
+#define FUSE_REGISTER_COUNT (4)
+#define NANOSECONDS_PER_SECOND (1000000000ull)
+
+typedef void (*FireCue)(int cue, int deviceCount);
+typedef void (*UpdateRegisters)(I2cDevice *device, uint8_t *values);
+
+static I2cDevice *_devices[MAX_DEVICE_COUNT];
+
+static uint64_t _now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * NANOSECONDS_PER_SECOND + time.tv_nsec;
+}
+
+// The per-byte access pattern of the original i2c.c.
+static void _legacyWriteByte(uint8_t deviceAddress, uint8_t registerAddress, uint8_t value) {
+    int fileDescriptor = open(BUS_NAME, O_RDWR);
+    ioctl(fileDescriptor, I2C_SLAVE, deviceAddress);
+    uint8_t buffer[2] = { registerAddress, value };
+    write(fileDescriptor, buffer, sizeof(buffer));
+    close(fileDescriptor);
+}
+
+static uint8_t _legacyReadByte(uint8_t deviceAddress, uint8_t registerAddress) {
+    int fileDescriptor = open(BUS_NAME, O_RDWR);
+    ioctl(fileDescriptor, I2C_SLAVE, deviceAddress);
+    uint8_t value = 0;
+    write(fileDescriptor, &registerAddress, 1);
+    read(fileDescriptor, &value, 1);
+    close(fileDescriptor);
+    return value;
+}
+
+static void _fireLegacy(int cue, int deviceCount) {
+    uint8_t deviceAddress = BASE_DEVICE_ADDRESS | (cue % deviceCount);
+    int fuseIndex = cue % MAX_FUSE_COUNT_PER_DEVICE;
+    uint8_t registerAddress = FUSE_REGISTER_BASE_ADDRESS + fuseIndex / FUSES_PER_REGISTER;
+    uint8_t mask = 0b11 << (2 * (fuseIndex % FUSES_PER_REGISTER));
+
+    uint8_t value = _legacyReadByte(deviceAddress, registerAddress);
+    _legacyWriteByte(deviceAddress, registerAddress, value | mask);
+    value = _legacyReadByte(deviceAddress, registerAddress);
+    _legacyWriteByte(deviceAddress, registerAddress, value & ~mask);
+}
+
+static void _firePersistent(int cue, int deviceCount) {
+    I2cDevice *device = _devices[cue % deviceCount];
+    int fuseIndex = cue % MAX_FUSE_COUNT_PER_DEVICE;
+    uint8_t registerAddress = FUSE_REGISTER_BASE_ADDRESS + fuseIndex / FUSES_PER_REGISTER;
+    uint8_t mask = 0b11 << (2 * (fuseIndex % FUSES_PER_REGISTER));
+
+    uint8_t value = i2cReadByte(device, registerAddress);
+    i2cWriteByte(device, registerAddress, value | mask);
+    value = i2cReadByte(device, registerAddress);
+    i2cWriteByte(device, registerAddress, value & ~mask);
+}
+
+static void _writeRegistersBytewise(I2cDevice *device, uint8_t *values) {
+    for (int i = 0; i < FUSE_REGISTER_COUNT; ++i) {
+        i2cWriteByte(device, FUSE_REGISTER_BASE_ADDRESS + i, values[i]);
+    }
+}
+
+static void _writeRegistersBlock(I2cDevice *device, uint8_t *values) {
+    i2cWriteBlock(device, FUSE_REGISTER_BASE_ADDRESS, values, FUSE_REGISTER_COUNT);
+}
+
+static bool _initDevices(int deviceCount, bool combinedTransfers) {
+    // Destroying every device closes the shared bus so the next
+    // i2cInit queries the adapter functionality again.
+    for (int i = 0; i < deviceCount; ++i) {
+        if (_devices[i] != NULL) {
+            i2cDestroy(_devices[i]);
+        }
+    }
+    i2cStubSetCombinedTransfers(combinedTransfers);
+    for (int i = 0; i < deviceCount; ++i) {
+        _devices[i] = i2cInit(BUS_NAME, strlen(BUS_NAME), BASE_DEVICE_ADDRESS | i);
+        if (_devices[i] == NULL || i2cGetError(_devices[i])->level == I2C_ERROR_LEVEL_ERROR) {
+            fprintf(stderr, "i2cInit failed for device %d\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void _runRegisters(char *name, UpdateRegisters update, int updateCount) {
+    uint8_t values[FUSE_REGISTER_COUNT];
+    i2cStubResetCounters();
+    uint64_t start = _now();
+    for (int i = 0; i < updateCount; ++i) {
+        memset(values, i, sizeof(values));
+        update(_devices[0], values);
+    }
+    uint64_t elapsed = _now() - start;
+    I2cStubCounters counters = i2cStubGetCounters();
+    printf(
+        "%-12s %8.2f %12.2f %10.0f\n",
+        name,
+        (double)i2cStubGetTotalSyscalls(&counters) / updateCount,
+        (double)counters.transactions / updateCount,
+        (double)elapsed / updateCount
+    );
+}
+
+static void _run(char *name, FireCue fire, int cueCount, int deviceCount) {
+    i2cStubResetCounters();
+    uint64_t start = _now();
+    for (int cue = 0; cue < cueCount; ++cue) {
+        fire(cue, deviceCount);
+    }
+    uint64_t elapsed = _now() - start;
+    I2cStubCounters counters = i2cStubGetCounters();
+
+    printf(
+        "%-12s %8.2f %12.2f %6.2f %6.2f %6.2f %6.2f %6.2f %10.0f\n",
+        name,
+        (double)i2cStubGetTotalSyscalls(&counters) / cueCount,
+        (double)counters.transactions / cueCount,
+        (double)counters.open / cueCount,
+        (double)counters.ioctl / cueCount,
+        (double)counters.read / cueCount,
+        (double)counters.write / cueCount,
+        (double)counters.close / cueCount,
+        (double)elapsed / cueCount
+    );
+}
+
+int main(int argc, char *argv[]) {
+    int cueCount = argc > 1 ? atoi(argv[1]) : DEFAULT_CUE_COUNT;
+    int deviceCount = argc > 2 ? atoi(argv[2]) : DEFAULT_DEVICE_COUNT;
+    if (cueCount <= 0 || deviceCount <= 0 || deviceCount > MAX_DEVICE_COUNT) {
+        fprintf(stderr, "usage: %s [cueCount] [deviceCount <= %d]\n", argv[0], MAX_DEVICE_COUNT);
+        return EXIT_FAILURE;
+    }
+
+    printf("%d cues, %d devices on %s, per fired cue:\n", cueCount, deviceCount, BUS_NAME);
+    printf("%-12s %8s %12s %6s %6s %6s %6s %6s %10s\n",
+        "mode", "syscalls", "transactions", "open", "ioctl", "read", "write", "close", "ns");
+    _run("per-byte", _fireLegacy, cueCount, deviceCount);
+    if (!_initDevices(deviceCount, false)) { return EXIT_FAILURE; }
+    _run("read/write", _firePersistent, cueCount, deviceCount);
+    if (!_initDevices(deviceCount, true)) { return EXIT_FAILURE; }
+    _run("I2C_RDWR", _firePersistent, cueCount, deviceCount);
+
+    printf("\nupdating all %d fuse registers of one device:\n", FUSE_REGISTER_COUNT);
+    printf("%-12s %8s %12s %10s\n", "mode", "syscalls", "transactions", "ns");
+    _runRegisters("bytewise", _writeRegistersBytewise, cueCount);
+    _runRegisters("block", _writeRegistersBlock, cueCount);
+
+    for (int i = 0; i < deviceCount; ++i) {
+        i2cDestroy(_devices[i]);
+    }
+    return EXIT_SUCCESS;
+}
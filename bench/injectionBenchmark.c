@@ -0,0 +1,206 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/fuses.h"
+#include "../src/fusesFormat.h"
+#include "../src/i2cSimulation.h"
+#include "benchShow.h"
+
+/**
+ * Plays a steady show on a simulated bus, alone and while injector
+ * threads add batches of cues a few milliseconds ahead and cancel half of
+ * them again. Printed are the ignite lateness of the show's cues and of
+ * the injected ones (microseconds), the injected cues fired and cancelled
+ * and the cost of fusesInjectCues per cue on the injecting threads (ns).
+ *
+ * Build: make bench, run: bin/injectionBenchmark
+*/
+
+#define CUE_COUNT (20000)
+#define CUE_SPACING (250000)
+#define FUSE_DURATION (5)
+#define DEVICE_COUNT (16)
+#define FUSE_COUNT_PER_DEVICE (16)
+#define BASE_DEVICE_ADDRESS (0b1100000)
+#define BUS_NAME ("/dev/i2c-1")
+#define INJECTOR_COUNT (4)
+#define BATCH_SIZE (8)
+#define BATCH_INTERVAL (500)
+#define INJECTION_CAPACITY (1024)
+#define MAX_LATENESS_SAMPLES (CUE_COUNT * 4)
+#define POLL_INTERVAL (1000)
+#define NANOSECONDS_PER_SECOND (1000000000)
+
+typedef struct {
+    int32_t *samples;
+    size_t count;
+} _Samples;
+
+typedef struct {
+    _Samples showLateness;
+    _Samples injectedLateness;
+} _Lateness;
+
+typedef struct {
+    FusesObject *fuses;
+    uint32_t seed;
+    bool *running;
+    uint64_t postTime;
+    uint64_t postedCount;
+} _Injector;
+
+static uint64_t _getCurrentTimeNanoseconds(void) {
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    return (uint64_t)currentTime.tv_sec * NANOSECONDS_PER_SECOND + currentTime.tv_nsec;
+}
+
+static int _compare(const void *a, const void *b) {
+    int32_t x = *(const int32_t*)a;
+    int32_t y = *(const int32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static int32_t _percentile(_Samples *samples, int percent) {
+    if (samples->count == 0) { return 0; }
+    qsort(samples->samples, samples->count, sizeof(int32_t), _compare);
+    size_t index = samples->count * percent / 100;
+    return samples->samples[index < samples->count ? index : samples->count - 1];
+}
+
+// Runs on the timing thread.
+static void _handleEvent(void *context, const FusesEvent *event) {
+    _Lateness *lateness = (_Lateness*)context;
+    _Samples *samples = (event->cueIndex & FUSES_INJECTED_CUE_FLAG)
+        ? &lateness->injectedLateness : &lateness->showLateness;
+    if (samples->count < MAX_LATENESS_SAMPLES) {
+        samples->samples[samples->count++] = event->lateness;
+    }
+}
+
+static void * _inject(void *argument) {
+    _Injector *injector = (_Injector*)argument;
+    FusesInjectedCue cues[BATCH_SIZE];
+    FusesCueId ids[BATCH_SIZE];
+    while (__atomic_load_n(injector->running, __ATOMIC_ACQUIRE)) {
+        for (int i = 0; i < BATCH_SIZE; ++i) {
+            cues[i].milliseconds = 2 + rand_r(&injector->seed) % 8;
+            cues[i].microseconds = rand_r(&injector->seed) % 1000;
+            cues[i].relative = true;
+            cues[i].i2cDeviceIndex = rand_r(&injector->seed) % DEVICE_COUNT;
+            cues[i].fuseIndex = rand_r(&injector->seed) % FUSE_COUNT_PER_DEVICE;
+        }
+        uint64_t start = _getCurrentTimeNanoseconds();
+        size_t injected = fusesInjectCues(injector->fuses, cues, BATCH_SIZE, ids);
+        injector->postTime += _getCurrentTimeNanoseconds() - start;
+        injector->postedCount += injected;
+        for (size_t i = 0; i < injected; i += 2) {
+            fusesCancelCue(injector->fuses, ids[i]);
+        }
+        usleep(BATCH_INTERVAL);
+    }
+    return NULL;
+}
+
+static void _setCue(void *context, uint32_t cueIndex, FusesCue *cue) {
+    uint32_t fuseSlot = cueIndex % (DEVICE_COUNT * FUSE_COUNT_PER_DEVICE);
+    cue->timestamp = (uint64_t)cueIndex * CUE_SPACING;
+    cue->i2cDeviceIndex = fuseSlot / FUSE_COUNT_PER_DEVICE;
+    cue->fuseIndex = fuseSlot % FUSE_COUNT_PER_DEVICE;
+}
+
+static bool _play(const char *name, uint8_t *show, size_t showSize, int injectorCount) {
+    _Lateness lateness = {
+        .showLateness = { .samples = (int32_t*)malloc(MAX_LATENESS_SAMPLES * sizeof(int32_t)) },
+        .injectedLateness = { .samples = (int32_t*)malloc(MAX_LATENESS_SAMPLES * sizeof(int32_t)) }
+    };
+    I2cSimulationConfiguration simulationConfiguration = { .clockFrequency = 0 };
+    I2cTransport *simulation = i2cSimulationInit(&simulationConfiguration);
+    FusesConfiguration configuration = {
+        .rawData = show,
+        .rawDataSize = showSize,
+        .busName = BUS_NAME,
+        .busNameLength = strlen(BUS_NAME),
+        .transport = simulation,
+        .fuseDuration = FUSE_DURATION,
+        .injectionCapacity = INJECTION_CAPACITY,
+        .eventMask = FUSES_EVENT_MASK(FUSES_EVENT_CUE_FIRED),
+        .eventCallback = _handleEvent,
+        .eventCallbackContext = &lateness
+    };
+    FusesObject *fuses = fusesInit(&configuration);
+    if (
+        lateness.showLateness.samples == NULL || lateness.injectedLateness.samples == NULL
+        || fuses == NULL || fusesGetError(fuses)->level == FUSES_ERROR_LEVEL_ERROR
+    ) {
+        fprintf(stderr, "fusesInit failed: %s\n", fuses ? fusesGetErrorString(fusesGetError(fuses)) : "");
+        return false;
+    }
+
+    bool running = true;
+    _Injector injectors[INJECTOR_COUNT];
+    pthread_t threads[INJECTOR_COUNT];
+    fusesPlay(fuses, NULL);
+    for (int i = 0; i < injectorCount; ++i) {
+        injectors[i] = (_Injector){ .fuses = fuses, .seed = i + 1, .running = &running };
+        pthread_create(&threads[i], NULL, _inject, &injectors[i]);
+    }
+    while (fusesGetIsPlaying(fuses)) {
+        usleep(POLL_INTERVAL);
+        if (fusesGetCurrentTime(fuses) * (uint64_t)1000000 >= (uint64_t)(CUE_COUNT - 1) * CUE_SPACING) {
+            __atomic_store_n(&running, false, __ATOMIC_RELEASE);
+        }
+    }
+    __atomic_store_n(&running, false, __ATOMIC_RELEASE);
+    uint64_t postTime = 0;
+    uint64_t postedCount = 0;
+    for (int i = 0; i < injectorCount; ++i) {
+        pthread_join(threads[i], NULL);
+        postTime += injectors[i].postTime;
+        postedCount += injectors[i].postedCount;
+    }
+    // the last injected cues
+    usleep(20000);
+
+    FusesStatistics statistics = fusesGetStatistics(fuses);
+    printf(
+        "%-10s %8d %8d %8d %8d %8d %8llu %8llu %8.0f\n",
+        name, _percentile(&lateness.showLateness, 50), _percentile(&lateness.showLateness, 99),
+        _percentile(&lateness.showLateness, 100),
+        _percentile(&lateness.injectedLateness, 50), _percentile(&lateness.injectedLateness, 99),
+        (unsigned long long)statistics.injectedCuesFired, (unsigned long long)statistics.injectedCuesCancelled,
+        postedCount > 0 ? (double)postTime / postedCount : 0.0
+    );
+    fusesDestroy(fuses);
+    i2cSimulationDestroy(simulation);
+    free(lateness.showLateness.samples);
+    free(lateness.injectedLateness.samples);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    BenchShowConfiguration showConfiguration = {
+        .deviceCount = DEVICE_COUNT,
+        .cueCount = CUE_COUNT,
+        .baseDeviceAddress = BASE_DEVICE_ADDRESS,
+        .cuePattern = _setCue
+    };
+    size_t showSize;
+    uint8_t *show = benchShowCreate(&showConfiguration, &showSize);
+    if (show == NULL) { return EXIT_FAILURE; }
+    printf(
+        "%d show cues every %d us, %d injectors posting %d cues every %d us\n",
+        CUE_COUNT, CUE_SPACING / 1000, INJECTOR_COUNT, BATCH_SIZE, BATCH_INTERVAL
+    );
+    printf(
+        "%-10s %8s %8s %8s %8s %8s %8s %8s %8s\n",
+        "scenario", "show p50", "p99", "max", "inj p50", "p99", "fired", "cancel", "ns/cue"
+    );
+    bool success = _play("baseline", show, showSize, 0) && _play("injecting", show, showSize, INJECTOR_COUNT);
+    free(show);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,182 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "../src/fuses.h"
+#include "../src/fusesFormat.h"
+
+/**
+ * Writes a multi-megabyte version 2 show and loads it in a fresh process
+ * per loader: malloc + read (the old main.c path), fusesMapShow and
+ * fusesMapShow with mlock. Prints the time until fusesInit returned and
+ * the anonymous and file backed resident memory of the process.
+ *
+ * Build: make bench, run: bin/loaderBenchmark [cueCount]
+*/
+
+#define DEFAULT_CUE_COUNT (1000000)
+#define DEVICE_COUNT (16)
+#define BASE_DEVICE_ADDRESS (0x60)
+#define FUSE_COUNT_PER_DEVICE (16)
+#define CUE_SPACING (1000000)
+#define FUSE_DURATION (50)
+#define SHOW_PATH ("/tmp/loaderBenchmark.fuses")
+#define BUS_NAME ("/dev/i2c-1")
+#define NANOSECONDS_PER_SECOND (1000000000)
+
+enum Loader {
+    LOADER_READ,
+    LOADER_MAP,
+    LOADER_MAP_LOCKED
+};
+
+static uint64_t _now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * NANOSECONDS_PER_SECOND + time.tv_nsec;
+}
+
+static long _statusKilobytes(char *key) {
+    FILE *file = fopen("/proc/self/status", "r");
+    if (file == NULL) { return -1; }
+    char line[256];
+    long kilobytes = -1;
+    size_t keyLength = strlen(key);
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (strncmp(line, key, keyLength) == 0 && line[keyLength] == ':') {
+            sscanf(line + keyLength + 1, "%ld", &kilobytes);
+            break;
+        }
+    }
+    fclose(file);
+    return kilobytes;
+}
+
+static bool _writeShow(uint32_t cueCount) {
+    FILE *file = fopen(SHOW_PATH, "wb");
+    if (file == NULL) { return false; }
+
+    FusesHeaderV2 header = {
+        .version = FUSES_FORMAT_VERSION_2,
+        .headerSize = sizeof(FusesHeaderV2),
+        .deviceCount = DEVICE_COUNT,
+        .dataItemCount = cueCount,
+        .cueOffset = fusesFormatCueOffset(DEVICE_COUNT)
+    };
+    memcpy(header.fusesMagic, FUSES_V2_MAGIC, FUSES_MAGIC_SIZE);
+    header.headerChecksum = fusesFormatChecksum(&header, FUSES_HEADER_V2_CHECKSUM_SIZE);
+    fwrite(&header, sizeof(header), 1, file);
+
+    FusesDevice devices[DEVICE_COUNT] = {{ 0 }};
+    for (int i = 0; i < DEVICE_COUNT; ++i) {
+        devices[i].deviceAddress = BASE_DEVICE_ADDRESS | i;
+    }
+    fwrite(devices, sizeof(devices), 1, file);
+    for (long i = ftell(file); i < (long)header.cueOffset; ++i) { fputc(0, file); }
+
+    for (uint32_t i = 0; i < cueCount; ++i) {
+        FusesCue cue = {
+            .timestamp = (uint64_t)i * CUE_SPACING,
+            .i2cDeviceIndex = i % DEVICE_COUNT,
+            .fuseIndex = (i / DEVICE_COUNT) % FUSE_COUNT_PER_DEVICE
+        };
+        fwrite(&cue, sizeof(cue), 1, file);
+    }
+    return fclose(file) == 0;
+}
+
+static bool _readShow(FusesConfiguration *configuration) {
+    int fileDescriptor = open(SHOW_PATH, O_RDONLY);
+    if (fileDescriptor == -1) { return false; }
+    off_t size = lseek(fileDescriptor, 0, SEEK_END);
+    lseek(fileDescriptor, 0, SEEK_SET);
+    char *data = NULL;
+    if (posix_memalign((void**)&data, FUSES_CUE_ALIGNMENT, size) != 0) { data = NULL; }
+    off_t offset = 0;
+    while (data != NULL && offset < size) {
+        ssize_t count = read(fileDescriptor, data + offset, size - offset);
+        if (count <= 0) { break; }
+        offset += count;
+    }
+    close(fileDescriptor);
+    configuration->rawData = data;
+    configuration->rawDataSize = size;
+    return data != NULL && offset == size;
+}
+
+static int _run(char *name, enum Loader loader) {
+    FusesConfiguration configuration = {
+        .busName = BUS_NAME,
+        .busNameLength = strlen(BUS_NAME),
+        .fuseDuration = FUSE_DURATION
+    };
+
+    uint64_t start = _now();
+    if (loader == LOADER_READ) {
+        if (!_readShow(&configuration)) {
+            perror("read");
+            return EXIT_FAILURE;
+        }
+    } else {
+        FusesError error;
+        if (!fusesMapShow(&configuration, SHOW_PATH, loader == LOADER_MAP_LOCKED, &error)) {
+            fprintf(stderr, "fusesMapShow failed: %s\n", fusesGetErrorString(&error));
+            return EXIT_FAILURE;
+        }
+        if (error.level == FUSES_ERROR_LEVEL_WARNING) {
+            fprintf(stderr, "%s: %s\n", name, fusesGetErrorString(&error));
+        }
+    }
+    uint64_t loaded = _now();
+
+    FusesObject *fuses = fusesInit(&configuration);
+    if (fuses == NULL || fusesGetError(fuses)->level == FUSES_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "fusesInit failed: %s\n", fuses ? fusesGetErrorString(fusesGetError(fuses)) : "");
+        return EXIT_FAILURE;
+    }
+    uint64_t ready = _now();
+
+    printf(
+        "%-12s %10.3f %10.3f %10ld %10ld %10ld\n",
+        name, (loaded - start) / 1e6, (ready - start) / 1e6,
+        _statusKilobytes("RssAnon"), _statusKilobytes("RssFile"), _statusKilobytes("VmHWM")
+    );
+    fusesDestroy(fuses);
+    return EXIT_SUCCESS;
+}
+
+static int _runIsolated(char *name, enum Loader loader) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        exit(_run(name, loader));
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t cueCount = argc > 1 ? (uint32_t)atoi(argv[1]) : DEFAULT_CUE_COUNT;
+    if (!_writeShow(cueCount)) {
+        perror(SHOW_PATH);
+        return EXIT_FAILURE;
+    }
+    printf(
+        "%u cues, %.1f MB show file, times in ms, memory in kB\n",
+        cueCount, (fusesFormatCueOffset(DEVICE_COUNT) + (double)cueCount * sizeof(FusesCue)) / 1e6
+    );
+    printf(
+        "%-12s %10s %10s %10s %10s %10s\n",
+        "loader", "loaded", "ready", "RssAnon", "RssFile", "VmHWM"
+    );
+    int result = _runIsolated("read", LOADER_READ);
+    if (result == EXIT_SUCCESS) { result = _runIsolated("mmap", LOADER_MAP); }
+    if (result == EXIT_SUCCESS) { result = _runIsolated("mmap+mlock", LOADER_MAP_LOCKED); }
+    unlink(SHOW_PATH);
+    return result;
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "../src/fuses.h"
+#include "../src/fusesFormat.h"
+
+/**
+ * Plays the same show with the polling main loop and with the deadline
+ * main loop against the in-process i2c-dev stand-in and prints the
+ * ignite lateness percentiles reported by fusesGetLatenessReport, plus
+ * the CPU time the player used.
+ *
+ * Build: make bench, run: bin/loopBenchmark [timeResolution]
+*/
+
+#define CUE_COUNT (250)
+#define SHOW_DURATION (3000)
+#define FUSE_DURATION (50)
+#define DEFAULT_TIME_RESOLUTION (10)
+#define POLL_INTERVAL (1000)
+#define BUS_NAME ("/dev/i2c-1")
+
+typedef struct __attribute__((packed)) {
+    FusesHeader header;
+    FusesDataItem items[CUE_COUNT];
+} Show;
+
+static void _createShow(Show *show) {
+    memcpy(show->header.fusesMagic, FUSES_V1_MAGIC, FUSES_MAGIC_SIZE);
+    show->header.dataItemCount = CUE_COUNT;
+    show->header.i2cDeviceIndexMask = 0b1111;
+    srand(1);
+    uint32_t timestamp = 0;
+    for (int i = 0; i < CUE_COUNT; ++i) {
+        // Irregular gaps so cues do not line up with the polling period.
+        timestamp += rand() % (2 * SHOW_DURATION / CUE_COUNT) + 1;
+        show->items[i].timestamp = timestamp;
+        show->items[i].i2cDeviceIndex = i % 4;
+        show->items[i].fuseIndex = i % 16;
+    }
+}
+
+static double _cpuSeconds(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+        + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static int _run(char *name, enum FusesLoopMode loopMode, uint32_t timeResolution) {
+    Show show;
+    _createShow(&show);
+    FusesConfiguration configuration = {
+        .rawData = &show,
+        .rawDataSize = sizeof(show),
+        .busName = BUS_NAME,
+        .busNameLength = strlen(BUS_NAME),
+        .fuseDuration = FUSE_DURATION,
+        .timeResolution = timeResolution,
+        .loopMode = loopMode,
+        .measureLateness = true
+    };
+    FusesObject *fuses = fusesInit(&configuration);
+    if (fuses == NULL || fusesGetError(fuses)->level == FUSES_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "fusesInit failed: %s\n", fuses ? fusesGetErrorString(fusesGetError(fuses)) : "");
+        return EXIT_FAILURE;
+    }
+
+    double cpuStart = _cpuSeconds();
+    fusesPlay(fuses, NULL);
+    while (fusesGetIsPlaying(fuses)) {
+        usleep(POLL_INTERVAL);
+    }
+    FusesLatenessReport report = fusesGetLatenessReport(fuses);
+    fusesDestroy(fuses);
+    double cpuSeconds = _cpuSeconds() - cpuStart;
+
+    printf(
+        "%-10s %6zu %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f\n",
+        name, report.count,
+        report.minimum / 1e3, report.median / 1e3, report.p90 / 1e3,
+        report.p99 / 1e3, report.p999 / 1e3, report.maximum / 1e3, cpuSeconds
+    );
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t timeResolution = argc > 1 ? (uint32_t)atoi(argv[1]) : DEFAULT_TIME_RESOLUTION;
+    printf(
+        "%d cues over ~%d ms, polling every %u ms, ignite lateness in ms\n",
+        CUE_COUNT, SHOW_DURATION, timeResolution
+    );
+    printf(
+        "%-10s %6s %8s %8s %8s %8s %8s %8s %8s\n",
+        "loop", "cues", "min", "p50", "p90", "p99", "p99.9", "max", "cpu[s]"
+    );
+    if (_run("polling", FUSES_LOOP_POLLING, timeResolution) != EXIT_SUCCESS) { return EXIT_FAILURE; }
+    if (_run("deadline", FUSES_LOOP_DEADLINE, timeResolution) != EXIT_SUCCESS) { return EXIT_FAILURE; }
+    return EXIT_SUCCESS;
+}
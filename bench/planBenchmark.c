@@ -0,0 +1,185 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/fuses.h"
+#include "../src/fusesFormat.h"
+#include "../src/i2cSimulation.h"
+#include "../src/showCompiler.h"
+#include "benchShow.h"
+
+/**
+ * Compares playing the cues of a show (version 2) with walking its
+ * compiled register write plan (version 3). The same salvo-heavy show is
+ * compiled with the show compiler and played on a simulated 400 kHz bus
+ * in both forms; printed are the compile time, the CPU time of the timing
+ * thread, fuse edges, register writes and ignite lateness (microseconds).
+ *
+ * Build: make bench, run: bin/planBenchmark
+*/
+
+#define SALVO_COUNT (256)
+#define SALVO_SIZE (16)
+#define SALVO_SPACING (10)
+#define CUE_COUNT (SALVO_COUNT * SALVO_SIZE)
+#define FUSE_DURATION (50)
+#define DEVICE_COUNT (8)
+#define FUSE_COUNT_PER_DEVICE (16)
+#define BASE_DEVICE_ADDRESS (0b1100000)
+#define BUS_NAME ("/dev/i2c-1")
+#define POLL_INTERVAL (1000)
+#define NANOSECONDS_PER_SECOND (1000000000)
+#define NANOSECONDS_PER_MILLISECOND (1000000)
+
+static uint64_t _getCurrentTimeNanoseconds(void) {
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    return (uint64_t)currentTime.tv_sec * NANOSECONDS_PER_SECOND + currentTime.tv_nsec;
+}
+
+/**
+ * @brief Sums the CPU time of the process's threads with the given name.
+ * Reads the scheduler's nanosecond runtime from /proc.
+*/
+static uint64_t _threadCpuTime(const char *threadName) {
+    uint64_t total = 0;
+    DIR *tasks = opendir("/proc/self/task");
+    if (tasks == NULL) { return 0; }
+    struct dirent *task;
+    char path[sizeof(((struct dirent*)0)->d_name) + 32];
+    char name[32];
+    while ((task = readdir(tasks)) != NULL) {
+        if (task->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), "/proc/self/task/%s/comm", task->d_name);
+        FILE *file = fopen(path, "r");
+        if (file == NULL) continue;
+        bool matches = fgets(name, sizeof(name), file) != NULL
+            && strncmp(name, threadName, strlen(threadName)) == 0
+            && (name[strlen(threadName)] == '\n' || name[strlen(threadName)] == '\0');
+        fclose(file);
+        if (!matches) continue;
+
+        snprintf(path, sizeof(path), "/proc/self/task/%s/schedstat", task->d_name);
+        file = fopen(path, "r");
+        if (file == NULL) continue;
+        unsigned long long runtime = 0;
+        if (fscanf(file, "%llu", &runtime) == 1) {
+            total += runtime;
+        }
+        fclose(file);
+    }
+    closedir(tasks);
+    return total;
+}
+
+// Salvos of neighbouring fuses, so ignites share registers.
+static void _setCue(void *context, uint32_t cueIndex, FusesCue *cue) {
+    uint32_t fuseSlot = cueIndex % (DEVICE_COUNT * FUSE_COUNT_PER_DEVICE);
+    cue->timestamp = (uint64_t)(cueIndex / SALVO_SIZE) * SALVO_SPACING * NANOSECONDS_PER_MILLISECOND;
+    cue->i2cDeviceIndex = fuseSlot / FUSE_COUNT_PER_DEVICE;
+    cue->fuseIndex = fuseSlot % FUSE_COUNT_PER_DEVICE;
+}
+
+static uint8_t * _createShowV3(size_t *showSize, uint64_t *compileTime) {
+    uint64_t start = _getCurrentTimeNanoseconds();
+    ShowCompiler *compiler = showCompilerInit(FUSE_DURATION);
+    if (compiler == NULL) { return NULL; }
+    for (uint32_t i = 0; i < CUE_COUNT; ++i) {
+        FusesCue cue;
+        _setCue(NULL, i, &cue);
+        showCompilerAddCue(
+            compiler, cue.timestamp, 0, BASE_DEVICE_ADDRESS | cue.i2cDeviceIndex, cue.fuseIndex, i + 1
+        );
+    }
+    char *buffer = NULL;
+    size_t bufferSize = 0;
+    FILE *file = open_memstream(&buffer, &bufferSize);
+    bool compiled = showCompilerCompile(compiler, "planBenchmark", stderr) && showCompilerWrite(compiler, file);
+    fclose(file);
+    showCompilerDestroy(compiler);
+    *compileTime = _getCurrentTimeNanoseconds() - start;
+
+    // The player needs the show aligned like a mapped file.
+    uint8_t *show = NULL;
+    if (!compiled || posix_memalign((void**)&show, FUSES_CUE_ALIGNMENT, bufferSize) != 0) {
+        free(buffer);
+        return NULL;
+    }
+    memcpy(show, buffer, bufferSize);
+    *showSize = bufferSize;
+    free(buffer);
+    return show;
+}
+
+static bool _play(const char *name, uint8_t *show, size_t showSize) {
+    I2cSimulationConfiguration simulationConfiguration = { .clockFrequency = I2C_FAST_MODE_FREQUENCY };
+    I2cTransport *simulation = i2cSimulationInit(&simulationConfiguration);
+    FusesConfiguration configuration = {
+        .rawData = show,
+        .rawDataSize = showSize,
+        .busName = BUS_NAME,
+        .busNameLength = strlen(BUS_NAME),
+        .transport = simulation,
+        .fuseDuration = FUSE_DURATION,
+        .measureLateness = true
+    };
+    FusesObject *fuses = fusesInit(&configuration);
+    if (fuses == NULL || fusesGetError(fuses)->level == FUSES_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "fusesInit failed: %s\n", fuses ? fusesGetErrorString(fusesGetError(fuses)) : "");
+        return false;
+    }
+
+    uint64_t loopCpuStart = _threadCpuTime("fusesLoop");
+    fusesPlay(fuses, NULL);
+    while (fusesGetIsPlaying(fuses)) {
+        usleep(POLL_INTERVAL);
+    }
+    // the extinguish edges of the last salvo
+    usleep(2 * FUSE_DURATION * 1000);
+    uint64_t loopCpu = _threadCpuTime("fusesLoop") - loopCpuStart;
+
+    FusesStatistics statistics = fusesGetStatistics(fuses);
+    FusesLatenessReport report = fusesGetLatenessReport(fuses);
+    printf(
+        "%-8s %9.2f %8llu %8llu %8d %8d %8d\n",
+        name, loopCpu / 1e6, (unsigned long long)statistics.fuseEdges,
+        (unsigned long long)statistics.registerWrites, report.median, report.p99, report.maximum
+    );
+    fusesDestroy(fuses);
+    i2cSimulationDestroy(simulation);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    BenchShowConfiguration showConfiguration = {
+        .deviceCount = DEVICE_COUNT,
+        .cueCount = CUE_COUNT,
+        .baseDeviceAddress = BASE_DEVICE_ADDRESS,
+        .cuePattern = _setCue
+    };
+    size_t v2Size, v3Size;
+    uint64_t compileTime;
+    uint8_t *v2 = benchShowCreate(&showConfiguration, &v2Size);
+    uint8_t *v3 = _createShowV3(&v3Size, &compileTime);
+    if (v2 == NULL || v3 == NULL) {
+        free(v2);
+        free(v3);
+        return EXIT_FAILURE;
+    }
+
+    printf(
+        "%d cues in salvos of %d every %d ms, compiled in %.2f ms (%zu bytes)\n",
+        CUE_COUNT, SALVO_SIZE, SALVO_SPACING, compileTime / 1e6, v3Size
+    );
+    printf(
+        "%-8s %9s %8s %8s %8s %8s %8s\n",
+        "show", "loop[ms]", "edges", "writes", "median", "p99", "max"
+    );
+    bool success = _play("cues", v2, v2Size) && _play("plan", v3, v3Size);
+    free(v2);
+    free(v3);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
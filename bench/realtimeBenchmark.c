@@ -0,0 +1,183 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+
+#include "../src/fuses.h"
+#include "../src/fusesFormat.h"
+#include "../src/i2cSimulation.h"
+#include "benchShow.h"
+
+/**
+ * Shows what real-time mode buys under CPU contention. A steady show is
+ * played on a simulated 400 kHz bus while one busy thread per CPU (plus
+ * one) competes for the processors, once with default scheduling and
+ * once in real-time mode, and the ignite lateness of both runs is
+ * printed side by side. A run without stress is the baseline.
+ *
+ * malloc, calloc, realloc and posix_memalign are wrapped at link time;
+ * calls made by the timing thread or a bus worker while the show plays
+ * are counted and must stay at 0.
+ *
+ * Real-time settings need root or CAP_SYS_NICE / CAP_IPC_LOCK; what could
+ * not be applied is printed before the results.
+ *
+ * Build: make bench, run: bin/realtimeBenchmark
+*/
+
+#define CUE_COUNT (400)
+#define CUE_SPACING (5)
+#define FUSE_DURATION (50)
+#define DEVICE_COUNT (4)
+#define BASE_DEVICE_ADDRESS (0b1100000)
+#define BUS_NAME ("/dev/i2c-1")
+#define POLL_INTERVAL (1000)
+#define MAX_STRESS_THREAD_COUNT (64)
+#define THREAD_NAME_SIZE (16)
+#define NANOSECONDS_PER_MILLISECOND (1000000)
+
+typedef struct {
+    const char *name;
+    bool stress;
+    bool realtime;
+} Run;
+
+static const Run runs[] = {
+    { "idle, default", false, false },
+    { "stress, default", true, false },
+    { "stress, real-time", true, true }
+};
+
+static volatile bool _stressing = false;
+static volatile bool _countingAllocations = false;
+static uint64_t _playAllocations = 0;
+
+void * __real_malloc(size_t size);
+void * __real_calloc(size_t count, size_t size);
+void * __real_realloc(void *pointer, size_t size);
+int __real_posix_memalign(void **pointer, size_t alignment, size_t size);
+
+static void _countAllocation(void) {
+    if (!_countingAllocations) { return; }
+    char name[THREAD_NAME_SIZE] = { 0 };
+    prctl(PR_GET_NAME, name);
+    if (strcmp(name, "fusesLoop") == 0 || strcmp(name, "fusesBus") == 0) {
+        __atomic_fetch_add(&_playAllocations, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void * __wrap_malloc(size_t size) {
+    _countAllocation();
+    return __real_malloc(size);
+}
+
+void * __wrap_calloc(size_t count, size_t size) {
+    _countAllocation();
+    return __real_calloc(count, size);
+}
+
+void * __wrap_realloc(void *pointer, size_t size) {
+    _countAllocation();
+    return __real_realloc(pointer, size);
+}
+
+int __wrap_posix_memalign(void **pointer, size_t alignment, size_t size) {
+    _countAllocation();
+    return __real_posix_memalign(pointer, alignment, size);
+}
+
+static void * _stress(void *argument) {
+    volatile uint64_t counter = 0;
+    while (_stressing) {
+        ++counter;
+    }
+    return NULL;
+}
+
+static void _setCue(void *context, uint32_t cueIndex, FusesCue *cue) {
+    cue->timestamp = (uint64_t)cueIndex * CUE_SPACING * NANOSECONDS_PER_MILLISECOND;
+    cue->i2cDeviceIndex = cueIndex % DEVICE_COUNT;
+    cue->fuseIndex = (cueIndex / DEVICE_COUNT) % 16;
+}
+
+static bool _play(const Run *run, uint8_t *show, size_t showSize, int stressThreadCount) {
+    I2cSimulationConfiguration simulationConfiguration = { .clockFrequency = I2C_FAST_MODE_FREQUENCY };
+    I2cTransport *simulation = i2cSimulationInit(&simulationConfiguration);
+    FusesConfiguration configuration = {
+        .rawData = show,
+        .rawDataSize = showSize,
+        .busName = BUS_NAME,
+        .busNameLength = strlen(BUS_NAME),
+        .transport = simulation,
+        .fuseDuration = FUSE_DURATION,
+        .measureLateness = true,
+        .realtime = { .enabled = run->realtime, .lockMemory = true }
+    };
+    FusesObject *fuses = fusesInit(&configuration);
+    if (fuses == NULL || fusesGetError(fuses)->level == FUSES_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "fusesInit failed: %s\n", fuses ? fusesGetErrorString(fusesGetError(fuses)) : "");
+        return false;
+    }
+    fusesPrintRealtimeReport(fuses, stderr);
+
+    pthread_t stressThreads[MAX_STRESS_THREAD_COUNT];
+    _stressing = run->stress;
+    for (int i = 0; run->stress && i < stressThreadCount; ++i) {
+        pthread_create(&stressThreads[i], NULL, _stress, NULL);
+    }
+
+    __atomic_store_n(&_playAllocations, 0, __ATOMIC_RELAXED);
+    _countingAllocations = true;
+    fusesPlay(fuses, NULL);
+    while (fusesGetIsPlaying(fuses)) {
+        usleep(POLL_INTERVAL);
+    }
+    _countingAllocations = false;
+
+    _stressing = false;
+    for (int i = 0; run->stress && i < stressThreadCount; ++i) {
+        pthread_join(stressThreads[i], NULL);
+    }
+
+    FusesLatenessReport report = fusesGetLatenessReport(fuses);
+    printf(
+        "%-20s %6zu %8d %8d %8d %8d %8llu\n",
+        run->name, report.count, report.median, report.p99, report.p999, report.maximum,
+        (unsigned long long)__atomic_load_n(&_playAllocations, __ATOMIC_RELAXED)
+    );
+    fusesDestroy(fuses);
+    i2cSimulationDestroy(simulation);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    int stressThreadCount = (int)sysconf(_SC_NPROCESSORS_ONLN) + 1;
+    if (stressThreadCount > MAX_STRESS_THREAD_COUNT) {
+        stressThreadCount = MAX_STRESS_THREAD_COUNT;
+    }
+    BenchShowConfiguration showConfiguration = {
+        .deviceCount = DEVICE_COUNT,
+        .cueCount = CUE_COUNT,
+        .baseDeviceAddress = BASE_DEVICE_ADDRESS,
+        .cuePattern = _setCue
+    };
+    size_t showSize;
+    uint8_t *show = benchShowCreate(&showConfiguration, &showSize);
+    if (show == NULL) { return EXIT_FAILURE; }
+
+    printf("%d cues every %d ms, %d stress threads\n", CUE_COUNT, CUE_SPACING, stressThreadCount);
+    printf(
+        "%-20s %6s %8s %8s %8s %8s %8s\n",
+        "ignite lateness [us]", "cues", "median", "p99", "p99.9", "max", "allocs"
+    );
+    for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); ++i) {
+        if (!_play(&runs[i], show, showSize, stressThreadCount)) {
+            free(show);
+            return EXIT_FAILURE;
+        }
+    }
+    free(show);
+    return EXIT_SUCCESS;
+}
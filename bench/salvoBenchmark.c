@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/fuses.h"
+#include "../src/fusesFormat.h"
+#include "i2cDevStub.h"
+
+/**
+ * Plays salvos of simultaneous cues (every fuse of every device at the
+ * same timestamp) against the in-process i2c-dev stand-in and prints how
+ * many fuse edges the player handled, how many register writes they were
+ * merged into and how many bus transactions that took. Afterwards every
+ * fuse register has to read back as all fuses off.
+ *
+ * Build: make bench, run: bin/salvoBenchmark [salvoCount]
+*/
+
+#define DEVICE_COUNT (4)
+#define FUSE_COUNT_PER_DEVICE (16)
+#define FUSES_PER_SALVO (DEVICE_COUNT * FUSE_COUNT_PER_DEVICE)
+#define MAX_SALVO_COUNT (255 / FUSES_PER_SALVO)
+#define DEFAULT_SALVO_COUNT (3)
+#define SALVO_SPACING (200)
+#define FUSE_DURATION (50)
+#define FUSE_REGISTER_BASE_ADDRESS (0x14)
+#define FUSE_REGISTER_COUNT (4)
+#define BASE_DEVICE_ADDRESS (0b1100000)
+#define BUS_NUMBER (1)
+#define BUS_NAME ("/dev/i2c-1")
+#define POLL_INTERVAL (1000)
+
+typedef struct __attribute__((packed)) {
+    FusesHeader header;
+    FusesDataItem items[MAX_SALVO_COUNT * FUSES_PER_SALVO];
+} Show;
+
+static size_t _createShow(Show *show, int salvoCount) {
+    memcpy(show->header.fusesMagic, FUSES_V1_MAGIC, FUSES_MAGIC_SIZE);
+    show->header.dataItemCount = salvoCount * FUSES_PER_SALVO;
+    show->header.i2cDeviceIndexMask = (1 << DEVICE_COUNT) - 1;
+    for (int i = 0; i < salvoCount * FUSES_PER_SALVO; ++i) {
+        show->items[i].timestamp = (i / FUSES_PER_SALVO) * SALVO_SPACING;
+        show->items[i].i2cDeviceIndex = (i % FUSES_PER_SALVO) / FUSE_COUNT_PER_DEVICE;
+        show->items[i].fuseIndex = i % FUSE_COUNT_PER_DEVICE;
+    }
+    return sizeof(FusesHeader) + show->header.dataItemCount * sizeof(FusesDataItem);
+}
+
+int main(int argc, char *argv[]) {
+    int salvoCount = argc > 1 ? atoi(argv[1]) : DEFAULT_SALVO_COUNT;
+    if (salvoCount < 1 || salvoCount > MAX_SALVO_COUNT) {
+        fprintf(stderr, "salvoCount must be between 1 and %d\n", MAX_SALVO_COUNT);
+        return EXIT_FAILURE;
+    }
+
+    Show show;
+    FusesConfiguration configuration = {
+        .rawData = &show,
+        .rawDataSize = _createShow(&show, salvoCount),
+        .busName = BUS_NAME,
+        .busNameLength = strlen(BUS_NAME),
+        .fuseDuration = FUSE_DURATION
+    };
+    FusesObject *fuses = fusesInit(&configuration);
+    if (fuses == NULL || fusesGetError(fuses)->level == FUSES_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "fusesInit failed: %s\n", fuses ? fusesGetErrorString(fusesGetError(fuses)) : "");
+        return EXIT_FAILURE;
+    }
+
+    i2cStubResetCounters();
+    fusesPlay(fuses, NULL);
+    while (fusesGetIsPlaying(fuses)) {
+        usleep(POLL_INTERVAL);
+    }
+    usleep(2 * FUSE_DURATION * 1000);
+    FusesStatistics statistics = fusesGetStatistics(fuses);
+    I2cStubCounters counters = i2cStubGetCounters();
+    fusesDestroy(fuses);
+
+    int litRegisters = 0;
+    for (int device = 0; device < DEVICE_COUNT; ++device) {
+        for (int i = 0; i < FUSE_REGISTER_COUNT; ++i) {
+            litRegisters += i2cStubGetRegister(
+                BUS_NUMBER, BASE_DEVICE_ADDRESS | device, FUSE_REGISTER_BASE_ADDRESS + i
+            ) != 0;
+        }
+    }
+
+    printf("%d salvos of %d fuses\n", salvoCount, FUSES_PER_SALVO);
+    printf("%-28s %10s %10s\n", "", "total", "per salvo");
+    printf("%-28s %10llu %10.1f\n", "fuse edges", (unsigned long long)statistics.fuseEdges,
+        (double)statistics.fuseEdges / salvoCount);
+    printf("%-28s %10llu %10.1f\n", "register writes", (unsigned long long)statistics.registerWrites,
+        (double)statistics.registerWrites / salvoCount);
+    printf("%-28s %10llu %10.1f\n", "bus transactions", (unsigned long long)counters.transactions,
+        (double)counters.transactions / salvoCount);
+    printf("%-28s %10d\n", "registers left lit", litRegisters);
+    return litRegisters == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+
+#include "../src/i2c.h"
+#include "i2cDevStub.h"
+
+/**
+ * Compares bus discovery with the original open/ioctl/close per address,
+ * which never touched the wire and found every address, with i2cScan
+ * probing each address over one handle, scanning four buses one after
+ * the other and in parallel with i2cScanBuses, and checking 16 present
+ * and 16 absent devices with i2cTest, where the cache spares the probes
+ * of the absent ones. Each bus carries 16
+ * fuse controllers, every probe takes the wire time of a quick write at
+ * 100 kHz. Printed are the wall time (ms), syscalls, transactions on the
+ * wire and the devices found.
+ *
+ * Build: make bench, run: bin/scanBenchmark
+*/
+
+#define BUS_COUNT (4)
+#define DEVICE_COUNT (16)
+#define BASE_DEVICE_ADDRESS (0b1100000)
+#define ADDRESS_COUNT (128)
+// address byte, ACK, START and STOP at 100 kHz
+#define PROBE_TIME (110)
+#define NANOSECONDS_PER_SECOND (1000000000ull)
+#define NANOSECONDS_PER_MILLISECOND (1000000.0)
+
+static const char * const _busNames[BUS_COUNT] = { "/dev/i2c-1", "/dev/i2c-2", "/dev/i2c-3", "/dev/i2c-4" };
+
+static uint64_t _now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * NANOSECONDS_PER_SECOND + time.tv_nsec;
+}
+
+// The scan of the original i2c.c: a descriptor per address, no transaction.
+static size_t _legacyScan(const char *busName) {
+    size_t found = 0;
+    for (uint8_t msb = 0b0001; msb <= 0b1110; ++msb) {
+        for (uint8_t lsb = 0b0000; lsb <= 0b1111; ++lsb) {
+            int fileDescriptor = open(busName, O_RDWR);
+            if (fileDescriptor == -1) { continue; }
+            if (ioctl(fileDescriptor, I2C_SLAVE, (msb << 4) | lsb) != -1) {
+                ++found;
+            }
+            close(fileDescriptor);
+        }
+    }
+    return found;
+}
+
+static void _report(const char *name, uint64_t start, size_t found) {
+    double wallTime = (_now() - start) / NANOSECONDS_PER_MILLISECOND;
+    I2cStubCounters counters = i2cStubGetCounters();
+    printf(
+        "%-16s %9.2f %9llu %9llu %6zu\n",
+        name, wallTime, (unsigned long long)i2cStubGetTotalSyscalls(&counters),
+        (unsigned long long)counters.transactions, found
+    );
+}
+
+int main(int argc, char *argv[]) {
+    for (int bus = 0; bus < BUS_COUNT; ++bus) {
+        int busNumber = atoi(_busNames[bus] + strlen("/dev/i2c-"));
+        for (int address = 0; address < ADDRESS_COUNT; ++address) {
+            bool present = address >= BASE_DEVICE_ADDRESS && address < BASE_DEVICE_ADDRESS + DEVICE_COUNT;
+            i2cStubSetDevicePresent(busNumber, address, present);
+        }
+    }
+    i2cStubSetTransactionDelay(PROBE_TIME);
+    printf("%d buses with %d devices, %d us per probe\n", BUS_COUNT, DEVICE_COUNT, PROBE_TIME);
+    printf("%-16s %9s %9s %9s %6s\n", "scan", "wall[ms]", "syscalls", "wire", "found");
+
+    i2cStubResetCounters();
+    uint64_t start = _now();
+    size_t found = _legacyScan(_busNames[0]);
+    _report("per address", start, found);
+
+    uint8_t addresses[I2C_ADDRESS_COUNT];
+    size_t length = 0;
+    i2cStubResetCounters();
+    start = _now();
+    I2cError error = i2cScan((char*)_busNames[0], strlen(_busNames[0]), addresses, &length);
+    _report("i2cScan", start, length);
+    if (error.level == I2C_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "i2cScan failed: %s\n", i2cGetErrorString(&error));
+        return EXIT_FAILURE;
+    }
+
+    I2cScanResult results[BUS_COUNT];
+    i2cStubResetCounters();
+    start = _now();
+    found = 0;
+    for (int bus = 0; bus < BUS_COUNT; ++bus) {
+        i2cScanBuses(&_busNames[bus], 1, NULL, &results[bus]);
+        found += results[bus].count;
+    }
+    _report("4 buses serial", start, found);
+
+    i2cStubResetCounters();
+    start = _now();
+    i2cScanBuses(_busNames, BUS_COUNT, NULL, results);
+    found = 0;
+    for (int bus = 0; bus < BUS_COUNT; ++bus) {
+        found += results[bus].count;
+    }
+    _report("4 buses parallel", start, found);
+
+    // The devices fusesInit brings up and as many missing ones, once
+    // probed and once checked against the cache.
+    I2cDevice *devices[2 * DEVICE_COUNT];
+    for (int i = 0; i < 2 * DEVICE_COUNT; ++i) {
+        devices[i] = i2cInit((char*)_busNames[0], strlen(_busNames[0]), BASE_DEVICE_ADDRESS + i);
+    }
+    bool success = true;
+    for (int cached = 0; cached <= 1; ++cached) {
+        if (!cached) {
+            i2cClearScanCache(NULL);
+        } else {
+            i2cScanBuses(_busNames, 1, NULL, results);
+        }
+        i2cStubResetCounters();
+        start = _now();
+        found = 0;
+        for (int i = 0; i < 2 * DEVICE_COUNT; ++i) {
+            found += i2cTest(devices[i]);
+        }
+        _report(cached ? "i2cTest cached" : "i2cTest probed", start, found);
+        success = success && found == DEVICE_COUNT;
+    }
+    for (int i = 0; i < 2 * DEVICE_COUNT; ++i) {
+        i2cDestroy(devices[i]);
+    }
+    return success && length == DEVICE_COUNT ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,247 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+#include "../src/timerQueue.h"
+
+/**
+ * Compares the original thread-per-cue model (one pthread, mutex and
+ * condition variable per cue, woken by a polling loop, sleeping through
+ * the pulse with usleep) with the single-threaded deadline scheduler
+ * (sorted cue cursor for ignite edges, TimerQueue for extinguish edges).
+ *
+ * Every model runs in its own child process so peak RSS is measured in
+ * isolation. All cues of a show are spread evenly over SHOW_DURATION.
+ * Lateness is measured against the scheduled ignite time and against
+ * ignite + FUSE_DURATION for the extinguish edge.
+ *
+ * Build: make bench, run: bin/schedulerBenchmark [cueCount...]
+*/
+
+#define SHOW_DURATION (2000)
+#define FUSE_DURATION (200)
+#define TIME_RESOLUTION (1)
+#define MICROSECONDS_PER_MILLISECOND (1000)
+#define NANOSECONDS_PER_MILLISECOND (1000000ull)
+#define NANOSECONDS_PER_SECOND (1000000000ull)
+#define THREAD_STACK_SIZE (64 * 1024)
+
+typedef struct {
+    uint64_t scheduled;
+    uint64_t ignited;
+    uint64_t extinguished;
+} Cue;
+
+typedef struct {
+    Cue *cues;
+    size_t cueCount;
+    uint64_t startTimestamp;
+} Show;
+
+typedef struct {
+    Show *show;
+    size_t index;
+    pthread_mutex_t lock;
+    pthread_cond_t condition;
+    int flag;
+} LegacyCue;
+
+static uint64_t _now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * NANOSECONDS_PER_SECOND + time.tv_nsec;
+}
+
+static long _peakRssKilobytes(void) {
+    FILE *file = fopen("/proc/self/status", "r");
+    if (file == NULL) { return -1; }
+    char line[256];
+    long kilobytes = -1;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, "VmHWM: %ld kB", &kilobytes) == 1) { break; }
+    }
+    fclose(file);
+    return kilobytes;
+}
+
+static int _compare(const void *a, const void *b) {
+    int64_t x = *(const int64_t*)a;
+    int64_t y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void _report(char *model, Show *show, size_t firedCount, double startupMilliseconds) {
+    int64_t *ignite = (int64_t*)malloc(show->cueCount * sizeof(int64_t));
+    int64_t *extinguish = (int64_t*)malloc(show->cueCount * sizeof(int64_t));
+    size_t count = 0;
+    for (size_t i = 0; i < show->cueCount; ++i) {
+        Cue *cue = &show->cues[i];
+        if (cue->ignited == 0 || cue->extinguished == 0) continue;
+        ignite[count] = (int64_t)(cue->ignited - show->startTimestamp - cue->scheduled);
+        extinguish[count] = (int64_t)(cue->extinguished - cue->ignited) 
+            - (int64_t)(FUSE_DURATION * NANOSECONDS_PER_MILLISECOND);
+        ++count;
+    }
+    qsort(ignite, count, sizeof(int64_t), _compare);
+    qsort(extinguish, count, sizeof(int64_t), _compare);
+
+    printf(
+        "%-8s %8zu %8zu %12.3f %10ld",
+        model, show->cueCount, firedCount, startupMilliseconds, _peakRssKilobytes()
+    );
+    if (count == 0) {
+        printf(" %10s %10s %10s %10s\n", "-", "-", "-", "-");
+    } else {
+        printf(
+            " %10.3f %10.3f %10.3f %10.3f\n",
+            ignite[count / 2] / 1e6, ignite[count * 99 / 100] / 1e6,
+            extinguish[count / 2] / 1e6, extinguish[count * 99 / 100] / 1e6
+        );
+    }
+    free(ignite);
+    free(extinguish);
+}
+
+static Show * _createShow(size_t cueCount) {
+    Show *show = (Show*)calloc(1, sizeof(Show));
+    show->cues = (Cue*)calloc(cueCount, sizeof(Cue));
+    show->cueCount = cueCount;
+    for (size_t i = 0; i < cueCount; ++i) {
+        show->cues[i].scheduled = i * SHOW_DURATION * NANOSECONDS_PER_MILLISECOND / cueCount;
+    }
+    return show;
+}
+
+static void * _legacyCueHandler(void *argument) {
+    LegacyCue *legacyCue = (LegacyCue*)argument;
+    pthread_mutex_lock(&legacyCue->lock);
+    while (!legacyCue->flag) {
+        pthread_cond_wait(&legacyCue->condition, &legacyCue->lock);
+    }
+    pthread_mutex_unlock(&legacyCue->lock);
+
+    Cue *cue = &legacyCue->show->cues[legacyCue->index];
+    cue->ignited = _now();
+    usleep(FUSE_DURATION * MICROSECONDS_PER_MILLISECOND);
+    cue->extinguished = _now();
+    return NULL;
+}
+
+static void _runLegacy(size_t cueCount) {
+    Show *show = _createShow(cueCount);
+    LegacyCue *legacyCues = (LegacyCue*)calloc(cueCount, sizeof(LegacyCue));
+    pthread_t *threads = (pthread_t*)calloc(cueCount, sizeof(pthread_t));
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, THREAD_STACK_SIZE);
+
+    uint64_t startupBegin = _now();
+    size_t created = 0;
+    for (; created < cueCount; ++created) {
+        LegacyCue *legacyCue = &legacyCues[created];
+        legacyCue->show = show;
+        legacyCue->index = created;
+        pthread_mutex_init(&legacyCue->lock, NULL);
+        pthread_cond_init(&legacyCue->condition, NULL);
+        if (pthread_create(&threads[created], &attributes, _legacyCueHandler, legacyCue) != 0) {
+            break;
+        }
+    }
+    double startupMilliseconds = (_now() - startupBegin) / 1e6;
+
+    show->startTimestamp = _now();
+    for (size_t next = 0; next < created;) {
+        usleep(TIME_RESOLUTION * MICROSECONDS_PER_MILLISECOND);
+        uint64_t showTime = _now() - show->startTimestamp;
+        while (next < created && show->cues[next].scheduled <= showTime) {
+            LegacyCue *legacyCue = &legacyCues[next++];
+            pthread_mutex_lock(&legacyCue->lock);
+            legacyCue->flag = 1;
+            pthread_cond_signal(&legacyCue->condition);
+            pthread_mutex_unlock(&legacyCue->lock);
+        }
+    }
+    for (size_t i = 0; i < created; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    _report("threads", show, created, startupMilliseconds);
+}
+
+static void _runScheduler(size_t cueCount) {
+    Show *show = _createShow(cueCount);
+
+    uint64_t startupBegin = _now();
+    TimerQueue *queue = timerQueueInit(cueCount);
+    double startupMilliseconds = (_now() - startupBegin) / 1e6;
+
+    show->startTimestamp = _now();
+    size_t next = 0;
+    while (next < cueCount || timerQueueGetCount(queue) > 0) {
+        usleep(TIME_RESOLUTION * MICROSECONDS_PER_MILLISECOND);
+        uint64_t now = _now();
+        TimerEvent event;
+        while (
+            timerQueuePeek(queue, &event) 
+            && event.deadline <= (now - show->startTimestamp) / NANOSECONDS_PER_MILLISECOND
+        ) {
+            timerQueuePop(queue, &event);
+            show->cues[event.dataItemIndex].extinguished = _now();
+        }
+        while (next < cueCount && show->cues[next].scheduled <= now - show->startTimestamp) {
+            Cue *cue = &show->cues[next];
+            cue->ignited = _now();
+            timerQueuePush(queue, (TimerEvent){
+                .deadline = (cue->ignited - show->startTimestamp) / NANOSECONDS_PER_MILLISECOND 
+                    + FUSE_DURATION,
+                .dataItemIndex = next
+            });
+            ++next;
+        }
+    }
+    _report("heap", show, cueCount, startupMilliseconds);
+    timerQueueDestroy(queue);
+}
+
+static void _runIsolated(void (*run)(size_t), size_t cueCount) {
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) {
+        run(cueCount);
+        fflush(stdout);
+        _exit(EXIT_SUCCESS);
+    }
+    waitpid(child, NULL, 0);
+}
+
+int main(int argc, char *argv[]) {
+    size_t defaultCueCounts[] = { 10, 1000, 100000 };
+    size_t *cueCounts = defaultCueCounts;
+    size_t countCount = sizeof(defaultCueCounts) / sizeof(defaultCueCounts[0]);
+    if (argc > 1) {
+        countCount = argc - 1;
+        cueCounts = (size_t*)calloc(countCount, sizeof(size_t));
+        for (size_t i = 0; i < countCount; ++i) {
+            cueCounts[i] = strtoull(argv[i + 1], NULL, 10);
+        }
+    }
+
+    printf(
+        "show of %d ms, %d ms pulses, %d ms polling, lateness in ms\n",
+        SHOW_DURATION, FUSE_DURATION, TIME_RESOLUTION
+    );
+    printf(
+        "%-8s %8s %8s %12s %10s %10s %10s %10s %10s\n",
+        "model", "cues", "fired", "startup[ms]", "rss[kB]",
+        "ign p50", "ign p99", "ext p50", "ext p99"
+    );
+    for (size_t i = 0; i < countCount; ++i) {
+        _runIsolated(_runLegacy, cueCounts[i]);
+        _runIsolated(_runScheduler, cueCounts[i]);
+    }
+    return EXIT_SUCCESS;
+}
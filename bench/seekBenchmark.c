@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/fuses.h"
+#include "../src/fusesFormat.h"
+#include "benchShow.h"
+
+/**
+ * Measures how long it takes to find the cue a jump lands on, for the
+ * linear scan fusesJump used to do, the binary search and the binary
+ * search narrowed by the seek index. Targets are random and include
+ * times past the end of the show.
+ *
+ * Build: make bench, run: bin/seekBenchmark [cues...]
+*/
+
+#define DEVICE_COUNT (16)
+#define BASE_DEVICE_ADDRESS (0x60)
+#define FUSE_COUNT_PER_DEVICE (16)
+#define AVERAGE_CUE_SPACING (20)
+#define FUSE_DURATION (50)
+#define SEEK_INDEX_RESOLUTION (100)
+#define SEEK_COUNT (1000000)
+#define LINEAR_SEEK_STEPS (2000000000ULL)
+#define BUS_NAME ("/dev/i2c-1")
+#define NANOSECONDS_PER_MILLISECOND (1000000)
+#define NANOSECONDS_PER_SECOND (1000000000)
+
+static const uint32_t defaultCueCounts[] = { 1000, 10000, 100000, 1000000, 10000000 };
+
+typedef struct {
+    void *data;
+    size_t size;
+    FusesCue *cues;
+    uint32_t cueCount;
+    uint32_t duration;
+} Show;
+
+static uint64_t _now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * NANOSECONDS_PER_SECOND + time.tv_nsec;
+}
+
+// Bursts of simultaneous cues with irregular gaps in between.
+static void _setCue(void *context, uint32_t cueIndex, FusesCue *cue) {
+    uint64_t *timestamp = (uint64_t*)context;
+    if (rand() % 4 != 0) {
+        *timestamp += (uint64_t)(rand() % (2 * AVERAGE_CUE_SPACING * 4 / 3 + 1)) * NANOSECONDS_PER_MILLISECOND;
+    }
+    cue->timestamp = *timestamp;
+    cue->i2cDeviceIndex = cueIndex % DEVICE_COUNT;
+    cue->fuseIndex = (cueIndex / DEVICE_COUNT) % FUSE_COUNT_PER_DEVICE;
+}
+
+static bool _createShow(Show *show, uint32_t cueCount) {
+    uint64_t timestamp = 0;
+    BenchShowConfiguration showConfiguration = {
+        .deviceCount = DEVICE_COUNT,
+        .cueCount = cueCount,
+        .baseDeviceAddress = BASE_DEVICE_ADDRESS,
+        .cuePattern = _setCue,
+        .context = &timestamp
+    };
+    srand(1);
+    show->data = benchShowCreate(&showConfiguration, &show->size);
+    if (show->data == NULL) { return false; }
+    show->cues = benchShowGetCues(show->data);
+    show->cueCount = cueCount;
+    show->duration = timestamp / NANOSECONDS_PER_MILLISECOND;
+    return true;
+}
+
+static uint32_t _linearSearch(Show *show, uint32_t time) {
+    uint64_t timestamp = (uint64_t)time * NANOSECONDS_PER_MILLISECOND;
+    for (uint32_t i = 0; i < show->cueCount; ++i) {
+        if (show->cues[i].timestamp >= timestamp) { return i; }
+    }
+    return show->cueCount;
+}
+
+static FusesObject * _init(Show *show, uint32_t seekIndexResolution) {
+    FusesConfiguration configuration = {
+        .rawData = show->data,
+        .rawDataSize = show->size,
+        .busName = BUS_NAME,
+        .busNameLength = strlen(BUS_NAME),
+        .fuseDuration = FUSE_DURATION,
+        .seekIndexResolution = seekIndexResolution
+    };
+    FusesObject *fuses = fusesInit(&configuration);
+    if (fuses == NULL || fusesGetError(fuses)->level == FUSES_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "fusesInit failed: %s\n", fuses ? fusesGetErrorString(fusesGetError(fuses)) : "");
+        return NULL;
+    }
+    return fuses;
+}
+
+static uint32_t * _createTargets(Show *show) {
+    uint32_t *targets = (uint32_t*)malloc(SEEK_COUNT * sizeof(uint32_t));
+    // About 1 in 20 targets lies past the end of the show.
+    uint32_t range = show->duration + show->duration / 20 + 1;
+    for (uint32_t i = 0; i < SEEK_COUNT; ++i) {
+        targets[i] = ((uint64_t)rand() * RAND_MAX + rand()) % range;
+    }
+    return targets;
+}
+
+static double _measureFuses(FusesObject *fuses, uint32_t *targets, uint32_t *results) {
+    uint64_t start = _now();
+    for (uint32_t i = 0; i < SEEK_COUNT; ++i) {
+        results[i] = fusesGetNextCueIndex(fuses, targets[i]);
+    }
+    return (double)(_now() - start) / SEEK_COUNT;
+}
+
+static int _run(uint32_t cueCount) {
+    Show show;
+    if (!_createShow(&show, cueCount)) {
+        fprintf(stderr, "could not allocate %u cues\n", cueCount);
+        return EXIT_FAILURE;
+    }
+    uint32_t *targets = _createTargets(&show);
+    uint32_t *binaryResults = (uint32_t*)malloc(SEEK_COUNT * sizeof(uint32_t));
+    uint32_t *indexedResults = (uint32_t*)malloc(SEEK_COUNT * sizeof(uint32_t));
+
+    FusesObject *binary = _init(&show, 0);
+    FusesObject *indexed = _init(&show, SEEK_INDEX_RESOLUTION);
+    if (binary == NULL || indexed == NULL) { return EXIT_FAILURE; }
+    double binaryNanoseconds = _measureFuses(binary, targets, binaryResults);
+    double indexedNanoseconds = _measureFuses(indexed, targets, indexedResults);
+    fusesDestroy(binary);
+    fusesDestroy(indexed);
+
+    // The linear scan only gets about LINEAR_SEEK_STEPS cue comparisons.
+    uint64_t linearCount = LINEAR_SEEK_STEPS / cueCount + 1;
+    if (linearCount > SEEK_COUNT) { linearCount = SEEK_COUNT; }
+    uint64_t start = _now();
+    for (uint64_t i = 0; i < linearCount; ++i) {
+        uint32_t expected = _linearSearch(&show, targets[i]);
+        if (expected != binaryResults[i] || expected != indexedResults[i]) {
+            fprintf(stderr, "mismatch at %u ms: %u, %u, %u\n", targets[i], expected, binaryResults[i], indexedResults[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    double linearNanoseconds = (double)(_now() - start) / linearCount;
+
+    printf(
+        "%10u %12u %14.1f %14.1f %14.1f\n",
+        cueCount, show.duration, linearNanoseconds, binaryNanoseconds, indexedNanoseconds
+    );
+    free(targets);
+    free(binaryResults);
+    free(indexedResults);
+    free(show.data);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    printf("ns per lookup, seek index buckets of %d ms\n", SEEK_INDEX_RESOLUTION);
+    printf("%10s %12s %14s %14s %14s\n", "cues", "duration[ms]", "linear", "binary", "indexed");
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) {
+            if (_run((uint32_t)atoi(argv[i])) != EXIT_SUCCESS) { return EXIT_FAILURE; }
+        }
+    } else {
+        for (size_t i = 0; i < sizeof(defaultCueCounts) / sizeof(defaultCueCounts[0]); ++i) {
+            if (_run(defaultCueCounts[i]) != EXIT_SUCCESS) { return EXIT_FAILURE; }
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/fuses.h"
+#include "../src/fusesFormat.h"
+#include "../src/i2cSimulation.h"
+#include "benchShow.h"
+
+/**
+ * Measures fusesInit for a large show with 16 devices at 100 kHz, all on
+ * one bus, where they come up one after the other, and spread over four
+ * buses, where they come up in parallel, and once more with one device
+ * whose probe hangs for half a second. Printed are the phases of the
+ * startup report (ms): parse, device probe, thread start and total, the
+ * slowest device and the device that timed out.
+ *
+ * Build: make bench, run: bin/startupBenchmark [cues]
+*/
+
+#define DEFAULT_CUE_COUNT (200000)
+#define CUE_SPACING (10)
+#define FUSE_DURATION (20)
+#define DEVICE_COUNT (16)
+#define FUSE_COUNT_PER_DEVICE (16)
+#define BASE_DEVICE_ADDRESS (0b1100000)
+#define MAX_BUS_COUNT (4)
+#define SEEK_INDEX_RESOLUTION (100)
+#define DEVICE_TIMEOUT (100)
+// the probe of the hanging device, in microseconds
+#define HANG_TIME (500000)
+#define NANOSECONDS_PER_MILLISECOND (1000000.0)
+
+static char *_busNames[MAX_BUS_COUNT] = { "/dev/i2c-1", "/dev/i2c-2", "/dev/i2c-3", "/dev/i2c-4" };
+
+// Forwards to the simulation, but the probe of one address hangs.
+typedef struct {
+    I2cTransport transport;
+    I2cTransport *inner;
+    uint8_t hangAddress;
+} _HangingTransport;
+
+static void * _open(I2cTransport *self, const char *busName) {
+    _HangingTransport *_self = (_HangingTransport*)self;
+    return _self->inner->open(_self->inner, busName);
+}
+
+static void _close(I2cTransport *self, void *bus) {
+    _HangingTransport *_self = (_HangingTransport*)self;
+    _self->inner->close(_self->inner, bus);
+}
+
+static bool _transfer(I2cTransport *self, void *bus, uint8_t address, I2cMessage *messages, size_t messageCount) {
+    _HangingTransport *_self = (_HangingTransport*)self;
+    return _self->inner->transfer(_self->inner, bus, address, messages, messageCount);
+}
+
+static bool _probe(I2cTransport *self, void *bus, uint8_t address) {
+    _HangingTransport *_self = (_HangingTransport*)self;
+    if (address == _self->hangAddress) {
+        usleep(HANG_TIME);
+    }
+    return _self->inner->probe(_self->inner, bus, address);
+}
+
+static bool _reopen(I2cTransport *self, void *bus, const char *busName) {
+    _HangingTransport *_self = (_HangingTransport*)self;
+    return _self->inner->reopen(_self->inner, bus, busName);
+}
+
+static void _setCue(void *context, uint32_t cueIndex, FusesCue *cue) {
+    uint32_t fuseSlot = cueIndex % (DEVICE_COUNT * FUSE_COUNT_PER_DEVICE);
+    cue->timestamp = (uint64_t)cueIndex * CUE_SPACING * NANOSECONDS_PER_MILLISECOND;
+    cue->i2cDeviceIndex = fuseSlot / FUSE_COUNT_PER_DEVICE;
+    cue->fuseIndex = fuseSlot % FUSE_COUNT_PER_DEVICE;
+}
+
+static bool _start(const char *name, uint32_t cueCount, uint32_t busCount, bool hang) {
+    BenchShowConfiguration showConfiguration = {
+        .deviceCount = DEVICE_COUNT,
+        .cueCount = cueCount,
+        .baseDeviceAddress = BASE_DEVICE_ADDRESS,
+        .busCount = busCount,
+        .cuePattern = _setCue
+    };
+    size_t showSize;
+    uint8_t *show = benchShowCreate(&showConfiguration, &showSize);
+    if (show == NULL) { return false; }
+    I2cSimulationConfiguration simulationConfiguration = { .clockFrequency = I2C_STANDARD_MODE_FREQUENCY };
+    I2cTransport *simulation = i2cSimulationInit(&simulationConfiguration);
+    _HangingTransport transport = {
+        .transport = { _open, _close, _transfer, _probe, _reopen },
+        .inner = simulation,
+        .hangAddress = hang ? BASE_DEVICE_ADDRESS | (DEVICE_COUNT / busCount - 1) : 0
+    };
+    FusesConfiguration configuration = {
+        .rawData = show,
+        .rawDataSize = showSize,
+        .busNames = _busNames,
+        .busCount = busCount,
+        .transport = (I2cTransport*)&transport,
+        .fuseDuration = FUSE_DURATION,
+        .seekIndexResolution = SEEK_INDEX_RESOLUTION,
+        .deviceTimeout = DEVICE_TIMEOUT
+    };
+    FusesObject *fuses = fusesInit(&configuration);
+    if (fuses == NULL) { return false; }
+    bool success = hang
+        ? fusesGetError(fuses)->type == FUSES_ERROR_DEVICE_TIMED_OUT
+        : fusesGetError(fuses)->level != FUSES_ERROR_LEVEL_ERROR;
+    if (!success) {
+        fprintf(stderr, "%s: %s\n", name, fusesGetErrorString(fusesGetError(fuses)));
+    }
+
+    FusesStartupReport report = fusesGetStartupReport(fuses);
+    char timedOut[8] = "-";
+    if (report.timedOutDeviceIndex != FUSES_TRACE_NO_DEVICE) {
+        snprintf(timedOut, sizeof(timedOut), "%u", report.timedOutDeviceIndex);
+    }
+    printf(
+        "%-16s %8.2f %8.2f %8.2f %8.2f %8u %10.2f %8s\n",
+        name, report.parseTime / NANOSECONDS_PER_MILLISECOND,
+        report.deviceProbeTime / NANOSECONDS_PER_MILLISECOND,
+        report.threadStartTime / NANOSECONDS_PER_MILLISECOND,
+        report.totalTime / NANOSECONDS_PER_MILLISECOND, report.deviceCount,
+        report.slowestDeviceTime / NANOSECONDS_PER_MILLISECOND, timedOut
+    );
+    // Waits for the hanging device, the simulation can go right after.
+    fusesDestroy(fuses);
+    i2cSimulationDestroy(simulation);
+    free(show);
+    return success;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t cueCount = argc > 1 ? (uint32_t)atoi(argv[1]) : DEFAULT_CUE_COUNT;
+    printf("%u cues, %d devices at 100 kHz, %d ms device timeout\n", cueCount, DEVICE_COUNT, DEVICE_TIMEOUT);
+    printf(
+        "%-16s %8s %8s %8s %8s %8s %10s %8s\n",
+        "buses", "parse", "probe", "threads", "total", "devices", "slowest", "timeout"
+    );
+    bool success = _start("1 bus", cueCount, 1, false);
+    success = _start("4 buses", cueCount, MAX_BUS_COUNT, false) && success;
+    success = _start("4 buses, hang", cueCount, MAX_BUS_COUNT, true) && success;
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
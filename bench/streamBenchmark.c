@@ -0,0 +1,166 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/fuses.h"
+#include "../src/fusesFormat.h"
+#include "../src/i2cSimulation.h"
+#include "benchShow.h"
+
+/**
+ * Plays a long show mapped into memory, streamed from a file and streamed
+ * from a pipe, on a simulated bus. Printed are the peak growth of the
+ * resident set while the show plays (KiB), chunks read, stalls of the
+ * timing thread waiting for a chunk and ignite lateness (microseconds).
+ * The mapped show grows by the whole cue table, the streamed ones by
+ * their two chunk buffers.
+ *
+ * Build: make bench, run: bin/streamBenchmark
+*/
+
+#define CUE_COUNT (500000)
+#define CUE_SPACING (10000)
+#define FUSE_DURATION (1)
+#define DEVICE_COUNT (16)
+#define FUSE_COUNT_PER_DEVICE (16)
+#define BASE_DEVICE_ADDRESS (0b1100000)
+#define BUS_NAME ("/dev/i2c-1")
+#define POLL_INTERVAL (1000)
+#define WRITE_BLOCK_SIZE (65536)
+
+typedef struct {
+    int fileDescriptor;
+    const uint8_t *show;
+    size_t showSize;
+} _PipeWriter;
+
+static size_t _getResidentKilobytes(void) {
+    FILE *file = fopen("/proc/self/status", "r");
+    if (file == NULL) { return 0; }
+    char line[128];
+    size_t kilobytes = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, "VmRSS: %zu kB", &kilobytes) == 1) break;
+    }
+    fclose(file);
+    return kilobytes;
+}
+
+// Every fuse in turn, so a fuse is out again before it is next lit.
+static void _setCue(void *context, uint32_t cueIndex, FusesCue *cue) {
+    uint32_t fuseSlot = cueIndex % (DEVICE_COUNT * FUSE_COUNT_PER_DEVICE);
+    cue->timestamp = (uint64_t)cueIndex * CUE_SPACING;
+    cue->i2cDeviceIndex = fuseSlot / FUSE_COUNT_PER_DEVICE;
+    cue->fuseIndex = fuseSlot % FUSE_COUNT_PER_DEVICE;
+}
+
+static void * _writePipe(void *argument) {
+    _PipeWriter *writer = (_PipeWriter*)argument;
+    size_t offset = 0;
+    while (offset < writer->showSize) {
+        size_t size = writer->showSize - offset < WRITE_BLOCK_SIZE ? writer->showSize - offset : WRITE_BLOCK_SIZE;
+        ssize_t written = write(writer->fileDescriptor, writer->show + offset, size);
+        if (written <= 0) break;
+        offset += written;
+    }
+    close(writer->fileDescriptor);
+    return NULL;
+}
+
+static bool _play(const char *name, const char *path, bool stream) {
+    size_t baseline = _getResidentKilobytes();
+    I2cSimulationConfiguration simulationConfiguration = { .clockFrequency = 0 };
+    I2cTransport *simulation = i2cSimulationInit(&simulationConfiguration);
+    FusesConfiguration configuration = {
+        .busName = BUS_NAME,
+        .busNameLength = strlen(BUS_NAME),
+        .transport = simulation,
+        .fuseDuration = FUSE_DURATION,
+        .measureLateness = true
+    };
+    FusesError mapError;
+    if (stream) {
+        configuration.streamPath = path;
+    } else if (!fusesMapShow(&configuration, (char*)path, false, &mapError)) {
+        fprintf(stderr, "fusesMapShow failed: %s\n", fusesGetErrorString(&mapError));
+        return false;
+    }
+    FusesObject *fuses = fusesInit(&configuration);
+    if (fuses == NULL || fusesGetError(fuses)->level == FUSES_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "fusesInit failed: %s\n", fuses ? fusesGetErrorString(fusesGetError(fuses)) : "");
+        return false;
+    }
+
+    size_t peak = _getResidentKilobytes();
+    fusesPlay(fuses, NULL);
+    while (fusesGetIsPlaying(fuses)) {
+        size_t resident = _getResidentKilobytes();
+        if (resident > peak) { peak = resident; }
+        usleep(POLL_INTERVAL);
+    }
+
+    FusesStatistics statistics = fusesGetStatistics(fuses);
+    FusesLatenessReport report = fusesGetLatenessReport(fuses);
+    printf(
+        "%-8s %10zu %8llu %8llu %8d %8d %8d%s\n",
+        name, peak - baseline, (unsigned long long)statistics.streamChunksRead,
+        (unsigned long long)statistics.streamStalls, report.median, report.p99, report.maximum,
+        statistics.streamFailed ? " (failed)" : ""
+    );
+    fusesDestroy(fuses);
+    i2cSimulationDestroy(simulation);
+    if (!stream) {
+        fusesUnmapShow(&configuration);
+    }
+    return !statistics.streamFailed;
+}
+
+int main(int argc, char *argv[]) {
+    BenchShowConfiguration showConfiguration = {
+        .deviceCount = DEVICE_COUNT,
+        .cueCount = CUE_COUNT,
+        .baseDeviceAddress = BASE_DEVICE_ADDRESS,
+        .cuePattern = _setCue
+    };
+    size_t showSize;
+    uint8_t *show = benchShowCreate(&showConfiguration, &showSize);
+    char path[] = "/tmp/streamBenchmarkXXXXXX";
+    int fileDescriptor = show != NULL ? mkstemp(path) : -1;
+    if (fileDescriptor == -1) {
+        free(show);
+        return EXIT_FAILURE;
+    }
+    bool written = write(fileDescriptor, show, showSize) == (ssize_t)showSize;
+    close(fileDescriptor);
+    // A failed stream closes the pipe before the writer is done.
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("%d cues every %d us, %zu KiB show\n", CUE_COUNT, CUE_SPACING / 1000, showSize / 1024);
+    printf(
+        "%-8s %10s %8s %8s %8s %8s %8s\n",
+        "show", "peak[KiB]", "chunks", "stalls", "median", "p99", "max"
+    );
+    bool success = written && _play("file", path, true);
+
+    // The pipe is opened again through /proc like a named pipe.
+    int pipeDescriptors[2];
+    if (success && pipe(pipeDescriptors) == 0) {
+        _PipeWriter writer = { .fileDescriptor = pipeDescriptors[1], .show = show, .showSize = showSize };
+        pthread_t writerThread;
+        pthread_create(&writerThread, NULL, _writePipe, &writer);
+        char pipePath[32];
+        snprintf(pipePath, sizeof(pipePath), "/proc/self/fd/%d", pipeDescriptors[0]);
+        success = _play("pipe", pipePath, true);
+        close(pipeDescriptors[0]);
+        pthread_join(writerThread, NULL);
+    }
+
+    success = success && _play("mapped", path, false);
+    unlink(path);
+    free(show);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/fuses.h"
+#include "../src/fusesFormat.h"
+#include "../src/i2cSimulation.h"
+#include "../src/virtualClock.h"
+#include "benchShow.h"
+
+/**
+ * Plays shows whose cues lie less than a millisecond apart on a virtual
+ * clock going from event to event, once from time 0 and once 50 days in,
+ * past the 49.7 days after which a 32 bit millisecond clock wraps. Every
+ * cue has to fire at its exact time: printed are the cue spacing (us),
+ * the start of the clock (days), the cues fired and their ignite lateness
+ * in virtual time (microseconds).
+ *
+ * Build: make bench, run: bin/timebaseBenchmark
+*/
+
+#define CUE_COUNT (256)
+#define FUSE_DURATION (20)
+#define DEVICE_COUNT (16)
+#define FUSE_COUNT_PER_DEVICE (16)
+#define BASE_DEVICE_ADDRESS (0b1100000)
+#define BUS_NAME ("/dev/i2c-1")
+#define POLL_INTERVAL (1000)
+#define NANOSECONDS_PER_MICROSECOND (1000)
+#define NANOSECONDS_PER_DAY (86400ull * 1000000000ull)
+
+static void _setCue(void *context, uint32_t cueIndex, FusesCue *cue) {
+    uint32_t spacing = *(uint32_t*)context;
+    cue->timestamp = (uint64_t)(cueIndex + 1) * spacing * NANOSECONDS_PER_MICROSECOND;
+    cue->i2cDeviceIndex = cueIndex / FUSE_COUNT_PER_DEVICE;
+    cue->fuseIndex = cueIndex % FUSE_COUNT_PER_DEVICE;
+}
+
+static bool _play(uint32_t spacing, uint32_t startDay) {
+    BenchShowConfiguration showConfiguration = {
+        .deviceCount = DEVICE_COUNT,
+        .cueCount = CUE_COUNT,
+        .baseDeviceAddress = BASE_DEVICE_ADDRESS,
+        .cuePattern = _setCue,
+        .context = &spacing
+    };
+    size_t showSize;
+    uint8_t *show = benchShowCreate(&showConfiguration, &showSize);
+    if (show == NULL) { return false; }
+    I2cSimulationConfiguration simulationConfiguration = { .clockFrequency = 0 };
+    I2cTransport *simulation = i2cSimulationInit(&simulationConfiguration);
+    VirtualClockConfiguration clockConfiguration = { .speed = 0, .startTime = startDay * NANOSECONDS_PER_DAY };
+    ClockSource *clock = virtualClockInit(&clockConfiguration);
+    FusesConfiguration configuration = {
+        .rawData = show,
+        .rawDataSize = showSize,
+        .busName = BUS_NAME,
+        .busNameLength = strlen(BUS_NAME),
+        .transport = simulation,
+        .fuseDuration = FUSE_DURATION,
+        .measureLateness = true,
+        .clock = clock
+    };
+    FusesObject *fuses = fusesInit(&configuration);
+    if (fuses == NULL || fusesGetError(fuses)->level == FUSES_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "fusesInit failed: %s\n", fuses ? fusesGetErrorString(fusesGetError(fuses)) : "");
+        return false;
+    }
+
+    fusesPlay(fuses, NULL);
+    while (fusesGetIsPlaying(fuses)) {
+        usleep(POLL_INTERVAL);
+    }
+
+    FusesLatenessReport report = fusesGetLatenessReport(fuses);
+    printf(
+        "%8u %8u %8zu %8d %8d %8d\n",
+        spacing, startDay, report.count, report.median, report.p99, report.maximum
+    );
+    fusesDestroy(fuses);
+    virtualClockDestroy(clock);
+    i2cSimulationDestroy(simulation);
+    free(show);
+    return report.count == CUE_COUNT && report.maximum == 0;
+}
+
+int main(int argc, char *argv[]) {
+    static const uint32_t spacings[] = { 1000, 250, 37 };
+    static const uint32_t startDays[] = { 0, 50 };
+    printf("%d cues, event to event\n", CUE_COUNT);
+    printf(
+        "%8s %8s %8s %8s %8s %8s\n",
+        "step[us]", "start[d]", "cues", "median", "p99", "max"
+    );
+    bool success = true;
+    for (size_t i = 0; i < sizeof(spacings) / sizeof(spacings[0]); ++i) {
+        for (size_t j = 0; j < sizeof(startDays) / sizeof(startDays[0]); ++j) {
+            success = _play(spacings[i], startDays[j]) && success;
+        }
+    }
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
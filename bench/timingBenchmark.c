@@ -0,0 +1,431 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/fuses.h"
+#include "../src/fusesFormat.h"
+#include "../src/i2cRecorder.h"
+#include "../src/i2cSimulation.h"
+#include "benchShow.h"
+
+/**
+ * Measures how late fuses go on and off at the bus relative to the cue
+ * timestamps. Synthetic version 2 shows are played over 4 devices on a
+ * simulated 400 kHz bus and every register write is recorded; ignite and
+ * extinguish edges are recovered from the written values and matched to
+ * the cue they belong to.
+ *
+ * Scenarios: steady cue rate, dense salvos, long idle gaps between cues,
+ * and a storm of random pauses and jumps during playback. For ignite and
+ * extinguish lateness and for the pulse width error (time lit minus
+ * fuseDuration) it prints min/median/p99/p99.9/max, plus the CPU time of
+ * the timing thread and the bus worker. Lateness is measured from the
+ * moment the harness issued play, pause or jump, so it includes the
+ * command latency.
+ *
+ * With an output path every scenario is appended as one JSON object per
+ * line, times in nanoseconds, so runs of different commits can be diffed.
+ *
+ * Build: make bench, run: bin/timingBenchmark [results.jsonl]
+ * or: make benchmark
+*/
+
+#define DEVICE_COUNT (4)
+#define FUSE_COUNT_PER_DEVICE (16)
+#define FUSE_COUNT (DEVICE_COUNT * FUSE_COUNT_PER_DEVICE)
+#define FUSE_DURATION (50)
+#define FUSE_REGISTER_BASE_ADDRESS (0x14)
+#define FUSES_PER_REGISTER (4)
+#define BASE_DEVICE_ADDRESS (0b1100000)
+#define BUS_NAME ("/dev/i2c-1")
+#define TRANSACTION_LATENCY (20000)
+#define RECORD_CAPACITY (65536)
+#define MAX_SEGMENT_COUNT (1024)
+#define POLL_INTERVAL (1000)
+// cues may fire this much before their time, the engine counts whole milliseconds
+#define EARLY_TOLERANCE (2000000)
+#define NANOSECONDS_PER_MILLISECOND (1000000)
+#define NANOSECONDS_PER_SECOND (1000000000)
+
+#define STORM_DURATION (2500)
+#define STORM_MINIMUM_INTERVAL (20)
+#define STORM_MAXIMUM_INTERVAL (80)
+#define STORM_MINIMUM_PAUSE (5)
+#define STORM_MAXIMUM_PAUSE (30)
+
+typedef struct {
+    const char *name;
+    uint32_t cueCount;
+    // milliseconds between consecutive cues or salvos
+    uint32_t spacing;
+    // cues sharing one timestamp
+    uint32_t salvoSize;
+    bool storm;
+} Scenario;
+
+static const Scenario scenarios[] = {
+    { "steady", 400, 5, 1, false },
+    { "burst", 8 * FUSE_COUNT, 250, FUSE_COUNT, false },
+    { "idle", 6, 800, 1, false },
+    { "storm", 2000, 2, 1, true }
+};
+
+// Show time origin on the monotonic clock from wallStart on.
+typedef struct {
+    uint64_t wallStart;
+    uint64_t origin;
+} Segment;
+
+typedef struct {
+    int64_t *values;
+    size_t count;
+} Samples;
+
+static uint64_t _getCurrentTimeNanoseconds(void) {
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    return (uint64_t)currentTime.tv_sec * NANOSECONDS_PER_SECOND + currentTime.tv_nsec;
+}
+
+static void _setCue(void *context, uint32_t cueIndex, FusesCue *cue) {
+    const Scenario *scenario = (const Scenario*)context;
+    // The first cue leaves the loop time to settle after play.
+    cue->timestamp = (uint64_t)(cueIndex / scenario->salvoSize + 1) * scenario->spacing * NANOSECONDS_PER_MILLISECOND;
+    cue->i2cDeviceIndex = (cueIndex % FUSE_COUNT) / FUSE_COUNT_PER_DEVICE;
+    cue->fuseIndex = cueIndex % FUSE_COUNT_PER_DEVICE;
+}
+
+/**
+ * @brief Sums the CPU time of the process's threads with the given name.
+ * Reads the scheduler's nanosecond runtime from /proc.
+*/
+static uint64_t _threadCpuTime(const char *threadName) {
+    uint64_t total = 0;
+    DIR *tasks = opendir("/proc/self/task");
+    if (tasks == NULL) { return 0; }
+    struct dirent *task;
+    char path[sizeof(((struct dirent*)0)->d_name) + 32];
+    char name[32];
+    while ((task = readdir(tasks)) != NULL) {
+        if (task->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), "/proc/self/task/%s/comm", task->d_name);
+        FILE *file = fopen(path, "r");
+        if (file == NULL) continue;
+        bool matches = fgets(name, sizeof(name), file) != NULL
+            && strncmp(name, threadName, strlen(threadName)) == 0
+            && (name[strlen(threadName)] == '\n' || name[strlen(threadName)] == '\0');
+        fclose(file);
+        if (!matches) continue;
+
+        snprintf(path, sizeof(path), "/proc/self/task/%s/schedstat", task->d_name);
+        file = fopen(path, "r");
+        if (file == NULL) continue;
+        unsigned long long runtime = 0;
+        if (fscanf(file, "%llu", &runtime) == 1) {
+            total += runtime;
+        }
+        fclose(file);
+    }
+    closedir(tasks);
+    return total;
+}
+
+static void _sleepMilliseconds(uint32_t milliseconds) {
+    usleep(milliseconds * 1000);
+}
+
+static uint32_t _randomBetween(uint32_t minimum, uint32_t maximum) {
+    return minimum + (uint32_t)rand() % (maximum - minimum + 1);
+}
+
+/**
+ * @brief Plays the show, pausing and jumping at random when the scenario
+ * is a storm. Every (re)start of show time is logged as a segment.
+*/
+static void _play(FusesObject *fuses, const Scenario *scenario, Segment *segments, size_t *segmentCount) {
+    uint64_t now = _getCurrentTimeNanoseconds();
+    segments[(*segmentCount)++] = (Segment){ .wallStart = now, .origin = now };
+    fusesPlay(fuses, NULL);
+    if (!scenario->storm) {
+        while (fusesGetIsPlaying(fuses)) {
+            usleep(POLL_INTERVAL);
+        }
+        return;
+    }
+
+    uint32_t showDuration = scenario->cueCount * scenario->spacing;
+    uint64_t stormEnd = now + (uint64_t)STORM_DURATION * NANOSECONDS_PER_MILLISECOND;
+    srand(1);
+    while (_getCurrentTimeNanoseconds() < stormEnd && *segmentCount < MAX_SEGMENT_COUNT) {
+        _sleepMilliseconds(_randomBetween(STORM_MINIMUM_INTERVAL, STORM_MAXIMUM_INTERVAL));
+        Segment *current = &segments[*segmentCount - 1];
+        if (rand() % 2 == 0) {
+            uint64_t pauseStart = _getCurrentTimeNanoseconds();
+            fusesPause(fuses, NULL);
+            _sleepMilliseconds(_randomBetween(STORM_MINIMUM_PAUSE, STORM_MAXIMUM_PAUSE));
+            uint64_t playStart = _getCurrentTimeNanoseconds();
+            segments[(*segmentCount)++] = (Segment){
+                .wallStart = playStart,
+                .origin = current->origin + (playStart - pauseStart)
+            };
+            fusesPlay(fuses, NULL);
+        } else {
+            uint32_t target = _randomBetween(0, showDuration);
+            uint64_t jumpStart = _getCurrentTimeNanoseconds();
+            segments[(*segmentCount)++] = (Segment){
+                .wallStart = jumpStart,
+                .origin = jumpStart - (uint64_t)target * NANOSECONDS_PER_MILLISECOND
+            };
+            fusesJump(fuses, NULL, target);
+        }
+    }
+    fusesStop(fuses, NULL);
+}
+
+static const Segment * _segmentAt(const Segment *segments, size_t segmentCount, uint64_t wallTime) {
+    size_t i = segmentCount - 1;
+    while (i > 0 && segments[i].wallStart > wallTime) {
+        --i;
+    }
+    return &segments[i];
+}
+
+/**
+ * @brief Returns the index of the last cue of the fuse at or before showTime.
+ * cueTimes holds the cue timestamps of every fuse, sorted, between fuseStarts.
+*/
+static int64_t _matchCue(const uint64_t *cueTimes, const uint32_t *fuseStarts, uint32_t fuse, int64_t showTime) {
+    int64_t low = fuseStarts[fuse];
+    int64_t high = fuseStarts[fuse + 1];
+    while (low < high) {
+        int64_t middle = low + (high - low) / 2;
+        if ((int64_t)cueTimes[middle] <= showTime + EARLY_TOLERANCE) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low > fuseStarts[fuse] ? low - 1 : -1;
+}
+
+static int _compareSamples(const void *a, const void *b) {
+    int64_t x = *(const int64_t*)a;
+    int64_t y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    size_t count;
+    int64_t minimum;
+    int64_t median;
+    int64_t p99;
+    int64_t p999;
+    int64_t maximum;
+} Summary;
+
+static Summary _summarize(Samples *samples) {
+    Summary summary = { 0 };
+    size_t count = samples->count;
+    if (count == 0) { return summary; }
+    qsort(samples->values, count, sizeof(int64_t), _compareSamples);
+    summary.count = count;
+    summary.minimum = samples->values[0];
+    summary.median = samples->values[count / 2];
+    summary.p99 = samples->values[count * 99 / 100];
+    summary.p999 = samples->values[count * 999 / 1000];
+    summary.maximum = samples->values[count - 1];
+    return summary;
+}
+
+static void _printSummary(const char *scenario, const char *edge, Summary *summary) {
+    printf(
+        "%-8s %-12s %6zu %9.3f %9.3f %9.3f %9.3f %9.3f\n",
+        scenario, edge, summary->count, summary->minimum / 1e6, summary->median / 1e6,
+        summary->p99 / 1e6, summary->p999 / 1e6, summary->maximum / 1e6
+    );
+}
+
+static void _writeSummary(FILE *output, const char *edge, Summary *summary) {
+    fprintf(
+        output, "\"%s\":{\"count\":%zu,\"min\":%lld,\"median\":%lld,\"p99\":%lld,\"p999\":%lld,\"max\":%lld},",
+        edge, summary->count, (long long)summary->minimum, (long long)summary->median,
+        (long long)summary->p99, (long long)summary->p999, (long long)summary->maximum
+    );
+}
+
+/**
+ * @brief Turns the recorded register writes into fuse edges and collects
+ * lateness and pulse width error per edge.
+*/
+static void _analyze(
+    I2cTransport *recorder, const FusesCue *cues, uint32_t cueCount,
+    const Segment *segments, size_t segmentCount,
+    Samples *ignite, Samples *extinguish, Samples *pulseWidthError, size_t *unmatched
+) {
+    uint32_t fuseStarts[FUSE_COUNT + 1] = { 0 };
+    uint64_t *cueTimes = (uint64_t*)malloc(cueCount * sizeof(uint64_t));
+    for (uint32_t i = 0; i < cueCount; ++i) {
+        ++fuseStarts[cues[i].i2cDeviceIndex * FUSE_COUNT_PER_DEVICE + cues[i].fuseIndex + 1];
+    }
+    for (uint32_t fuse = 0; fuse < FUSE_COUNT; ++fuse) {
+        fuseStarts[fuse + 1] += fuseStarts[fuse];
+    }
+    uint32_t fill[FUSE_COUNT];
+    memcpy(fill, fuseStarts, sizeof(fill));
+    for (uint32_t i = 0; i < cueCount; ++i) {
+        cueTimes[fill[cues[i].i2cDeviceIndex * FUSE_COUNT_PER_DEVICE + cues[i].fuseIndex]++] = cues[i].timestamp;
+    }
+
+    uint8_t registers[DEVICE_COUNT][FUSE_COUNT_PER_DEVICE / FUSES_PER_REGISTER] = { { 0 } };
+    uint64_t litAt[FUSE_COUNT] = { 0 };
+    uint64_t dueAt[FUSE_COUNT] = { 0 };
+    I2cTransactionRecord record;
+    for (size_t i = 0; i2cRecorderGetRecord(recorder, i, &record); ++i) {
+        I2cMessageRecord *message = &record.messages[0];
+        if (record.errorNumber != 0 || message->read || message->length != 2) continue;
+        uint32_t device = record.address - BASE_DEVICE_ADDRESS;
+        uint32_t registerIndex = message->data[0] - FUSE_REGISTER_BASE_ADDRESS;
+        if (device >= DEVICE_COUNT || registerIndex >= FUSE_COUNT_PER_DEVICE / FUSES_PER_REGISTER) continue;
+
+        uint8_t previous = registers[device][registerIndex];
+        uint8_t value = message->data[1];
+        registers[device][registerIndex] = value;
+        for (uint32_t pair = 0; pair < FUSES_PER_REGISTER; ++pair) {
+            uint8_t mask = 0b11 << (2 * pair);
+            if ((previous & mask) == (value & mask)) continue;
+            uint32_t fuse = device * FUSE_COUNT_PER_DEVICE + registerIndex * FUSES_PER_REGISTER + pair;
+            uint64_t wallTime = record.endTimestamp;
+
+            if (value & mask) {
+                const Segment *segment = _segmentAt(segments, segmentCount, wallTime);
+                int64_t showTime = (int64_t)(wallTime - segment->origin);
+                int64_t cue = _matchCue(cueTimes, fuseStarts, fuse, showTime);
+                if (cue < 0) {
+                    ++(*unmatched);
+                    continue;
+                }
+                ignite->values[ignite->count++] = showTime - (int64_t)cueTimes[cue];
+                litAt[fuse] = wallTime;
+                dueAt[fuse] = segment->origin + cueTimes[cue];
+            } else if (litAt[fuse] != 0) {
+                int64_t duration = (int64_t)FUSE_DURATION * NANOSECONDS_PER_MILLISECOND;
+                extinguish->values[extinguish->count++] = (int64_t)(wallTime - dueAt[fuse]) - duration;
+                pulseWidthError->values[pulseWidthError->count++] = (int64_t)(wallTime - litAt[fuse]) - duration;
+                litAt[fuse] = 0;
+            }
+        }
+    }
+    free(cueTimes);
+}
+
+static int _run(const Scenario *scenario, FILE *output) {
+    BenchShowConfiguration showConfiguration = {
+        .deviceCount = DEVICE_COUNT,
+        .cueCount = scenario->cueCount,
+        .baseDeviceAddress = BASE_DEVICE_ADDRESS,
+        .cuePattern = _setCue,
+        .context = (void*)scenario
+    };
+    size_t showSize;
+    void *show = benchShowCreate(&showConfiguration, &showSize);
+    I2cSimulationConfiguration simulationConfiguration = {
+        .clockFrequency = I2C_FAST_MODE_FREQUENCY,
+        .transactionLatency = TRANSACTION_LATENCY
+    };
+    I2cTransport *simulation = i2cSimulationInit(&simulationConfiguration);
+    I2cTransport *recorder = i2cRecorderInit(simulation, RECORD_CAPACITY);
+    Segment *segments = (Segment*)malloc(MAX_SEGMENT_COUNT * sizeof(Segment));
+    if (show == NULL || simulation == NULL || recorder == NULL || segments == NULL) { return EXIT_FAILURE; }
+
+    FusesConfiguration configuration = {
+        .rawData = show,
+        .rawDataSize = showSize,
+        .busName = BUS_NAME,
+        .busNameLength = strlen(BUS_NAME),
+        .transport = recorder,
+        .fuseDuration = FUSE_DURATION
+    };
+    FusesObject *fuses = fusesInit(&configuration);
+    if (fuses == NULL || fusesGetError(fuses)->level == FUSES_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "fusesInit failed: %s\n", fuses ? fusesGetErrorString(fusesGetError(fuses)) : "");
+        return EXIT_FAILURE;
+    }
+
+    i2cRecorderClear(recorder);
+    uint64_t loopCpuStart = _threadCpuTime("fusesLoop");
+    uint64_t busCpuStart = _threadCpuTime("fusesBus");
+    size_t segmentCount = 0;
+    _play(fuses, scenario, segments, &segmentCount);
+    _sleepMilliseconds(2 * FUSE_DURATION);
+    uint64_t loopCpu = _threadCpuTime("fusesLoop") - loopCpuStart;
+    uint64_t busCpu = _threadCpuTime("fusesBus") - busCpuStart;
+    fusesDestroy(fuses);
+
+    size_t recordCount = i2cRecorderGetCount(recorder);
+    Samples ignite = { (int64_t*)malloc(recordCount * FUSES_PER_REGISTER * sizeof(int64_t)), 0 };
+    Samples extinguish = { (int64_t*)malloc(recordCount * FUSES_PER_REGISTER * sizeof(int64_t)), 0 };
+    Samples pulseWidthError = { (int64_t*)malloc(recordCount * FUSES_PER_REGISTER * sizeof(int64_t)), 0 };
+    size_t unmatched = 0;
+    FusesCue *cues = (FusesCue*)((uint8_t*)show + fusesFormatCueOffset(DEVICE_COUNT));
+    _analyze(
+        recorder, cues, scenario->cueCount, segments, segmentCount,
+        &ignite, &extinguish, &pulseWidthError, &unmatched
+    );
+    Summary igniteSummary = _summarize(&ignite);
+    Summary extinguishSummary = _summarize(&extinguish);
+    Summary pulseWidthSummary = _summarize(&pulseWidthError);
+
+    _printSummary(scenario->name, "ignite", &igniteSummary);
+    _printSummary(scenario->name, "extinguish", &extinguishSummary);
+    _printSummary(scenario->name, "pulseWidth", &pulseWidthSummary);
+    printf(
+        "%-8s %-12s loop %.3f ms, bus %.3f ms, %zu unmatched edges, %zu commands\n",
+        scenario->name, "cpu", loopCpu / 1e6, busCpu / 1e6, unmatched, segmentCount
+    );
+    if (output != NULL) {
+        fprintf(output, "{\"scenario\":\"%s\",", scenario->name);
+        _writeSummary(output, "ignite", &igniteSummary);
+        _writeSummary(output, "extinguish", &extinguishSummary);
+        _writeSummary(output, "pulseWidthError", &pulseWidthSummary);
+        fprintf(
+            output, "\"loopCpu\":%llu,\"busCpu\":%llu,\"unmatched\":%zu}\n",
+            (unsigned long long)loopCpu, (unsigned long long)busCpu, unmatched
+        );
+    }
+
+    free(ignite.values);
+    free(extinguish.values);
+    free(pulseWidthError.values);
+    free(segments);
+    i2cRecorderDestroy(recorder);
+    i2cSimulationDestroy(simulation);
+    free(show);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    FILE *output = NULL;
+    if (argc > 1 && (output = fopen(argv[1], "w")) == NULL) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+    printf(
+        "%d devices on a simulated %d kHz bus, fuseDuration %d ms, times in ms\n",
+        DEVICE_COUNT, I2C_FAST_MODE_FREQUENCY / 1000, FUSE_DURATION
+    );
+    printf(
+        "%-8s %-12s %6s %9s %9s %9s %9s %9s\n",
+        "scenario", "edge", "count", "min", "p50", "p99", "p99.9", "max"
+    );
+    int result = EXIT_SUCCESS;
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]) && result == EXIT_SUCCESS; ++i) {
+        result = _run(&scenarios[i], output);
+    }
+    if (output != NULL) {
+        fclose(output);
+    }
+    return result;
+}
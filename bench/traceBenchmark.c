@@ -0,0 +1,166 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/fuses.h"
+#include "../src/fusesFormat.h"
+#include "../src/fusesTrace.h"
+#include "../src/i2cSimulation.h"
+#include "benchShow.h"
+
+/**
+ * Prints what one debug line costs the firing path: fusesTraceRecord
+ * from one and from several threads at once, against the printf the
+ * player used before, written to a pipe nobody reads fast enough.
+ * Then plays a short show on the simulated bus with tracing on and
+ * writes the drained trace in the format of bin/traceDump.
+ *
+ * Build: make bench, run: bin/traceBenchmark [trace.bin]
+*/
+
+#define RECORD_COUNT (1000000)
+#define PRINTF_COUNT (100000)
+#define TRACE_CAPACITY (1 << 21)
+#define PRODUCER_COUNT (4)
+#define CUE_COUNT (64)
+#define CUE_SPACING (10)
+#define FUSE_DURATION (50)
+#define DEVICE_COUNT (4)
+#define BASE_DEVICE_ADDRESS (0b1100000)
+#define BUS_NAME ("/dev/i2c-1")
+#define POLL_INTERVAL (1000)
+#define NANOSECONDS_PER_SECOND (1000000000)
+#define NANOSECONDS_PER_MILLISECOND (1000000)
+
+typedef struct {
+    FusesTrace *trace;
+    uint32_t count;
+} Producer;
+
+static uint64_t _getCurrentTimeNanoseconds(void) {
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    return (uint64_t)currentTime.tv_sec * NANOSECONDS_PER_SECOND + currentTime.tv_nsec;
+}
+
+static void * _produce(void *argument) {
+    Producer *producer = (Producer*)argument;
+    FusesTraceEvent event = { .type = FUSES_TRACE_CUE_IGNITED, .i2cDeviceIndex = FUSES_TRACE_NO_DEVICE };
+    for (uint32_t i = 0; i < producer->count; ++i) {
+        event.cueIndex = i;
+        fusesTraceRecord(producer->trace, &event);
+    }
+    return NULL;
+}
+
+static double _recordCost(uint32_t producerCount) {
+    FusesTrace *trace = fusesTraceInit(TRACE_CAPACITY);
+    Producer producer = { trace, RECORD_COUNT / producerCount };
+    pthread_t threads[PRODUCER_COUNT];
+    uint64_t start = _getCurrentTimeNanoseconds();
+    for (uint32_t i = 0; i < producerCount; ++i) {
+        pthread_create(&threads[i], NULL, _produce, &producer);
+    }
+    for (uint32_t i = 0; i < producerCount; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    uint64_t elapsed = _getCurrentTimeNanoseconds() - start;
+    fusesTraceDestroy(trace);
+    return (double)elapsed / RECORD_COUNT;
+}
+
+static double _printfCost(void) {
+    int pipeFileDescriptors[2];
+    if (pipe(pipeFileDescriptors) != 0) { return 0; }
+    FILE *output = fdopen(pipeFileDescriptors[1], "w");
+    // A reader that drains slowly, like a terminal scrolling.
+    pid_t reader = fork();
+    if (reader == 0) {
+        fclose(output);
+        char buffer[4096];
+        while (read(pipeFileDescriptors[0], buffer, sizeof(buffer)) > 0) {
+            usleep(100);
+        }
+        _exit(0);
+    }
+    close(pipeFileDescriptors[0]);
+    uint64_t start = _getCurrentTimeNanoseconds();
+    for (uint32_t i = 0; i < PRINTF_COUNT; ++i) {
+        fprintf(output, "DEBUG: lit fuse %u\n", i);
+    }
+    fflush(output);
+    uint64_t elapsed = _getCurrentTimeNanoseconds() - start;
+    fclose(output);
+    return (double)elapsed / PRINTF_COUNT;
+}
+
+static void _setCue(void *context, uint32_t cueIndex, FusesCue *cue) {
+    cue->timestamp = (uint64_t)cueIndex * CUE_SPACING * NANOSECONDS_PER_MILLISECOND;
+    cue->i2cDeviceIndex = cueIndex % DEVICE_COUNT;
+    cue->fuseIndex = cueIndex / DEVICE_COUNT;
+}
+
+static int _traceShow(const char *path) {
+    BenchShowConfiguration showConfiguration = {
+        .deviceCount = DEVICE_COUNT,
+        .cueCount = CUE_COUNT,
+        .baseDeviceAddress = BASE_DEVICE_ADDRESS,
+        .cuePattern = _setCue
+    };
+    size_t showSize;
+    uint8_t *show = benchShowCreate(&showConfiguration, &showSize);
+    if (show == NULL) { return EXIT_FAILURE; }
+
+    I2cSimulationConfiguration simulationConfiguration = { .clockFrequency = I2C_FAST_MODE_FREQUENCY };
+    I2cTransport *simulation = i2cSimulationInit(&simulationConfiguration);
+    FusesConfiguration configuration = {
+        .rawData = show,
+        .rawDataSize = showSize,
+        .busName = BUS_NAME,
+        .busNameLength = strlen(BUS_NAME),
+        .transport = simulation,
+        .fuseDuration = FUSE_DURATION,
+        .traceCapacity = CUE_COUNT * 16
+    };
+    FusesObject *fuses = fusesInit(&configuration);
+    if (fuses == NULL || fusesGetError(fuses)->level == FUSES_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "fusesInit failed: %s\n", fuses ? fusesGetErrorString(fusesGetError(fuses)) : "");
+        return EXIT_FAILURE;
+    }
+    fusesPlay(fuses, NULL);
+    while (fusesGetIsPlaying(fuses)) {
+        usleep(POLL_INTERVAL);
+    }
+    usleep(2 * FUSE_DURATION * 1000);
+
+    FusesTraceEvent events[CUE_COUNT * 16];
+    size_t count = fusesDrainTrace(fuses, events, CUE_COUNT * 16);
+    FusesStatistics statistics = fusesGetStatistics(fuses);
+    fusesDestroy(fuses);
+    i2cSimulationDestroy(simulation);
+    free(show);
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL || !fusesTraceWriteHeader(file)) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+    fwrite(events, sizeof(FusesTraceEvent), count, file);
+    fclose(file);
+    printf(
+        "%zu trace events of %d cues written to %s, %llu dropped\n",
+        count, CUE_COUNT, path, (unsigned long long)statistics.traceEventsDropped
+    );
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    printf("%-28s %10s\n", "", "ns/event");
+    printf("%-28s %10.1f\n", "fusesTraceRecord, 1 thread", _recordCost(1));
+    printf("%-28s %10.1f\n", "fusesTraceRecord, 4 threads", _recordCost(PRODUCER_COUNT));
+    printf("%-28s %10.1f\n", "printf to a slow pipe", _printfCost());
+    return argc > 1 ? _traceShow(argv[1]) : EXIT_SUCCESS;
+}
@@ -0,0 +1,173 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/fuses.h"
+#include "../src/fusesFormat.h"
+#include "../src/i2cRecorder.h"
+#include "../src/i2cSimulation.h"
+
+/**
+ * Plays salvos over 4 devices through the simulated bus at standard and
+ * fast mode clock, with and without injected failures, and records the
+ * bus traffic. Prints the transactions, their mean wire time, how long
+ * the slowest salvo edge occupied the bus, the failed transactions and
+ * the register repairs they caused, and checks that every fuse ends up
+ * off. No i2c-dev stand-in is linked, the engine runs unmodified.
+ *
+ * Build: make bench, run: bin/transportBenchmark [trace.csv]
+ * (the trace of the last run is written as CSV)
+*/
+
+#define DEVICE_COUNT (4)
+#define FUSE_COUNT_PER_DEVICE (16)
+#define FUSES_PER_SALVO (DEVICE_COUNT * FUSE_COUNT_PER_DEVICE)
+#define SALVO_COUNT (3)
+#define SALVO_SPACING (200)
+#define FUSE_DURATION (50)
+#define FUSE_REGISTER_BASE_ADDRESS (0x14)
+#define FUSE_REGISTER_COUNT (4)
+#define BASE_DEVICE_ADDRESS (0b1100000)
+#define BUS_NAME ("/dev/i2c-1")
+#define POLL_INTERVAL (1000)
+#define RECORD_CAPACITY (4096)
+#define TRANSACTION_LATENCY (20000)
+// transactions further apart than this belong to different edges
+#define EDGE_GAP (5000000)
+#define FAILURE_RATE (20000)
+
+typedef struct {
+    uint32_t clockFrequency;
+    uint32_t failureRate;
+} Scenario;
+
+static const Scenario scenarios[] = {
+    { I2C_STANDARD_MODE_FREQUENCY, 0 },
+    { I2C_FAST_MODE_FREQUENCY, 0 },
+    { I2C_STANDARD_MODE_FREQUENCY, FAILURE_RATE },
+    { I2C_FAST_MODE_FREQUENCY, FAILURE_RATE }
+};
+
+typedef struct __attribute__((packed)) {
+    FusesHeader header;
+    FusesDataItem items[SALVO_COUNT * FUSES_PER_SALVO];
+} Show;
+
+static void _createShow(Show *show) {
+    memcpy(show->header.fusesMagic, FUSES_V1_MAGIC, FUSES_MAGIC_SIZE);
+    show->header.dataItemCount = SALVO_COUNT * FUSES_PER_SALVO;
+    show->header.i2cDeviceIndexMask = (1 << DEVICE_COUNT) - 1;
+    for (int i = 0; i < SALVO_COUNT * FUSES_PER_SALVO; ++i) {
+        show->items[i].timestamp = (i / FUSES_PER_SALVO) * SALVO_SPACING;
+        show->items[i].i2cDeviceIndex = (i % FUSES_PER_SALVO) / FUSE_COUNT_PER_DEVICE;
+        show->items[i].fuseIndex = i % FUSE_COUNT_PER_DEVICE;
+    }
+}
+
+static int _run(Show *show, const Scenario *scenario, FILE *trace) {
+    I2cSimulationConfiguration simulationConfiguration = {
+        .clockFrequency = scenario->clockFrequency,
+        .transactionLatency = TRANSACTION_LATENCY,
+        .failureRate = scenario->failureRate,
+        // a NACKed data byte, not retried by the i2c layer like EIO
+        .failureErrno = EREMOTEIO,
+        .seed = 1
+    };
+    I2cTransport *simulation = i2cSimulationInit(&simulationConfiguration);
+    I2cTransport *recorder = i2cRecorderInit(simulation, RECORD_CAPACITY);
+    if (simulation == NULL || recorder == NULL) { return EXIT_FAILURE; }
+
+    FusesConfiguration configuration = {
+        .rawData = show,
+        .rawDataSize = sizeof(Show),
+        .busName = BUS_NAME,
+        .busNameLength = strlen(BUS_NAME),
+        .transport = recorder,
+        .fuseDuration = FUSE_DURATION
+    };
+    FusesObject *fuses = fusesInit(&configuration);
+    if (fuses == NULL || fusesGetError(fuses)->level == FUSES_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "fusesInit failed: %s\n", fuses ? fusesGetErrorString(fusesGetError(fuses)) : "");
+        return EXIT_FAILURE;
+    }
+
+    i2cRecorderClear(recorder);
+    fusesPlay(fuses, NULL);
+    while (fusesGetIsPlaying(fuses)) {
+        usleep(POLL_INTERVAL);
+    }
+    usleep(4 * FUSE_DURATION * 1000);
+    FusesStatistics statistics = fusesGetStatistics(fuses);
+    fusesDestroy(fuses);
+
+    uint64_t busTime = 0;
+    uint64_t failed = 0;
+    uint64_t longestEdge = 0;
+    uint64_t edgeStart = 0;
+    uint64_t previousEnd = 0;
+    I2cTransactionRecord record;
+    size_t count = i2cRecorderGetCount(recorder);
+    for (size_t i = 0; i2cRecorderGetRecord(recorder, i, &record); ++i) {
+        busTime += record.endTimestamp - record.startTimestamp;
+        failed += record.errorNumber != 0;
+        if (i == 0 || record.startTimestamp - previousEnd > EDGE_GAP) {
+            edgeStart = record.startTimestamp;
+        }
+        if (record.endTimestamp - edgeStart > longestEdge) {
+            longestEdge = record.endTimestamp - edgeStart;
+        }
+        previousEnd = record.endTimestamp;
+    }
+    if (trace != NULL) {
+        i2cRecorderWriteCsv(recorder, trace);
+    }
+
+    int litRegisters = 0;
+    for (int device = 0; device < DEVICE_COUNT; ++device) {
+        for (int i = 0; i < FUSE_REGISTER_COUNT; ++i) {
+            litRegisters += i2cSimulationGetRegister(
+                simulation, BUS_NAME, BASE_DEVICE_ADDRESS | device, FUSE_REGISTER_BASE_ADDRESS + i
+            ) != 0;
+        }
+    }
+    i2cRecorderDestroy(recorder);
+    i2cSimulationDestroy(simulation);
+
+    printf(
+        "%9u %8.1f%% %13zu %12.1f %13.3f %7llu %8llu %6d\n",
+        scenario->clockFrequency / 1000, scenario->failureRate / 1e4, count,
+        count > 0 ? busTime / 1e3 / count : 0.0, longestEdge / 1e6,
+        (unsigned long long)failed, (unsigned long long)statistics.registerRepairs, litRegisters
+    );
+    return litRegisters == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[]) {
+    FILE *trace = NULL;
+    if (argc > 1 && (trace = fopen(argv[1], "w")) == NULL) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+    Show show;
+    _createShow(&show);
+
+    printf(
+        "%d salvos of %d fuses, %d us transaction latency\n",
+        SALVO_COUNT, FUSES_PER_SALVO, TRANSACTION_LATENCY / 1000
+    );
+    printf(
+        "%9s %9s %13s %12s %13s %7s %8s %6s\n",
+        "clock[kHz]", "failures", "transactions", "mean[us]", "edgeSpan[ms]", "failed", "repairs", "lit"
+    );
+    int result = EXIT_SUCCESS;
+    size_t scenarioCount = sizeof(scenarios) / sizeof(scenarios[0]);
+    for (size_t i = 0; i < scenarioCount && result == EXIT_SUCCESS; ++i) {
+        result = _run(&show, &scenarios[i], i == scenarioCount - 1 ? trace : NULL);
+    }
+    if (trace != NULL) {
+        fclose(trace);
+    }
+    return result;
+}
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/fuses.h"
+#include "../src/fusesFormat.h"
+#include "../src/i2cSimulation.h"
+#include "benchShow.h"
+
+/**
+ * Plays a steady show on one simulated bus at 100 kHz without and with
+ * verifyWrites, and once more with a device whose first fuse register
+ * never latches: the transport acknowledges its writes but drops them.
+ * Printed are the median ignite lateness and the mean and maximum time
+ * writes waited for the bus (microseconds), which grows by at most one
+ * readback, register writes, readbacks, mismatches, mismatch events that
+ * named a cue of the broken register, and the share of the show the bus
+ * was busy.
+ *
+ * Build: make bench, run: bin/verifyBenchmark
+*/
+
+#define CUE_COUNT (1000)
+#define CUE_SPACING (5)
+#define FUSE_DURATION (20)
+#define DEVICE_COUNT (16)
+#define FUSE_COUNT_PER_DEVICE (16)
+#define BASE_DEVICE_ADDRESS (0b1100000)
+#define BUS_NAME ("/dev/i2c-1")
+#define BROKEN_DEVICE_INDEX (5)
+#define BROKEN_REGISTER (FUSES_REGISTER_BASE_ADDRESS)
+#define POLL_INTERVAL (1000)
+#define NANOSECONDS_PER_MILLISECOND (1000000)
+#define NANOSECONDS_PER_MICROSECOND (1000)
+
+// Forwards to the simulation, but drops the writes to the broken register.
+typedef struct {
+    I2cTransport transport;
+    I2cTransport *inner;
+    bool broken;
+    uint64_t droppedWrites;
+} _LatchTransport;
+
+typedef struct {
+    const FusesCue *cues;
+    uint64_t events;
+    uint64_t namedEvents;
+} _Mismatches;
+
+static void * _open(I2cTransport *self, const char *busName) {
+    _LatchTransport *_self = (_LatchTransport*)self;
+    return _self->inner->open(_self->inner, busName);
+}
+
+static void _close(I2cTransport *self, void *bus) {
+    _LatchTransport *_self = (_LatchTransport*)self;
+    _self->inner->close(_self->inner, bus);
+}
+
+static bool _transfer(I2cTransport *self, void *bus, uint8_t address, I2cMessage *messages, size_t messageCount) {
+    _LatchTransport *_self = (_LatchTransport*)self;
+    if (
+        _self->broken && address == (BASE_DEVICE_ADDRESS | BROKEN_DEVICE_INDEX)
+        && messageCount == 1 && !messages[0].read && messages[0].buffer[0] == BROKEN_REGISTER
+    ) {
+        ++(_self->droppedWrites);
+        return true;
+    }
+    return _self->inner->transfer(_self->inner, bus, address, messages, messageCount);
+}
+
+static bool _probe(I2cTransport *self, void *bus, uint8_t address) {
+    _LatchTransport *_self = (_LatchTransport*)self;
+    return _self->inner->probe(_self->inner, bus, address);
+}
+
+static bool _reopen(I2cTransport *self, void *bus, const char *busName) {
+    _LatchTransport *_self = (_LatchTransport*)self;
+    return _self->inner->reopen(_self->inner, bus, busName);
+}
+
+// On the bus worker, the only thread raising mismatches.
+static void _handleEvent(void *context, const FusesEvent *event) {
+    _Mismatches *mismatches = (_Mismatches*)context;
+    if (event->type != FUSES_EVENT_VERIFY_MISMATCH) { return; }
+    ++(mismatches->events);
+    if (event->cueIndex >= CUE_COUNT) { return; }
+    const FusesCue *cue = &mismatches->cues[event->cueIndex];
+    if (
+        cue->i2cDeviceIndex == BROKEN_DEVICE_INDEX && cue->fuseIndex == event->fuseIndex
+        && event->registerAddress == BROKEN_REGISTER && event->switchTimestamp <= event->timestamp
+    ) {
+        ++(mismatches->namedEvents);
+    }
+}
+
+static void _setCue(void *context, uint32_t cueIndex, FusesCue *cue) {
+    uint32_t fuseSlot = cueIndex % (DEVICE_COUNT * FUSE_COUNT_PER_DEVICE);
+    cue->timestamp = (uint64_t)(cueIndex + 1) * CUE_SPACING * NANOSECONDS_PER_MILLISECOND;
+    // device first, so consecutive cues hit different devices
+    cue->i2cDeviceIndex = fuseSlot % DEVICE_COUNT;
+    cue->fuseIndex = fuseSlot / DEVICE_COUNT;
+}
+
+static bool _play(const char *name, uint8_t *show, size_t showSize, bool verify, bool broken) {
+    I2cSimulationConfiguration simulationConfiguration = { .clockFrequency = I2C_STANDARD_MODE_FREQUENCY };
+    I2cTransport *simulation = i2cSimulationInit(&simulationConfiguration);
+    _LatchTransport transport = {
+        .transport = { _open, _close, _transfer, _probe, _reopen },
+        .inner = simulation,
+        .broken = broken
+    };
+    _Mismatches mismatches = { .cues = (const FusesCue*)(show + fusesFormatCueOffset(DEVICE_COUNT)) };
+    FusesConfiguration configuration = {
+        .rawData = show,
+        .rawDataSize = showSize,
+        .busName = BUS_NAME,
+        .busNameLength = strlen(BUS_NAME),
+        .transport = (I2cTransport*)&transport,
+        .fuseDuration = FUSE_DURATION,
+        .measureLateness = true,
+        .eventMask = FUSES_EVENT_MASK(FUSES_EVENT_VERIFY_MISMATCH),
+        .eventCallback = _handleEvent,
+        .eventCallbackContext = &mismatches,
+        .verifyWrites = verify
+    };
+    FusesObject *fuses = fusesInit(&configuration);
+    if (fuses == NULL || fusesGetError(fuses)->level == FUSES_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "fusesInit failed: %s\n", fuses ? fusesGetErrorString(fusesGetError(fuses)) : "");
+        return false;
+    }
+
+    // The writes of startup are not part of the show.
+    I2cSimulationStatistics startStatistics = i2cSimulationGetStatistics(simulation);
+    fusesPlay(fuses, NULL);
+    while (fusesGetIsPlaying(fuses)) {
+        usleep(POLL_INTERVAL);
+    }
+    // The last extinguish edges and their readbacks.
+    usleep(2 * FUSE_DURATION * 1000);
+
+    FusesStatistics statistics = fusesGetStatistics(fuses);
+    FusesLatenessReport report = fusesGetLatenessReport(fuses);
+    BusWorkerStatistics busStatistics = fusesGetBusStatistics(fuses, 0);
+    I2cSimulationStatistics simulationStatistics = i2cSimulationGetStatistics(simulation);
+    double busyShare = (double)(simulationStatistics.busyTime - startStatistics.busyTime)
+        / ((CUE_COUNT + 1) * CUE_SPACING * (double)NANOSECONDS_PER_MILLISECOND);
+    printf(
+        "%-16s %7d %7llu %8llu %8llu %9llu %10llu %8llu %6.1f%%\n",
+        name, report.median,
+        (unsigned long long)(busStatistics.totalQueueDelay / busStatistics.writes / NANOSECONDS_PER_MICROSECOND),
+        (unsigned long long)(busStatistics.maximumQueueDelay / NANOSECONDS_PER_MICROSECOND),
+        (unsigned long long)statistics.registerWrites, (unsigned long long)statistics.verifications,
+        (unsigned long long)statistics.verificationMismatches, (unsigned long long)mismatches.namedEvents,
+        busyShare * 100
+    );
+    fusesDestroy(fuses);
+    i2cSimulationDestroy(simulation);
+
+    bool success = report.count == CUE_COUNT;
+    if (verify && !broken) {
+        success = success && statistics.verifications > 0 && statistics.verificationMismatches == 0;
+    }
+    if (broken) {
+        // Every mismatch event has to name a cue of the broken register.
+        success = success && mismatches.events > 0 && mismatches.namedEvents == mismatches.events;
+    }
+    return success;
+}
+
+int main(int argc, char *argv[]) {
+    BenchShowConfiguration showConfiguration = {
+        .deviceCount = DEVICE_COUNT,
+        .cueCount = CUE_COUNT,
+        .baseDeviceAddress = BASE_DEVICE_ADDRESS,
+        .cuePattern = _setCue
+    };
+    size_t showSize;
+    uint8_t *show = benchShowCreate(&showConfiguration, &showSize);
+    if (show == NULL) { return EXIT_FAILURE; }
+    printf("%d cues every %d ms, %d devices on one bus at 100 kHz\n", CUE_COUNT, CUE_SPACING, DEVICE_COUNT);
+    printf(
+        "%-16s %7s %7s %8s %8s %9s %10s %8s %7s\n",
+        "verification", "median", "wait", "max wait", "writes", "readbacks", "mismatches", "named", "busy"
+    );
+    bool success = _play("off", show, showSize, false, false);
+    success = _play("on", show, showSize, true, false) && success;
+    success = _play("on, no latch", show, showSize, true, true) && success;
+    free(show);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/fuses.h"
+#include "../src/fusesFormat.h"
+#include "../src/i2cSimulation.h"
+#include "../src/virtualClock.h"
+#include "benchShow.h"
+
+/**
+ * Plays a 30 minute show on a simulated bus with a virtual clock going
+ * from event to event and running at 1000x and 10000x. Printed are the
+ * wall time (s), how much faster than real time the show played, the
+ * waits of the timing thread, register writes and the ignite lateness in
+ * virtual time (microseconds): exact from event to event, scaled by the
+ * speed otherwise.
+ *
+ * Build: make bench, run: bin/virtualClockBenchmark
+*/
+
+#define SHOW_DURATION (30 * 60 * 1000)
+#define CUE_SPACING (250)
+#define CUE_COUNT (SHOW_DURATION / CUE_SPACING)
+#define FUSE_DURATION (200)
+#define DEVICE_COUNT (16)
+#define FUSE_COUNT_PER_DEVICE (16)
+#define BASE_DEVICE_ADDRESS (0b1100000)
+#define BUS_NAME ("/dev/i2c-1")
+#define POLL_INTERVAL (1000)
+#define NANOSECONDS_PER_MILLISECOND (1000000)
+#define NANOSECONDS_PER_SECOND (1000000000)
+
+static uint64_t _getCurrentTimeNanoseconds(void) {
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    return (uint64_t)currentTime.tv_sec * NANOSECONDS_PER_SECOND + currentTime.tv_nsec;
+}
+
+static void _setCue(void *context, uint32_t cueIndex, FusesCue *cue) {
+    uint32_t fuseSlot = cueIndex % (DEVICE_COUNT * FUSE_COUNT_PER_DEVICE);
+    cue->timestamp = (uint64_t)cueIndex * CUE_SPACING * NANOSECONDS_PER_MILLISECOND;
+    cue->i2cDeviceIndex = fuseSlot / FUSE_COUNT_PER_DEVICE;
+    cue->fuseIndex = fuseSlot % FUSE_COUNT_PER_DEVICE;
+}
+
+static bool _play(const char *name, uint8_t *show, size_t showSize, uint32_t speed) {
+    I2cSimulationConfiguration simulationConfiguration = { .clockFrequency = 0 };
+    I2cTransport *simulation = i2cSimulationInit(&simulationConfiguration);
+    VirtualClockConfiguration clockConfiguration = { .speed = speed };
+    ClockSource *clock = virtualClockInit(&clockConfiguration);
+    FusesConfiguration configuration = {
+        .rawData = show,
+        .rawDataSize = showSize,
+        .busName = BUS_NAME,
+        .busNameLength = strlen(BUS_NAME),
+        .transport = simulation,
+        .fuseDuration = FUSE_DURATION,
+        .measureLateness = true,
+        .clock = clock
+    };
+    FusesObject *fuses = fusesInit(&configuration);
+    if (fuses == NULL || fusesGetError(fuses)->level == FUSES_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "fusesInit failed: %s\n", fuses ? fusesGetErrorString(fusesGetError(fuses)) : "");
+        return false;
+    }
+
+    uint64_t start = _getCurrentTimeNanoseconds();
+    fusesPlay(fuses, NULL);
+    while (fusesGetIsPlaying(fuses)) {
+        usleep(POLL_INTERVAL);
+    }
+    double wallTime = (double)(_getCurrentTimeNanoseconds() - start) / NANOSECONDS_PER_SECOND;
+
+    FusesStatistics statistics = fusesGetStatistics(fuses);
+    FusesLatenessReport report = fusesGetLatenessReport(fuses);
+    VirtualClockStatistics clockStatistics = virtualClockGetStatistics(clock);
+    printf(
+        "%-14s %8.3f %10.0f %8llu %8llu %8d %8d %8d\n",
+        name, wallTime, SHOW_DURATION / 1000.0 / wallTime, (unsigned long long)clockStatistics.waits,
+        (unsigned long long)statistics.registerWrites, report.median, report.p99, report.maximum
+    );
+    fusesDestroy(fuses);
+    virtualClockDestroy(clock);
+    i2cSimulationDestroy(simulation);
+    return report.count == CUE_COUNT;
+}
+
+int main(int argc, char *argv[]) {
+    BenchShowConfiguration showConfiguration = {
+        .deviceCount = DEVICE_COUNT,
+        .cueCount = CUE_COUNT,
+        .baseDeviceAddress = BASE_DEVICE_ADDRESS,
+        .cuePattern = _setCue
+    };
+    size_t showSize;
+    uint8_t *show = benchShowCreate(&showConfiguration, &showSize);
+    if (show == NULL) { return EXIT_FAILURE; }
+    printf("%d cues every %d ms, %d minutes of show\n", CUE_COUNT, CUE_SPACING, SHOW_DURATION / 60000);
+    printf(
+        "%-14s %8s %10s %8s %8s %8s %8s %8s\n",
+        "clock", "wall[s]", "speedup", "waits", "writes", "median", "p99", "max"
+    );
+    bool success = _play("event to event", show, showSize, 0)
+        && _play("1000x", show, showSize, 1000)
+        && _play("10000x", show, showSize, 10000);
+    free(show);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
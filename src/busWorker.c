@@ -0,0 +1,278 @@
+#include "busWorker.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/prctl.h>
+
+#include "spscRing.h"
+
+typedef uint8_t Bool8;
+
+#define NANOSECONDS_PER_SECOND (1000000000)
+#define IDLE_POLL_INTERVAL (100)
+// yields before the first sleep, writes without wire time take microseconds
+#define IDLE_YIELD_COUNT (64)
+#define THREAD_NAME ("fusesBus")
+
+typedef struct {
+    SpscRing *ring;
+    pthread_t thread;
+    Bool8 threadStarted;
+    int wakeFileDescriptor;
+    Bool8 sleeping;
+    Bool8 haltFlag;
+
+    BusWorkerCompletionHandler completionHandler;
+    BusWorkerVerificationHandler verificationHandler;
+    void *context;
+
+    // readbacks still to do, oldest first, owned by the worker
+    BusWrite *verifications;
+    size_t verificationCapacity;
+    size_t verificationHead;
+    size_t verificationCount;
+
+    // written by the producer
+    uint64_t posted;
+    uint64_t rejectedWrites;
+    size_t maximumQueueDepth;
+
+    // written by the worker
+    uint64_t writes;
+    uint64_t failedWrites;
+    uint64_t totalQueueDelay;
+    uint64_t maximumQueueDelay;
+    uint64_t totalServiceTime;
+    uint64_t maximumServiceTime;
+    uint64_t verificationsPerformed;
+    uint64_t verificationMismatches;
+    uint64_t failedVerifications;
+} _BusWorker;
+
+static uint64_t _getCurrentTimeNanoseconds(void) {
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    return (uint64_t)currentTime.tv_sec * NANOSECONDS_PER_SECOND + currentTime.tv_nsec;
+}
+
+static void _add(uint64_t *counter, uint64_t value) {
+    __atomic_store_n(counter, *counter + value, __ATOMIC_RELAXED);
+}
+
+static void _maximum(uint64_t *counter, uint64_t value) {
+    if (value > *counter) {
+        __atomic_store_n(counter, value, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Queues the readback of a performed write, or replaces the one
+ * pending for the same register, whose value is outdated now.
+*/
+static void _queueVerification(_BusWorker *_self, BusWrite *write, bool failed) {
+    for (size_t i = 0; i < _self->verificationCount; ++i) {
+        BusWrite *pending = &_self->verifications[(_self->verificationHead + i) % _self->verificationCapacity];
+        if (pending->device == write->device && pending->registerAddress == write->registerAddress) {
+            // A failed write is repaired by a later one, which is read back.
+            if (failed) {
+                pending->device = NULL;
+            } else {
+                *pending = *write;
+            }
+            return;
+        }
+    }
+    if (failed || _self->verificationCount == _self->verificationCapacity) { return; }
+    size_t tail = (_self->verificationHead + _self->verificationCount) % _self->verificationCapacity;
+    _self->verifications[tail] = *write;
+    ++(_self->verificationCount);
+}
+
+static void _verify(_BusWorker *_self) {
+    BusWrite write = _self->verifications[_self->verificationHead];
+    _self->verificationHead = (_self->verificationHead + 1) % _self->verificationCapacity;
+    --(_self->verificationCount);
+    if (write.device == NULL) { return; }
+
+    uint8_t value = i2cReadByte(write.device, write.registerAddress);
+    bool failed = i2cGetError(write.device)->level == I2C_ERROR_LEVEL_ERROR;
+    _add(&_self->verificationsPerformed, 1);
+    if (failed) {
+        _add(&_self->failedVerifications, 1);
+    } else if (value != write.value) {
+        _add(&_self->verificationMismatches, 1);
+    }
+    _self->verificationHandler(_self->context, &write, value, failed);
+}
+
+static void _perform(_BusWorker *_self, BusWrite *write) {
+    uint64_t start = _getCurrentTimeNanoseconds();
+    i2cWriteByte(write->device, write->registerAddress, write->value);
+    uint64_t end = _getCurrentTimeNanoseconds();
+
+    _add(&_self->totalQueueDelay, start - write->postedTimestamp);
+    _maximum(&_self->maximumQueueDelay, start - write->postedTimestamp);
+    _add(&_self->totalServiceTime, end - start);
+    _maximum(&_self->maximumServiceTime, end - start);
+    bool failed = i2cGetError(write->device)->level == I2C_ERROR_LEVEL_ERROR;
+    if (failed) {
+        _add(&_self->failedWrites, 1);
+    }
+    if (_self->completionHandler != NULL) {
+        _self->completionHandler(_self->context, write, failed);
+    }
+    if (_self->verificationHandler != NULL) {
+        _queueVerification(_self, write, failed);
+    }
+    // Last, so busWorkerWaitIdle sees the write including its error.
+    __atomic_store_n(&_self->writes, _self->writes + 1, __ATOMIC_RELEASE);
+}
+
+static void * _run(void *self) {
+    _BusWorker *_self = (_BusWorker*)self;
+    prctl(PR_SET_NAME, THREAD_NAME);
+    BusWrite write;
+    while (true) {
+        if (spscRingPop(_self->ring, &write)) {
+            _perform(_self, &write);
+            continue;
+        }
+        if (__atomic_load_n(&_self->haltFlag, __ATOMIC_ACQUIRE)) { break; }
+        // Only while no write waits, the ring is looked at again after each.
+        if (_self->verificationCount > 0) {
+            _verify(_self);
+            continue;
+        }
+
+        // Announce the sleep before the last look at the ring; the
+        // producer publishes before it checks the flag.
+        __atomic_store_n(&_self->sleeping, true, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (spscRingGetCount(_self->ring) == 0 && !__atomic_load_n(&_self->haltFlag, __ATOMIC_ACQUIRE)) {
+            uint64_t counter;
+            read(_self->wakeFileDescriptor, &counter, sizeof(counter));
+        }
+        __atomic_store_n(&_self->sleeping, false, __ATOMIC_SEQ_CST);
+    }
+    return NULL;
+}
+
+static void _wake(_BusWorker *_self) {
+    uint64_t increment = 1;
+    write(_self->wakeFileDescriptor, &increment, sizeof(increment));
+}
+
+BusWorker * busWorkerInit(size_t capacity, BusWorkerCompletionHandler completionHandler, void *context) {
+    return busWorkerInitWithVerification(capacity, completionHandler, NULL, context);
+}
+
+BusWorker * busWorkerInitWithVerification(
+    size_t capacity, BusWorkerCompletionHandler completionHandler,
+    BusWorkerVerificationHandler verificationHandler, void *context
+) {
+    _BusWorker *_self = (_BusWorker*)calloc(1, sizeof(_BusWorker));
+    if (_self == NULL) { return NULL; }
+    _self->completionHandler = completionHandler;
+    _self->verificationHandler = verificationHandler;
+    _self->context = context;
+    _self->wakeFileDescriptor = eventfd(0, EFD_CLOEXEC);
+    _self->ring = spscRingInit(capacity, sizeof(BusWrite));
+    if (verificationHandler != NULL) {
+        _self->verificationCapacity = capacity;
+        _self->verifications = (BusWrite*)malloc(capacity * sizeof(BusWrite));
+    }
+    if (
+        _self->wakeFileDescriptor == -1
+        || _self->ring == NULL
+        || (verificationHandler != NULL && _self->verifications == NULL)
+        || pthread_create(&_self->thread, NULL, _run, (void*)_self) != 0
+    ) {
+        busWorkerDestroy((BusWorker*)_self);
+        return NULL;
+    }
+    _self->threadStarted = true;
+    return (BusWorker*)_self;
+}
+
+void busWorkerDestroy(BusWorker *self) {
+    _BusWorker *_self = (_BusWorker*)self;
+    if (_self->threadStarted) {
+        __atomic_store_n(&_self->haltFlag, true, __ATOMIC_SEQ_CST);
+        _wake(_self);
+        pthread_join(_self->thread, NULL);
+    }
+    if (_self->wakeFileDescriptor != -1) {
+        close(_self->wakeFileDescriptor);
+    }
+    if (_self->ring != NULL) {
+        spscRingDestroy(_self->ring);
+    }
+    free(_self->verifications);
+    free(_self);
+}
+
+bool busWorkerPost(BusWorker *self, BusWrite *write) {
+    _BusWorker *_self = (_BusWorker*)self;
+    write->postedTimestamp = _getCurrentTimeNanoseconds();
+    if (!spscRingPush(_self->ring, write)) {
+        __atomic_store_n(&_self->rejectedWrites, _self->rejectedWrites + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    __atomic_store_n(&_self->posted, _self->posted + 1, __ATOMIC_RELEASE);
+
+    size_t queueDepth = spscRingGetCount(_self->ring);
+    if (queueDepth > _self->maximumQueueDepth) {
+        __atomic_store_n(&_self->maximumQueueDepth, queueDepth, __ATOMIC_RELAXED);
+    }
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&_self->sleeping, __ATOMIC_SEQ_CST)) {
+        _wake(_self);
+    }
+    return true;
+}
+
+bool busWorkerCanPost(BusWorker *self) {
+    _BusWorker *_self = (_BusWorker*)self;
+    return spscRingGetCount(_self->ring) < spscRingGetCapacity(_self->ring);
+}
+
+void busWorkerWaitIdle(BusWorker *self) {
+    _BusWorker *_self = (_BusWorker*)self;
+    uint64_t posted = __atomic_load_n(&_self->posted, __ATOMIC_ACQUIRE);
+    for (int i = 0; __atomic_load_n(&_self->writes, __ATOMIC_ACQUIRE) < posted; ++i) {
+        if (i < IDLE_YIELD_COUNT) {
+            sched_yield();
+        } else {
+            usleep(IDLE_POLL_INTERVAL);
+        }
+    }
+}
+
+BusWorkerStatistics busWorkerGetStatistics(BusWorker *self) {
+    _BusWorker *_self = (_BusWorker*)self;
+    BusWorkerStatistics statistics = {
+        .writes = __atomic_load_n(&_self->writes, __ATOMIC_ACQUIRE),
+        .failedWrites = __atomic_load_n(&_self->failedWrites, __ATOMIC_RELAXED),
+        .rejectedWrites = __atomic_load_n(&_self->rejectedWrites, __ATOMIC_RELAXED),
+        .queueDepth = spscRingGetCount(_self->ring),
+        .maximumQueueDepth = __atomic_load_n(&_self->maximumQueueDepth, __ATOMIC_RELAXED),
+        .totalQueueDelay = __atomic_load_n(&_self->totalQueueDelay, __ATOMIC_RELAXED),
+        .maximumQueueDelay = __atomic_load_n(&_self->maximumQueueDelay, __ATOMIC_RELAXED),
+        .totalServiceTime = __atomic_load_n(&_self->totalServiceTime, __ATOMIC_RELAXED),
+        .maximumServiceTime = __atomic_load_n(&_self->maximumServiceTime, __ATOMIC_RELAXED),
+        .verifications = __atomic_load_n(&_self->verificationsPerformed, __ATOMIC_RELAXED),
+        .verificationMismatches = __atomic_load_n(&_self->verificationMismatches, __ATOMIC_RELAXED),
+        .failedVerifications = __atomic_load_n(&_self->failedVerifications, __ATOMIC_RELAXED)
+    };
+    return statistics;
+}
+
+pthread_t busWorkerGetThread(BusWorker *self) {
+    _BusWorker *_self = (_BusWorker*)self;
+    return _self->thread;
+}
@@ -0,0 +1,86 @@
+#ifndef __BUS_WORKER_H__
+#define __BUS_WORKER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "i2c.h"
+
+/**
+ * @brief I/O thread that owns one I2C bus and performs the register
+ * writes posted to it in posting order.
+ *
+ * Writes travel through a lock-free single-producer/single-consumer ring,
+ * so busWorkerPost never blocks on the bus: it returns false when the
+ * ring is full and the producer decides how to retry. The worker sleeps
+ * on an eventfd while the ring is empty and is only woken when it
+ * actually sleeps.
+ *
+ * With a verification handler every write is read back once the ring is
+ * empty, so readbacks only fill idle slots of the bus and a write waits
+ * for at most one of them. A later write to the same register replaces
+ * its pending readback; readbacks still pending at busWorkerDestroy are
+ * dropped.
+*/
+
+typedef struct {
+    I2cDevice *device;
+    uint32_t i2cDeviceIndex;
+    uint8_t registerAddress;
+    uint8_t value;
+    // set by busWorkerPost
+    uint64_t postedTimestamp;
+} BusWrite;
+
+// Called on the worker thread after every write, failed tells whether
+// i2cGetError of the device holds the error of this write.
+typedef void (*BusWorkerCompletionHandler)(void *context, BusWrite *write, bool failed);
+// Called on the worker thread after every readback of write with the
+// value read, failed tells whether the read itself failed.
+typedef void (*BusWorkerVerificationHandler)(void *context, BusWrite *write, uint8_t value, bool failed);
+
+typedef struct {
+    uint64_t writes;
+    uint64_t failedWrites;
+    // writes not taken because the ring was full
+    uint64_t rejectedWrites;
+    size_t queueDepth;
+    size_t maximumQueueDepth;
+    // time from posting to the start of the write, in nanoseconds
+    uint64_t totalQueueDelay;
+    uint64_t maximumQueueDelay;
+    // time the write itself took on the bus, in nanoseconds
+    uint64_t totalServiceTime;
+    uint64_t maximumServiceTime;
+    // readbacks performed, read back values that differed from the write
+    // and readbacks that failed on the bus
+    uint64_t verifications;
+    uint64_t verificationMismatches;
+    uint64_t failedVerifications;
+} BusWorkerStatistics;
+
+typedef void* BusWorker;
+
+BusWorker * busWorkerInit(size_t capacity, BusWorkerCompletionHandler completionHandler, void *context);
+// reads back every write as well, up to capacity registers pending
+BusWorker * busWorkerInitWithVerification(
+    size_t capacity, BusWorkerCompletionHandler completionHandler,
+    BusWorkerVerificationHandler verificationHandler, void *context
+);
+// performs the writes still queued, then stops the thread
+void busWorkerDestroy(BusWorker *self);
+
+// producer thread only
+bool busWorkerPost(BusWorker *self, BusWrite *write);
+// producer thread only; the next post succeeds, the worker only frees slots
+bool busWorkerCanPost(BusWorker *self);
+// blocks until every write posted so far has been performed
+void busWorkerWaitIdle(BusWorker *self);
+
+BusWorkerStatistics busWorkerGetStatistics(BusWorker *self);
+// for scheduling settings of the worker thread
+pthread_t busWorkerGetThread(BusWorker *self);
+
+#endif // __BUS_WORKER_H__
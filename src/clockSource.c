@@ -0,0 +1,20 @@
+#include "clockSource.h"
+
+#include <time.h>
+
+#define NANOSECONDS_PER_SECOND (1000000000)
+
+static uint64_t _monotonicNow(ClockSource *self) {
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    return (uint64_t)currentTime.tv_sec * NANOSECONDS_PER_SECOND + currentTime.tv_nsec;
+}
+
+static ClockSource _monotonicClock = {
+    .now = _monotonicNow,
+    .wait = NULL
+};
+
+ClockSource * clockSourceGetMonotonic(void) {
+    return &_monotonicClock;
+}
@@ -0,0 +1,28 @@
+#ifndef __CLOCK_SOURCE_H__
+#define __CLOCK_SOURCE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Time source of the player.
+ *
+ * now returns the current time in nanoseconds on a monotonic scale and is
+ * called from any thread. wait blocks the timing thread until deadline
+ * (only when armed) or until fileDescriptor becomes readable and returns
+ * whether it is readable. wait may be NULL, then the timing thread sleeps
+ * on CLOCK_MONOTONIC itself, which now has to follow. A clock with its
+ * own wait does not run on wall time: the player lets its bus workers
+ * finish every posted write before it waits, so writes complete at the
+ * time they were issued.
+*/
+typedef struct ClockSource ClockSource;
+struct ClockSource {
+    uint64_t (*now)(ClockSource *self);
+    bool (*wait)(ClockSource *self, int fileDescriptor, bool armed, uint64_t deadline);
+};
+
+// CLOCK_MONOTONIC, the clock of the player unless configured otherwise
+ClockSource * clockSourceGetMonotonic(void);
+
+#endif // __CLOCK_SOURCE_H__
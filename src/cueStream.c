@@ -0,0 +1,524 @@
+#include "cueStream.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+
+typedef uint8_t Bool8;
+
+#define BUFFER_COUNT (2)
+// last timestamps of the chunks read from a pipe that are remembered
+#define PIPE_HISTORY_SIZE (BUFFER_COUNT + 1)
+#define THREAD_NAME ("fusesStream")
+#define CHUNK_FREE (0)
+#define CHUNK_READY (1)
+#define NO_CHUNK (UINT32_MAX)
+
+typedef struct {
+    FusesCue *cues;
+    uint32_t chunkIndex;
+    uint32_t firstIndex;
+    uint32_t count;
+    // CHUNK_FREE, owned by the reader, or the seek generation << 1 |
+    // CHUNK_READY, owned by the consumer while that generation is current
+    uint32_t state;
+} _Chunk;
+
+typedef struct {
+    int fileDescriptor;
+    Bool8 seekable;
+    uint64_t cueOffset;
+    uint32_t cueCount;
+    uint32_t chunkSize;
+    // chunk chunkCount is an empty end marker
+    uint32_t chunkCount;
+    CueStreamValidator validator;
+    CueStreamReadyHandler readyHandler;
+    void *context;
+
+    _Chunk chunks[BUFFER_COUNT];
+
+    pthread_t thread;
+    Bool8 threadStarted;
+    int wakeFileDescriptor;
+    Bool8 sleeping;
+    Bool8 haltFlag;
+
+    // written by the consumer, the target before the generation
+    uint64_t seekTimestamp;
+    uint32_t generation;
+    Bool8 stalled;
+    Bool8 failed;
+
+    // reader thread only
+    uint32_t readerGeneration;
+    uint32_t nextChunk;
+    uint32_t pipeChunk;
+    uint64_t pipeLastTimestamps[PIPE_HISTORY_SIZE];
+    // a pipe seek without a held chunk skips chunks ending before the target
+    Bool8 pipeSeekPending;
+    uint64_t pipeSeekTimestamp;
+    uint32_t lastLoadedChunk;
+    uint64_t lastLoadedTimestamp;
+
+    uint64_t chunksRead;
+    uint64_t stalls;
+    uint64_t seeks;
+} _CueStream;
+
+static uint32_t _readyState(uint32_t generation) {
+    return (generation << 1) | CHUNK_READY;
+}
+
+static void _add(uint64_t *counter, uint64_t value) {
+    __atomic_store_n(counter, *counter + value, __ATOMIC_RELAXED);
+}
+
+static bool _readFully(int fileDescriptor, void *buffer, size_t size) {
+    uint8_t *bytes = (uint8_t*)buffer;
+    while (size > 0) {
+        ssize_t result = read(fileDescriptor, bytes, size);
+        if (result == -1 && errno == EINTR) continue;
+        if (result <= 0) { return false; }
+        bytes += result;
+        size -= result;
+    }
+    return true;
+}
+
+static bool _preadFully(int fileDescriptor, void *buffer, size_t size, uint64_t offset) {
+    uint8_t *bytes = (uint8_t*)buffer;
+    while (size > 0) {
+        ssize_t result = pread(fileDescriptor, bytes, size, offset);
+        if (result == -1 && errno == EINTR) continue;
+        if (result <= 0) { return false; }
+        bytes += result;
+        size -= result;
+        offset += result;
+    }
+    return true;
+}
+
+static uint32_t _chunkEnd(_CueStream *_self, uint32_t chunkIndex) {
+    uint64_t end = (uint64_t)(chunkIndex + 1) * _self->chunkSize;
+    return end < _self->cueCount ? (uint32_t)end : _self->cueCount;
+}
+
+static void _wakeReader(_CueStream *_self) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&_self->sleeping, __ATOMIC_SEQ_CST)) {
+        uint64_t increment = 1;
+        write(_self->wakeFileDescriptor, &increment, sizeof(increment));
+    }
+}
+
+/**
+ * @brief Tells a consumer waiting for a chunk that it may look again.
+*/
+static void _notifyConsumer(_CueStream *_self) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_exchange_n(&_self->stalled, false, __ATOMIC_SEQ_CST) && _self->readyHandler != NULL) {
+        _self->readyHandler(_self->context);
+    }
+}
+
+static void _fail(_CueStream *_self) {
+    __atomic_store_n(&_self->failed, true, __ATOMIC_SEQ_CST);
+    _notifyConsumer(_self);
+}
+
+/**
+ * @brief Reads and validates one chunk into a free buffer.
+*/
+static bool _load(_CueStream *_self, _Chunk *chunk, uint32_t chunkIndex) {
+    chunk->chunkIndex = chunkIndex;
+    chunk->firstIndex = chunkIndex == _self->chunkCount ? _self->cueCount : chunkIndex * _self->chunkSize;
+    chunk->count = chunkIndex == _self->chunkCount ? 0 : _chunkEnd(_self, chunkIndex) - chunk->firstIndex;
+    if (chunk->count == 0) { return true; }
+
+    size_t size = (size_t)chunk->count * sizeof(FusesCue);
+    if (_self->seekable) {
+        uint64_t offset = _self->cueOffset + (uint64_t)chunk->firstIndex * sizeof(FusesCue);
+        if (!_preadFully(_self->fileDescriptor, chunk->cues, size, offset)) { return false; }
+    } else {
+        // Pipes only move forward, chunk by chunk.
+        if (chunkIndex != _self->pipeChunk || !_readFully(_self->fileDescriptor, chunk->cues, size)) {
+            return false;
+        }
+        _self->pipeLastTimestamps[chunkIndex % PIPE_HISTORY_SIZE] = chunk->cues[chunk->count - 1].timestamp;
+        ++(_self->pipeChunk);
+    }
+    _add(&_self->chunksRead, 1);
+
+    for (uint32_t i = 0; i < chunk->count; ++i) {
+        uint64_t previous = i > 0 ? chunk->cues[i - 1].timestamp
+            : (chunkIndex == _self->lastLoadedChunk + 1 ? _self->lastLoadedTimestamp : 0);
+        if (chunk->cues[i].timestamp < previous) { return false; }
+        if (_self->validator != NULL && !_self->validator(_self->context, &chunk->cues[i])) { return false; }
+    }
+    _self->lastLoadedChunk = chunkIndex;
+    _self->lastLoadedTimestamp = chunk->cues[chunk->count - 1].timestamp;
+    return true;
+}
+
+static bool _readLastTimestamp(_CueStream *_self, uint32_t chunkIndex, uint64_t *timestamp) {
+    FusesCue cue;
+    uint64_t offset = _self->cueOffset + (uint64_t)(_chunkEnd(_self, chunkIndex) - 1) * sizeof(FusesCue);
+    if (!_preadFully(_self->fileDescriptor, &cue, sizeof(FusesCue), offset)) { return false; }
+    *timestamp = cue.timestamp;
+    return true;
+}
+
+static _Chunk * _heldChunk(_CueStream *_self, uint32_t chunkIndex) {
+    for (int i = 0; i < BUFFER_COUNT; ++i) {
+        _Chunk *chunk = &_self->chunks[i];
+        if (__atomic_load_n(&chunk->state, __ATOMIC_ACQUIRE) != CHUNK_FREE && chunk->chunkIndex == chunkIndex) {
+            return chunk;
+        }
+    }
+    return NULL;
+}
+
+static void _reclaimStaleChunks(_CueStream *_self) {
+    uint32_t current = _readyState(_self->readerGeneration);
+    for (int i = 0; i < BUFFER_COUNT; ++i) {
+        uint32_t state = __atomic_load_n(&_self->chunks[i].state, __ATOMIC_ACQUIRE);
+        if (state != CHUNK_FREE && state != current) {
+            __atomic_store_n(&_self->chunks[i].state, CHUNK_FREE, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+/**
+ * @brief Finds the chunk a seek lands in, the first one whose last cue is
+ * at or after timestamp, and takes over the buffers already holding it or
+ * its successors.
+*/
+static void _seek(_CueStream *_self, uint64_t timestamp) {
+    uint32_t current = _readyState(_self->readerGeneration);
+    _self->pipeSeekPending = false;
+    uint32_t target;
+    if (_self->seekable) {
+        uint32_t low = 0;
+        uint32_t high = _self->chunkCount;
+        while (low < high) {
+            uint32_t middle = low + (high - low) / 2;
+            uint64_t lastTimestamp;
+            if (!_readLastTimestamp(_self, middle, &lastTimestamp)) {
+                _fail(_self);
+                return;
+            }
+            if (lastTimestamp < timestamp) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        target = low;
+    } else {
+        // The oldest chunk still held, everything before it is gone.
+        uint32_t available = _self->pipeChunk;
+        for (int i = 0; i < BUFFER_COUNT; ++i) {
+            _Chunk *chunk = &_self->chunks[i];
+            if (__atomic_load_n(&chunk->state, __ATOMIC_ACQUIRE) != CHUNK_FREE && chunk->chunkIndex < available) {
+                available = chunk->chunkIndex;
+            }
+        }
+        if (available > 0 && timestamp <= _self->pipeLastTimestamps[(available - 1) % PIPE_HISTORY_SIZE]) {
+            _fail(_self);
+            return;
+        }
+        target = available;
+        while (target < _self->pipeChunk) {
+            _Chunk *chunk = _heldChunk(_self, target);
+            if (chunk == NULL || chunk->count == 0 || chunk->cues[chunk->count - 1].timestamp >= timestamp) break;
+            ++target;
+        }
+        if (target == _self->pipeChunk && target < _self->chunkCount) {
+            _self->pipeSeekPending = true;
+            _self->pipeSeekTimestamp = timestamp;
+        }
+    }
+
+    // Chunks already loaded are taken over instead of read again.
+    _self->nextChunk = target;
+    _Chunk *chunk;
+    while (_self->nextChunk <= _self->chunkCount && (chunk = _heldChunk(_self, _self->nextChunk)) != NULL) {
+        __atomic_store_n(&chunk->state, current, __ATOMIC_RELEASE);
+        ++(_self->nextChunk);
+    }
+    _reclaimStaleChunks(_self);
+    if (_self->nextChunk > target) {
+        _notifyConsumer(_self);
+    }
+}
+
+/**
+ * @brief Does one step of work, returns false when there is nothing to do.
+*/
+static bool _work(_CueStream *_self) {
+    uint32_t generation = __atomic_load_n(&_self->generation, __ATOMIC_ACQUIRE);
+    if (generation != _self->readerGeneration) {
+        _self->readerGeneration = generation;
+        if (!__atomic_load_n(&_self->failed, __ATOMIC_ACQUIRE)) {
+            _seek(_self, __atomic_load_n(&_self->seekTimestamp, __ATOMIC_RELAXED));
+        }
+        return true;
+    }
+    if (__atomic_load_n(&_self->failed, __ATOMIC_ACQUIRE) || _self->nextChunk > _self->chunkCount) { return false; }
+
+    _Chunk *chunk = NULL;
+    for (int i = 0; i < BUFFER_COUNT && chunk == NULL; ++i) {
+        if (__atomic_load_n(&_self->chunks[i].state, __ATOMIC_ACQUIRE) == CHUNK_FREE) {
+            chunk = &_self->chunks[i];
+        }
+    }
+    if (chunk == NULL) { return false; }
+
+    if (!_load(_self, chunk, _self->nextChunk)) {
+        _fail(_self);
+        return true;
+    }
+    ++(_self->nextChunk);
+    if (_self->pipeSeekPending) {
+        if (chunk->count > 0 && chunk->cues[chunk->count - 1].timestamp < _self->pipeSeekTimestamp) {
+            return true;
+        }
+        _self->pipeSeekPending = false;
+    }
+    __atomic_store_n(&chunk->state, _readyState(_self->readerGeneration), __ATOMIC_RELEASE);
+    _notifyConsumer(_self);
+    return true;
+}
+
+static void * _run(void *self) {
+    _CueStream *_self = (_CueStream*)self;
+    prctl(PR_SET_NAME, THREAD_NAME);
+    while (!__atomic_load_n(&_self->haltFlag, __ATOMIC_ACQUIRE)) {
+        if (_work(_self)) continue;
+
+        // Announce the sleep before the last look for work; the consumer
+        // publishes before it checks the flag.
+        __atomic_store_n(&_self->sleeping, true, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (!_work(_self) && !__atomic_load_n(&_self->haltFlag, __ATOMIC_ACQUIRE)) {
+            uint64_t counter;
+            read(_self->wakeFileDescriptor, &counter, sizeof(counter));
+        }
+        __atomic_store_n(&_self->sleeping, false, __ATOMIC_SEQ_CST);
+    }
+    return NULL;
+}
+
+CueStream * cueStreamInit(CueStreamConfiguration *configuration) {
+    _CueStream *_self = (_CueStream*)calloc(1, sizeof(_CueStream));
+    if (_self == NULL) {
+        close(configuration->fileDescriptor);
+        return NULL;
+    }
+    _self->fileDescriptor = configuration->fileDescriptor;
+    _self->cueOffset = configuration->cueOffset;
+    _self->cueCount = configuration->cueCount;
+    _self->chunkSize = configuration->chunkSize > 0 ? configuration->chunkSize : 1;
+    _self->chunkCount = (_self->cueCount + _self->chunkSize - 1) / _self->chunkSize;
+    _self->validator = configuration->validator;
+    _self->readyHandler = configuration->readyHandler;
+    _self->context = configuration->context;
+    _self->lastLoadedChunk = NO_CHUNK;
+
+    struct stat status;
+    _self->seekable = fstat(_self->fileDescriptor, &status) == 0 && S_ISREG(status.st_mode);
+    _self->wakeFileDescriptor = eventfd(0, EFD_CLOEXEC);
+    bool allocated = true;
+    for (int i = 0; i < BUFFER_COUNT; ++i) {
+        _self->chunks[i].cues = (FusesCue*)malloc((size_t)_self->chunkSize * sizeof(FusesCue));
+        allocated = allocated && _self->chunks[i].cues != NULL;
+    }
+    if (
+        !allocated
+        || _self->wakeFileDescriptor == -1
+        || pthread_create(&_self->thread, NULL, _run, (void*)_self) != 0
+    ) {
+        cueStreamDestroy((CueStream*)_self);
+        return NULL;
+    }
+    _self->threadStarted = true;
+    return (CueStream*)_self;
+}
+
+void cueStreamDestroy(CueStream *self) {
+    _CueStream *_self = (_CueStream*)self;
+    if (_self->threadStarted) {
+        __atomic_store_n(&_self->haltFlag, true, __ATOMIC_SEQ_CST);
+        uint64_t increment = 1;
+        write(_self->wakeFileDescriptor, &increment, sizeof(increment));
+        pthread_join(_self->thread, NULL);
+    }
+    if (_self->wakeFileDescriptor != -1) {
+        close(_self->wakeFileDescriptor);
+    }
+    close(_self->fileDescriptor);
+    for (int i = 0; i < BUFFER_COUNT; ++i) {
+        free(_self->chunks[i].cues);
+    }
+    free(_self);
+}
+
+static _Chunk * _findChunk(_CueStream *_self, uint32_t index) {
+    uint32_t current = _readyState(_self->generation);
+    for (int i = 0; i < BUFFER_COUNT; ++i) {
+        _Chunk *chunk = &_self->chunks[i];
+        if (
+            __atomic_load_n(&chunk->state, __ATOMIC_ACQUIRE) == current
+            && index >= chunk->firstIndex && index - chunk->firstIndex < chunk->count
+        ) {
+            return chunk;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Announces that the consumer waits; the reader publishes before
+ * it checks the flag, so a chunk loaded meanwhile is seen by the caller's
+ * second look.
+*/
+static void _stall(_CueStream *_self) {
+    if (!__atomic_load_n(&_self->stalled, __ATOMIC_RELAXED)) {
+        _add(&_self->stalls, 1);
+        __atomic_store_n(&_self->stalled, true, __ATOMIC_SEQ_CST);
+    }
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+const FusesCue * cueStreamGet(CueStream *self, uint32_t index) {
+    _CueStream *_self = (_CueStream*)self;
+    _Chunk *chunk = _findChunk(_self, index);
+    if (chunk == NULL && !__atomic_load_n(&_self->failed, __ATOMIC_ACQUIRE)) {
+        _stall(_self);
+        chunk = _findChunk(_self, index);
+    }
+    return chunk != NULL ? &chunk->cues[index - chunk->firstIndex] : NULL;
+}
+
+void cueStreamRelease(CueStream *self, uint32_t index) {
+    _CueStream *_self = (_CueStream*)self;
+    uint32_t current = _readyState(_self->generation);
+    bool released = false;
+    for (int i = 0; i < BUFFER_COUNT; ++i) {
+        _Chunk *chunk = &_self->chunks[i];
+        if (
+            __atomic_load_n(&chunk->state, __ATOMIC_ACQUIRE) == current
+            && chunk->count > 0 && chunk->firstIndex + chunk->count <= index
+        ) {
+            __atomic_store_n(&chunk->state, CHUNK_FREE, __ATOMIC_RELEASE);
+            released = true;
+        }
+    }
+    if (released) {
+        _wakeReader(_self);
+    }
+}
+
+void cueStreamSeek(CueStream *self, uint64_t timestamp) {
+    _CueStream *_self = (_CueStream*)self;
+    __atomic_store_n(&_self->seekTimestamp, timestamp, __ATOMIC_RELAXED);
+    __atomic_store_n(&_self->generation, (_self->generation + 1) & (UINT32_MAX >> 1), __ATOMIC_RELEASE);
+    _add(&_self->seeks, 1);
+    _wakeReader(_self);
+}
+
+/**
+ * @brief The lowest chunk of the current generation is the one the seek
+ * landed in; nothing is released while the seek is unresolved.
+*/
+static _Chunk * _seekChunk(_CueStream *_self) {
+    uint32_t current = _readyState(_self->generation);
+    _Chunk *found = NULL;
+    for (int i = 0; i < BUFFER_COUNT; ++i) {
+        _Chunk *chunk = &_self->chunks[i];
+        if (
+            __atomic_load_n(&chunk->state, __ATOMIC_ACQUIRE) == current
+            && (found == NULL || chunk->chunkIndex < found->chunkIndex)
+        ) {
+            found = chunk;
+        }
+    }
+    return found;
+}
+
+bool cueStreamResolveSeek(CueStream *self, uint32_t *index) {
+    _CueStream *_self = (_CueStream*)self;
+    _Chunk *chunk = _seekChunk(_self);
+    if (chunk == NULL) {
+        if (__atomic_load_n(&_self->failed, __ATOMIC_ACQUIRE)) {
+            *index = _self->cueCount;
+            return true;
+        }
+        _stall(_self);
+        chunk = _seekChunk(_self);
+        if (chunk == NULL) { return false; }
+    }
+    uint32_t low = 0;
+    uint32_t high = chunk->count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (chunk->cues[middle].timestamp < _self->seekTimestamp) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    *index = chunk->firstIndex + low;
+    return true;
+}
+
+bool cueStreamGetFailed(CueStream *self) {
+    _CueStream *_self = (_CueStream*)self;
+    return __atomic_load_n(&_self->failed, __ATOMIC_ACQUIRE);
+}
+
+bool cueStreamGetSeekable(CueStream *self) {
+    _CueStream *_self = (_CueStream*)self;
+    return _self->seekable;
+}
+
+bool cueStreamReadCue(CueStream *self, uint32_t index, FusesCue *cue) {
+    _CueStream *_self = (_CueStream*)self;
+    if (!_self->seekable || index >= _self->cueCount) { return false; }
+    uint64_t offset = _self->cueOffset + (uint64_t)index * sizeof(FusesCue);
+    return _preadFully(_self->fileDescriptor, cue, sizeof(FusesCue), offset);
+}
+
+uint32_t cueStreamFind(CueStream *self, uint64_t timestamp) {
+    _CueStream *_self = (_CueStream*)self;
+    if (!_self->seekable) { return _self->cueCount; }
+    uint32_t low = 0;
+    uint32_t high = _self->cueCount;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        FusesCue cue;
+        if (!cueStreamReadCue(self, middle, &cue)) { return _self->cueCount; }
+        if (cue.timestamp < timestamp) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+CueStreamStatistics cueStreamGetStatistics(CueStream *self) {
+    _CueStream *_self = (_CueStream*)self;
+    CueStreamStatistics statistics = {
+        .chunksRead = __atomic_load_n(&_self->chunksRead, __ATOMIC_RELAXED),
+        .stalls = __atomic_load_n(&_self->stalls, __ATOMIC_RELAXED),
+        .seeks = __atomic_load_n(&_self->seeks, __ATOMIC_RELAXED),
+        .failed = __atomic_load_n(&_self->failed, __ATOMIC_ACQUIRE)
+    };
+    return statistics;
+}
@@ -0,0 +1,76 @@
+#ifndef __CUE_STREAM_H__
+#define __CUE_STREAM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fusesFormat.h"
+
+/**
+ * @brief Reads the sorted cue table of a show from a file or pipe in
+ * fixed-size chunks, so a show of any length plays in constant memory.
+ *
+ * A reader thread fills two chunk buffers ahead of the consumer (double
+ * buffering) and validates every cue it loads. The consumer, the timing
+ * thread, never blocks: cueStreamGet returns NULL for a cue that is not
+ * loaded yet and the ready handler is called once it is.
+ *
+ * Seeks are answered by the reader. In a regular file it binary searches
+ * the last cue of every chunk with pread, the sorted table serving as a
+ * sparse on-disk index, and loads only the chunk the seek lands in. A pipe
+ * is read forward only; seeking back before the oldest chunk still held
+ * fails the stream.
+*/
+
+// Checks one cue as it is loaded, on the reader thread.
+typedef bool (*CueStreamValidator)(void *context, const FusesCue *cue);
+// Called on the reader thread when a chunk the consumer waited for is loaded.
+typedef void (*CueStreamReadyHandler)(void *context);
+
+typedef struct {
+    int fileDescriptor;
+    // file offset of the first cue; a pipe must be positioned there
+    uint64_t cueOffset;
+    uint32_t cueCount;
+    // cues per chunk
+    uint32_t chunkSize;
+    CueStreamValidator validator;
+    CueStreamReadyHandler readyHandler;
+    void *context;
+} CueStreamConfiguration;
+
+typedef struct {
+    uint64_t chunksRead;
+    // times the consumer had to wait for a chunk
+    uint64_t stalls;
+    uint64_t seeks;
+    // the stream ended early: read error, invalid cue or seek back in a pipe
+    bool failed;
+} CueStreamStatistics;
+
+typedef void* CueStream;
+
+// takes ownership of the file descriptor
+CueStream * cueStreamInit(CueStreamConfiguration *configuration);
+void cueStreamDestroy(CueStream *self);
+
+// consumer thread only
+const FusesCue * cueStreamGet(CueStream *self, uint32_t index);
+// cues before index are not needed anymore, their chunks are refilled
+void cueStreamRelease(CueStream *self, uint32_t index);
+// continues the stream at the first cue at or after timestamp (ns)
+void cueStreamSeek(CueStream *self, uint64_t timestamp);
+// index of the cue the last seek landed on, false while it is being loaded
+bool cueStreamResolveSeek(CueStream *self, uint32_t *index);
+bool cueStreamGetFailed(CueStream *self);
+
+// any thread, regular files only
+bool cueStreamGetSeekable(CueStream *self);
+bool cueStreamReadCue(CueStream *self, uint32_t index, FusesCue *cue);
+// first cue at or after timestamp (ns), cueCount past the end or for a pipe
+uint32_t cueStreamFind(CueStream *self, uint64_t timestamp);
+
+CueStreamStatistics cueStreamGetStatistics(CueStream *self);
+
+#endif // __CUE_STREAM_H__
@@ -1,52 +1,162 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 
-typedef struct __attribute__((packed)) {
-    uint8_t fusesMagic[4];
-    uint8_t dataItemCount;
-    uint16_t i2cDeviceIndexMask;
-} FusesHeader;
-
-typedef struct __attribute__((packed)) {
-    uint32_t timestamp;
-    uint8_t i2cDeviceIndex;
-    uint8_t fuseIndex;
-    uint8_t __align[2];
-} FusesDataItem;
+#include "fusesFormat.h"
+#include "showCompiler.h"
 
 #define ITEM_COUNT (8)
 #define WAIT_TIME (500)
+#define DEVICE_INDEX (1)
+#define NANOSECONDS_PER_MILLISECOND (1000000ull)
+#define DEFAULT_FUSE_DURATION (1000)
 
-int main(int argc, char *argv[]) {
+#define DEFAULT_FILENAME ("fuses.bin")
+
+int writeV1(FILE *file) {
     FusesHeader header = {
         .dataItemCount = ITEM_COUNT,
-        .i2cDeviceIndexMask = 0b00000001
+        .i2cDeviceIndexMask = 1 << DEVICE_INDEX
     };
-    header.fusesMagic[0] = 'F';
-    header.fusesMagic[1] = 'U';
-    header.fusesMagic[2] = 'S';
-    header.fusesMagic[3] = 'E';
+    memcpy(header.fusesMagic, FUSES_V1_MAGIC, FUSES_MAGIC_SIZE);
 
     FusesDataItem items[ITEM_COUNT];
     for (int i = 0; i < ITEM_COUNT; ++i) {
         items[i].timestamp = i * WAIT_TIME;
-        items[i].i2cDeviceIndex = 1;
+        items[i].i2cDeviceIndex = DEVICE_INDEX;
         items[i].fuseIndex = i;
         items[i].__align[0] = 255;
         items[i].__align[1] = 255;
     }
 
-    FILE *file = fopen("fuses.bin", "wb");
+    fwrite(&header, sizeof(FusesHeader), 1, file);
+    fwrite(items, sizeof(FusesDataItem), ITEM_COUNT, file);
+    return EXIT_SUCCESS;
+}
+
+int writeV2(FILE *file) {
+    FusesDevice devices[1] = {
+        { .busIndex = 0, .deviceAddress = 0b1100000 | DEVICE_INDEX }
+    };
+    size_t deviceCount = sizeof(devices) / sizeof(devices[0]);
+
+    FusesHeaderV2 header = {
+        .version = FUSES_FORMAT_VERSION_2,
+        .headerSize = sizeof(FusesHeaderV2),
+        .deviceCount = deviceCount,
+        .dataItemCount = ITEM_COUNT,
+        .cueOffset = fusesFormatCueOffset(deviceCount)
+    };
+    memcpy(header.fusesMagic, FUSES_V2_MAGIC, FUSES_MAGIC_SIZE);
+    header.headerChecksum = fusesFormatChecksum(&header, FUSES_HEADER_V2_CHECKSUM_SIZE);
+
+    FusesCue cues[ITEM_COUNT] = { 0 };
+    for (int i = 0; i < ITEM_COUNT; ++i) {
+        cues[i].timestamp = i * WAIT_TIME * NANOSECONDS_PER_MILLISECOND;
+        cues[i].i2cDeviceIndex = 0;
+        cues[i].fuseIndex = i;
+    }
+
+    uint8_t padding[FUSES_CUE_ALIGNMENT] = { 0 };
+    fwrite(&header, sizeof(FusesHeaderV2), 1, file);
+    fwrite(devices, sizeof(FusesDevice), deviceCount, file);
+    fwrite(padding, 1, header.cueOffset - sizeof(FusesHeaderV2) - deviceCount * sizeof(FusesDevice), file);
+    fwrite(cues, sizeof(FusesCue), ITEM_COUNT, file);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Compiles the dummy cues, or the cue list at cueListName, into a
+ * version 3 show. Problems of the cue list are reported on stderr.
+*/
+ShowCompiler * compileV3(char *cueListName, uint16_t fuseDuration) {
+    ShowCompiler *compiler = showCompilerInit(fuseDuration);
+    if (compiler == NULL) { return NULL; }
+
+    bool parsed = true;
+    if (cueListName != NULL) {
+        FILE *cueList = fopen(cueListName, "r");
+        if (cueList == NULL) {
+            perror("fopen");
+            showCompilerDestroy(compiler);
+            return NULL;
+        }
+        parsed = showCompilerParse(compiler, cueList, cueListName, stderr);
+        fclose(cueList);
+    } else {
+        for (int i = 0; i < ITEM_COUNT; ++i) {
+            showCompilerAddCue(
+                compiler, i * WAIT_TIME * NANOSECONDS_PER_MILLISECOND, 0, 0b1100000 | DEVICE_INDEX, i, i + 1
+            );
+        }
+    }
+    // Compiled even if lines were rejected, to report every other problem.
+    bool compiled = showCompilerCompile(compiler, cueListName != NULL ? cueListName : "dummy", stderr);
+    if (!parsed || !compiled) {
+        showCompilerDestroy(compiler);
+        return NULL;
+    }
+    return compiler;
+}
+
+int main(int argc, char *argv[]) {
+    int version = 1;
+    char *filename = DEFAULT_FILENAME;
+    char *cueListName = NULL;
+    uint16_t fuseDuration = DEFAULT_FUSE_DURATION;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--v1") == 0) {
+            version = 1;
+        } else if (strcmp(argv[i], "--v2") == 0) {
+            version = 2;
+        } else if (strcmp(argv[i], "--v3") == 0) {
+            version = 3;
+        } else if (strcmp(argv[i], "--compile") == 0 && i + 1 < argc) {
+            version = 3;
+            cueListName = argv[++i];
+        } else if (strcmp(argv[i], "--fuse-duration") == 0 && i + 1 < argc) {
+            fuseDuration = (uint16_t)atoi(argv[++i]);
+        } else if (argv[i][0] != '-') {
+            filename = argv[i];
+        } else {
+            // An unknown option is no filename, or --help would write a show named --help.
+            fprintf(
+                stderr, "usage: %s [--v1|--v2|--v3] [show file]\n"
+                "       %s --compile <cue list> [--fuse-duration ms] [show file]\n", argv[0], argv[0]
+            );
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Compiled first, so a rejected cue list leaves no show behind.
+    ShowCompiler *compiler = NULL;
+    if (version == 3) {
+        compiler = compileV3(cueListName, fuseDuration);
+        if (compiler == NULL) { return EXIT_FAILURE; }
+    }
+
+    FILE *file = fopen(filename, "wb");
     if (file == NULL) {
         perror("fopen");
+        if (compiler != NULL) { showCompilerDestroy(compiler); }
         return EXIT_FAILURE;
     }
 
-    fwrite(&header, sizeof(FusesHeader), 1, file);
-    fwrite(items, sizeof(FusesDataItem), ITEM_COUNT, file);
+    int result;
+    if (version == 3) {
+        result = showCompilerWrite(compiler, file) ? EXIT_SUCCESS : EXIT_FAILURE;
+        ShowCompilerStatistics statistics = showCompilerGetStatistics(compiler);
+        printf(
+            "%u cues on %u devices, %u edges in %u writes\n",
+            statistics.cueCount, statistics.deviceCount, statistics.edgeCount, statistics.writeCount
+        );
+        showCompilerDestroy(compiler);
+    } else {
+        result = version == 2 ? writeV2(file) : writeV1(file);
+    }
 
     fclose(file);
 
-    return EXIT_SUCCESS;
+    return result;
 }
@@ -1,80 +1,195 @@
 #include "fuses.h"
-
+#include "fusesFormat.h"
+#include "timerQueue.h"
+#include "realtime.h"
+#include "mpscRing.h"
+#include "cueStream.h"
+#include "injectionQueue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
+#include <poll.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
 
 typedef uint8_t Bool8;
 
-#define FUSES_MAGIC (uint8_t[4]){'F', 'U', 'S', 'E'}
-#define MAGIC_SIZE (4)
-
-#define MAX_I2C_DEVICE_COUNT (16)
+#define MAX_V1_I2C_DEVICE_COUNT (16)
 #define MAX_FUSE_COUNT_PER_DEVICE (16)
-#define MAX_FUSE_COUNT (MAX_I2C_DEVICE_COUNT * MAX_FUSE_COUNT_PER_DEVICE)
+#define FUSES_PER_REGISTER (4)
+
+#define FUSE_REGISTER_COUNT (MAX_FUSE_COUNT_PER_DEVICE / FUSES_PER_REGISTER)
 
 #define MICROSECONDS_PER_MILLISECOND (1000)
-#define MILLISECONDS_PER_SECOND (1000)
-#define MILLISECONDS_PER_NANOSECOND (1000000)
-
-typedef struct __attribute__((packed)) {
-    uint8_t fusesMagic[4];
-    uint8_t dataItemCount;
-    uint16_t i2cDeviceIndexMask;
-} FusesHeader;
-
-typedef struct __attribute__((packed)) {
-    uint32_t timestamp;
-    uint8_t i2cDeviceIndex;
-    uint8_t fuseIndex;
-    uint8_t __align[2];
-} FusesDataItem;
+#define NANOSECONDS_PER_MILLISECOND (1000000)
+#define NANOSECONDS_PER_MICROSECOND (1000)
+#define NANOSECONDS_PER_SECOND (1000000000)
+
+// in nanoseconds
+#define BUS_RETRY_INTERVAL (1000000)
+#define BUS_WRITE_QUEUE_TICKS (4)
+#define HALT_RETRY_COUNT (100)
+#define THREAD_NAME ("fusesLoop")
+#define COMMAND_QUEUE_CAPACITY (64)
+#define DEFAULT_COMMAND_TIMEOUT (100000)
+// deepest stack of the timing thread touched before the show starts
+#define REALTIME_STACK_PREFAULT_SIZE (64 * 1024)
+#define DEFAULT_STREAM_CHUNK_SIZE (4096)
+// lateness samples kept of a streamed show, whose length is unbounded
+#define STREAM_LATENESS_CAPACITY (65536)
 
 typedef struct {
     I2cDevice *i2cDevices;
-    uint8_t i2cDeviceCount;
-    FusesDataItem *data;
-    uint8_t dataItemCount;
-    uint8_t totalDuration;
+    uint32_t i2cDeviceCount;
+    uint8_t (*registerShadows)[FUSE_REGISTER_COUNT];
+    // bumped with every post of a register, so a resync sees writes racing its read
+    uint32_t (*registerGenerations)[FUSE_REGISTER_COUNT];
+    pthread_mutex_t *registerShadowLock;
+    // statistics counters below are read atomically by fusesGetStatistics
+    uint64_t registerReadsAvoided;
+    uint64_t registerResyncs;
+
+    // fuse edges of the current tick, merged per (device, register)
+    uint8_t (*pendingSetMasks)[FUSE_REGISTER_COUNT];
+    uint8_t (*pendingClearMasks)[FUSE_REGISTER_COUNT];
+    uint32_t *pendingRegisters;  // i2cDeviceIndex * FUSE_REGISTER_COUNT + register
+    uint32_t pendingRegisterCount;
+    uint32_t pendingEdgeCount;
+    uint64_t fuseEdges;
+    uint64_t registerWrites;
+    uint64_t registerRepairs;
+
+    // one I/O worker per bus; stale devices are rewritten from the shadow
+    uint8_t *i2cDeviceBuses;
+    BusWorker **busWorkers;
+    uint32_t busCount;
+    Bool8 *devicesStale;
+    Bool8 anyDeviceStale;
+
+    FusesCue *data;
+    FusesCue *convertedData;
+    uint32_t dataItemCount;
+    // the device table the cues are validated against
+    FusesDevice *devices;
+
+    // streamed shows: a bounded window of the cues instead of data
+    CueStream *stream;
+    int streamFileDescriptor;
+    FusesDevice *streamDevices;
+    // a jump or stop was handed to the stream, nextFuseIndex is not known yet
+    Bool8 streamSeekPending;
+    // stopped away from the start, the stream is rewound by the next play
+    Bool8 streamRewindPending;
+
+    // cues added while the show runs, see fusesInjectCues
+    InjectionQueue *injections;
+    uint64_t injectedCuesFired;
+    uint64_t injectedCuesCancelled;
+
+    // compiled shows: the register writes walked instead of the cues
+    FusesWrite *plan;
+    uint32_t planWriteCount;
+    uint32_t nextWriteIndex;
+    // fuse bits switched on by the plan, their cues, until it switches them off
+    uint8_t (*planLitMasks)[FUSE_REGISTER_COUNT];
+    uint32_t (*planLitCues)[MAX_FUSE_COUNT_PER_DEVICE];
+    // verifyWrites: the cue that last switched each fuse and when, read
+    // by the bus workers to name the cue of a register that read back wrong
+    uint32_t (*switchCues)[MAX_FUSE_COUNT_PER_DEVICE];
+    uint64_t (*switchTimestamps)[MAX_FUSE_COUNT_PER_DEVICE];
+    uint32_t totalDuration;
     uint32_t timeResolution;
     uint16_t fuseDuration;
+    uint64_t fuseDurationNanoseconds;
 
     pthread_t *thread;
-    pthread_barrier_t *externalBarrier;
-    pthread_barrier_t *internalBarrier;
-    pthread_mutex_t *actionLock;
     FusesError *error;
 
-    pthread_t *subThreads;
-    pthread_mutex_t *subThreadLocks;
-    pthread_cond_t *subThreadConditions;
-    Bool8 *subThreadFlags;
-
-    uint32_t jumpTarget;
-    uint32_t currentTime;
-
-    uint32_t startTimestamp;
-    uint32_t pauseStartedTimestamp;
+    // commands of any thread to the main loop, applied in posting order
+    MpscRing *commands;
+    // commands applied so far (low 32 bits), the futex acknowledging them
+    uint32_t appliedCommands;
+    uint32_t commandWaiters;
+    uint32_t commandTimeout;
+
+    // events for the host, see fusesReadEvents
+    MpscRing *events;
+    int eventFileDescriptor;
+    uint32_t eventMask;
+    FusesEventCallback eventCallback;
+    void *eventCallbackContext;
+    uint32_t lateCueThreshold;
+    uint64_t eventsDropped;
+
+    FusesDevice v1Devices[MAX_V1_I2C_DEVICE_COUNT];
+    TimerQueue *extinguishQueue;
+    enum FusesLoopMode loopMode;
+    int timerFileDescriptor;
+    int wakeFileDescriptor;
+    // all times of the player, see ClockSource
+    ClockSource *clock;
+
+    int32_t *igniteLateness;
+    size_t igniteLatenessCount;
+    size_t igniteLatenessCapacity;
+
+    FusesTrace *trace;
+
+    FusesRealtimeConfiguration realtime;
+    FusesRealtimeReport realtimeReport;
+    FusesStartupReport startupReport;
+    // devices fusesInit gave up on, still coming up, see fusesDestroy
+    struct _DeviceBringUp *deviceBringUp;
+
+    // Show times and timestamps of the clock, all in nanoseconds. The
+    // show time is the clock's time minus startTimestamp.
+    uint64_t jumpTarget;
+    uint64_t currentTime;
+
+    uint64_t startTimestamp;
+    uint64_t pauseStartedTimestamp;
     uint32_t timePaused;
-    uint8_t nextFuseIndex;
+    uint32_t nextFuseIndex;
+
+    // seekIndex[b] is the first cue at or after b * seekIndexResolution,
+    // seekIndex[seekIndexSize] is dataItemCount
+    uint32_t *seekIndex;
+    uint32_t seekIndexSize;
+    uint32_t seekIndexResolution;
 
-    Bool8 useExternalBarrier;
+    // written by the main loop only, read atomically by any thread
     Bool8 isPlaying;
     Bool8 isPaused;
-    Bool8 playFlag;
-    Bool8 pauseFlag;
-    Bool8 stopFlag;
     Bool8 haltFlag;
-    Bool8 jumpFlag;
+    // queued events the event descriptor was not yet signalled for
+    Bool8 eventsPending;
+    // the show ended, SHOW_FINISHED follows once every fuse is out
+    Bool8 finishing;
 } _FusesObject;
 
 typedef struct {
-    _FusesObject *fusesObject;
-    uint8_t dataItemIndex;
-} SubThreadArg;
+    uint8_t type;
+    // jump target in ns
+    uint64_t argument;
+    // waited on by the main loop once the command has been applied
+    pthread_barrier_t *barrier;
+} _Command;
 
 #define BASE_DEVICE_ADDRESS (0b1100000)
+// the general call address, never a fuse board
+#define NO_DEVICE_ADDRESS (0x00)
 #define FUSE_REGISTER_BASE_ADDRESS (0x14)
-#define FUSES_PER_REGISTER (4)
 
 const uint8_t fuseRegisterMasks[4] = {
     0b00000011,
@@ -83,177 +198,1740 @@ const uint8_t fuseRegisterMasks[4] = {
     0b11000000
 };
 
-#define INTERNAL_BARRIER_COUNT (2)
+#define WAKE_FILE_DESCRIPTOR_COUNT (2)
+#define NO_TIMEOUT (-1)
 
-void _resetError(_FusesObject *_self) {
+static void _resetError(_FusesObject *_self) {
     _self->error->type = FUSES_ERROR_NO_ERROR;
     _self->error->level = FUSES_ERROR_LEVEL_INFO;
     _self->error->i2cError = NULL;
+    _self->error->ioErrno = 0;
+}
+
+/**
+ * @brief Returns a cue, NULL if a streamed show has not loaded it yet.
+*/
+const FusesCue * _getCue(_FusesObject *_self, uint32_t dataItemIndex) {
+    if (_self->stream != NULL) {
+        return cueStreamGet(_self->stream, dataItemIndex);
+    }
+    return &_self->data[dataItemIndex];
+}
+
+/**
+ * @brief Show time of a loaded cue in nanoseconds.
+*/
+uint64_t _cueTime(_FusesObject *_self, uint32_t dataItemIndex) {
+    return _getCue(_self, dataItemIndex)->timestamp;
+}
+
+uint64_t _getCurrentTime(_FusesObject *_self) {
+    return _self->clock->now(_self->clock);
+}
+
+/**
+ * @brief Reloads the shadow copy of a device's fuse registers from the board.
+ *
+ * The read runs without registerShadowLock, so cues keep firing while it
+ * waits for the bus. A register posted meanwhile keeps its shadow value,
+ * which is what its queued write leaves on the board. A failed read leaves
+ * the other fuses off in the shadow.
+*/
+bool _resyncRegisterShadow(_FusesObject *_self, uint32_t i2cDeviceIndex) {
+    uint32_t generations[FUSE_REGISTER_COUNT];
+    pthread_mutex_lock(_self->registerShadowLock);
+    memcpy(generations, _self->registerGenerations[i2cDeviceIndex], sizeof(generations));
+    pthread_mutex_unlock(_self->registerShadowLock);
+    // Writes posted before the snapshot reach the board before the read.
+    busWorkerWaitIdle(_self->busWorkers[_self->i2cDeviceBuses[i2cDeviceIndex]]);
+
+    I2cDevice *device = _self->i2cDevices[i2cDeviceIndex];
+    uint8_t registers[FUSE_REGISTER_COUNT];
+    i2cReadBlock(device, FUSE_REGISTER_BASE_ADDRESS, registers, FUSE_REGISTER_COUNT);
+
+    pthread_mutex_lock(_self->registerShadowLock);
+    for (uint8_t registerIndex = 0; registerIndex < FUSE_REGISTER_COUNT; ++registerIndex) {
+        if (_self->registerGenerations[i2cDeviceIndex][registerIndex] != generations[registerIndex]) continue;
+        _self->registerShadows[i2cDeviceIndex][registerIndex] = registers[registerIndex];
+    }
+    pthread_mutex_unlock(_self->registerShadowLock);
+    __atomic_fetch_add(&_self->registerResyncs, 1, __ATOMIC_RELAXED);
+    return i2cGetError(device)->level != I2C_ERROR_LEVEL_ERROR;
+}
+
+/**
+ * @brief Records fuse edges of one register for the current tick.
+ *
+ * Edges are merged per (device, register) into bits to set and bits to
+ * clear, the later edge of a fuse winning. _flushFuseEdges turns them
+ * into one write per register.
+*/
+void _queueRegisterEdges(
+    _FusesObject *_self, uint32_t i2cDeviceIndex, uint8_t registerIndex,
+    uint8_t setMask, uint8_t clearMask, uint32_t edgeCount
+) {
+    if (_self->i2cDevices[i2cDeviceIndex] == NULL) { return; }
+
+    uint8_t *pendingSetMask = &_self->pendingSetMasks[i2cDeviceIndex][registerIndex];
+    uint8_t *pendingClearMask = &_self->pendingClearMasks[i2cDeviceIndex][registerIndex];
+    if ((*pendingSetMask | *pendingClearMask) == 0) {
+        _self->pendingRegisters[_self->pendingRegisterCount++] =
+            i2cDeviceIndex * FUSE_REGISTER_COUNT + registerIndex;
+    }
+    *pendingSetMask = (*pendingSetMask & ~clearMask) | setMask;
+    *pendingClearMask = (*pendingClearMask & ~setMask) | clearMask;
+    _self->pendingEdgeCount += edgeCount;
+}
+
+/**
+ * @brief Remembers the cue of a fuse edge for the readbacks of verifyWrites.
+*/
+void _recordFuseSwitch(_FusesObject *_self, uint32_t i2cDeviceIndex, uint8_t fuseIndex, uint32_t cueIndex) {
+    if (_self->switchCues == NULL) { return; }
+    __atomic_store_n(&_self->switchCues[i2cDeviceIndex][fuseIndex], cueIndex, __ATOMIC_RELAXED);
+    __atomic_store_n(
+        &_self->switchTimestamps[i2cDeviceIndex][fuseIndex], _getCurrentTime(_self), __ATOMIC_RELAXED
+    );
 }
 
-void _lightFuse(_FusesObject *_self, uint8_t dataItemIndex) {
-    I2cDevice *device = _self->i2cDevices[_self->data[dataItemIndex].i2cDeviceIndex];
-    uint8_t registerAddress = FUSE_REGISTER_BASE_ADDRESS + _self->data[dataItemIndex].fuseIndex / FUSES_PER_REGISTER;
-    uint8_t registerMask = fuseRegisterMasks[_self->data[dataItemIndex].fuseIndex % FUSES_PER_REGISTER];
+void _queueFuseEdge(_FusesObject *_self, uint32_t i2cDeviceIndex, uint8_t fuseIndex, bool lit) {
+    uint8_t registerMask = fuseRegisterMasks[fuseIndex % FUSES_PER_REGISTER];
+    _queueRegisterEdges(
+        _self, i2cDeviceIndex, fuseIndex / FUSES_PER_REGISTER,
+        lit ? registerMask : 0, lit ? 0 : registerMask, 1
+    );
+}
+
+/**
+ * @brief Records a trace event if tracing is compiled in and configured.
+*/
+static inline void _trace(
+    _FusesObject *_self, enum FusesTraceEventType type, uint32_t cueIndex, uint32_t i2cDeviceIndex,
+    uint8_t registerAddress, uint8_t value, uint32_t argument
+) {
+#if FUSES_TRACE_ENABLED
+    if (_self->trace == NULL) { return; }
+    FusesTraceEvent event = {
+        .cueIndex = cueIndex,
+        .argument = argument,
+        .i2cDeviceIndex = i2cDeviceIndex,
+        .type = type,
+        .registerAddress = registerAddress,
+        .value = value
+    };
+    fusesTraceRecord(_self->trace, &event);
+#endif
+}
+
+static inline void _traceCommand(_FusesObject *_self, enum FusesTraceCommand command, uint32_t argument) {
+#if FUSES_TRACE_ENABLED
+    if (_self->trace == NULL) { return; }
+    FusesTraceEvent event = {
+        .cueIndex = FUSES_TRACE_NO_CUE,
+        .argument = argument,
+        .i2cDeviceIndex = FUSES_TRACE_NO_DEVICE,
+        .type = FUSES_TRACE_COMMAND,
+        .command = command
+    };
+    fusesTraceRecord(_self->trace, &event);
+#endif
+}
+
+bool _isEventRaised(_FusesObject *_self, enum FusesEventType type) {
+    return (_self->events != NULL || _self->eventCallback != NULL)
+        && (_self->eventMask & FUSES_EVENT_MASK(type));
+}
+
+void _signalEvents(_FusesObject *_self) {
+    uint64_t increment = 1;
+    write(_self->eventFileDescriptor, &increment, sizeof(increment));
+}
+
+/**
+ * @brief Queues the event and passes it to the callback. The main loop
+ * signals the event descriptor once per iteration, other threads right away.
+*/
+void _raiseEvent(_FusesObject *_self, FusesEvent *event, bool signal) {
+    event->timestamp = _self->clock->now(_self->clock);
+    if (_self->events != NULL) {
+        if (!mpscRingPush(_self->events, event, NULL)) {
+            __atomic_fetch_add(&_self->eventsDropped, 1, __ATOMIC_RELAXED);
+        } else if (signal) {
+            _signalEvents(_self);
+        } else {
+            _self->eventsPending = true;
+        }
+    }
+    if (_self->eventCallback != NULL) {
+        _self->eventCallback(_self->eventCallbackContext, event);
+    }
+}
 
-    uint8_t value = i2cReadByte(device, registerAddress);
-    value &= ~registerMask;
-    value |= registerMask;
-    i2cWriteByte(device, registerAddress, value);
-    printf("DEBUG: lit fuse %d\n", dataItemIndex);
+void _raiseStateChange(_FusesObject *_self, enum FusesState state) {
+    if (!_isEventRaised(_self, FUSES_EVENT_STATE_CHANGED)) { return; }
+    FusesEvent event = {
+        .type = FUSES_EVENT_STATE_CHANGED,
+        .state = state,
+        .cueIndex = FUSES_TRACE_NO_CUE,
+        .i2cDeviceIndex = FUSES_TRACE_NO_DEVICE
+    };
+    _raiseEvent(_self, &event, false);
 }
 
-void _extinguishFuse(_FusesObject *_self, uint8_t dataItemIndex) {
-    I2cDevice *device = _self->i2cDevices[_self->data[dataItemIndex].i2cDeviceIndex];
-    uint8_t registerAddress = FUSE_REGISTER_BASE_ADDRESS + _self->data[dataItemIndex].fuseIndex / FUSES_PER_REGISTER;
-    uint8_t registerMask = fuseRegisterMasks[_self->data[dataItemIndex].fuseIndex % FUSES_PER_REGISTER];
+void _wakeMainloop(_FusesObject *_self) {
+    uint64_t increment = 1;
+    write(_self->wakeFileDescriptor, &increment, sizeof(increment));
+}
 
-    uint8_t value = i2cReadByte(device, registerAddress);
-    value &= ~registerMask;
-    i2cWriteByte(device, registerAddress, value);
-    printf("DEBUG: unlit fuse %d\n", dataItemIndex);
+void _markDeviceStale(_FusesObject *_self, uint32_t i2cDeviceIndex) {
+    __atomic_store_n(&_self->devicesStale[i2cDeviceIndex], true, __ATOMIC_RELEASE);
+    __atomic_store_n(&_self->anyDeviceStale, true, __ATOMIC_RELEASE);
 }
 
-void * _subThreadHandler(void *arg) {
-    SubThreadArg *subThreadArg = (SubThreadArg*)arg;
-    _FusesObject *_self = subThreadArg->fusesObject;
-    uint8_t dataItemIndex = subThreadArg->dataItemIndex;
+/**
+ * @brief Hands the shadow value of a register to the device's bus worker.
+ * A full ring marks the device stale instead of waiting for the bus.
+ * Must hold registerShadowLock.
+ *
+ * The write is traced before the post, the worker may complete it before
+ * busWorkerPost returns. A write the ring rejects is not traced.
+*/
+void _postRegisterWrite(_FusesObject *_self, uint32_t i2cDeviceIndex, uint8_t registerIndex) {
+    BusWrite write = {
+        .device = _self->i2cDevices[i2cDeviceIndex],
+        .i2cDeviceIndex = i2cDeviceIndex,
+        .registerAddress = FUSE_REGISTER_BASE_ADDRESS + registerIndex,
+        .value = _self->registerShadows[i2cDeviceIndex][registerIndex]
+    };
+    ++(_self->registerGenerations[i2cDeviceIndex][registerIndex]);
+    BusWorker *busWorker = _self->busWorkers[_self->i2cDeviceBuses[i2cDeviceIndex]];
+    if (busWorkerCanPost(busWorker)) {
+        _trace(
+            _self, FUSES_TRACE_WRITE_ISSUED, FUSES_TRACE_NO_CUE, i2cDeviceIndex,
+            write.registerAddress, write.value, 0
+        );
+    }
+    if (busWorkerPost(busWorker, &write)) {
+        __atomic_store_n(&_self->registerWrites, _self->registerWrites + 1, __ATOMIC_RELAXED);
+    } else {
+        _markDeviceStale(_self, i2cDeviceIndex);
+    }
+}
 
-    pthread_mutex_lock(&_self->subThreadLocks[dataItemIndex]);
-    while (!_self->subThreadFlags[dataItemIndex]) {
-        pthread_cond_wait(
-            &_self->subThreadConditions[dataItemIndex], 
-            &_self->subThreadLocks[dataItemIndex]
+/**
+ * @brief Called by a bus worker after each register write.
+*/
+void _handleBusWriteCompletion(void *self, BusWrite *write, bool failed) {
+    _FusesObject *_self = (_FusesObject*)self;
+    if (!failed) {
+        _trace(
+            _self, FUSES_TRACE_WRITE_COMPLETED, FUSES_TRACE_NO_CUE, write->i2cDeviceIndex,
+            write->registerAddress, write->value, 0
         );
+        return;
+    }
+    _trace(
+        _self, FUSES_TRACE_I2C_ERROR, FUSES_TRACE_NO_CUE, write->i2cDeviceIndex,
+        write->registerAddress, write->value, (uint32_t)i2cGetError(write->device)->ioErrno
+    );
+    if (_isEventRaised(_self, FUSES_EVENT_I2C_ERROR)) {
+        FusesEvent event = {
+            .type = FUSES_EVENT_I2C_ERROR,
+            .cueIndex = FUSES_TRACE_NO_CUE,
+            .i2cDeviceIndex = write->i2cDeviceIndex,
+            .ioErrno = i2cGetError(write->device)->ioErrno
+        };
+        _raiseEvent(_self, &event, true);
     }
-    pthread_mutex_unlock(&_self->subThreadLocks[dataItemIndex]);
+    _markDeviceStale(_self, write->i2cDeviceIndex);
+    _wakeMainloop(_self);
+}
 
-    if (_self->haltFlag) {
-        return NULL;
+/**
+ * @brief Called by a bus worker after each readback of verifyWrites.
+ *
+ * A register that reads back other than written raises one event per
+ * wrong fuse, naming the cue that last switched it, and is repaired like
+ * a failed write. A failed readback proves nothing and is only counted
+ * by the bus worker.
+*/
+void _handleBusVerification(void *self, BusWrite *write, uint8_t value, bool failed) {
+    _FusesObject *_self = (_FusesObject*)self;
+    if (failed || value == write->value) { return; }
+
+    uint8_t registerIndex = write->registerAddress - FUSE_REGISTER_BASE_ADDRESS;
+    uint8_t firstFuseIndex = registerIndex * FUSES_PER_REGISTER;
+    uint32_t traceCueIndex = FUSES_TRACE_NO_CUE;
+    for (uint8_t i = 0; i < FUSES_PER_REGISTER; ++i) {
+        if (((value ^ write->value) & fuseRegisterMasks[i]) == 0) continue;
+        uint8_t fuseIndex = firstFuseIndex + i;
+        uint32_t cueIndex = __atomic_load_n(&_self->switchCues[write->i2cDeviceIndex][fuseIndex], __ATOMIC_RELAXED);
+        if (traceCueIndex == FUSES_TRACE_NO_CUE) {
+            traceCueIndex = cueIndex;
+        }
+        if (!_isEventRaised(_self, FUSES_EVENT_VERIFY_MISMATCH)) continue;
+        FusesEvent event = {
+            .type = FUSES_EVENT_VERIFY_MISMATCH,
+            .cueIndex = cueIndex,
+            .i2cDeviceIndex = write->i2cDeviceIndex,
+            .switchTimestamp = __atomic_load_n(
+                &_self->switchTimestamps[write->i2cDeviceIndex][fuseIndex], __ATOMIC_RELAXED
+            ),
+            .fuseIndex = fuseIndex,
+            .registerAddress = write->registerAddress,
+            .writtenValue = write->value,
+            .readValue = value
+        };
+        _raiseEvent(_self, &event, true);
     }
+    _trace(
+        _self, FUSES_TRACE_VERIFY_MISMATCH, traceCueIndex, write->i2cDeviceIndex,
+        write->registerAddress, value, write->value
+    );
+    // Without a wake the repair waits for the next tick or BUS_RETRY_INTERVAL,
+    // so a register that never latches is not rewritten back to back.
+    _markDeviceStale(_self, write->i2cDeviceIndex);
+}
 
-    _lightFuse(_self, dataItemIndex);
-    usleep(_self->fuseDuration * MICROSECONDS_PER_MILLISECOND);
-    _extinguishFuse(_self, dataItemIndex);
+/**
+ * @brief Applies the queued fuse edges to the shadow registers and posts
+ * one write per touched register to the bus workers.
+ *
+ * The player is the only writer of the fuse registers, so the shadow copy
+ * is the state the board should be in and replaces the read of a
+ * read-modify-write. Devices whose writes failed or did not fit into the
+ * ring are stale; all their registers are posted again from the shadow.
+*/
+void _flushFuseEdges(_FusesObject *_self) {
+    bool anyDeviceStale = __atomic_load_n(&_self->anyDeviceStale, __ATOMIC_ACQUIRE);
+    if (_self->pendingRegisterCount == 0 && !anyDeviceStale) { return; }
+
+    pthread_mutex_lock(_self->registerShadowLock);
+    if (anyDeviceStale) {
+        __atomic_store_n(&_self->anyDeviceStale, false, __ATOMIC_RELEASE);
+        for (uint32_t i = 0; i < _self->i2cDeviceCount; ++i) {
+            if (!__atomic_exchange_n(&_self->devicesStale[i], false, __ATOMIC_ACQ_REL)) continue;
+            for (uint8_t registerIndex = 0; registerIndex < FUSE_REGISTER_COUNT; ++registerIndex) {
+                _postRegisterWrite(_self, i, registerIndex);
+            }
+            __atomic_store_n(&_self->registerRepairs, _self->registerRepairs + 1, __ATOMIC_RELAXED);
+        }
+    }
 
-    return NULL;
+    for (uint32_t i = 0; i < _self->pendingRegisterCount; ++i) {
+        uint32_t i2cDeviceIndex = _self->pendingRegisters[i] / FUSE_REGISTER_COUNT;
+        uint8_t registerIndex = _self->pendingRegisters[i] % FUSE_REGISTER_COUNT;
+        uint8_t setMask = _self->pendingSetMasks[i2cDeviceIndex][registerIndex];
+        uint8_t clearMask = _self->pendingClearMasks[i2cDeviceIndex][registerIndex];
+        _self->pendingSetMasks[i2cDeviceIndex][registerIndex] = 0;
+        _self->pendingClearMasks[i2cDeviceIndex][registerIndex] = 0;
+
+        uint8_t *shadow = &_self->registerShadows[i2cDeviceIndex][registerIndex];
+        *shadow = (*shadow & ~clearMask) | setMask;
+        __atomic_store_n(&_self->registerReadsAvoided, _self->registerReadsAvoided + 1, __ATOMIC_RELAXED);
+        _postRegisterWrite(_self, i2cDeviceIndex, registerIndex);
+    }
+    __atomic_store_n(&_self->fuseEdges, _self->fuseEdges + _self->pendingEdgeCount, __ATOMIC_RELAXED);
+    _self->pendingEdgeCount = 0;
+    _self->pendingRegisterCount = 0;
+    pthread_mutex_unlock(_self->registerShadowLock);
+}
+
+/**
+ * @brief Switches off the fuse of an extinguish event. The event carries
+ * the fuse, the cue may have left the window of a streamed show.
+*/
+void _extinguishFuse(_FusesObject *_self, TimerEvent *event) {
+    _queueFuseEdge(_self, event->i2cDeviceIndex, event->fuseIndex, false);
+    _recordFuseSwitch(_self, event->i2cDeviceIndex, event->fuseIndex, event->dataItemIndex);
+    _trace(
+        _self, FUSES_TRACE_FUSE_EXTINGUISHED, event->dataItemIndex, event->i2cDeviceIndex,
+        0, event->fuseIndex, 0
+    );
+}
+
+/**
+ * @brief Returns how many microseconds after its due show time a cue is lit now.
+*/
+int32_t _getIgniteLateness(_FusesObject *_self, uint64_t cueTime) {
+    int64_t lateness = (int64_t)(_getCurrentTime(_self) - (_self->startTimestamp + cueTime));
+    return (int32_t)(lateness / NANOSECONDS_PER_MICROSECOND);
 }
 
-void _scheduleLightFuse(_FusesObject *_self, uint8_t fuseIndex) {
-    pthread_mutex_lock(&_self->subThreadLocks[fuseIndex]);
-    _self->subThreadFlags[fuseIndex] = true;
-    pthread_cond_signal(&_self->subThreadConditions[fuseIndex]);
-    pthread_mutex_unlock(&_self->subThreadLocks[fuseIndex]);
+/**
+ * @brief Stores the lateness of a lit cue.
+ *
+ * Only the main loop appends; the release store of the count publishes
+ * the value to fusesGetLatenessReport.
+*/
+void _recordIgniteLateness(_FusesObject *_self, int32_t lateness) {
+    size_t count = _self->igniteLatenessCount;
+    if (count == _self->igniteLatenessCapacity) { return; }
+    _self->igniteLateness[count] = lateness;
+    __atomic_store_n(&_self->igniteLatenessCount, count + 1, __ATOMIC_RELEASE);
 }
 
-void _waitForBarriers(_FusesObject *_self) {
-    pthread_barrier_wait(_self->internalBarrier);
-    if (_self->externalBarrier != NULL) {
-        pthread_barrier_wait(_self->externalBarrier);
-        _self->externalBarrier = NULL;
+void _raiseCueEvents(_FusesObject *_self, uint32_t cueIndex, uint32_t i2cDeviceIndex, int32_t lateness) {
+    FusesEvent event = {
+        .type = FUSES_EVENT_CUE_FIRED,
+        .cueIndex = cueIndex,
+        .lateness = lateness,
+        .i2cDeviceIndex = i2cDeviceIndex
+    };
+    if (_isEventRaised(_self, FUSES_EVENT_CUE_FIRED)) {
+        _raiseEvent(_self, &event, false);
+    }
+    if (lateness > (int32_t)_self->lateCueThreshold && _isEventRaised(_self, FUSES_EVENT_CUE_LATE)) {
+        event.type = FUSES_EVENT_CUE_LATE;
+        _raiseEvent(_self, &event, false);
     }
 }
 
-void _play(_FusesObject *_self) {
-    _self->playFlag = false;
-    _self->isPlaying = true;
-    _self->isPaused = false;
+/**
+ * @brief Raises SHOW_FINISHED once the show ended and its last fuse is out.
+*/
+void _checkShowFinished(_FusesObject *_self) {
+    if (!_self->finishing || timerQueueGetCount(_self->extinguishQueue) > 0) { return; }
+    _self->finishing = false;
+    if (!_isEventRaised(_self, FUSES_EVENT_SHOW_FINISHED)) { return; }
+    FusesEvent event = {
+        .type = FUSES_EVENT_SHOW_FINISHED,
+        .cueIndex = FUSES_TRACE_NO_CUE,
+        .i2cDeviceIndex = FUSES_TRACE_NO_DEVICE
+    };
+    _raiseEvent(_self, &event, false);
+}
+
+void _pushExtinguish(_FusesObject *_self, TimerEvent *event) {
+    if (timerQueueGetCount(_self->extinguishQueue) == timerQueueGetCapacity(_self->extinguishQueue)) {
+        // Only reachable when jumps refire cues faster than they expire.
+        // Never leave a fuse lit because the queue is full. Queued before
+        // the light edge so a refired fuse ends up lit.
+        TimerEvent earliest;
+        timerQueuePop(_self->extinguishQueue, &earliest);
+        _extinguishFuse(_self, &earliest);
+    }
+    timerQueuePush(_self->extinguishQueue, *event);
+}
+
+/**
+ * @brief Schedules the extinguish edge of a lit cue for a deadline of the clock.
+*/
+void _scheduleExtinguish(_FusesObject *_self, uint32_t dataItemIndex, uint64_t deadline) {
+    const FusesCue *cue = _getCue(_self, dataItemIndex);
+    TimerEvent event = {
+        .deadline = deadline,
+        .dataItemIndex = dataItemIndex,
+        .i2cDeviceIndex = cue->i2cDeviceIndex,
+        .fuseIndex = cue->fuseIndex
+    };
+    _pushExtinguish(_self, &event);
+}
+
+/**
+ * @brief Lights a fuse and schedules its extinguish edge.
+ *
+ * Extinguish deadlines are kept on the clock rather than show time, so a
+ * lit fuse goes off after fuseDuration even if the show is paused,
+ * stopped or jumped in between. The trace carries the cue time in ms.
+*/
+void _igniteFuse(_FusesObject *_self, uint32_t cueIndex, uint32_t i2cDeviceIndex, uint8_t fuseIndex, uint64_t cueTime) {
+    TimerEvent event = {
+        .deadline = _getCurrentTime(_self) + _self->fuseDurationNanoseconds,
+        .dataItemIndex = cueIndex,
+        .i2cDeviceIndex = i2cDeviceIndex,
+        .fuseIndex = fuseIndex
+    };
+    _pushExtinguish(_self, &event);
+    _queueFuseEdge(_self, i2cDeviceIndex, fuseIndex, true);
+    _recordFuseSwitch(_self, i2cDeviceIndex, fuseIndex, cueIndex);
+    _trace(
+        _self, FUSES_TRACE_CUE_IGNITED, cueIndex, i2cDeviceIndex, 0, fuseIndex,
+        (uint32_t)(cueTime / NANOSECONDS_PER_MILLISECOND)
+    );
+}
+
+void _igniteCue(_FusesObject *_self, uint32_t dataItemIndex) {
+    const FusesCue *cue = _getCue(_self, dataItemIndex);
+    _igniteFuse(_self, dataItemIndex, cue->i2cDeviceIndex, cue->fuseIndex, _cueTime(_self, dataItemIndex));
+}
+
+/**
+ * @brief Fires the injected cues due at showTime. Their lateness is taken
+ * before the flush, so it lacks the time of the register writes.
+*/
+void _igniteInjectedCues(_FusesObject *_self, uint64_t showTime) {
+    InjectedCue cue;
+    bool cueEvents = _isEventRaised(_self, FUSES_EVENT_CUE_FIRED) || _isEventRaised(_self, FUSES_EVENT_CUE_LATE);
+    while (injectionQueuePeek(_self->injections, &cue) && cue.time <= showTime) {
+        injectionQueuePop(_self->injections, &cue);
+        uint32_t cueIndex = FUSES_INJECTED_CUE_INDEX(cue.id);
+        _igniteFuse(_self, cueIndex, cue.i2cDeviceIndex, cue.fuseIndex, cue.time);
+        __atomic_store_n(&_self->injectedCuesFired, _self->injectedCuesFired + 1, __ATOMIC_RELAXED);
+        if (_self->igniteLateness != NULL || cueEvents) {
+            int32_t lateness = _getIgniteLateness(_self, cue.time);
+            if (_self->igniteLateness != NULL) {
+                _recordIgniteLateness(_self, lateness);
+            }
+            if (cueEvents) {
+                _raiseCueEvents(_self, cueIndex, cue.i2cDeviceIndex, lateness);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Show time in nanoseconds, frozen while paused or stopped.
+*/
+uint64_t _getShowTime(_FusesObject *_self) {
+    return (_self->isPlaying ? _getCurrentTime(_self) : _self->pauseStartedTimestamp) - _self->startTimestamp;
+}
+
+void _dropInjectedCues(_FusesObject *_self, size_t count) {
+    __atomic_store_n(&_self->injectedCuesCancelled, _self->injectedCuesCancelled + count, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Merges the cues injected and cancelled since the last iteration.
+*/
+void _applyInjections(_FusesObject *_self) {
+    if (_self->injections == NULL) { return; }
+    _dropInjectedCues(_self, injectionQueueMerge(_self->injections, _getShowTime(_self)));
+}
+
+/**
+ * @brief Applies the plan writes due at showTime.
+ *
+ * Only fuses the plan lit itself are switched off by it; the n-th fuse
+ * it switches on is cue n, so nextFuseIndex advances as with the cues.
+*/
+void _walkPlan(_FusesObject *_self, uint64_t showTime) {
+    while (_self->nextWriteIndex < _self->planWriteCount && _self->plan[_self->nextWriteIndex].timestamp <= showTime) {
+        FusesWrite *write = &_self->plan[_self->nextWriteIndex++];
+        uint8_t registerIndex = write->registerAddress - FUSE_REGISTER_BASE_ADDRESS;
+        uint8_t *litMask = &_self->planLitMasks[write->i2cDeviceIndex][registerIndex];
+        uint32_t *litCues = &_self->planLitCues[write->i2cDeviceIndex][registerIndex * FUSES_PER_REGISTER];
+        uint8_t clearMask = write->clearMask & *litMask;
+        for (uint8_t i = 0; i < FUSES_PER_REGISTER; ++i) {
+            if (clearMask & fuseRegisterMasks[i]) {
+                _recordFuseSwitch(_self, write->i2cDeviceIndex, registerIndex * FUSES_PER_REGISTER + i, litCues[i]);
+                _trace(
+                    _self, FUSES_TRACE_FUSE_EXTINGUISHED, litCues[i], write->i2cDeviceIndex,
+                    0, registerIndex * FUSES_PER_REGISTER + i, 0
+                );
+            }
+            if (write->setMask & fuseRegisterMasks[i]) {
+                litCues[i] = _self->nextFuseIndex;
+                _recordFuseSwitch(_self, write->i2cDeviceIndex, registerIndex * FUSES_PER_REGISTER + i, litCues[i]);
+                _trace(
+                    _self, FUSES_TRACE_CUE_IGNITED, _self->nextFuseIndex, write->i2cDeviceIndex,
+                    0, registerIndex * FUSES_PER_REGISTER + i,
+                    (uint32_t)(_cueTime(_self, _self->nextFuseIndex) / NANOSECONDS_PER_MILLISECOND)
+                );
+                ++(_self->nextFuseIndex);
+            }
+        }
+        *litMask = (*litMask & ~clearMask) | write->setMask;
+        _queueRegisterEdges(
+            _self, write->i2cDeviceIndex, registerIndex, write->setMask, clearMask,
+            (__builtin_popcount(write->setMask) + __builtin_popcount(clearMask)) / 2
+        );
+    }
+}
+
+/**
+ * @brief Hands the fuses lit by the plan to the extinguish queue before
+ * the plan is left, so they still go off fuseDuration after their cue.
+*/
+void _releasePlanFuses(_FusesObject *_self) {
+    if (_self->plan == NULL) { return; }
+    for (uint32_t i = 0; i < _self->i2cDeviceCount; ++i) {
+        for (uint8_t registerIndex = 0; registerIndex < FUSE_REGISTER_COUNT; ++registerIndex) {
+            uint8_t litMask = _self->planLitMasks[i][registerIndex];
+            if (litMask == 0) continue;
+            for (uint8_t j = 0; j < FUSES_PER_REGISTER; ++j) {
+                if (!(litMask & fuseRegisterMasks[j])) continue;
+                uint32_t dataItemIndex = _self->planLitCues[i][registerIndex * FUSES_PER_REGISTER + j];
+                _scheduleExtinguish(
+                    _self, dataItemIndex,
+                    _self->startTimestamp + _cueTime(_self, dataItemIndex) + _self->fuseDurationNanoseconds
+                );
+            }
+            _self->planLitMasks[i][registerIndex] = 0;
+        }
+    }
+}
 
-    uint32_t dt = _getCurrentTime() - _self->pauseStartedTimestamp;
+void _extinguishDueCues(_FusesObject *_self) {
+    TimerEvent event;
+    while (
+        timerQueuePeek(_self->extinguishQueue, &event) 
+        && event.deadline <= _getCurrentTime(_self)
+    ) {
+        timerQueuePop(_self->extinguishQueue, &event);
+        _extinguishFuse(_self, &event);
+    }
+}
+
+void _play(_FusesObject *_self) {
+    _traceCommand(_self, FUSES_TRACE_COMMAND_PLAY, 0);
+    __atomic_store_n(&_self->isPlaying, true, __ATOMIC_RELEASE);
+    __atomic_store_n(&_self->isPaused, false, __ATOMIC_RELEASE);
+
+    if (_self->streamRewindPending) {
+        cueStreamSeek(_self->stream, 0);
+        _self->streamSeekPending = true;
+        _self->streamRewindPending = false;
+    }
+    uint64_t dt = _getCurrentTime(_self) - _self->pauseStartedTimestamp;
     _self->startTimestamp += dt;
+    _self->finishing = false;
+    _raiseStateChange(_self, FUSES_STATE_PLAYING);
 }
 
 void _pause(_FusesObject *_self) {
-    _self->pauseFlag = false;
-    _self->isPlaying = false;
-    _self->isPaused = true;
+    _traceCommand(_self, FUSES_TRACE_COMMAND_PAUSE, 0);
+    _releasePlanFuses(_self);
+    __atomic_store_n(&_self->isPlaying, false, __ATOMIC_RELEASE);
+    __atomic_store_n(&_self->isPaused, true, __ATOMIC_RELEASE);
 
-    _self->pauseStartedTimestamp = _getCurrentTime();
+    _self->pauseStartedTimestamp = _getCurrentTime(_self);
+    _raiseStateChange(_self, FUSES_STATE_PAUSED);
 }
 
 void _stop(_FusesObject *_self) {
-    _self->stopFlag = false;
-    _self->isPlaying = false;
-    _self->isPaused = false;
+    _traceCommand(_self, FUSES_TRACE_COMMAND_STOP, 0);
+    _releasePlanFuses(_self);
+    bool stateChanged = _self->isPlaying || _self->isPaused;
+    __atomic_store_n(&_self->isPlaying, false, __ATOMIC_RELEASE);
+    __atomic_store_n(&_self->isPaused, false, __ATOMIC_RELEASE);
 
     // _self->timePaused = 0;
     // _self->currentTime = 0;
 
-    _self->startTimestamp = _getCurrentTime();
+    _self->startTimestamp = _getCurrentTime(_self);
     _self->pauseStartedTimestamp = _self->startTimestamp;
+    // Rewinding waits for the next play, so a pipe that played to its end
+    // is not asked to go back. A stream still at its start keeps its chunks.
+    if (_self->stream != NULL && (_self->nextFuseIndex != 0 || _self->streamSeekPending)) {
+        _self->streamRewindPending = true;
+    }
+    if (_self->injections != NULL) {
+        _dropInjectedCues(_self, injectionQueueClear(_self->injections));
+    }
     _self->nextFuseIndex = 0;
+    _self->nextWriteIndex = 0;
+    __atomic_store_n(&_self->currentTime, 0, __ATOMIC_RELAXED);
+    _self->finishing = false;
+    if (stateChanged) {
+        _raiseStateChange(_self, FUSES_STATE_STOPPED);
+    }
+}
+
+/**
+ * @brief Returns the index of the first cue at or after timestamp (ns), or
+ * dataItemCount when every cue lies before it.
+ *
+ * The seek index narrows the range to one bucket, the rest is a binary
+ * search over the sorted cues.
+*/
+uint32_t _searchNextFuseIndex(_FusesObject *_self, uint64_t timestamp) {
+    uint32_t low = 0;
+    uint32_t high = _self->dataItemCount;
+    if (_self->seekIndex != NULL) {
+        uint64_t bucket = timestamp / NANOSECONDS_PER_MILLISECOND / _self->seekIndexResolution;
+        if (bucket >= _self->seekIndexSize) { return _self->dataItemCount; }
+        low = _self->seekIndex[bucket];
+        high = _self->seekIndex[bucket + 1];
+    }
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (_self->data[middle].timestamp < timestamp) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
 }
 
-uint8_t _searchNextFuseIndex(_FusesObject *_self) {
-    for (uint8_t i = 0; i < _self->dataItemCount; ++i) {
-        if (_self->data[i].timestamp >= _self->jumpTarget) {
-            return i;
+/**
+ * @brief Returns the index of the first plan write at or after timestamp (ns).
+*/
+uint32_t _searchNextWriteIndex(_FusesObject *_self, uint64_t timestamp) {
+    uint32_t low = 0;
+    uint32_t high = _self->planWriteCount;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (_self->plan[middle].timestamp < timestamp) {
+            low = middle + 1;
+        } else {
+            high = middle;
         }
     }
+    return low;
 }
 
 void _jump(_FusesObject *_self) {
-    _self->jumpFlag = false;
+    _traceCommand(_self, FUSES_TRACE_COMMAND_JUMP, (uint32_t)(_self->jumpTarget / NANOSECONDS_PER_MILLISECOND));
+    _releasePlanFuses(_self);
     // _self->currentTime = _self->jumpTarget;
     // if (_self->currentTime > _self->totalDuration) {
     //     _self->currentTime = _self->totalDuration;
     // }
 
-    _self->startTimestamp = _getCurrentTime() - _self->jumpTarget;
-    _self->nextFuseIndex = _searchNextFuseIndex(_self);
+    // While paused or stopped the show time stays at the target until the
+    // next play moves startTimestamp by the time spent waiting.
+    _self->startTimestamp = (_self->isPlaying ? _getCurrentTime(_self) : _self->pauseStartedTimestamp)
+        - _self->jumpTarget;
+    if (_self->stream != NULL) {
+        // Resolved by _tick once the stream has loaded the target chunk.
+        cueStreamSeek(_self->stream, _self->jumpTarget);
+        _self->streamSeekPending = true;
+        _self->streamRewindPending = false;
+    } else {
+        _self->nextFuseIndex = _searchNextFuseIndex(_self, _self->jumpTarget);
+    }
+    if (_self->plan != NULL) {
+        _self->nextWriteIndex = _searchNextWriteIndex(_self, _self->jumpTarget);
+    }
+    // Injected cues before the target are skipped like the show's.
+    if (_self->injections != NULL) {
+        _dropInjectedCues(_self, injectionQueueDropBefore(_self->injections, _self->jumpTarget));
+    }
+    __atomic_store_n(&_self->currentTime, _self->jumpTarget, __ATOMIC_RELAXED);
+    _self->finishing = false;
 }
 
-uint32_t _getCurrentTime() {
-    struct timespec currentTime;
-    clock_gettime(CLOCK_MONOTONIC, &currentTime);
-    return currentTime.tv_sec * MILLISECONDS_PER_SECOND 
-        + currentTime.tv_nsec / MILLISECONDS_PER_NANOSECOND;
+/**
+ * @brief Applies every queued command in posting order and acknowledges
+ * each one before waiting on its barrier.
+*/
+void _applyCommands(_FusesObject *_self) {
+    _Command command;
+    while (mpscRingPop(_self->commands, &command)) {
+        switch (command.type) {
+            case FUSES_COMMAND_PLAY:
+                if (!_self->isPlaying) {
+                    _play(_self);
+                }
+                break;
+            case FUSES_COMMAND_PAUSE:
+                if (_self->isPlaying) {
+                    _pause(_self);
+                }
+                break;
+            case FUSES_COMMAND_STOP:
+                _stop(_self);
+                break;
+            case FUSES_COMMAND_JUMP:
+                _self->jumpTarget = command.argument;
+                _jump(_self);
+                break;
+        }
+        // Sequentially consistent with the waiter count in fusesWaitCommand,
+        // so either the waiter sees the new count or it is woken.
+        __atomic_add_fetch(&_self->appliedCommands, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&_self->commandWaiters, __ATOMIC_SEQ_CST) > 0) {
+            syscall(SYS_futex, &_self->appliedCommands, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+        }
+        if (command.barrier != NULL) {
+            pthread_barrier_wait(command.barrier);
+        }
+    }
 }
 
+/**
+ * @brief A failed stream ends the show at the first cue it could not load.
+*/
+bool _isStreamExhausted(_FusesObject *_self) {
+    return _self->stream != NULL
+        && _getCue(_self, _self->nextFuseIndex) == NULL
+        && cueStreamGetFailed(_self->stream);
+}
+
+/**
+ * @brief Collects all due extinguish and ignite edges and writes each
+ * touched register once.
+*/
 void _tick(_FusesObject *_self) {
+    _extinguishDueCues(_self);
+    if (!_self->isPlaying) {
+        _flushFuseEdges(_self);
+        _checkShowFinished(_self);
+        return;
+    }
+
+    if (_self->stream != NULL) {
+        if (_self->streamSeekPending) {
+            // The stream wakes the loop once the target chunk is loaded.
+            if (!cueStreamResolveSeek(_self->stream, &_self->nextFuseIndex)) {
+                _flushFuseEdges(_self);
+                return;
+            }
+            _self->streamSeekPending = false;
+        }
+        cueStreamRelease(_self->stream, _self->nextFuseIndex);
+    }
+
+    uint32_t firstIgnited = _self->nextFuseIndex;
+    uint64_t showTime = _getCurrentTime(_self) - _self->startTimestamp;
+    if (_self->plan != NULL) {
+        _walkPlan(_self, showTime);
+    }
     while (
-        _self->data[_self->nextFuseIndex].timestamp 
-            <= _getCurrentTime() - _self->startTimestamp
+        _self->plan == NULL
+        && _self->nextFuseIndex < _self->dataItemCount
+        && _getCue(_self, _self->nextFuseIndex) != NULL
+        && _cueTime(_self, _self->nextFuseIndex) <= showTime
     ) {
-        _scheduleLightFuse(_self, _self->nextFuseIndex);
+        _igniteCue(_self, _self->nextFuseIndex);
         ++(_self->nextFuseIndex);
-        if (_self->nextFuseIndex == _self->dataItemCount) {
-            _stop(_self);
-            break;
+    }
+    if (_self->injections != NULL) {
+        _igniteInjectedCues(_self, showTime);
+    }
+    _flushFuseEdges(_self);
+    __atomic_store_n(&_self->currentTime, showTime, __ATOMIC_RELAXED);
+
+    bool cueEvents = _isEventRaised(_self, FUSES_EVENT_CUE_FIRED) || _isEventRaised(_self, FUSES_EVENT_CUE_LATE);
+    if (_self->igniteLateness != NULL || cueEvents) {
+        for (uint32_t i = firstIgnited; i < _self->nextFuseIndex; ++i) {
+            int32_t lateness = _getIgniteLateness(_self, _cueTime(_self, i));
+            if (_self->igniteLateness != NULL) {
+                _recordIgniteLateness(_self, lateness);
+            }
+            if (cueEvents) {
+                _raiseCueEvents(_self, i, _getCue(_self, i)->i2cDeviceIndex, lateness);
+            }
+        }
+    }
+    // The show runs on while injected cues are pending.
+    InjectedCue injectedCue;
+    if (
+        (_self->nextFuseIndex == _self->dataItemCount || _isStreamExhausted(_self))
+        && (_self->injections == NULL || !injectionQueuePeek(_self->injections, &injectedCue))
+    ) {
+        _stop(_self);
+        _self->finishing = true;
+        _checkShowFinished(_self);
+    }
+}
+
+/**
+ * @brief Returns the earliest pending ignite or extinguish deadline.
+*/
+bool _nextDeadline(_FusesObject *_self, uint64_t *deadline) {
+    bool found = false;
+    if (__atomic_load_n(&_self->anyDeviceStale, __ATOMIC_ACQUIRE)) {
+        *deadline = _getCurrentTime(_self) + BUS_RETRY_INTERVAL;
+        found = true;
+    }
+    TimerEvent event;
+    if (
+        timerQueuePeek(_self->extinguishQueue, &event)
+        && (!found || event.deadline < *deadline)
+    ) {
+        *deadline = event.deadline;
+        found = true;
+    }
+    // A cue still being streamed has no deadline yet, its chunk wakes the loop.
+    if (
+        _self->isPlaying && _self->nextFuseIndex < _self->dataItemCount
+        && !_self->streamSeekPending && (_self->plan != NULL || _getCue(_self, _self->nextFuseIndex) != NULL)
+    ) {
+        uint64_t igniteDeadline = _self->startTimestamp + (_self->plan != NULL
+            ? _self->plan[_self->nextWriteIndex].timestamp
+            : _cueTime(_self, _self->nextFuseIndex));
+        if (!found || igniteDeadline < *deadline) {
+            *deadline = igniteDeadline;
+        }
+        found = true;
+    }
+    InjectedCue injectedCue;
+    if (_self->isPlaying && _self->injections != NULL && injectionQueuePeek(_self->injections, &injectedCue)) {
+        uint64_t injectedDeadline = _self->startTimestamp + injectedCue.time;
+        if (!found || injectedDeadline < *deadline) {
+            *deadline = injectedDeadline;
+        }
+        found = true;
+    }
+    return found;
+}
+
+/**
+ * @brief Arms the timerfd for an absolute CLOCK_MONOTONIC deadline in
+ * nanoseconds or disarms it. A deadline of 0 would disarm, so it is 1.
+*/
+void _armTimer(_FusesObject *_self, bool armed, uint64_t deadline) {
+    struct itimerspec timer = { 0 };
+    if (armed) {
+        if (deadline == 0) { deadline = 1; }
+        timer.it_value.tv_sec = deadline / NANOSECONDS_PER_SECOND;
+        timer.it_value.tv_nsec = deadline % NANOSECONDS_PER_SECOND;
+    }
+    timerfd_settime(_self->timerFileDescriptor, TFD_TIMER_ABSTIME, &timer, NULL);
+}
+
+/**
+ * @brief Waits on a clock with its own wait for the next deadline or a
+ * control call. The bus goes idle first, its writes take no time there.
+*/
+void _waitForClock(_FusesObject *_self) {
+    for (uint32_t i = 0; i < _self->busCount; ++i) {
+        busWorkerWaitIdle(_self->busWorkers[i]);
+    }
+    uint64_t deadline = _getCurrentTime(_self) + (uint64_t)_self->timeResolution * NANOSECONDS_PER_MILLISECOND;
+    bool armed = _self->loopMode == FUSES_LOOP_POLLING || _nextDeadline(_self, &deadline);
+    if (_self->clock->wait(_self->clock, _self->wakeFileDescriptor, armed, deadline)) {
+        uint64_t counter;
+        read(_self->wakeFileDescriptor, &counter, sizeof(counter));
+    }
+}
+
+/**
+ * @brief Sleeps until the next cue deadline or until a control call wakes the loop.
+*/
+void _waitForNextEvent(_FusesObject *_self) {
+    if (_self->clock->wait != NULL) {
+        _waitForClock(_self);
+        return;
+    }
+    struct pollfd fileDescriptors[WAKE_FILE_DESCRIPTOR_COUNT] = {
+        { .fd = _self->wakeFileDescriptor, .events = POLLIN },
+        { .fd = _self->timerFileDescriptor, .events = POLLIN }
+    };
+    // Commands wake the loop in either mode.
+    if (_self->loopMode == FUSES_LOOP_POLLING) {
+        if (poll(fileDescriptors, 1, _self->timeResolution) <= 0) { return; }
+    } else {
+        uint64_t deadline = 0;
+        bool armed = _nextDeadline(_self, &deadline);
+        _armTimer(_self, armed, deadline);
+        if (poll(fileDescriptors, WAKE_FILE_DESCRIPTOR_COUNT, NO_TIMEOUT) <= 0) { return; }
+    }
+
+    uint64_t counter;
+    for (int i = 0; i < WAKE_FILE_DESCRIPTOR_COUNT; ++i) {
+        if (fileDescriptors[i].revents & POLLIN) {
+            read(fileDescriptors[i].fd, &counter, sizeof(counter));
+        }
+    }
+}
+
+/**
+ * @brief Builds the jump index with seekIndexResolution. fusesInit does
+ * this while the devices come up, the timing thread never allocates it.
+*/
+bool _buildSeekIndex(_FusesObject *_self) {
+    uint32_t resolution = _self->seekIndexResolution;
+    uint32_t lastTime = _self->dataItemCount == 0 ? 0
+        : (uint32_t)(_cueTime(_self, _self->dataItemCount - 1) / NANOSECONDS_PER_MILLISECOND);
+    uint32_t size = lastTime / resolution + 1;
+    uint32_t *seekIndex = (uint32_t*)malloc((size + 1) * sizeof(uint32_t));
+    if (seekIndex == NULL) { return false; }
+
+    uint32_t cueIndex = 0;
+    for (uint32_t bucket = 0; bucket < size; ++bucket) {
+        uint64_t bucketStart = (uint64_t)bucket * resolution * NANOSECONDS_PER_MILLISECOND;
+        while (cueIndex < _self->dataItemCount && _self->data[cueIndex].timestamp < bucketStart) {
+            ++cueIndex;
+        }
+        seekIndex[bucket] = cueIndex;
+    }
+    seekIndex[size] = _self->dataItemCount;
+    _self->seekIndex = seekIndex;
+    _self->seekIndexSize = size;
+    return true;
+}
+
+void * _mainloop(void *self) {
+    _FusesObject *_self = (_FusesObject*)self;
+    prctl(PR_SET_NAME, THREAD_NAME);
+    if (_self->realtime.enabled) {
+        realtimePrefaultStack(REALTIME_STACK_PREFAULT_SIZE);
+    }
+    _self->isPaused = false;
+    _self->startTimestamp = _getCurrentTime(_self);
+    _self->pauseStartedTimestamp = _self->startTimestamp;
+    _self->nextFuseIndex = 0;
+    _self->nextWriteIndex = 0;
+    // _self->timePaused = 0;
+
+    while (!__atomic_load_n(&_self->haltFlag, __ATOMIC_ACQUIRE)) {
+        _applyCommands(_self);
+        _applyInjections(_self);
+        _tick(_self);
+        if (_self->eventsPending) {
+            _self->eventsPending = false;
+            _signalEvents(_self);
+        }
+        _waitForNextEvent(_self);
+    }
+
+    // Nothing may stay lit once the player is gone.
+    _releasePlanFuses(_self);
+    TimerEvent event;
+    while (timerQueuePop(_self->extinguishQueue, &event)) {
+        _extinguishFuse(_self, &event);
+    }
+    _flushFuseEdges(_self);
+    for (
+        int i = 0;
+        i < HALT_RETRY_COUNT && __atomic_load_n(&_self->anyDeviceStale, __ATOMIC_ACQUIRE);
+        ++i
+    ) {
+        usleep(BUS_RETRY_INTERVAL / NANOSECONDS_PER_MICROSECOND);
+        _flushFuseEdges(_self);
+    }
+
+    return NULL;
+}
+
+bool _setDataError(_FusesObject *_self, enum FusesErrorType type) {
+    _self->error->type = type;
+    _self->error->level = FUSES_ERROR_LEVEL_ERROR;
+    return false;
+}
+
+/**
+ * @brief Checks that a cue addresses a configured device and fuse. Also
+ * called by the reader thread of a streamed show for every cue it loads.
+*/
+bool _isCueValid(void *self, const FusesCue *cue) {
+    _FusesObject *_self = (_FusesObject*)self;
+    return cue->i2cDeviceIndex < _self->i2cDeviceCount
+        && _self->devices[cue->i2cDeviceIndex].deviceAddress != NO_DEVICE_ADDRESS
+        && cue->fuseIndex < MAX_FUSE_COUNT_PER_DEVICE;
+}
+
+/**
+ * @brief Checks that every cue addresses a configured device and fuse
+ * and that the cues are sorted by time.
+*/
+bool _validateCues(_FusesObject *_self, FusesDevice *devices) {
+    _self->devices = devices;
+    for (uint32_t i = 0; i < _self->dataItemCount; ++i) {
+        FusesCue *cue = &_self->data[i];
+        if (!_isCueValid(_self, cue) || (i > 0 && cue->timestamp < _self->data[i - 1].timestamp)) {
+            return _setDataError(_self, FUSES_ERROR_INVALID_DATA);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Checks magic, version, checksum and that all tables lie inside
+ * the buffer, without touching the cues themselves.
+*/
+enum FusesErrorType _checkShowLayout(void *rawData, size_t rawDataSize) {
+    if (rawDataSize < FUSES_MAGIC_SIZE) { return FUSES_ERROR_INVALID_MAGIC_NUMBER; }
+
+    if (memcmp(rawData, FUSES_V1_MAGIC, FUSES_MAGIC_SIZE) == 0) {
+        FusesHeader *header = (FusesHeader*)rawData;
+        if (
+            rawDataSize < sizeof(FusesHeader)
+            || rawDataSize < sizeof(FusesHeader) + header->dataItemCount * sizeof(FusesDataItem)
+        ) {
+            return FUSES_ERROR_INVALID_DATA;
+        }
+        return FUSES_ERROR_NO_ERROR;
+    }
+
+    if (memcmp(rawData, FUSES_V2_MAGIC, FUSES_MAGIC_SIZE) == 0) {
+        FusesHeaderV2 *header = (FusesHeaderV2*)rawData;
+        if (rawDataSize < sizeof(FusesHeaderV2)) { return FUSES_ERROR_INVALID_DATA; }
+        if (fusesFormatChecksum(header, FUSES_HEADER_V2_CHECKSUM_SIZE) != header->headerChecksum) {
+            return FUSES_ERROR_INVALID_CHECKSUM;
+        }
+        if (header->version != FUSES_FORMAT_VERSION_2 || header->headerSize != sizeof(FusesHeaderV2)) {
+            return FUSES_ERROR_UNSUPPORTED_VERSION;
+        }
+        if (
+            header->cueOffset < fusesFormatCueOffset(header->deviceCount)
+            || header->cueOffset % FUSES_CUE_ALIGNMENT != 0
+            || header->cueOffset > rawDataSize
+            || (rawDataSize - header->cueOffset) / sizeof(FusesCue) < header->dataItemCount
+            || ((uintptr_t)rawData) % FUSES_CUE_ALIGNMENT != 0
+        ) {
+            return FUSES_ERROR_INVALID_DATA;
+        }
+        return FUSES_ERROR_NO_ERROR;
+    }
+
+    if (memcmp(rawData, FUSES_V3_MAGIC, FUSES_MAGIC_SIZE) == 0) {
+        FusesHeaderV3 *header = (FusesHeaderV3*)rawData;
+        if (rawDataSize < sizeof(FusesHeaderV3)) { return FUSES_ERROR_INVALID_DATA; }
+        if (fusesFormatChecksum(header, FUSES_HEADER_V3_CHECKSUM_SIZE) != header->headerChecksum) {
+            return FUSES_ERROR_INVALID_CHECKSUM;
+        }
+        if (header->version != FUSES_FORMAT_VERSION_3 || header->headerSize != sizeof(FusesHeaderV3)) {
+            return FUSES_ERROR_UNSUPPORTED_VERSION;
+        }
+        if (
+            header->cueOffset < fusesFormatCueOffsetV3(header->deviceCount)
+            || header->cueOffset % FUSES_CUE_ALIGNMENT != 0
+            || header->cueOffset > rawDataSize
+            || (rawDataSize - header->cueOffset) / sizeof(FusesCue) < header->dataItemCount
+            || header->writeOffset < header->cueOffset + (uint64_t)header->dataItemCount * sizeof(FusesCue)
+            || header->writeOffset % FUSES_CUE_ALIGNMENT != 0
+            || header->writeOffset > rawDataSize
+            || (rawDataSize - header->writeOffset) / sizeof(FusesWrite) < header->writeCount
+            || ((uintptr_t)rawData) % FUSES_CUE_ALIGNMENT != 0
+        ) {
+            return FUSES_ERROR_INVALID_DATA;
+        }
+        return FUSES_ERROR_NO_ERROR;
+    }
+
+    return FUSES_ERROR_INVALID_MAGIC_NUMBER;
+}
+
+/**
+ * @brief Converts a version 1 show into cues and a 16 entry device table.
+*/
+FusesDevice * _loadShowV1(_FusesObject *_self, FusesConfiguration *configuration) {
+    FusesHeader *header = (FusesHeader*)configuration->rawData;
+    _self->dataItemCount = header->dataItemCount;
+    _self->i2cDeviceCount = MAX_V1_I2C_DEVICE_COUNT;
+    for (int i = 0; i < MAX_V1_I2C_DEVICE_COUNT; ++i) {
+        _self->v1Devices[i].busIndex = 0;
+        _self->v1Devices[i].deviceAddress = (header->i2cDeviceIndexMask & (1 << i))
+            ? BASE_DEVICE_ADDRESS | i : NO_DEVICE_ADDRESS;
+    }
+
+    _self->convertedData = (FusesCue*)calloc(_self->dataItemCount > 0 ? _self->dataItemCount : 1, sizeof(FusesCue));
+    if (_self->convertedData == NULL) {
+        _setDataError(_self, FUSES_ERROR_MEMORY_ALLOCATION_FAILED);
+        return NULL;
+    }
+    FusesDataItem *items = (FusesDataItem*)(configuration->rawData + sizeof(FusesHeader));
+    for (uint32_t i = 0; i < _self->dataItemCount; ++i) {
+        _self->convertedData[i].timestamp = (uint64_t)items[i].timestamp * NANOSECONDS_PER_MILLISECOND;
+        _self->convertedData[i].i2cDeviceIndex = items[i].i2cDeviceIndex;
+        _self->convertedData[i].fuseIndex = items[i].fuseIndex;
+    }
+    _self->data = _self->convertedData;
+    return _self->v1Devices;
+}
+
+/**
+ * @brief Uses the device table and cues of a version 2 show in place.
+*/
+FusesDevice * _loadShowV2(_FusesObject *_self, FusesConfiguration *configuration) {
+    FusesHeaderV2 *header = (FusesHeaderV2*)configuration->rawData;
+    _self->dataItemCount = header->dataItemCount;
+    _self->i2cDeviceCount = header->deviceCount;
+    _self->data = (FusesCue*)(configuration->rawData + header->cueOffset);
+    return (FusesDevice*)(configuration->rawData + sizeof(FusesHeaderV2));
+}
+
+/**
+ * @brief Uses the device table, cues and write plan of a compiled show in place.
+*/
+FusesDevice * _loadShowV3(_FusesObject *_self, FusesConfiguration *configuration) {
+    FusesHeaderV3 *header = (FusesHeaderV3*)configuration->rawData;
+    _self->dataItemCount = header->dataItemCount;
+    _self->i2cDeviceCount = header->deviceCount;
+    _self->data = (FusesCue*)(configuration->rawData + header->cueOffset);
+    _self->plan = (FusesWrite*)(configuration->rawData + header->writeOffset);
+    _self->planWriteCount = header->writeCount;
+    _self->fuseDuration = header->fuseDuration;
+    return (FusesDevice*)(configuration->rawData + sizeof(FusesHeaderV3));
+}
+
+/**
+ * @brief Checks that the plan writes are sorted, address existing fuse
+ * registers and switch on exactly the cues, in cue order.
+*/
+bool _validatePlan(_FusesObject *_self) {
+    uint32_t cueIndex = 0;
+    for (uint32_t i = 0; i < _self->planWriteCount; ++i) {
+        FusesWrite *write = &_self->plan[i];
+        uint8_t registerIndex = write->registerAddress - FUSE_REGISTER_BASE_ADDRESS;
+        if (
+            write->i2cDeviceIndex >= _self->i2cDeviceCount
+            || write->registerAddress < FUSE_REGISTER_BASE_ADDRESS
+            || registerIndex >= FUSE_REGISTER_COUNT
+            || (write->setMask & write->clearMask) != 0
+            || (i > 0 && write->timestamp < _self->plan[i - 1].timestamp)
+        ) {
+            return _setDataError(_self, FUSES_ERROR_INVALID_DATA);
+        }
+        for (uint8_t j = 0; j < FUSES_PER_REGISTER; ++j) {
+            uint8_t setBits = write->setMask & fuseRegisterMasks[j];
+            uint8_t clearBits = write->clearMask & fuseRegisterMasks[j];
+            // a fuse is switched by both of its bits
+            if (
+                (setBits != 0 && setBits != fuseRegisterMasks[j])
+                || (clearBits != 0 && clearBits != fuseRegisterMasks[j])
+            ) {
+                return _setDataError(_self, FUSES_ERROR_INVALID_DATA);
+            }
+            if (setBits == 0) continue;
+            FusesCue *cue = &_self->data[cueIndex];
+            if (
+                cueIndex == _self->dataItemCount
+                || cue->timestamp != write->timestamp
+                || cue->i2cDeviceIndex != write->i2cDeviceIndex
+                || cue->fuseIndex != registerIndex * FUSES_PER_REGISTER + j
+            ) {
+                return _setDataError(_self, FUSES_ERROR_INVALID_DATA);
+            }
+            ++cueIndex;
+        }
+    }
+    return cueIndex == _self->dataItemCount || _setDataError(_self, FUSES_ERROR_INVALID_DATA);
+}
+
+FusesDevice * _loadShow(_FusesObject *_self, FusesConfiguration *configuration) {
+    enum FusesErrorType layoutError = _checkShowLayout(configuration->rawData, configuration->rawDataSize);
+    if (layoutError != FUSES_ERROR_NO_ERROR) {
+        _setDataError(_self, layoutError);
+        return NULL;
+    }
+    FusesDevice *devices;
+    if (memcmp(configuration->rawData, FUSES_V1_MAGIC, FUSES_MAGIC_SIZE) == 0) {
+        devices = _loadShowV1(_self, configuration);
+    } else if (memcmp(configuration->rawData, FUSES_V2_MAGIC, FUSES_MAGIC_SIZE) == 0) {
+        devices = _loadShowV2(_self, configuration);
+    } else {
+        devices = _loadShowV3(_self, configuration);
+    }
+    if (devices == NULL) { return NULL; }
+
+    // The rig's wiring takes precedence over the table in the show.
+    if (configuration->deviceMap != NULL) {
+        devices = configuration->deviceMap;
+        _self->i2cDeviceCount = configuration->deviceMapSize;
+    }
+    return devices;
+}
+
+/**
+ * @brief Checks the cues and plan loaded by _loadShow, which fusesInit
+ * does while the devices come up.
+*/
+bool _validateShow(_FusesObject *_self, FusesDevice *devices) {
+    if (!_validateCues(_self, devices)) { return false; }
+    return _self->plan == NULL || _validatePlan(_self);
+}
+
+bool _readFully(int fileDescriptor, void *buffer, size_t size) {
+    uint8_t *bytes = (uint8_t*)buffer;
+    while (size > 0) {
+        ssize_t result = read(fileDescriptor, bytes, size);
+        if (result == -1 && errno == EINTR) continue;
+        if (result <= 0) { return false; }
+        bytes += result;
+        size -= result;
+    }
+    return true;
+}
+
+void _handleStreamReady(void *self) {
+    _wakeMainloop((_FusesObject*)self);
+}
+
+/**
+ * @brief Reads header and device table of a version 2 show from a file or
+ * pipe and prepares streaming its cues.
+ *
+ * Only the tables before the cues are read here; the cues are validated
+ * by the stream as they are loaded. lastCueTime is UINT32_MAX for a pipe,
+ * whose end is not known before it is read.
+*/
+FusesDevice * _openShowStream(
+    _FusesObject *_self, FusesConfiguration *configuration,
+    CueStreamConfiguration *streamConfiguration, uint32_t *lastCueTime
+) {
+    int fileDescriptor = open(configuration->streamPath, O_RDONLY | O_CLOEXEC);
+    struct stat status;
+    if (fileDescriptor == -1 || fstat(fileDescriptor, &status) == -1) {
+        _self->error->ioErrno = errno;
+        if (fileDescriptor != -1) { close(fileDescriptor); }
+        _setDataError(_self, FUSES_ERROR_IO_ERROR);
+        return NULL;
+    }
+    _self->streamFileDescriptor = fileDescriptor;
+    bool seekable = S_ISREG(status.st_mode);
+
+    FusesHeaderV2 header;
+    if (!_readFully(fileDescriptor, &header, FUSES_MAGIC_SIZE)) {
+        _setDataError(_self, FUSES_ERROR_INVALID_MAGIC_NUMBER);
+        return NULL;
+    }
+    if (
+        memcmp(header.fusesMagic, FUSES_V1_MAGIC, FUSES_MAGIC_SIZE) == 0
+        || memcmp(header.fusesMagic, FUSES_V3_MAGIC, FUSES_MAGIC_SIZE) == 0
+    ) {
+        _setDataError(_self, FUSES_ERROR_UNSUPPORTED_VERSION);
+        return NULL;
+    }
+    if (memcmp(header.fusesMagic, FUSES_V2_MAGIC, FUSES_MAGIC_SIZE) != 0) {
+        _setDataError(_self, FUSES_ERROR_INVALID_MAGIC_NUMBER);
+        return NULL;
+    }
+    if (!_readFully(fileDescriptor, (uint8_t*)&header + FUSES_MAGIC_SIZE, sizeof(FusesHeaderV2) - FUSES_MAGIC_SIZE)) {
+        _setDataError(_self, FUSES_ERROR_INVALID_DATA);
+        return NULL;
+    }
+    if (fusesFormatChecksum(&header, FUSES_HEADER_V2_CHECKSUM_SIZE) != header.headerChecksum) {
+        _setDataError(_self, FUSES_ERROR_INVALID_CHECKSUM);
+        return NULL;
+    }
+    if (header.version != FUSES_FORMAT_VERSION_2 || header.headerSize != sizeof(FusesHeaderV2)) {
+        _setDataError(_self, FUSES_ERROR_UNSUPPORTED_VERSION);
+        return NULL;
+    }
+    if (
+        header.cueOffset < fusesFormatCueOffset(header.deviceCount)
+        || header.cueOffset % FUSES_CUE_ALIGNMENT != 0
+        || (seekable && (
+            header.cueOffset > (uint64_t)status.st_size
+            || ((uint64_t)status.st_size - header.cueOffset) / sizeof(FusesCue) < header.dataItemCount
+        ))
+    ) {
+        _setDataError(_self, FUSES_ERROR_INVALID_DATA);
+        return NULL;
+    }
+
+    _self->streamDevices = (FusesDevice*)calloc(header.deviceCount > 0 ? header.deviceCount : 1, sizeof(FusesDevice));
+    if (_self->streamDevices == NULL) {
+        _setDataError(_self, FUSES_ERROR_MEMORY_ALLOCATION_FAILED);
+        return NULL;
+    }
+    if (!_readFully(fileDescriptor, _self->streamDevices, header.deviceCount * sizeof(FusesDevice))) {
+        _setDataError(_self, FUSES_ERROR_INVALID_DATA);
+        return NULL;
+    }
+    // A pipe has to be positioned at the first cue.
+    uint8_t padding[FUSES_CUE_ALIGNMENT];
+    size_t paddingSize = header.cueOffset - sizeof(FusesHeaderV2) - header.deviceCount * sizeof(FusesDevice);
+    while (paddingSize > 0) {
+        size_t size = paddingSize < sizeof(padding) ? paddingSize : sizeof(padding);
+        if (!_readFully(fileDescriptor, padding, size)) {
+            _setDataError(_self, FUSES_ERROR_INVALID_DATA);
+            return NULL;
+        }
+        paddingSize -= size;
+    }
+
+    *lastCueTime = seekable ? 0 : UINT32_MAX;
+    if (seekable && header.dataItemCount > 0) {
+        FusesCue cue;
+        if (pread(
+            fileDescriptor, &cue, sizeof(FusesCue),
+            header.cueOffset + (uint64_t)(header.dataItemCount - 1) * sizeof(FusesCue)
+        ) != sizeof(FusesCue)) {
+            _self->error->ioErrno = errno;
+            _setDataError(_self, FUSES_ERROR_IO_ERROR);
+            return NULL;
+        }
+        *lastCueTime = (uint32_t)(cue.timestamp / NANOSECONDS_PER_MILLISECOND);
+    }
+
+    _self->dataItemCount = header.dataItemCount;
+    _self->i2cDeviceCount = header.deviceCount;
+    FusesDevice *devices = _self->streamDevices;
+    // The rig's wiring takes precedence over the table in the show.
+    if (configuration->deviceMap != NULL) {
+        devices = configuration->deviceMap;
+        _self->i2cDeviceCount = configuration->deviceMapSize;
+    }
+    _self->devices = devices;
+
+    streamConfiguration->fileDescriptor = fileDescriptor;
+    streamConfiguration->cueOffset = header.cueOffset;
+    streamConfiguration->cueCount = header.dataItemCount;
+    streamConfiguration->chunkSize = configuration->streamChunkSize > 0
+        ? configuration->streamChunkSize : DEFAULT_STREAM_CHUNK_SIZE;
+    streamConfiguration->validator = _isCueValid;
+    streamConfiguration->readyHandler = _handleStreamReady;
+    streamConfiguration->context = (void*)_self;
+    return devices;
+}
+
+bool fusesMapShow(FusesConfiguration *configuration, char *path, bool lockMemory, FusesError *error) {
+    error->type = FUSES_ERROR_NO_ERROR;
+    error->level = FUSES_ERROR_LEVEL_INFO;
+    error->i2cError = NULL;
+    error->ioErrno = 0;
+
+    int fileDescriptor = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat status;
+    if (fileDescriptor == -1 || fstat(fileDescriptor, &status) == -1) {
+        error->type = FUSES_ERROR_IO_ERROR;
+        error->level = FUSES_ERROR_LEVEL_ERROR;
+        error->ioErrno = errno;
+        if (fileDescriptor != -1) { close(fileDescriptor); }
+        return false;
+    }
+    if (status.st_size == 0) {
+        error->type = FUSES_ERROR_INVALID_MAGIC_NUMBER;
+        error->level = FUSES_ERROR_LEVEL_ERROR;
+        close(fileDescriptor);
+        return false;
+    }
+
+    // Prefaulting only pays off when the pages are going to be locked anyway.
+    void *data = mmap(
+        NULL, status.st_size, PROT_READ,
+        MAP_PRIVATE | (lockMemory ? MAP_POPULATE : 0), fileDescriptor, 0
+    );
+    error->ioErrno = errno;
+    close(fileDescriptor);
+    if (data == MAP_FAILED) {
+        error->type = FUSES_ERROR_IO_ERROR;
+        error->level = FUSES_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    error->ioErrno = 0;
+
+    enum FusesErrorType layoutError = _checkShowLayout(data, status.st_size);
+    if (layoutError != FUSES_ERROR_NO_ERROR) {
+        munmap(data, status.st_size);
+        error->type = layoutError;
+        error->level = FUSES_ERROR_LEVEL_ERROR;
+        return false;
+    }
+
+    if (lockMemory) {
+        if (mlock(data, status.st_size) == -1) {
+            error->type = FUSES_WARNING_MEMORY_NOT_LOCKED;
+            error->level = FUSES_ERROR_LEVEL_WARNING;
+            error->ioErrno = errno;
+        }
+    } else {
+        madvise(data, status.st_size, MADV_SEQUENTIAL);
+    }
+
+    configuration->rawData = data;
+    configuration->rawDataSize = status.st_size;
+    return true;
+}
+
+void fusesUnmapShow(FusesConfiguration *configuration) {
+    munmap(configuration->rawData, configuration->rawDataSize);
+    configuration->rawData = NULL;
+    configuration->rawDataSize = 0;
+}
+
+
+/**
+ * @brief Applies priority and CPU mask to one thread. A check counts as
+ * applied only if it succeeded for every thread it covers, first starts it.
+*/
+void _applyThreadSettings(
+    pthread_t thread, int priority, uint64_t cpuMask,
+    FusesRealtimeCheck *priorityCheck, FusesRealtimeCheck *affinityCheck, bool first
+) {
+    if (first) {
+        priorityCheck->applied = true;
+        affinityCheck->applied = affinityCheck->requested;
+    }
+    if (priorityCheck->applied && !realtimeSetPriority(thread, priority, &priorityCheck->ioErrno)) {
+        priorityCheck->applied = false;
+    }
+    if (
+        affinityCheck->requested && affinityCheck->applied
+        && !realtimeSetAffinity(thread, cpuMask, &affinityCheck->ioErrno)
+    ) {
+        affinityCheck->applied = false;
+    }
+}
+
+enum _DeviceState {
+    _DEVICE_NONE,
+    _DEVICE_PENDING,
+    _DEVICE_STARTING,
+    _DEVICE_UP,
+    _DEVICE_FAILED
+};
+
+typedef struct _DeviceBringUp _DeviceBringUp;
+
+typedef struct {
+    _DeviceBringUp *bringUp;
+    uint32_t busIndex;
+} _BusBringUp;
+
+/**
+ * @brief Bring-up of the devices of a show, one thread per bus.
+ *
+ * fusesInit and the threads share it by reference count, so fusesInit
+ * can give up on a device that hangs and return. Devices fusesInit did
+ * not claim are destroyed by whoever drops the last reference. After a
+ * failed startup the player keeps its reference until fusesDestroy, which
+ * waits for the threads, so the transport is free once it returns.
+*/
+struct _DeviceBringUp {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    uint32_t references;
+    Bool8 abandoned;
+    Bool8 failed;
+
+    // copies, the configuration may be gone before the threads are
+    I2cTransport *transport;
+    char **busNames;
+    uint32_t busCount;
+    FusesDevice *devices;
+    uint32_t deviceCount;
+    _BusBringUp *buses;
+
+    I2cDevice **i2cDevices;
+    uint8_t (*registers)[FUSE_REGISTER_COUNT];
+    uint8_t *states;
+    Bool8 *claimed;
+    uint64_t *startTimes;
+    uint64_t *durations;
+};
+
+uint64_t _getMonotonicTime(void) {
+    ClockSource *clock = clockSourceGetMonotonic();
+    return clock->now(clock);
+}
+
+void _releaseDeviceBringUp(_DeviceBringUp *bringUp) {
+    pthread_mutex_lock(&bringUp->lock);
+    bool last = --(bringUp->references) == 0;
+    // for _waitDeviceBringUp
+    pthread_cond_broadcast(&bringUp->changed);
+    pthread_mutex_unlock(&bringUp->lock);
+    if (!last) { return; }
+    for (uint32_t i = 0; i < bringUp->deviceCount; ++i) {
+        if (bringUp->i2cDevices[i] != NULL && !bringUp->claimed[i]) {
+            i2cDestroy(bringUp->i2cDevices[i]);
+        }
+    }
+    for (uint32_t i = 0; i < bringUp->busCount; ++i) {
+        free(bringUp->busNames[i]);
+    }
+    pthread_cond_destroy(&bringUp->changed);
+    pthread_mutex_destroy(&bringUp->lock);
+    free(bringUp->busNames);
+    free(bringUp->devices);
+    free(bringUp->buses);
+    free(bringUp->i2cDevices);
+    free(bringUp->registers);
+    free(bringUp->states);
+    free(bringUp->claimed);
+    free(bringUp->startTimes);
+    free(bringUp->durations);
+    free(bringUp);
+}
+
+/**
+ * @brief Opens, probes and reads the fuse registers of the devices of one
+ * bus in device order, until one fails or fusesInit gives up.
+*/
+void * _bringUpBus(void *argument) {
+    _BusBringUp *bus = (_BusBringUp*)argument;
+    _DeviceBringUp *bringUp = bus->bringUp;
+    char *busName = bringUp->busNames[bus->busIndex];
+    for (uint32_t i = 0; i < bringUp->deviceCount; ++i) {
+        if (bringUp->devices[i].busIndex != bus->busIndex) continue;
+        pthread_mutex_lock(&bringUp->lock);
+        if (bringUp->states[i] != _DEVICE_PENDING) {
+            pthread_mutex_unlock(&bringUp->lock);
+            continue;
+        }
+        bool stopped = bringUp->abandoned || bringUp->failed;
+        if (!stopped) {
+            bringUp->states[i] = _DEVICE_STARTING;
+            bringUp->startTimes[i] = _getMonotonicTime();
+        }
+        pthread_mutex_unlock(&bringUp->lock);
+        if (stopped) break;
+
+        I2cDevice *device = i2cInitWithTransport(
+            busName, busName != NULL ? strlen(busName) : 0,
+            bringUp->devices[i].deviceAddress, bringUp->transport
+        );
+        bool up = device != NULL && i2cGetError(device)->level != I2C_ERROR_LEVEL_ERROR && i2cTest(device);
+        if (up) {
+            i2cReadBlock(device, FUSE_REGISTER_BASE_ADDRESS, bringUp->registers[i], FUSE_REGISTER_COUNT);
+            up = i2cGetError(device)->level != I2C_ERROR_LEVEL_ERROR;
+        }
+
+        pthread_mutex_lock(&bringUp->lock);
+        bringUp->i2cDevices[i] = device;
+        bringUp->durations[i] = _getMonotonicTime() - bringUp->startTimes[i];
+        bringUp->states[i] = up ? _DEVICE_UP : _DEVICE_FAILED;
+        bringUp->failed = bringUp->failed || !up;
+        pthread_cond_broadcast(&bringUp->changed);
+        pthread_mutex_unlock(&bringUp->lock);
+    }
+    _releaseDeviceBringUp(bringUp);
+    return NULL;
+}
+
+/**
+ * @brief Starts the bring-up of the devices, NULL when out of memory.
+*/
+_DeviceBringUp * _startDeviceBringUp(
+    _FusesObject *_self, FusesConfiguration *configuration, FusesDevice *devices
+) {
+    _DeviceBringUp *bringUp = (_DeviceBringUp*)calloc(1, sizeof(_DeviceBringUp));
+    if (bringUp == NULL) { return NULL; }
+    pthread_mutex_init(&bringUp->lock, NULL);
+    pthread_condattr_t conditionAttributes;
+    pthread_condattr_init(&conditionAttributes);
+    pthread_condattr_setclock(&conditionAttributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&bringUp->changed, &conditionAttributes);
+    pthread_condattr_destroy(&conditionAttributes);
+    bringUp->references = 1;
+    bringUp->transport = configuration->transport;
+    bringUp->busCount = _self->busCount;
+    bringUp->deviceCount = _self->i2cDeviceCount;
+    bringUp->busNames = (char**)calloc(bringUp->busCount, sizeof(char*));
+    bringUp->devices = (FusesDevice*)malloc(bringUp->deviceCount * sizeof(FusesDevice));
+    bringUp->buses = (_BusBringUp*)calloc(bringUp->busCount, sizeof(_BusBringUp));
+    bringUp->i2cDevices = (I2cDevice**)calloc(bringUp->deviceCount, sizeof(I2cDevice*));
+    bringUp->registers = calloc(bringUp->deviceCount, sizeof(*bringUp->registers));
+    bringUp->states = (uint8_t*)calloc(bringUp->deviceCount, sizeof(uint8_t));
+    bringUp->claimed = (Bool8*)calloc(bringUp->deviceCount, sizeof(Bool8));
+    bringUp->startTimes = (uint64_t*)calloc(bringUp->deviceCount, sizeof(uint64_t));
+    bringUp->durations = (uint64_t*)calloc(bringUp->deviceCount, sizeof(uint64_t));
+    bool allocated = bringUp->busNames != NULL && bringUp->buses != NULL && (bringUp->deviceCount == 0 || (
+        bringUp->devices != NULL && bringUp->i2cDevices != NULL && bringUp->registers != NULL
+        && bringUp->states != NULL && bringUp->claimed != NULL
+        && bringUp->startTimes != NULL && bringUp->durations != NULL
+    ));
+    for (uint32_t i = 0; allocated && i < bringUp->busCount; ++i) {
+        // NULL for bus 0 without busName selects the default bus.
+        const char *busName = configuration->busNames != NULL ? configuration->busNames[i] : configuration->busName;
+        size_t busNameLength = configuration->busNames != NULL || busName == NULL
+            ? (busName != NULL ? strlen(busName) : 0) : configuration->busNameLength;
+        if (busName != NULL) {
+            bringUp->busNames[i] = strndup(busName, busNameLength);
+            allocated = bringUp->busNames[i] != NULL;
+        }
+    }
+    if (!allocated) {
+        _releaseDeviceBringUp(bringUp);
+        return NULL;
+    }
+    if (bringUp->deviceCount > 0) {
+        memcpy(bringUp->devices, devices, bringUp->deviceCount * sizeof(FusesDevice));
+    }
+    for (uint32_t i = 0; i < bringUp->deviceCount; ++i) {
+        bringUp->states[i] = devices[i].deviceAddress == NO_DEVICE_ADDRESS ? _DEVICE_NONE : _DEVICE_PENDING;
+    }
+
+    for (uint32_t i = 0; i < bringUp->busCount; ++i) {
+        bringUp->buses[i] = (_BusBringUp){ .bringUp = bringUp, .busIndex = i };
+        pthread_mutex_lock(&bringUp->lock);
+        ++(bringUp->references);
+        pthread_mutex_unlock(&bringUp->lock);
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, _bringUpBus, &bringUp->buses[i]) == 0) {
+            pthread_detach(thread);
+        } else {
+            // Still brought up, just not in parallel.
+            _bringUpBus(&bringUp->buses[i]);
         }
     }
+    return bringUp;
 }
 
-void * _mainloop(void *self) {
-    _FusesObject *_self = (_FusesObject*)self;
-    _self->isPaused = false;
-    _self->startTimestamp = _getCurrentTime();
-    _self->pauseStartedTimestamp = _self->startTimestamp;
-    _self->nextFuseIndex = 0;
-    // _self->timePaused = 0;
+/**
+ * @brief Waits until the bus threads are done and drops the last reference.
+*/
+void _waitDeviceBringUp(_DeviceBringUp *bringUp) {
+    pthread_mutex_lock(&bringUp->lock);
+    while (bringUp->references > 1) {
+        pthread_cond_wait(&bringUp->changed, &bringUp->lock);
+    }
+    pthread_mutex_unlock(&bringUp->lock);
+    _releaseDeviceBringUp(bringUp);
+}
 
-    while (!_self->haltFlag) {
-        if (_self->playFlag) {
-            _play(_self);
-            _waitForBarriers(_self);
-        } else if (_self->pauseFlag) {
-            _pause(_self);
-            _waitForBarriers(_self);
-        } else if (_self->stopFlag) {
-            _stop(_self);
-            _waitForBarriers(_self);
-        } else if (_self->jumpFlag) {
-            _jump(_self);
-            _waitForBarriers(_self);
+/**
+ * @brief Waits until every device is up, one failed or one took longer
+ * than timeout (ns), then hands the devices brought up so far to the
+ * player. Returns false and leaves the error and report set on failure.
+*/
+bool _finishDeviceBringUp(_FusesObject *_self, _DeviceBringUp *bringUp, uint64_t timeout, bool abandon) {
+    FusesStartupReport *report = &_self->startupReport;
+    pthread_mutex_lock(&bringUp->lock);
+    uint32_t timedOutDeviceIndex = FUSES_TRACE_NO_DEVICE;
+    while (!abandon && !bringUp->failed) {
+        uint64_t now = _getMonotonicTime();
+        uint64_t deadline = UINT64_MAX;
+        bool done = true;
+        for (uint32_t i = 0; i < bringUp->deviceCount; ++i) {
+            if (bringUp->states[i] == _DEVICE_PENDING) {
+                done = false;
+            } else if (bringUp->states[i] == _DEVICE_STARTING) {
+                done = false;
+                if (now - bringUp->startTimes[i] >= timeout) {
+                    timedOutDeviceIndex = i;
+                    break;
+                }
+                if (bringUp->startTimes[i] + timeout < deadline) {
+                    deadline = bringUp->startTimes[i] + timeout;
+                }
+            }
         }
+        if (done || timedOutDeviceIndex != FUSES_TRACE_NO_DEVICE) break;
+        // A thread between two devices has none starting.
+        if (deadline == UINT64_MAX) {
+            deadline = now + timeout;
+        }
+        struct timespec wakeTime = {
+            .tv_sec = deadline / NANOSECONDS_PER_SECOND,
+            .tv_nsec = deadline % NANOSECONDS_PER_SECOND
+        };
+        pthread_cond_timedwait(&bringUp->changed, &bringUp->lock, &wakeTime);
+    }
 
-        usleep(_self->timeResolution * MICROSECONDS_PER_MILLISECOND);  // TODO: replace usleep
-        if (_self->isPaused) continue;
-
-        _tick(_self);
+    uint32_t failedDeviceIndex = FUSES_TRACE_NO_DEVICE;
+    for (uint32_t i = 0; i < bringUp->deviceCount; ++i) {
+        if (bringUp->states[i] != _DEVICE_UP && bringUp->states[i] != _DEVICE_FAILED) continue;
+        bringUp->claimed[i] = true;
+        _self->i2cDevices[i] = bringUp->i2cDevices[i];
+        if (bringUp->states[i] == _DEVICE_FAILED) {
+            if (failedDeviceIndex == FUSES_TRACE_NO_DEVICE) {
+                failedDeviceIndex = i;
+            }
+            continue;
+        }
+        memcpy(_self->registerShadows[i], bringUp->registers[i], FUSE_REGISTER_COUNT);
+        ++(_self->registerResyncs);
+        ++(report->deviceCount);
+        if (report->deviceCount == 1 || bringUp->durations[i] > report->slowestDeviceTime) {
+            report->slowestDeviceIndex = i;
+            report->slowestDeviceTime = bringUp->durations[i];
+        }
+    }
+    bool success = !abandon && failedDeviceIndex == FUSES_TRACE_NO_DEVICE
+        && timedOutDeviceIndex == FUSES_TRACE_NO_DEVICE;
+    bringUp->abandoned = !success;
+    pthread_mutex_unlock(&bringUp->lock);
+    // Threads still busy use the transport, fusesDestroy waits for them.
+    if (success) {
+        _releaseDeviceBringUp(bringUp);
+    } else {
+        _self->deviceBringUp = bringUp;
     }
 
-    return NULL;
+    report->timedOutDeviceIndex = timedOutDeviceIndex;
+    if (abandon) { return false; }
+    if (failedDeviceIndex != FUSES_TRACE_NO_DEVICE) {
+        I2cDevice *device = _self->i2cDevices[failedDeviceIndex];
+        _self->error->type = device != NULL ? FUSES_I2C_ERROR : FUSES_ERROR_I2C_INITIALIZATION_FAILED;
+        _self->error->level = FUSES_ERROR_LEVEL_ERROR;
+        _self->error->i2cError = device != NULL ? i2cGetError(device) : NULL;
+        return false;
+    }
+    if (timedOutDeviceIndex != FUSES_TRACE_NO_DEVICE) {
+        _self->error->type = FUSES_ERROR_DEVICE_TIMED_OUT;
+        _self->error->level = FUSES_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    return true;
 }
 
 FusesObject * fusesInit(FusesConfiguration *configuration) {
@@ -266,105 +1944,267 @@ FusesObject * fusesInit(FusesConfiguration *configuration) {
         return NULL;
     }
     _resetError(_self);
-
-    FusesHeader *header = (FusesHeader*)configuration->rawData;
-    if (memcmp(header->fusesMagic, FUSES_MAGIC, MAGIC_SIZE) != 0) {
-        _self->error->type = FUSES_ERROR_INVALID_MAGIC_NUMBER;
-        _self->error->level = FUSES_ERROR_LEVEL_ERROR;
-        return (FusesObject*)_self;
+    _self->timerFileDescriptor = -1;
+    _self->wakeFileDescriptor = -1;
+    _self->eventFileDescriptor = -1;
+    _self->streamFileDescriptor = -1;
+    _self->clock = configuration->clock != NULL ? configuration->clock : clockSourceGetMonotonic();
+    // Startup is measured in real time, whatever clock the show plays on.
+    uint64_t startTime = _getMonotonicTime();
+    FusesStartupReport *startupReport = &_self->startupReport;
+    startupReport->slowestDeviceIndex = FUSES_TRACE_NO_DEVICE;
+    startupReport->timedOutDeviceIndex = FUSES_TRACE_NO_DEVICE;
+
+    CueStreamConfiguration streamConfiguration;
+    uint32_t lastCueTime = 0;
+    FusesDevice *devices = configuration->streamPath != NULL
+        ? _openShowStream(_self, configuration, &streamConfiguration, &lastCueTime)
+        : _loadShow(_self, configuration);
+    if (devices == NULL) { return (FusesObject*)_self; }
+
+    if (_self->plan == NULL) {
+        _self->fuseDuration = configuration->fuseDuration;
     }
-
-    _self->dataItemCount = header->dataItemCount;
-    _self->fuseDuration = configuration->fuseDuration;
+    _self->fuseDurationNanoseconds = (uint64_t)_self->fuseDuration * NANOSECONDS_PER_MILLISECOND;
     _self->timeResolution = configuration->timeResolution;
-
-    _self->i2cDevices = (I2cDevice*)calloc(MAX_I2C_DEVICE_COUNT, sizeof(I2cDevice));
-    if (_self->i2cDevices == NULL) {
+    _self->loopMode = configuration->loopMode;
+    if (configuration->streamPath == NULL && _self->dataItemCount > 0) {
+        lastCueTime = (uint32_t)(_cueTime(_self, _self->dataItemCount - 1) / NANOSECONDS_PER_MILLISECOND);
+    }
+    _self->totalDuration = _self->dataItemCount == 0 ? 0
+        : lastCueTime == UINT32_MAX ? UINT32_MAX : lastCueTime + _self->fuseDuration;
+
+    _self->seekIndexResolution = configuration->seekIndexResolution;
+
+    _self->i2cDevices = (I2cDevice*)calloc(_self->i2cDeviceCount, sizeof(I2cDevice));
+    _self->registerShadows = calloc(_self->i2cDeviceCount, sizeof(*_self->registerShadows));
+    _self->registerGenerations = calloc(_self->i2cDeviceCount, sizeof(*_self->registerGenerations));
+    _self->registerShadowLock = (pthread_mutex_t*)calloc(1, sizeof(pthread_mutex_t));
+    _self->pendingSetMasks = calloc(_self->i2cDeviceCount, sizeof(*_self->pendingSetMasks));
+    _self->pendingClearMasks = calloc(_self->i2cDeviceCount, sizeof(*_self->pendingClearMasks));
+    _self->pendingRegisters = (uint32_t*)calloc(_self->i2cDeviceCount * FUSE_REGISTER_COUNT, sizeof(uint32_t));
+    _self->i2cDeviceBuses = (uint8_t*)calloc(_self->i2cDeviceCount, sizeof(uint8_t));
+    _self->devicesStale = (Bool8*)calloc(_self->i2cDeviceCount, sizeof(Bool8));
+    if (_self->plan != NULL) {
+        _self->planLitMasks = calloc(_self->i2cDeviceCount, sizeof(*_self->planLitMasks));
+        _self->planLitCues = calloc(_self->i2cDeviceCount, sizeof(*_self->planLitCues));
+    }
+    if (configuration->verifyWrites) {
+        _self->switchCues = malloc(_self->i2cDeviceCount * sizeof(*_self->switchCues));
+        _self->switchTimestamps = calloc(_self->i2cDeviceCount, sizeof(*_self->switchTimestamps));
+        if (_self->switchCues != NULL) {
+            memset(_self->switchCues, 0xff, _self->i2cDeviceCount * sizeof(*_self->switchCues));
+        }
+    }
+    if (
+        (_self->i2cDeviceCount > 0 && (
+            _self->i2cDevices == NULL
+            || _self->registerShadows == NULL 
+            || _self->registerGenerations == NULL
+            || _self->pendingSetMasks == NULL
+            || _self->pendingClearMasks == NULL
+            || _self->pendingRegisters == NULL
+            || _self->i2cDeviceBuses == NULL
+            || _self->devicesStale == NULL
+            || (_self->plan != NULL && (_self->planLitMasks == NULL || _self->planLitCues == NULL))
+            || (configuration->verifyWrites && (_self->switchCues == NULL || _self->switchTimestamps == NULL))
+        ))
+        || _self->registerShadowLock == NULL
+    ) {
         _self->error->type = FUSES_ERROR_MEMORY_ALLOCATION_FAILED;
         _self->error->level = FUSES_ERROR_LEVEL_ERROR;
         return (FusesObject*)_self;
     }
+    pthread_mutex_init(_self->registerShadowLock, NULL);
 
-    for (int i = 0; i < MAX_I2C_DEVICE_COUNT; ++i) {
-        if (!(header->i2cDeviceIndexMask & (1 << i))) continue; 
-        uint8_t deviceAddress = BASE_DEVICE_ADDRESS | i;
-        I2cDevice *device = i2cInit(
-            configuration->busName, configuration->busNameLength, deviceAddress
-        );
-        if (device == NULL) {
-            _self->error->type = FUSES_ERROR_I2C_INITIALIZATION_FAILED;
-            _self->error->level = FUSES_ERROR_LEVEL_ERROR;
-            return (FusesObject*)_self;
-        }
-        if (i2cGetError(device)->level == I2C_ERROR_LEVEL_ERROR) {
-            _self->error->type = FUSES_I2C_ERROR;
-            _self->error->level = FUSES_ERROR_LEVEL_ERROR;
-            _self->error->i2cError = i2cGetError(device);
-            return (FusesObject*)_self;
-        }
-        if (!i2cTest(device)) {
-            _self->error->type = FUSES_I2C_ERROR;
+    _self->busCount = configuration->busNames != NULL ? configuration->busCount : 1;
+    for (uint32_t i = 0; i < _self->i2cDeviceCount; ++i) {
+        if (devices[i].deviceAddress == NO_DEVICE_ADDRESS) continue;
+        if (devices[i].busIndex >= _self->busCount) {
+            _self->error->type = FUSES_ERROR_UNKNOWN_BUS;
             _self->error->level = FUSES_ERROR_LEVEL_ERROR;
-            _self->error->i2cError = i2cGetError(device);
             return (FusesObject*)_self;
         }
-        _self->i2cDevices[_self->i2cDeviceCount++] = device;
+        _self->i2cDeviceBuses[i] = devices[i].busIndex;
     }
 
-    _self->data = (FusesDataItem*)(configuration->rawData + sizeof(FusesHeader));
-    _self->totalDuration = _self->data[_self->dataItemCount - 1].timestamp + _self->fuseDuration;
-
-    _self->thread = (pthread_t*)calloc(1, sizeof(pthread_t));
-    if (_self->thread == NULL) {
+    // The devices come up, one thread per bus, while the show is checked.
+    uint64_t parseTime = _getMonotonicTime() - startTime;
+    uint64_t deviceProbeStartTime = _getMonotonicTime();
+    _DeviceBringUp *bringUp = _startDeviceBringUp(_self, configuration, devices);
+    if (bringUp == NULL) {
         _self->error->type = FUSES_ERROR_MEMORY_ALLOCATION_FAILED;
         _self->error->level = FUSES_ERROR_LEVEL_ERROR;
         return (FusesObject*)_self;
     }
-
-    _self->internalBarrier = (pthread_barrier_t*)calloc(1, sizeof(pthread_barrier_t));
-    if (_self->internalBarrier == NULL) {
+    uint64_t validationStartTime = _getMonotonicTime();
+    bool valid = configuration->streamPath != NULL || _validateShow(_self, devices);
+    bool indexed = !valid || configuration->streamPath != NULL || _self->seekIndexResolution == 0
+        || _buildSeekIndex(_self);
+    parseTime += _getMonotonicTime() - validationStartTime;
+    uint32_t deviceTimeout = configuration->deviceTimeout > 0
+        ? configuration->deviceTimeout : FUSES_DEFAULT_DEVICE_TIMEOUT;
+    bool devicesUp = _finishDeviceBringUp(
+        _self, bringUp, (uint64_t)deviceTimeout * NANOSECONDS_PER_MILLISECOND, !valid || !indexed
+    );
+    uint64_t threadStartTime = _getMonotonicTime();
+    startupReport->parseTime = parseTime;
+    startupReport->deviceProbeTime = threadStartTime - deviceProbeStartTime;
+    if (!indexed) {
         _self->error->type = FUSES_ERROR_MEMORY_ALLOCATION_FAILED;
         _self->error->level = FUSES_ERROR_LEVEL_ERROR;
+    }
+    if (!valid || !indexed || !devicesUp) {
+        startupReport->totalTime = _getMonotonicTime() - startTime;
         return (FusesObject*)_self;
     }
 
-    _self->actionLock = (pthread_mutex_t*)calloc(1, sizeof(pthread_mutex_t));
-    if (_self->actionLock == NULL) {
+    _self->realtime = configuration->realtime;
+    FusesRealtimeReport *report = &_self->realtimeReport;
+    if (_self->realtime.enabled) {
+        if (_self->realtime.timingPriority == 0) {
+            _self->realtime.timingPriority = FUSES_REALTIME_DEFAULT_TIMING_PRIORITY;
+        }
+        if (_self->realtime.busPriority == 0) {
+            _self->realtime.busPriority = FUSES_REALTIME_DEFAULT_BUS_PRIORITY;
+        }
+        report->timingPriority.requested = true;
+        report->busPriority.requested = true;
+        report->timingAffinity.requested = _self->realtime.timingCpuMask != 0;
+        report->busAffinity.requested = _self->realtime.busCpuMask != 0;
+        report->memoryLock.requested = _self->realtime.lockMemory;
+        // Before the threads start, so their stacks are locked as well.
+        if (report->memoryLock.requested) {
+            report->memoryLock.applied = realtimeLockMemory(&report->memoryLock.ioErrno);
+        }
+    }
+
+    // Each bus is driven by its own worker, so buses transfer in parallel.
+    _self->busWorkers = (BusWorker**)calloc(_self->busCount, sizeof(BusWorker*));
+    if (_self->busWorkers == NULL) {
         _self->error->type = FUSES_ERROR_MEMORY_ALLOCATION_FAILED;
         _self->error->level = FUSES_ERROR_LEVEL_ERROR;
         return (FusesObject*)_self;
     }
-    pthread_mutex_init(_self->actionLock, NULL);
+    for (uint32_t i = 0; i < _self->busCount; ++i) {
+        uint32_t busDeviceCount = 0;
+        for (uint32_t j = 0; j < _self->i2cDeviceCount; ++j) {
+            if (_self->i2cDevices[j] != NULL && _self->i2cDeviceBuses[j] == i) {
+                ++busDeviceCount;
+            }
+        }
+        // Room for a few ticks of writes to all registers on the bus.
+        _self->busWorkers[i] = busWorkerInitWithVerification(
+            BUS_WRITE_QUEUE_TICKS * (busDeviceCount > 0 ? busDeviceCount : 1) * FUSE_REGISTER_COUNT,
+            _handleBusWriteCompletion, configuration->verifyWrites ? _handleBusVerification : NULL,
+            (void*)_self
+        );
+        if (_self->busWorkers[i] == NULL) {
+            _self->error->type = FUSES_ERROR_BUS_WORKER_INITIALIZATION_FAILED;
+            _self->error->level = FUSES_ERROR_LEVEL_ERROR;
+            return (FusesObject*)_self;
+        }
+        if (_self->realtime.enabled) {
+            _applyThreadSettings(
+                busWorkerGetThread(_self->busWorkers[i]),
+                _self->realtime.busPriority, _self->realtime.busCpuMask,
+                &report->busPriority, &report->busAffinity, i == 0
+            );
+        }
+    }
 
-    
-    if ((_self->subThreads = (pthread_t*)calloc(_self->dataItemCount, sizeof(pthread_t))) == NULL) {
+    _self->thread = (pthread_t*)calloc(1, sizeof(pthread_t));
+    if (_self->thread == NULL) {
         _self->error->type = FUSES_ERROR_MEMORY_ALLOCATION_FAILED;
         _self->error->level = FUSES_ERROR_LEVEL_ERROR;
         return (FusesObject*)_self;
     }
-    if ((_self->subThreadLocks = (pthread_mutex_t*)calloc(_self->dataItemCount, sizeof(pthread_mutex_t))) == NULL) {
+
+    _self->commands = mpscRingInit(COMMAND_QUEUE_CAPACITY, sizeof(_Command));
+    if (_self->commands == NULL) {
         _self->error->type = FUSES_ERROR_MEMORY_ALLOCATION_FAILED;
         _self->error->level = FUSES_ERROR_LEVEL_ERROR;
         return (FusesObject*)_self;
     }
-    if ((_self->subThreadConditions = (pthread_cond_t*)calloc(_self->dataItemCount, sizeof(pthread_cond_t))) == NULL) {
+    _self->commandTimeout = configuration->commandTimeout > 0
+        ? configuration->commandTimeout : DEFAULT_COMMAND_TIMEOUT;
+
+    _self->eventMask = configuration->eventMask != 0 ? configuration->eventMask : UINT32_MAX;
+    _self->eventCallback = configuration->eventCallback;
+    _self->eventCallbackContext = configuration->eventCallbackContext;
+    _self->lateCueThreshold = configuration->lateCueThreshold > 0
+        ? configuration->lateCueThreshold : FUSES_DEFAULT_LATE_CUE_THRESHOLD;
+    if (configuration->eventCapacity > 0) {
+        _self->events = mpscRingInit(configuration->eventCapacity, sizeof(FusesEvent));
+        if (_self->events == NULL) {
+            _self->error->type = FUSES_ERROR_MEMORY_ALLOCATION_FAILED;
+            _self->error->level = FUSES_ERROR_LEVEL_ERROR;
+            return (FusesObject*)_self;
+        }
+        _self->eventFileDescriptor = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (_self->eventFileDescriptor == -1) {
+            _self->error->type = FUSES_ERROR_TIMER_INITIALIZATION_FAILED;
+            _self->error->level = FUSES_ERROR_LEVEL_ERROR;
+            return (FusesObject*)_self;
+        }
+    }
+
+    // Every cue can be lit at most once per pass through the show. A
+    // streamed show is bounded by its fuses instead, each lit once at a time.
+    _self->extinguishQueue = timerQueueInit(configuration->injectionCapacity + (configuration->streamPath != NULL
+        ? _self->i2cDeviceCount * MAX_FUSE_COUNT_PER_DEVICE : _self->dataItemCount));
+    if (_self->extinguishQueue == NULL) {
         _self->error->type = FUSES_ERROR_MEMORY_ALLOCATION_FAILED;
         _self->error->level = FUSES_ERROR_LEVEL_ERROR;
         return (FusesObject*)_self;
     }
-    if ((_self->subThreadFlags = (Bool8*)calloc(_self->dataItemCount, sizeof(Bool8))) == NULL) {
-        _self->error->type = FUSES_ERROR_MEMORY_ALLOCATION_FAILED;
+
+    if (configuration->injectionCapacity > 0) {
+        _self->injections = injectionQueueInit(configuration->injectionCapacity);
+        if (_self->injections == NULL) {
+            _self->error->type = FUSES_ERROR_MEMORY_ALLOCATION_FAILED;
+            _self->error->level = FUSES_ERROR_LEVEL_ERROR;
+            return (FusesObject*)_self;
+        }
+    }
+
+    if (configuration->measureLateness) {
+        _self->igniteLatenessCapacity = configuration->streamPath != NULL && _self->dataItemCount > STREAM_LATENESS_CAPACITY
+            ? STREAM_LATENESS_CAPACITY : _self->dataItemCount;
+        _self->igniteLateness = (int32_t*)calloc(_self->igniteLatenessCapacity, sizeof(int32_t));
+        if (_self->igniteLateness == NULL) {
+            _self->error->type = FUSES_ERROR_MEMORY_ALLOCATION_FAILED;
+            _self->error->level = FUSES_ERROR_LEVEL_ERROR;
+            return (FusesObject*)_self;
+        }
+    }
+
+    if (FUSES_TRACE_ENABLED && configuration->traceCapacity > 0) {
+        _self->trace = fusesTraceInitWithClock(configuration->traceCapacity, _self->clock);
+        if (_self->trace == NULL) {
+            _self->error->type = FUSES_ERROR_MEMORY_ALLOCATION_FAILED;
+            _self->error->level = FUSES_ERROR_LEVEL_ERROR;
+            return (FusesObject*)_self;
+        }
+    }
+
+    _self->timerFileDescriptor = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    _self->wakeFileDescriptor = eventfd(0, EFD_CLOEXEC);
+    if (_self->timerFileDescriptor == -1 || _self->wakeFileDescriptor == -1) {
+        _self->error->type = FUSES_ERROR_TIMER_INITIALIZATION_FAILED;
         _self->error->level = FUSES_ERROR_LEVEL_ERROR;
         return (FusesObject*)_self;
     }
-    for (int i = 0; i < _self->dataItemCount; ++i) {
-        pthread_mutex_init(&_self->subThreadLocks[i], NULL);
-        pthread_cond_init(&_self->subThreadConditions[i], NULL);
-        _self->subThreadFlags[i] = false;
-        pthread_create(
-            &_self->subThreads[i], NULL, _subThreadHandler, 
-            (void*)&(SubThreadArg){.fusesObject = _self, .dataItemIndex = i}
-        );
+
+    // The stream wakes the main loop, so it starts after the wake descriptor.
+    if (configuration->streamPath != NULL) {
+        _self->stream = cueStreamInit(&streamConfiguration);
+        _self->streamFileDescriptor = -1;
+        if (_self->stream == NULL) {
+            _self->error->type = FUSES_ERROR_MEMORY_ALLOCATION_FAILED;
+            _self->error->level = FUSES_ERROR_LEVEL_ERROR;
+            return (FusesObject*)_self;
+        }
     }
 
     _self->jumpTarget = 0;
@@ -373,138 +2213,349 @@ FusesObject * fusesInit(FusesConfiguration *configuration) {
     _self->pauseStartedTimestamp = 0;
     // _self->timePaused = 0;
 
-    _self->useExternalBarrier = false;
     _self->isPlaying = false;
     _self->isPaused = false;
-    _self->playFlag = false;
-    _self->pauseFlag = false;
-    _self->stopFlag = false;
     _self->haltFlag = false;
-    _self->jumpFlag = false;
+    _self->eventsPending = false;
+    _self->finishing = false;
 
     pthread_create(_self->thread, NULL, _mainloop, (void*)_self);
+    if (_self->realtime.enabled) {
+        _applyThreadSettings(
+            *_self->thread, _self->realtime.timingPriority, _self->realtime.timingCpuMask,
+            &report->timingPriority, &report->timingAffinity, true
+        );
+        if (
+            (report->timingPriority.requested && !report->timingPriority.applied)
+            || (report->busPriority.requested && !report->busPriority.applied)
+            || (report->timingAffinity.requested && !report->timingAffinity.applied)
+            || (report->busAffinity.requested && !report->busAffinity.applied)
+            || (report->memoryLock.requested && !report->memoryLock.applied)
+        ) {
+            _self->error->type = FUSES_WARNING_REALTIME_INCOMPLETE;
+            _self->error->level = FUSES_ERROR_LEVEL_WARNING;
+        }
+    }
+    startupReport->threadStartTime = _getMonotonicTime() - threadStartTime;
+    startupReport->totalTime = _getMonotonicTime() - startTime;
     return (FusesObject*)_self;
 }
 
 void fusesDestroy(FusesObject *self) {
     _FusesObject *_self = (_FusesObject*)self;
-    
+
+    if (_self->thread != NULL) {
+        __atomic_store_n(&_self->haltFlag, true, __ATOMIC_RELEASE);
+        _wakeMainloop(_self);
+        pthread_join(*_self->thread, NULL);
+        free(_self->thread);
+    }
+    // Before the wake descriptor closes, the reader thread uses it.
+    if (_self->stream != NULL) {
+        cueStreamDestroy(_self->stream);
+    }
+    if (_self->streamFileDescriptor != -1) {
+        close(_self->streamFileDescriptor);
+    }
+    if (_self->realtimeReport.memoryLock.applied) {
+        munlockall();
+    }
+    if (_self->timerFileDescriptor != -1) {
+        close(_self->timerFileDescriptor);
+    }
+    if (_self->wakeFileDescriptor != -1) {
+        close(_self->wakeFileDescriptor);
+    }
+    // Performs the writes still queued before the devices go away.
+    if (_self->busWorkers != NULL) {
+        for (uint32_t i = 0; i < _self->busCount; ++i) {
+            if (_self->busWorkers[i] == NULL) continue;
+            busWorkerDestroy(_self->busWorkers[i]);
+        }
+        free(_self->busWorkers);
+    }
+    free(_self->igniteLateness);
+    if (_self->trace != NULL) {
+        fusesTraceDestroy(_self->trace);
+    }
+    if (_self->extinguishQueue != NULL) {
+        timerQueueDestroy(_self->extinguishQueue);
+    }
+    if (_self->commands != NULL) {
+        mpscRingDestroy(_self->commands);
+    }
+    if (_self->injections != NULL) {
+        injectionQueueDestroy(_self->injections);
+    }
+    if (_self->events != NULL) {
+        mpscRingDestroy(_self->events);
+    }
+    if (_self->eventFileDescriptor != -1) {
+        close(_self->eventFileDescriptor);
+    }
+    if (_self->i2cDevices != NULL) {
+        for (uint32_t i = 0; i < _self->i2cDeviceCount; ++i) {
+            if (_self->i2cDevices[i] == NULL) continue;
+            i2cDestroy(_self->i2cDevices[i]);
+        }
+        free(_self->i2cDevices);
+    }
+    // Blocks while a device fusesInit gave up on is still coming up.
+    if (_self->deviceBringUp != NULL) {
+        _waitDeviceBringUp(_self->deviceBringUp);
+    }
+    if (_self->registerShadowLock != NULL) {
+        pthread_mutex_destroy(_self->registerShadowLock);
+        free(_self->registerShadowLock);
+    }
+    free(_self->registerShadows);
+    free(_self->registerGenerations);
+    free(_self->pendingSetMasks);
+    free(_self->pendingClearMasks);
+    free(_self->pendingRegisters);
+    free(_self->i2cDeviceBuses);
+    free(_self->devicesStale);
+    free(_self->planLitMasks);
+    free(_self->planLitCues);
+    free(_self->switchCues);
+    free(_self->switchTimestamps);
+    free(_self->convertedData);
+    free(_self->streamDevices);
+    free(_self->seekIndex);
+    free(_self->error);
     free(_self);
 }
 
-/**
- * @brief This function locks the action lock and checks if the action is allowed.
-*/
-bool _lockAction(
-    _FusesObject *_self, pthread_barrier_t *barrier, bool predicate
+bool fusesPostCommand(
+    FusesObject *self, enum FusesCommandType type, uint32_t milliseconds, FusesCommandTicket *ticket
 ) {
-    // This lock prevents any other action from being processed while
-    // the current action is being processed.
-    pthread_mutex_lock(_self->actionLock);
+    _FusesObject *_self = (_FusesObject*)self;
+    _Command command = {
+        .type = type, .argument = (uint64_t)milliseconds * NANOSECONDS_PER_MILLISECOND, .barrier = NULL
+    };
+    if (!mpscRingPush(_self->commands, &command, ticket)) { return false; }
+    _wakeMainloop(_self);
+    return true;
+}
 
-    // If the predicate is false the action is not allowed.
-    if (!predicate) {
-        pthread_mutex_unlock(_self->actionLock);
-        return false;
+size_t fusesInjectCues(FusesObject *self, const FusesInjectedCue *cues, size_t count, FusesCueId *ids) {
+    _FusesObject *_self = (_FusesObject*)self;
+    if (_self->injections == NULL) { return 0; }
+    size_t injected = 0;
+    while (
+        injected < count
+        && cues[injected].i2cDeviceIndex < _self->i2cDeviceCount
+        && _self->i2cDevices[cues[injected].i2cDeviceIndex] != NULL
+        && cues[injected].fuseIndex < MAX_FUSE_COUNT_PER_DEVICE
+        && cues[injected].milliseconds <= INT32_MAX
+        && injectionQueuePost(
+            _self->injections,
+            (uint64_t)cues[injected].milliseconds * NANOSECONDS_PER_MILLISECOND
+                + (uint64_t)cues[injected].microseconds * NANOSECONDS_PER_MICROSECOND,
+            cues[injected].relative,
+            cues[injected].i2cDeviceIndex, cues[injected].fuseIndex, ids != NULL ? &ids[injected] : NULL
+        )
+    ) {
+        ++injected;
     }
+    // One wake-up for the whole batch.
+    if (injected > 0) {
+        _wakeMainloop(_self);
+    }
+    return injected;
+}
 
-    // If an external barrier is used, wait for it.
-    _self->externalBarrier = barrier;
-    pthread_barrier_init(
-        _self->internalBarrier, NULL, INTERNAL_BARRIER_COUNT
-    );
-
+bool fusesCancelCue(FusesObject *self, FusesCueId id) {
+    _FusesObject *_self = (_FusesObject*)self;
+    if (_self->injections == NULL || !injectionQueueCancel(_self->injections, id)) { return false; }
+    _wakeMainloop(_self);
     return true;
 }
 
+int fusesGetEventFileDescriptor(FusesObject *self) {
+    _FusesObject *_self = (_FusesObject*)self;
+    return _self->eventFileDescriptor;
+}
+
+size_t fusesReadEvents(FusesObject *self, FusesEvent *events, size_t capacity) {
+    _FusesObject *_self = (_FusesObject*)self;
+    if (_self->events == NULL) { return 0; }
+    // Reset first: an event queued after the drain signals again.
+    uint64_t counter;
+    read(_self->eventFileDescriptor, &counter, sizeof(counter));
+    size_t count = 0;
+    while (count < capacity && mpscRingPop(_self->events, &events[count])) {
+        ++count;
+    }
+    if (count == capacity) {
+        // Possibly more left, stay readable.
+        _signalEvents(_self);
+    }
+    return count;
+}
+
+const char * fusesGetEventName(uint8_t type) {
+    switch (type) {
+        case FUSES_EVENT_STATE_CHANGED:
+            return "stateChanged";
+        case FUSES_EVENT_CUE_FIRED:
+            return "cueFired";
+        case FUSES_EVENT_CUE_LATE:
+            return "cueLate";
+        case FUSES_EVENT_SHOW_FINISHED:
+            return "showFinished";
+        case FUSES_EVENT_I2C_ERROR:
+            return "i2cError";
+        case FUSES_EVENT_VERIFY_MISMATCH:
+            return "verifyMismatch";
+        default:
+            return "unknown";
+    }
+}
+
+uint64_t _getRemainingNanoseconds(struct timespec *deadline) {
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    int64_t remaining = (int64_t)(deadline->tv_sec - currentTime.tv_sec) * NANOSECONDS_PER_SECOND
+        + (deadline->tv_nsec - currentTime.tv_nsec);
+    return remaining > 0 ? (uint64_t)remaining : 0;
+}
+
+bool fusesWaitCommand(FusesObject *self, FusesCommandTicket ticket, uint32_t timeout) {
+    _FusesObject *_self = (_FusesObject*)self;
+    uint32_t target = (uint32_t)(ticket + 1);
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    uint64_t deadlineNanoseconds = (uint64_t)deadline.tv_nsec + (uint64_t)timeout * NANOSECONDS_PER_MICROSECOND;
+    deadline.tv_sec += deadlineNanoseconds / NANOSECONDS_PER_SECOND;
+    deadline.tv_nsec = deadlineNanoseconds % NANOSECONDS_PER_SECOND;
+
+    __atomic_add_fetch(&_self->commandWaiters, 1, __ATOMIC_SEQ_CST);
+    bool applied;
+    while (true) {
+        uint32_t appliedCommands = __atomic_load_n(&_self->appliedCommands, __ATOMIC_SEQ_CST);
+        applied = (int32_t)(appliedCommands - target) >= 0;
+        if (applied) break;
+        uint64_t remaining = _getRemainingNanoseconds(&deadline);
+        if (remaining == 0) break;
+        struct timespec relativeTimeout = {
+            .tv_sec = remaining / NANOSECONDS_PER_SECOND,
+            .tv_nsec = remaining % NANOSECONDS_PER_SECOND
+        };
+        syscall(
+            SYS_futex, &_self->appliedCommands, FUTEX_WAIT_PRIVATE,
+            appliedCommands, &relativeTimeout, NULL, 0
+        );
+    }
+    __atomic_sub_fetch(&_self->commandWaiters, 1, __ATOMIC_SEQ_CST);
+    return applied;
+}
+
 /**
- * @brief This function unlocks the action lock and waits for the fuses thread to process the action.
+ * @brief Posts a command for the blocking control calls and waits until
+ * the main loop applied it, at most commandTimeout.
 */
-void _unlockAction(_FusesObject *_self) {
-    // wait for the fuses thread to process the action
-    pthread_barrier_wait(_self->internalBarrier);
-    pthread_barrier_destroy(_self->internalBarrier);
-
-    pthread_mutex_unlock(_self->actionLock);
+bool _sendCommand(
+    _FusesObject *_self, enum FusesCommandType type, uint64_t argument, pthread_barrier_t *barrier
+) {
+    _Command command = { .type = type, .argument = argument, .barrier = barrier };
+    FusesCommandTicket ticket;
+    if (!mpscRingPush(_self->commands, &command, &ticket)) {
+        _self->error->type = FUSES_WARNING_COMMAND_QUEUE_FULL;
+        _self->error->level = FUSES_ERROR_LEVEL_WARNING;
+        return false;
+    }
+    _wakeMainloop(_self);
+    if (!fusesWaitCommand((FusesObject*)_self, ticket, _self->commandTimeout)) {
+        _self->error->type = FUSES_WARNING_COMMAND_TIMED_OUT;
+        _self->error->level = FUSES_ERROR_LEVEL_WARNING;
+        return false;
+    }
+    return true;
 }
 
 bool fusesPlay(FusesObject *self, pthread_barrier_t *barrier) {
     _FusesObject *_self = (_FusesObject*)self;
     _resetError(_self);
-    if (!_lockAction(
-        _self, barrier, 
-        !_self->isPlaying 
-    )) {
+    if (__atomic_load_n(&_self->isPlaying, __ATOMIC_ACQUIRE)) {
         _self->error->type = FUSES_WARNING_ALREADY_PLAYING;
         _self->error->level = FUSES_ERROR_LEVEL_WARNING;
         return false;
     }
-
-    _self->playFlag = true;
-
-    _unlockAction(_self);
-    return true;
+    return _sendCommand(_self, FUSES_COMMAND_PLAY, 0, barrier);
 }
 
 bool fusesPause(FusesObject *self, pthread_barrier_t *barrier) {
     _FusesObject *_self = (_FusesObject*)self;
     _resetError(_self);
-    if (!_lockAction(
-        _self, barrier, 
-        _self->isPlaying
-    )) {
+    if (!__atomic_load_n(&_self->isPlaying, __ATOMIC_ACQUIRE)) {
         _self->error->type = FUSES_WARNING_ALREADY_PAUSED;
         _self->error->level = FUSES_ERROR_LEVEL_WARNING;
         return false;
     }
-
-    _self->pauseFlag = true;
-
-    _unlockAction(_self);
-    return true;
+    return _sendCommand(_self, FUSES_COMMAND_PAUSE, 0, barrier);
 }
 
 void fusesStop(FusesObject *self, pthread_barrier_t *barrier) {
     _FusesObject *_self = (_FusesObject*)self;
     _resetError(_self);
-    _lockAction(_self, barrier, true);
-
-    _self->stopFlag = true;
-
-    _unlockAction(_self);
+    _sendCommand(_self, FUSES_COMMAND_STOP, 0, barrier);
 }
 
 void fusesJump(FusesObject *self, pthread_barrier_t *barrier, uint32_t milliseconds) {
+    fusesJumpMicroseconds(self, barrier, (uint64_t)milliseconds * MICROSECONDS_PER_MILLISECOND);
+}
+
+void fusesJumpMicroseconds(FusesObject *self, pthread_barrier_t *barrier, uint64_t microseconds) {
     _FusesObject *_self = (_FusesObject*)self;
     _resetError(_self);
-    _lockAction(_self, barrier, true);
-
-    _self->jumpFlag = true;
-    if (milliseconds > _self->totalDuration) {
+    if (
+        _sendCommand(_self, FUSES_COMMAND_JUMP, microseconds * NANOSECONDS_PER_MICROSECOND, barrier)
+        && microseconds > (uint64_t)_self->totalDuration * MICROSECONDS_PER_MILLISECOND
+    ) {
         _self->error->type = FUSES_WARNING_JUMPED_BEYOND_END;
         _self->error->level = FUSES_ERROR_LEVEL_WARNING;
     }
-    _self->jumpTarget = milliseconds;
+}
+
+uint32_t fusesGetCueCount(FusesObject *self) {
+    _FusesObject *_self = (_FusesObject*)self;
+    _resetError(_self);
+    return _self->dataItemCount;
+}
 
-    _unlockAction(_self);
+uint32_t fusesGetNextCueIndex(FusesObject *self, uint32_t milliseconds) {
+    _FusesObject *_self = (_FusesObject*)self;
+    _resetError(_self);
+    uint64_t timestamp = (uint64_t)milliseconds * NANOSECONDS_PER_MILLISECOND;
+    if (_self->stream != NULL) {
+        return cueStreamFind(_self->stream, timestamp);
+    }
+    return _searchNextFuseIndex(_self, timestamp);
 }
 
 bool fusesGetIsPlaying(FusesObject *self) {
     _FusesObject *_self = (_FusesObject*)self;
     _resetError(_self);
-    return _self->isPlaying;
+    return __atomic_load_n(&_self->isPlaying, __ATOMIC_ACQUIRE);
 }
 
 bool fusesGetIsPaused(FusesObject *self) {
     _FusesObject *_self = (_FusesObject*)self;
     _resetError(_self);
-    return _self->isPaused;
+    return __atomic_load_n(&_self->isPaused, __ATOMIC_ACQUIRE);
+}
+
+uint32_t fusesGetCurrentTime(FusesObject *self) {
+    _FusesObject *_self = (_FusesObject*)self;
+    _resetError(_self);
+    return (uint32_t)(__atomic_load_n(&_self->currentTime, __ATOMIC_RELAXED) / NANOSECONDS_PER_MILLISECOND);
 }
 
-uint64_t fusesGetCurrentTime(FusesObject *self) {
+uint64_t fusesGetCurrentTimeMicroseconds(FusesObject *self) {
     _FusesObject *_self = (_FusesObject*)self;
     _resetError(_self);
-    return _self->currentTime;
+    return __atomic_load_n(&_self->currentTime, __ATOMIC_RELAXED) / NANOSECONDS_PER_MICROSECOND;
 }
 
 uint32_t fusesGetTotalDuration(FusesObject *self) {
@@ -513,6 +2564,153 @@ uint32_t fusesGetTotalDuration(FusesObject *self) {
     return _self->totalDuration;
 }
 
+void fusesResyncRegisters(FusesObject *self) {
+    _FusesObject *_self = (_FusesObject*)self;
+    _resetError(_self);
+    for (uint32_t i = 0; i < _self->i2cDeviceCount; ++i) {
+        if (_self->i2cDevices[i] == NULL) continue;
+        if (!_resyncRegisterShadow(_self, i)) {
+            _self->error->type = FUSES_I2C_ERROR;
+            _self->error->level = FUSES_ERROR_LEVEL_ERROR;
+            _self->error->i2cError = i2cGetError(_self->i2cDevices[i]);
+            // The board state is unknown, bring it back to the shadow.
+            _markDeviceStale(_self, i);
+        }
+    }
+    if (__atomic_load_n(&_self->anyDeviceStale, __ATOMIC_ACQUIRE)) {
+        _wakeMainloop(_self);
+    }
+}
+
+FusesStatistics fusesGetStatistics(FusesObject *self) {
+    _FusesObject *_self = (_FusesObject*)self;
+    _resetError(_self);
+    FusesStatistics statistics = {
+        .registerReadsAvoided = __atomic_load_n(&_self->registerReadsAvoided, __ATOMIC_RELAXED),
+        .registerResyncs = __atomic_load_n(&_self->registerResyncs, __ATOMIC_RELAXED),
+        .fuseEdges = __atomic_load_n(&_self->fuseEdges, __ATOMIC_RELAXED),
+        .registerWrites = __atomic_load_n(&_self->registerWrites, __ATOMIC_RELAXED),
+        .registerRepairs = __atomic_load_n(&_self->registerRepairs, __ATOMIC_RELAXED),
+        .traceEventsDropped = _self->trace != NULL ? fusesTraceGetDropped(_self->trace) : 0,
+        .eventsDropped = __atomic_load_n(&_self->eventsDropped, __ATOMIC_RELAXED),
+        .injectedCuesFired = __atomic_load_n(&_self->injectedCuesFired, __ATOMIC_RELAXED),
+        .injectedCuesCancelled = __atomic_load_n(&_self->injectedCuesCancelled, __ATOMIC_RELAXED)
+    };
+    for (uint32_t i = 0; _self->busWorkers != NULL && i < _self->busCount; ++i) {
+        if (_self->busWorkers[i] == NULL) continue;
+        BusWorkerStatistics busStatistics = busWorkerGetStatistics(_self->busWorkers[i]);
+        statistics.verifications += busStatistics.verifications;
+        statistics.verificationMismatches += busStatistics.verificationMismatches;
+        statistics.failedVerifications += busStatistics.failedVerifications;
+    }
+    if (_self->stream != NULL) {
+        CueStreamStatistics streamStatistics = cueStreamGetStatistics(_self->stream);
+        statistics.streamChunksRead = streamStatistics.chunksRead;
+        statistics.streamStalls = streamStatistics.stalls;
+        statistics.streamFailed = streamStatistics.failed;
+    }
+    return statistics;
+}
+
+void fusesSetTraceEnabled(FusesObject *self, bool enabled) {
+    _FusesObject *_self = (_FusesObject*)self;
+    _resetError(_self);
+    if (_self->trace != NULL) {
+        fusesTraceSetEnabled(_self->trace, enabled);
+    }
+}
+
+size_t fusesDrainTrace(FusesObject *self, FusesTraceEvent *events, size_t capacity) {
+    _FusesObject *_self = (_FusesObject*)self;
+    _resetError(_self);
+    if (_self->trace == NULL) { return 0; }
+    return fusesTraceDrain(_self->trace, events, capacity);
+}
+
+static int _compareLateness(const void *a, const void *b) {
+    int32_t x = *(const int32_t*)a;
+    int32_t y = *(const int32_t*)b;
+    return (x > y) - (x < y);
+}
+
+uint32_t fusesGetBusCount(FusesObject *self) {
+    _FusesObject *_self = (_FusesObject*)self;
+    _resetError(_self);
+    return _self->busCount;
+}
+
+BusWorkerStatistics fusesGetBusStatistics(FusesObject *self, uint32_t busIndex) {
+    _FusesObject *_self = (_FusesObject*)self;
+    _resetError(_self);
+    BusWorkerStatistics statistics = { 0 };
+    if (busIndex >= _self->busCount) {
+        _self->error->type = FUSES_ERROR_UNKNOWN_BUS;
+        _self->error->level = FUSES_ERROR_LEVEL_ERROR;
+        return statistics;
+    }
+    return busWorkerGetStatistics(_self->busWorkers[busIndex]);
+}
+
+FusesLatenessReport fusesGetLatenessReport(FusesObject *self) {
+    _FusesObject *_self = (_FusesObject*)self;
+    _resetError(_self);
+    FusesLatenessReport report = { 0 };
+    if (_self->igniteLateness == NULL) { return report; }
+
+    size_t count = __atomic_load_n(&_self->igniteLatenessCount, __ATOMIC_ACQUIRE);
+    if (count == 0) { return report; }
+    int32_t *sorted = (int32_t*)malloc(count * sizeof(int32_t));
+    if (sorted == NULL) {
+        _self->error->type = FUSES_ERROR_MEMORY_ALLOCATION_FAILED;
+        _self->error->level = FUSES_ERROR_LEVEL_ERROR;
+        return report;
+    }
+    memcpy(sorted, _self->igniteLateness, count * sizeof(int32_t));
+    qsort(sorted, count, sizeof(int32_t), _compareLateness);
+
+    report.count = count;
+    report.minimum = sorted[0];
+    report.median = sorted[count / 2];
+    report.p90 = sorted[count * 90 / 100];
+    report.p99 = sorted[count * 99 / 100];
+    report.p999 = sorted[count * 999 / 1000];
+    report.maximum = sorted[count - 1];
+    free(sorted);
+    return report;
+}
+
+FusesRealtimeReport fusesGetRealtimeReport(FusesObject *self) {
+    _FusesObject *_self = (_FusesObject*)self;
+    return _self->realtimeReport;
+}
+
+FusesStartupReport fusesGetStartupReport(FusesObject *self) {
+    _FusesObject *_self = (_FusesObject*)self;
+    return _self->startupReport;
+}
+
+int fusesPrintRealtimeReport(FusesObject *self, FILE *file) {
+    _FusesObject *_self = (_FusesObject*)self;
+    FusesRealtimeReport *report = &_self->realtimeReport;
+    struct {
+        const char *name;
+        FusesRealtimeCheck *check;
+    } checks[] = {
+        { "SCHED_FIFO priority of the timing thread", &report->timingPriority },
+        { "SCHED_FIFO priority of the bus workers", &report->busPriority },
+        { "CPU affinity of the timing thread", &report->timingAffinity },
+        { "CPU affinity of the bus workers", &report->busAffinity },
+        { "memory lock", &report->memoryLock }
+    };
+    int failureCount = 0;
+    for (size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); ++i) {
+        if (!checks[i].check->requested || checks[i].check->applied) continue;
+        fprintf(file, "real-time: %s not applied: %s\n", checks[i].name, strerror(checks[i].check->ioErrno));
+        ++failureCount;
+    }
+    return failureCount;
+}
+
 FusesError * fusesGetError(FusesObject *self) {
     _FusesObject *_self = (_FusesObject*)self;
     return _self->error;
@@ -536,12 +2734,42 @@ char * fusesGetErrorString(FusesError *error) {
         case FUSES_WARNING_JUMPED_BEYOND_END:
             return "Jumoed beyond end of fuses";
 
+        case FUSES_WARNING_MEMORY_NOT_LOCKED:
+            return "Show file could not be locked into memory";
+
+        case FUSES_WARNING_REALTIME_INCOMPLETE:
+            return "Some real-time settings could not be applied";
+
+        case FUSES_WARNING_COMMAND_QUEUE_FULL:
+            return "Too many commands are pending";
+
+        case FUSES_WARNING_COMMAND_TIMED_OUT:
+            return "The command did not take effect in time";
+
 
         // erorrs
         // fuses
         case FUSES_ERROR_INVALID_MAGIC_NUMBER:
             return "FUSE magic is invalid";
 
+        case FUSES_ERROR_INVALID_CHECKSUM:
+            return "Header checksum does not match";
+
+        case FUSES_ERROR_UNSUPPORTED_VERSION:
+            return "Unsupported show file version";
+
+        case FUSES_ERROR_INVALID_DATA:
+            return "Show data is truncated, unsorted or addresses unknown fuses";
+
+        case FUSES_ERROR_UNKNOWN_BUS:
+            return "A device is on a bus that is not configured";
+
+        case FUSES_ERROR_BUS_WORKER_INITIALIZATION_FAILED:
+            return "Could not start a bus I/O worker";
+
+        case FUSES_ERROR_IO_ERROR:
+            return strerror(error->ioErrno);
+
         // i2c
         case FUSES_I2C_ERROR:
             return i2cGetErrorString(error->i2cError);
@@ -549,7 +2777,13 @@ char * fusesGetErrorString(FusesError *error) {
         case FUSES_ERROR_I2C_INITIALIZATION_FAILED:
             return "Initialization ot the i2c device failed";
 
+        case FUSES_ERROR_DEVICE_TIMED_OUT:
+            return "A device did not come up in time";
+
         // other
+        case FUSES_ERROR_TIMER_INITIALIZATION_FAILED:
+            return "Creating the timer or wake up descriptor failed";
+
         case FUSES_ERROR_MEMORY_ALLOCATION_FAILED:
             return "Memory allocation failed";
 
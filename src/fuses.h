@@ -3,9 +3,14 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <pthread.h>
 
 #include "i2c.h"
+#include "busWorker.h"
+#include "clockSource.h"
+#include "fusesFormat.h"
+#include "fusesTrace.h"
 
 enum FusesErrorType {
     // info
@@ -15,14 +20,26 @@ enum FusesErrorType {
     FUSES_WARNING_ALREADY_PLAYING,
     FUSES_WARNING_ALREADY_PAUSED,
     FUSES_WARNING_JUMPED_BEYOND_END,
+    FUSES_WARNING_MEMORY_NOT_LOCKED,
+    FUSES_WARNING_REALTIME_INCOMPLETE,
+    FUSES_WARNING_COMMAND_QUEUE_FULL,
+    FUSES_WARNING_COMMAND_TIMED_OUT,
 
     // errors
     // fuses
     FUSES_ERROR_INVALID_MAGIC_NUMBER,
+    FUSES_ERROR_INVALID_CHECKSUM,
+    FUSES_ERROR_UNSUPPORTED_VERSION,
+    FUSES_ERROR_INVALID_DATA,
+    FUSES_ERROR_UNKNOWN_BUS,
+    FUSES_ERROR_IO_ERROR,
+    FUSES_ERROR_BUS_WORKER_INITIALIZATION_FAILED,
     // i2c
     FUSES_I2C_ERROR,
     FUSES_ERROR_I2C_INITIALIZATION_FAILED,
+    FUSES_ERROR_DEVICE_TIMED_OUT,
     // other
+    FUSES_ERROR_TIMER_INITIALIZATION_FAILED,
     FUSES_ERROR_MEMORY_ALLOCATION_FAILED
 };
 
@@ -36,19 +53,289 @@ typedef struct {
     enum FusesErrorType type;
     enum FusesErrorLevel level;
     I2cError *i2cError;
+    int ioErrno;
 } FusesError;
 
+enum FusesLoopMode {
+    // sleep until the next cue deadline or control call
+    FUSES_LOOP_DEADLINE = 0,
+    // wake up every timeResolution milliseconds or on a control call
+    FUSES_LOOP_POLLING = 1
+};
+
+/**
+ * @brief Control commands travel through a lock-free queue to the main
+ * loop, which is woken immediately and applies them in posting order.
+ *
+ * fusesPostCommand returns as soon as the command is queued and never
+ * blocks; its ticket can be waited on with fusesWaitCommand. fusesPlay,
+ * fusesPause, fusesStop and fusesJump post and wait for the command to
+ * take effect, at most commandTimeout.
+*/
+enum FusesCommandType {
+    FUSES_COMMAND_PLAY,
+    FUSES_COMMAND_PAUSE,
+    FUSES_COMMAND_STOP,
+    // milliseconds is the jump target
+    FUSES_COMMAND_JUMP
+};
+
+typedef uint64_t FusesCommandTicket;
+
+enum FusesState {
+    FUSES_STATE_STOPPED,
+    FUSES_STATE_PLAYING,
+    FUSES_STATE_PAUSED
+};
+
+/**
+ * @brief Events of the player for host applications.
+ *
+ * Selected events are queued for fusesReadEvents, whose file descriptor
+ * becomes readable while events are queued, so hosts can wait in poll or
+ * epoll. The optional callback sees the same events on the thread that
+ * raised them, the timing thread or a bus worker, and must not block.
+*/
+enum FusesEventType {
+    // state is the new FusesState
+    FUSES_EVENT_STATE_CHANGED,
+    // the ignite write of cueIndex was handed to its bus, lateness in us
+    FUSES_EVENT_CUE_FIRED,
+    // additionally raised for cues fired more than lateCueThreshold late
+    FUSES_EVENT_CUE_LATE,
+    // the last cue fired and every fuse went out again
+    FUSES_EVENT_SHOW_FINISHED,
+    // a register write failed with ioErrno
+    FUSES_EVENT_I2C_ERROR,
+    // the readback of a register did not show the fuse fuseIndex as the
+    // cue cueIndex switched it at switchTimestamp, see verifyWrites
+    FUSES_EVENT_VERIFY_MISMATCH,
+    FUSES_EVENT_TYPE_COUNT
+};
+
+#define FUSES_EVENT_MASK(type) (1u << (type))
+#define FUSES_DEFAULT_LATE_CUE_THRESHOLD (5000)
+#define FUSES_DEFAULT_DEVICE_TIMEOUT (100)
+
+typedef struct {
+    // time of the player's clock, CLOCK_MONOTONIC by default, in nanoseconds
+    uint64_t timestamp;
+    // FUSES_TRACE_NO_CUE and FUSES_TRACE_NO_DEVICE where they do not apply
+    uint32_t cueIndex;
+    int32_t lateness;
+    int ioErrno;
+    uint16_t i2cDeviceIndex;
+    uint8_t type;
+    uint8_t state;
+    // FUSES_EVENT_VERIFY_MISMATCH: the register as written and as read back
+    uint64_t switchTimestamp;
+    uint8_t fuseIndex;
+    uint8_t registerAddress;
+    uint8_t writtenValue;
+    uint8_t readValue;
+} FusesEvent;
+
+typedef void (*FusesEventCallback)(void *context, const FusesEvent *event);
+
+/**
+ * @brief Cues added to the running show from any thread.
+ *
+ * fusesInjectCues queues cues through a lock-free queue that the timing
+ * thread merges into its schedule on its next iteration, without pausing
+ * the show; inserting and cancelling cost O(log n) and nothing allocates
+ * after fusesInit. Injected cues fire on show time while the show plays,
+ * a jump drops those before its target and a stop drops all. Events and
+ * trace events of an injected cue carry FUSES_INJECTED_CUE_INDEX(id) as
+ * their cue index.
+*/
+typedef struct {
+    // show time, or time after the current show time with relative;
+    // microseconds are added to milliseconds for sub-millisecond cues
+    uint32_t milliseconds;
+    uint32_t microseconds;
+    bool relative;
+    uint32_t i2cDeviceIndex;
+    uint8_t fuseIndex;
+} FusesInjectedCue;
+
+typedef uint64_t FusesCueId;
+
+#define FUSES_INJECTED_CUE_FLAG (0x80000000u)
+#define FUSES_INJECTED_CUE_INDEX(id) (FUSES_INJECTED_CUE_FLAG | (uint32_t)(id))
+
+#define FUSES_REALTIME_DEFAULT_TIMING_PRIORITY (80)
+#define FUSES_REALTIME_DEFAULT_BUS_PRIORITY (70)
+
+/**
+ * @brief Opt-in real-time execution of the timing thread and the bus workers.
+ *
+ * The threads run SCHED_FIFO and can be pinned to CPUs, memory is locked
+ * with mlockall before they start and the timing thread prefaults its
+ * stack. Nothing on the play path allocates, real-time mode or not.
+ * Settings that cannot be applied, usually for lack of privileges, leave
+ * fusesInit with FUSES_WARNING_REALTIME_INCOMPLETE and are listed by
+ * fusesGetRealtimeReport.
+*/
+typedef struct {
+    bool enabled;
+    // SCHED_FIFO priorities, 0 picks the defaults above
+    int timingPriority;
+    int busPriority;
+    // bit i allows CPU i, 0 leaves the threads unpinned
+    uint64_t timingCpuMask;
+    uint64_t busCpuMask;
+    bool lockMemory;
+} FusesRealtimeConfiguration;
+
+typedef struct {
+    bool requested;
+    bool applied;
+    int ioErrno;
+} FusesRealtimeCheck;
+
+typedef struct {
+    FusesRealtimeCheck timingPriority;
+    FusesRealtimeCheck busPriority;
+    FusesRealtimeCheck timingAffinity;
+    FusesRealtimeCheck busAffinity;
+    FusesRealtimeCheck memoryLock;
+} FusesRealtimeReport;
+
 typedef struct {
     void *rawData;
     size_t rawDataSize;
-    char *busName;
+    // plays a version 2 show from this file or pipe in constant memory
+    // instead of rawData; a pipe plays forward only, jumps back fail
+    const char *streamPath;
+    // cues per read of the stream, 0 picks 4096
+    uint32_t streamChunkSize;
+    char *busName;  // bus 0 when busNames is NULL
     size_t busNameLength;
+    // i2c-dev path per bus index; every bus gets its own I/O worker
+    char **busNames;
+    size_t busCount;
+    // replaces the device table of the show: device index -> (bus, address)
+    FusesDevice *deviceMap;
+    uint32_t deviceMapSize;
+    // carries the register traffic, NULL uses the kernel i2c-dev driver;
+    // devices on a bus scanned through it are checked against the scan
+    I2cTransport *transport;
+    // ignored for compiled (version 3) shows, which carry their own
     uint16_t fuseDuration;
-    uint32_t timeResolution;
+    uint32_t timeResolution;  // only used by FUSES_LOOP_POLLING
+    enum FusesLoopMode loopMode;
+    bool measureLateness;
+    // milliseconds per bucket of the jump index, 0 jumps by binary search
+    // only; fusesInit builds it while the devices come up
+    uint32_t seekIndexResolution;
+    // events held by the trace ring, 0 records no trace
+    size_t traceCapacity;
+    FusesRealtimeConfiguration realtime;
+    // how long play, pause, stop and jump wait for the command to take
+    // effect, in microseconds, 0 picks 100 ms
+    uint32_t commandTimeout;
+    // events queued for fusesReadEvents, 0 queues none
+    size_t eventCapacity;
+    // FUSES_EVENT_MASK of the events raised, 0 raises all
+    uint32_t eventMask;
+    FusesEventCallback eventCallback;
+    void *eventCallbackContext;
+    // in microseconds, 0 picks FUSES_DEFAULT_LATE_CUE_THRESHOLD
+    uint32_t lateCueThreshold;
+    // injected cues pending at once, 0 disables fusesInjectCues
+    size_t injectionCapacity;
+    // time source of the player, NULL uses CLOCK_MONOTONIC; a virtual
+    // clock (src/virtualClock.h) plays a show faster than real time
+    ClockSource *clock;
+    // milliseconds one device may take to come up, 0 picks
+    // FUSES_DEFAULT_DEVICE_TIMEOUT; see FusesStartupReport
+    uint32_t deviceTimeout;
+    // reads every written register back in idle slots of its bus, after
+    // the writes waiting for it; a register that does not read back as
+    // written raises FUSES_EVENT_VERIFY_MISMATCH and is written again
+    bool verifyWrites;
 } FusesConfiguration;
 
+/**
+ * @brief Where fusesInit spent its time, in nanoseconds of CLOCK_MONOTONIC.
+ *
+ * The devices come up in parallel, one thread per bus, while the calling
+ * thread validates the show, so parse and device probe overlap and add up
+ * to more than total. fusesInit gives up on a device that takes longer
+ * than deviceTimeout and fails with FUSES_ERROR_DEVICE_TIMED_OUT; the
+ * device is left to its thread, and fusesDestroy waits for that thread
+ * to finish, so the transport can be destroyed once fusesDestroy returns.
+*/
+typedef struct {
+    // loading and validating the show, building the seek index
+    uint64_t parseTime;
+    // bringing up every device: open, probe and reading its registers
+    uint64_t deviceProbeTime;
+    // bus workers, the timing thread and the remaining setup
+    uint64_t threadStartTime;
+    uint64_t totalTime;
+    uint32_t deviceCount;
+    uint32_t slowestDeviceIndex;
+    uint64_t slowestDeviceTime;
+    // FUSES_TRACE_NO_DEVICE unless a device timed out
+    uint32_t timedOutDeviceIndex;
+} FusesStartupReport;
+
+typedef struct {
+    // register reads saved by the shadow copy of the fuse registers
+    uint64_t registerReadsAvoided;
+    // reloads of the shadow copy at startup, on demand and after errors
+    uint64_t registerResyncs;
+    // ignite and extinguish edges and the register writes they were merged into
+    uint64_t fuseEdges;
+    uint64_t registerWrites;
+    // rewrites of all registers of a device after a failed or rejected write
+    uint64_t registerRepairs;
+    // trace events lost because the ring was full
+    uint64_t traceEventsDropped;
+    // events not queued because the event queue was full
+    uint64_t eventsDropped;
+    // chunks read by a streamed show and how often the timing thread had
+    // to wait for one
+    uint64_t streamChunksRead;
+    uint64_t streamStalls;
+    // a read error, invalid cue or jump back in a pipe ended the show early
+    bool streamFailed;
+    // injected cues fired, and cancelled or dropped by a stop or jump
+    uint64_t injectedCuesFired;
+    uint64_t injectedCuesCancelled;
+    // readbacks of verifyWrites, those that differed from the write and
+    // those that failed on the bus
+    uint64_t verifications;
+    uint64_t verificationMismatches;
+    uint64_t failedVerifications;
+} FusesStatistics;
+
+// Ignite lateness in microseconds, recorded when measureLateness is set
+typedef struct {
+    size_t count;
+    int32_t minimum;
+    int32_t median;
+    int32_t p90;
+    int32_t p99;
+    int32_t p999;
+    int32_t maximum;
+} FusesLatenessReport;
+
 typedef void* FusesObject;
 
+/**
+ * @brief Maps a show file read-only into rawData/rawDataSize of the configuration.
+ *
+ * The header and table bounds are validated in place and version 2 and 3
+ * cues and write plans are later used by fusesInit without a copy. With lockMemory the mapping
+ * is prefaulted and mlock'ed so playback never page faults; failing to
+ * lock is reported as a warning and the mapping is still usable.
+ * The mapping has to outlive the FusesObject created from it.
+*/
+bool fusesMapShow(FusesConfiguration *configuration, char *path, bool lockMemory, FusesError *error);
+void fusesUnmapShow(FusesConfiguration *configuration);
+
 FusesObject * fusesInit(FusesConfiguration *configuration);
 void fusesDestroy(FusesObject *self);
 
@@ -56,12 +343,60 @@ bool fusesPlay(FusesObject *self, pthread_barrier_t *barrier);
 bool fusesPause(FusesObject *self, pthread_barrier_t *barrier);
 void fusesStop(FusesObject *self, pthread_barrier_t *barrier);
 void fusesJump(FusesObject *self, pthread_barrier_t *barrier, uint32_t milliseconds);
+void fusesJumpMicroseconds(FusesObject *self, pthread_barrier_t *barrier, uint64_t microseconds);
+
+// fire-and-forget from any thread, false when the command queue is full;
+// ticket may be NULL
+bool fusesPostCommand(
+    FusesObject *self, enum FusesCommandType type, uint32_t milliseconds, FusesCommandTicket *ticket
+);
+// true once the command of ticket has taken effect, false after timeout microseconds
+bool fusesWaitCommand(FusesObject *self, FusesCommandTicket ticket, uint32_t timeout);
 
+// any thread, returns how many of the cues were queued: stops at a cue
+// for an unknown device or fuse and once injectionCapacity cues are
+// pending; ids may be NULL
+size_t fusesInjectCues(FusesObject *self, const FusesInjectedCue *cues, size_t count, FusesCueId *ids);
+// any thread, false when the queue is full; a fired or unknown id is ignored
+bool fusesCancelCue(FusesObject *self, FusesCueId id);
+
+// readable while events are queued, -1 without an event queue
+int fusesGetEventFileDescriptor(FusesObject *self);
+// moves up to capacity events out of the queue, oldest first; one reader at a time
+size_t fusesReadEvents(FusesObject *self, FusesEvent *events, size_t capacity);
+const char * fusesGetEventName(uint8_t type);
+
+uint32_t fusesGetCueCount(FusesObject *self);
+// first cue at or after milliseconds, fusesGetCueCount() past the end
+uint32_t fusesGetNextCueIndex(FusesObject *self, uint32_t milliseconds);
 bool fusesGetIsPlaying(FusesObject *self);
 bool fusesGetIsPaused(FusesObject *self);
+// show time in milliseconds
 uint32_t fusesGetCurrentTime(FusesObject *self);
+// show time in microseconds, the engine keeps it in nanoseconds
+uint64_t fusesGetCurrentTimeMicroseconds(FusesObject *self);
+// UINT32_MAX for a show streamed from a pipe, whose end is not known yet
 uint32_t fusesGetTotalDuration(FusesObject *self);
 
+// reads the fuse registers back from the boards, cues keep firing meanwhile
+void fusesResyncRegisters(FusesObject *self);
+FusesStatistics fusesGetStatistics(FusesObject *self);
+uint32_t fusesGetBusCount(FusesObject *self);
+// queue depth and per-write service time of one bus worker
+BusWorkerStatistics fusesGetBusStatistics(FusesObject *self, uint32_t busIndex);
+FusesLatenessReport fusesGetLatenessReport(FusesObject *self);
+// which real-time settings were requested and which could be applied
+FusesRealtimeReport fusesGetRealtimeReport(FusesObject *self);
+// also after fusesInit failed
+FusesStartupReport fusesGetStartupReport(FusesObject *self);
+// prints every requested setting that could not be applied, returns their count
+int fusesPrintRealtimeReport(FusesObject *self, FILE *file);
+
+// while disabled the player records no trace events
+void fusesSetTraceEnabled(FusesObject *self, bool enabled);
+// moves up to capacity trace events out of the ring, one caller at a time
+size_t fusesDrainTrace(FusesObject *self, FusesTraceEvent *events, size_t capacity);
+
 FusesError * fusesGetError(FusesObject *self);
 char * fusesGetErrorString(FusesError *error);
 
@@ -0,0 +1,144 @@
+#ifndef __FUSES_FORMAT_H__
+#define __FUSES_FORMAT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief On-disk layouts of show files.
+ *
+ * Version 1 ("FUSE"): FusesHeader followed by dataItemCount FusesDataItem.
+ * Timestamps are milliseconds, cues address device i2cDeviceIndex of
+ * i2cDeviceIndexMask, at most 255 cues and 16 devices on one bus.
+ *
+ * Version 2 ("FUS2"): FusesHeaderV2, deviceCount FusesDevice entries,
+ * padding up to cueOffset, then dataItemCount FusesCue sorted by timestamp.
+ * All fields are little endian and naturally aligned so the cue array
+ * can be used in place. Timestamps are nanoseconds since the show start.
+ *
+ * Version 3 ("FUS3") is a compiled show: FusesHeaderV3, the device table
+ * and the cues as in version 2, the cues sorted by (timestamp, device,
+ * fuse), then writeCount FusesWrite at writeOffset. The writes are the
+ * register traffic of the show played from the start, ignite and
+ * extinguish edges merged per register and sorted by (timestamp, device,
+ * register), so the n-th fuse switched on by the writes is cue n.
+*/
+
+#define FUSES_MAGIC_SIZE (4)
+#define FUSES_V1_MAGIC ((uint8_t[FUSES_MAGIC_SIZE]){'F', 'U', 'S', 'E'})
+#define FUSES_V2_MAGIC ((uint8_t[FUSES_MAGIC_SIZE]){'F', 'U', 'S', '2'})
+#define FUSES_V3_MAGIC ((uint8_t[FUSES_MAGIC_SIZE]){'F', 'U', 'S', '3'})
+#define FUSES_FORMAT_VERSION_2 (2)
+#define FUSES_FORMAT_VERSION_3 (3)
+#define FUSES_CUE_ALIGNMENT (16)
+
+// fuse boards: 16 fuses in 4 registers from 0x14, 2 bits per fuse
+#define FUSES_FUSE_COUNT_PER_DEVICE (16)
+#define FUSES_FUSES_PER_REGISTER (4)
+#define FUSES_REGISTER_COUNT (FUSES_FUSE_COUNT_PER_DEVICE / FUSES_FUSES_PER_REGISTER)
+#define FUSES_REGISTER_BASE_ADDRESS (0x14)
+#define FUSES_FUSE_MASK (0b11)
+
+typedef struct __attribute__((packed)) {
+    uint8_t fusesMagic[4];
+    uint8_t dataItemCount;
+    uint16_t i2cDeviceIndexMask;
+} FusesHeader;
+
+typedef struct __attribute__((packed)) {
+    uint32_t timestamp;
+    uint8_t i2cDeviceIndex;
+    uint8_t fuseIndex;
+    uint8_t __align[2];
+} FusesDataItem;
+
+typedef struct {
+    uint8_t fusesMagic[4];
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t deviceCount;
+    uint32_t dataItemCount;
+    uint64_t cueOffset;
+    // CRC-32 of all header bytes before this field
+    uint32_t headerChecksum;
+    uint32_t __reserved;
+} FusesHeaderV2;
+
+typedef struct {
+    // index into the bus list of the configuration
+    uint8_t busIndex;
+    // 7 bit i2c address
+    uint8_t deviceAddress;
+    uint8_t __reserved[2];
+} FusesDevice;
+
+typedef struct {
+    uint64_t timestamp;
+    // index into the device table
+    uint32_t i2cDeviceIndex;
+    uint8_t fuseIndex;
+    uint8_t __reserved[3];
+} FusesCue;
+
+typedef struct {
+    uint8_t fusesMagic[4];
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t deviceCount;
+    uint32_t dataItemCount;
+    uint64_t cueOffset;
+    uint64_t writeOffset;
+    uint32_t writeCount;
+    // milliseconds every fuse is lit, the extinguish edges are compiled in
+    uint16_t fuseDuration;
+    uint16_t __reserved;
+    // CRC-32 of all header bytes before this field
+    uint32_t headerChecksum;
+    uint32_t __reserved2;
+} FusesHeaderV3;
+
+typedef struct {
+    uint64_t timestamp;
+    uint16_t i2cDeviceIndex;
+    uint8_t registerAddress;
+    // register value when the show plays through from the start
+    uint8_t value;
+    // fuse bits switched on and off by this write
+    uint8_t setMask;
+    uint8_t clearMask;
+    uint8_t __reserved[2];
+} FusesWrite;
+
+_Static_assert(sizeof(FusesHeaderV2) == 32, "FusesHeaderV2 layout changed");
+_Static_assert(sizeof(FusesHeaderV3) == 48, "FusesHeaderV3 layout changed");
+_Static_assert(sizeof(FusesWrite) == FUSES_CUE_ALIGNMENT, "FusesWrite layout changed");
+_Static_assert(sizeof(FusesDevice) == 4, "FusesDevice layout changed");
+_Static_assert(sizeof(FusesCue) == FUSES_CUE_ALIGNMENT, "FusesCue layout changed");
+
+#define FUSES_HEADER_V2_CHECKSUM_SIZE (offsetof(FusesHeaderV2, headerChecksum))
+#define FUSES_HEADER_V3_CHECKSUM_SIZE (offsetof(FusesHeaderV3, headerChecksum))
+
+static inline size_t fusesFormatCueOffset(uint32_t deviceCount) {
+    size_t offset = sizeof(FusesHeaderV2) + deviceCount * sizeof(FusesDevice);
+    return (offset + FUSES_CUE_ALIGNMENT - 1) / FUSES_CUE_ALIGNMENT * FUSES_CUE_ALIGNMENT;
+}
+
+static inline size_t fusesFormatCueOffsetV3(uint32_t deviceCount) {
+    size_t offset = sizeof(FusesHeaderV3) + deviceCount * sizeof(FusesDevice);
+    return (offset + FUSES_CUE_ALIGNMENT - 1) / FUSES_CUE_ALIGNMENT * FUSES_CUE_ALIGNMENT;
+}
+
+// CRC-32 (IEEE 802.3), bitwise since it only covers the header
+static inline uint32_t fusesFormatChecksum(const void *data, size_t size) {
+    const uint8_t *bytes = (const uint8_t*)data;
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+#endif // __FUSES_FORMAT_H__
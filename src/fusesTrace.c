@@ -0,0 +1,239 @@
+#include "fusesTrace.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t Bool8;
+
+#define CACHE_LINE_SIZE (64)
+#define TRACE_MAGIC_SIZE (4)
+#define TRACE_MAGIC ((uint8_t[TRACE_MAGIC_SIZE]){'F', 'T', 'R', 'C'})
+
+// sequence == position: free for the producer claiming position,
+// sequence == position + 1: holds the event of position
+typedef struct {
+    size_t sequence;
+    FusesTraceEvent event;
+} _Slot;
+
+typedef struct {
+    // claimed by producers
+    size_t tail __attribute__((aligned(CACHE_LINE_SIZE)));
+    uint64_t dropped;
+
+    // owned by the draining thread
+    size_t head __attribute__((aligned(CACHE_LINE_SIZE)));
+
+    _Slot *slots __attribute__((aligned(CACHE_LINE_SIZE)));
+    size_t mask;
+    Bool8 enabled;
+    ClockSource *clock;
+} _FusesTrace;
+
+FusesTrace * fusesTraceInit(size_t capacity) {
+    return fusesTraceInitWithClock(capacity, NULL);
+}
+
+FusesTrace * fusesTraceInitWithClock(size_t capacity, ClockSource *clock) {
+    _FusesTrace *_self = NULL;
+    if (posix_memalign((void**)&_self, CACHE_LINE_SIZE, sizeof(_FusesTrace)) != 0) { return NULL; }
+    memset(_self, 0, sizeof(_FusesTrace));
+
+    size_t roundedCapacity = 1;
+    while (roundedCapacity < capacity) {
+        roundedCapacity <<= 1;
+    }
+    _self->slots = (_Slot*)calloc(roundedCapacity, sizeof(_Slot));
+    if (_self->slots == NULL) {
+        free(_self);
+        return NULL;
+    }
+    for (size_t i = 0; i < roundedCapacity; ++i) {
+        _self->slots[i].sequence = i;
+    }
+    _self->mask = roundedCapacity - 1;
+    _self->enabled = true;
+    _self->clock = clock != NULL ? clock : clockSourceGetMonotonic();
+    return (FusesTrace*)_self;
+}
+
+void fusesTraceDestroy(FusesTrace *self) {
+    _FusesTrace *_self = (_FusesTrace*)self;
+    free(_self->slots);
+    free(_self);
+}
+
+void fusesTraceSetEnabled(FusesTrace *self, bool enabled) {
+    _FusesTrace *_self = (_FusesTrace*)self;
+    __atomic_store_n(&_self->enabled, enabled, __ATOMIC_RELAXED);
+}
+
+bool fusesTraceGetEnabled(FusesTrace *self) {
+    _FusesTrace *_self = (_FusesTrace*)self;
+    return __atomic_load_n(&_self->enabled, __ATOMIC_RELAXED);
+}
+
+bool fusesTraceRecord(FusesTrace *self, FusesTraceEvent *event) {
+    _FusesTrace *_self = (_FusesTrace*)self;
+    if (!__atomic_load_n(&_self->enabled, __ATOMIC_RELAXED)) { return false; }
+    event->timestamp = _self->clock->now(_self->clock);
+
+    size_t position = __atomic_load_n(&_self->tail, __ATOMIC_RELAXED);
+    _Slot *slot;
+    while (true) {
+        slot = &_self->slots[position & _self->mask];
+        size_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+        if (difference == 0) {
+            if (__atomic_compare_exchange_n(
+                &_self->tail, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED
+            )) {
+                break;
+            }
+        } else if (difference < 0) {
+            // The slot still holds an event from one lap ago: full.
+            __atomic_fetch_add(&_self->dropped, 1, __ATOMIC_RELAXED);
+            return false;
+        } else {
+            position = __atomic_load_n(&_self->tail, __ATOMIC_RELAXED);
+        }
+    }
+    slot->event = *event;
+    __atomic_store_n(&slot->sequence, position + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+size_t fusesTraceDrain(FusesTrace *self, FusesTraceEvent *events, size_t capacity) {
+    _FusesTrace *_self = (_FusesTrace*)self;
+    size_t count = 0;
+    while (count < capacity) {
+        _Slot *slot = &_self->slots[_self->head & _self->mask];
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != _self->head + 1) { break; }
+        events[count++] = slot->event;
+        __atomic_store_n(&slot->sequence, _self->head + _self->mask + 1, __ATOMIC_RELEASE);
+        ++(_self->head);
+    }
+    return count;
+}
+
+uint64_t fusesTraceGetDropped(FusesTrace *self) {
+    _FusesTrace *_self = (_FusesTrace*)self;
+    return __atomic_load_n(&_self->dropped, __ATOMIC_RELAXED);
+}
+
+bool fusesTraceWriteHeader(FILE *file) {
+    uint32_t eventSize = sizeof(FusesTraceEvent);
+    return fwrite(TRACE_MAGIC, TRACE_MAGIC_SIZE, 1, file) == 1
+        && fwrite(&eventSize, sizeof(eventSize), 1, file) == 1;
+}
+
+bool fusesTraceReadHeader(FILE *file) {
+    uint8_t magic[TRACE_MAGIC_SIZE];
+    uint32_t eventSize;
+    return fread(magic, TRACE_MAGIC_SIZE, 1, file) == 1
+        && memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_SIZE) == 0
+        && fread(&eventSize, sizeof(eventSize), 1, file) == 1
+        && eventSize == sizeof(FusesTraceEvent);
+}
+
+const char * fusesTraceGetEventName(uint8_t type) {
+    switch (type) {
+        case FUSES_TRACE_CUE_IGNITED:
+            return "ignite";
+        case FUSES_TRACE_FUSE_EXTINGUISHED:
+            return "extinguish";
+        case FUSES_TRACE_WRITE_ISSUED:
+            return "writeIssued";
+        case FUSES_TRACE_WRITE_COMPLETED:
+            return "writeCompleted";
+        case FUSES_TRACE_COMMAND:
+            return "command";
+        case FUSES_TRACE_I2C_ERROR:
+            return "i2cError";
+        case FUSES_TRACE_VERIFY_MISMATCH:
+            return "verifyMismatch";
+        default:
+            return "unknown";
+    }
+}
+
+const char * fusesTraceGetCommandName(uint8_t command) {
+    switch (command) {
+        case FUSES_TRACE_COMMAND_PLAY:
+            return "play";
+        case FUSES_TRACE_COMMAND_PAUSE:
+            return "pause";
+        case FUSES_TRACE_COMMAND_STOP:
+            return "stop";
+        case FUSES_TRACE_COMMAND_JUMP:
+            return "jump";
+        default:
+            return "unknown";
+    }
+}
+
+void fusesTracePrint(FILE *file, const FusesTraceEvent *event, uint64_t origin) {
+    fprintf(
+        file, "%14.6f %-15s", (double)(int64_t)(event->timestamp - origin) / 1e6,
+        fusesTraceGetEventName(event->type)
+    );
+    switch (event->type) {
+        case FUSES_TRACE_CUE_IGNITED:
+            fprintf(
+                file, " cue %u device %u fuse %u at %u ms",
+                event->cueIndex, event->i2cDeviceIndex, event->value, event->argument
+            );
+            break;
+        case FUSES_TRACE_FUSE_EXTINGUISHED:
+            fprintf(file, " cue %u device %u fuse %u", event->cueIndex, event->i2cDeviceIndex, event->value);
+            break;
+        case FUSES_TRACE_WRITE_ISSUED:
+        case FUSES_TRACE_WRITE_COMPLETED:
+            fprintf(
+                file, " device %u register 0x%02x = 0x%02x",
+                event->i2cDeviceIndex, event->registerAddress, event->value
+            );
+            break;
+        case FUSES_TRACE_COMMAND:
+            fprintf(file, " %s", fusesTraceGetCommandName(event->command));
+            if (event->command == FUSES_TRACE_COMMAND_JUMP) {
+                fprintf(file, " to %u ms", event->argument);
+            }
+            break;
+        case FUSES_TRACE_I2C_ERROR:
+            fprintf(
+                file, " device %u register 0x%02x: %s",
+                event->i2cDeviceIndex, event->registerAddress, strerror((int)event->argument)
+            );
+            break;
+        case FUSES_TRACE_VERIFY_MISMATCH:
+            fprintf(
+                file, " cue %u device %u register 0x%02x written 0x%02x read 0x%02x",
+                event->cueIndex, event->i2cDeviceIndex, event->registerAddress, event->argument, event->value
+            );
+            break;
+    }
+    fprintf(file, "\n");
+}
+
+void fusesTracePrintCsvHeader(FILE *file) {
+    fprintf(file, "timestamp,event,cue,device,register,value,command,argument\n");
+}
+
+void fusesTracePrintCsv(FILE *file, const FusesTraceEvent *event) {
+    fprintf(file, "%llu,%s,", (unsigned long long)event->timestamp, fusesTraceGetEventName(event->type));
+    if (event->cueIndex != FUSES_TRACE_NO_CUE) {
+        fprintf(file, "%u", event->cueIndex);
+    }
+    fprintf(file, ",");
+    if (event->i2cDeviceIndex != FUSES_TRACE_NO_DEVICE) {
+        fprintf(file, "%u,0x%02x,0x%02x", event->i2cDeviceIndex, event->registerAddress, event->value);
+    } else {
+        fprintf(file, ",,");
+    }
+    fprintf(
+        file, ",%s,%u\n",
+        event->type == FUSES_TRACE_COMMAND ? fusesTraceGetCommandName(event->command) : "",
+        event->argument
+    );
+}
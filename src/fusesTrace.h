@@ -0,0 +1,100 @@
+#ifndef __FUSES_TRACE_H__
+#define __FUSES_TRACE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "clockSource.h"
+
+/**
+ * @brief Preallocated lock-free ring of fixed size binary trace events.
+ *
+ * Any thread may record; a slot is claimed with one compare-and-swap and
+ * recording never blocks, allocates or touches stdio. When the ring is
+ * full the event is dropped and counted. One thread at a time drains the
+ * ring, during or after a show. Building with FUSES_TRACE_ENABLED=0
+ * (make TRACE=0) compiles the recording calls of the player out.
+*/
+
+#ifndef FUSES_TRACE_ENABLED
+#define FUSES_TRACE_ENABLED (1)
+#endif
+
+#define FUSES_TRACE_NO_CUE (UINT32_MAX)
+#define FUSES_TRACE_NO_DEVICE (UINT16_MAX)
+
+enum FusesTraceEventType {
+    // ignite edge of cueIndex queued, argument is the cue's show time in ms
+    FUSES_TRACE_CUE_IGNITED,
+    // extinguish edge of cueIndex queued
+    FUSES_TRACE_FUSE_EXTINGUISHED,
+    // register write handed to the bus worker
+    FUSES_TRACE_WRITE_ISSUED,
+    // register write performed by the bus worker
+    FUSES_TRACE_WRITE_COMPLETED,
+    // command applied by the main loop (stop also ends a show), argument
+    // is the jump target in ms
+    FUSES_TRACE_COMMAND,
+    // register write failed, argument is errno
+    FUSES_TRACE_I2C_ERROR,
+    // readback of a written register differed, value is the value read,
+    // argument the value written, cueIndex the cue of the first wrong fuse
+    FUSES_TRACE_VERIFY_MISMATCH,
+    FUSES_TRACE_EVENT_TYPE_COUNT
+};
+
+enum FusesTraceCommand {
+    FUSES_TRACE_COMMAND_PLAY,
+    FUSES_TRACE_COMMAND_PAUSE,
+    FUSES_TRACE_COMMAND_STOP,
+    FUSES_TRACE_COMMAND_JUMP
+};
+
+typedef struct {
+    // time of the trace's clock, CLOCK_MONOTONIC by default, in nanoseconds
+    uint64_t timestamp;
+    uint32_t cueIndex;
+    uint32_t argument;
+    uint16_t i2cDeviceIndex;
+    uint8_t type;
+    // FusesTraceCommand for FUSES_TRACE_COMMAND
+    uint8_t command;
+    uint8_t registerAddress;
+    // register value, the fuse index for ignite and extinguish events
+    uint8_t value;
+    uint8_t __reserved[2];
+} FusesTraceEvent;
+
+_Static_assert(sizeof(FusesTraceEvent) == 24, "FusesTraceEvent layout changed");
+
+typedef void* FusesTrace;
+
+FusesTrace * fusesTraceInit(size_t capacity);
+// events are stamped by clock, NULL selects CLOCK_MONOTONIC
+FusesTrace * fusesTraceInitWithClock(size_t capacity, ClockSource *clock);
+void fusesTraceDestroy(FusesTrace *self);
+
+void fusesTraceSetEnabled(FusesTrace *self, bool enabled);
+bool fusesTraceGetEnabled(FusesTrace *self);
+// stamps the event with the current time, false when disabled or full
+bool fusesTraceRecord(FusesTrace *self, FusesTraceEvent *event);
+// moves up to capacity events out of the ring, oldest first
+size_t fusesTraceDrain(FusesTrace *self, FusesTraceEvent *events, size_t capacity);
+uint64_t fusesTraceGetDropped(FusesTrace *self);
+
+/**
+ * @brief Trace files are a magic, the event size and the events as recorded.
+*/
+bool fusesTraceWriteHeader(FILE *file);
+bool fusesTraceReadHeader(FILE *file);
+
+const char * fusesTraceGetEventName(uint8_t type);
+const char * fusesTraceGetCommandName(uint8_t command);
+// one line per event, times relative to origin
+void fusesTracePrint(FILE *file, const FusesTraceEvent *event, uint64_t origin);
+void fusesTracePrintCsvHeader(FILE *file);
+void fusesTracePrintCsv(FILE *file, const FusesTraceEvent *event);
+
+#endif // __FUSES_TRACE_H__
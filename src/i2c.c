@@ -5,57 +5,235 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <linux/i2c-dev.h>
+#include <linux/i2c.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
 
 
 typedef uint8_t Bool8;
 
 #define DEFAULT_BUS_NAME ("/dev/i2c-1")
 
-#define WRITE_REQUEST_SIZE (2)
-#define READ_REQUEST_SIZE (1)
-#define READ_SIZE (1)
 #define IO_ERROR (-1)
-#define FIRST_I2C_MSB (0b0001)
-#define LAST_I2C_MSB (0b1110)
+#define NO_DEVICE_SELECTED (-1)
+#define NANOSECONDS_PER_SECOND (1000000000)
+#define RECONNECT_ATTEMPTS (1)
+#define REGISTER_ADDRESS_SIZE (1)
+
+/**
+ * @brief A bus opened through a transport and shared by every device on it.
+ *
+ * Buses are reference counted and live in a process wide list keyed by
+ * name and transport, so devices on the same /dev/i2c-N reuse one handle.
+ * The lock serializes all transactions on the bus.
+*/
+typedef struct _I2cBus {
+    char *busName;
+    I2cTransport *transport;
+    void *handle;
+    size_t referenceCount;
+    pthread_mutex_t lock;
+    struct _I2cBus *next;
+} _I2cBus;
 
 typedef struct {
     char *busName;
     uint8_t deviceAddress;
     Bool8 busNameSetByUser;
+    _I2cBus *bus;
     I2cError *error;
 } _I2cDevice;
 
-int _openBus(char *busName, uint8_t deviceAddress, I2cError *error) {
-    int fileDescriptor = open(busName, O_RDWR);
-    if (fileDescriptor == IO_ERROR) {
-        error->type = I2C_ERROR_IO_ERROR;
-        error->level = I2C_ERROR_LEVEL_ERROR;
-        error->ioErrno = errno;
-        return IO_ERROR;
-    }
-    if (ioctl(fileDescriptor, I2C_SLAVE, deviceAddress) == IO_ERROR) {
-        error->type = I2C_ERROR_IO_ERROR;
-        error->level = I2C_ERROR_LEVEL_ERROR;
-        error->ioErrno = errno;
-        close(fileDescriptor);
-        return IO_ERROR;
-    }
-    return fileDescriptor;
+/**
+ * @brief State of the kernel transport for one open /dev/i2c-N.
+ *
+ * Adapters that support plain i2c transfers get every transaction as a
+ * single I2C_RDWR ioctl; others fall back to read()/write() and only
+ * change the slave address with ioctl(I2C_SLAVE) when a different device
+ * is addressed.
+*/
+typedef struct {
+    int fileDescriptor;
+    Bool8 combinedTransfers;
+    Bool8 quickWrite;
+    Bool8 readByte;
+    int selectedAddress;
+} _KernelBus;
+
+typedef struct _ScanCacheEntry {
+    char *busName;
+    I2cTransport *transport;
+    I2cScanResult result;
+    struct _ScanCacheEntry *next;
+} _ScanCacheEntry;
+
+typedef struct {
+    const char *busName;
+    I2cTransport *transport;
+    I2cScanResult *result;
+} _ScanJob;
+
+static _I2cBus *_buses = NULL;
+static pthread_mutex_t _busesLock = PTHREAD_MUTEX_INITIALIZER;
+static _ScanCacheEntry *_scanCache = NULL;
+static pthread_mutex_t _scanCacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t _getCurrentTimeNanoseconds(void) {
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    return (uint64_t)currentTime.tv_sec * NANOSECONDS_PER_SECOND + currentTime.tv_nsec;
 }
 
 void _closeBus(int fileDescriptor) {
     close(fileDescriptor);
 }
 
-void _resetError(_I2cDevice *_self) {
+static void _kernelQueryFunctionality(_KernelBus *bus) {
+    unsigned long functionality = 0;
+    if (ioctl(bus->fileDescriptor, I2C_FUNCS, &functionality) == IO_ERROR) {
+        functionality = 0;
+    }
+    bus->combinedTransfers = (functionality & I2C_FUNC_I2C) != 0;
+    bus->quickWrite = (functionality & I2C_FUNC_SMBUS_QUICK) != 0;
+    bus->readByte = (functionality & I2C_FUNC_SMBUS_READ_BYTE) != 0;
+}
+
+static void * _kernelOpen(I2cTransport *self, const char *busName) {
+    _KernelBus *bus = (_KernelBus*)malloc(sizeof(_KernelBus));
+    if (bus == NULL) { return NULL; }
+    bus->fileDescriptor = open(busName, O_RDWR);
+    bus->selectedAddress = NO_DEVICE_SELECTED;
+    if (bus->fileDescriptor == IO_ERROR) {
+        int openErrno = errno;
+        free(bus);
+        errno = openErrno;
+        return NULL;
+    }
+    _kernelQueryFunctionality(bus);
+    return bus;
+}
+
+static void _kernelClose(I2cTransport *self, void *handle) {
+    _KernelBus *bus = (_KernelBus*)handle;
+    _closeBus(bus->fileDescriptor);
+    free(bus);
+}
+
+static bool _kernelReopen(I2cTransport *self, void *handle, const char *busName) {
+    _KernelBus *bus = (_KernelBus*)handle;
+    _closeBus(bus->fileDescriptor);
+    bus->selectedAddress = NO_DEVICE_SELECTED;
+    bus->fileDescriptor = open(busName, O_RDWR);
+    if (bus->fileDescriptor == IO_ERROR) { return false; }
+    _kernelQueryFunctionality(bus);
+    return true;
+}
+
+static bool _kernelSelect(_KernelBus *bus, uint8_t address) {
+    if (bus->selectedAddress == address) { return true; }
+    if (ioctl(bus->fileDescriptor, I2C_SLAVE, address) == IO_ERROR) {
+        bus->selectedAddress = NO_DEVICE_SELECTED;
+        return false;
+    }
+    bus->selectedAddress = address;
+    return true;
+}
+
+static bool _kernelTransfer(
+    I2cTransport *self, void *handle, uint8_t address, I2cMessage *messages, size_t messageCount
+) {
+    _KernelBus *bus = (_KernelBus*)handle;
+    if (bus->combinedTransfers) {
+        struct i2c_msg kernelMessages[I2C_MAX_MESSAGES];
+        for (size_t i = 0; i < messageCount; ++i) {
+            kernelMessages[i].addr = address;
+            kernelMessages[i].flags = messages[i].read ? I2C_M_RD : 0;
+            kernelMessages[i].len = messages[i].length;
+            kernelMessages[i].buf = messages[i].buffer;
+        }
+        struct i2c_rdwr_ioctl_data transaction = {
+            .msgs = kernelMessages,
+            .nmsgs = messageCount
+        };
+        return ioctl(bus->fileDescriptor, I2C_RDWR, &transaction) != IO_ERROR;
+    }
+
+    if (!_kernelSelect(bus, address)) { return false; }
+    for (size_t i = 0; i < messageCount; ++i) {
+        ssize_t result = messages[i].read
+            ? read(bus->fileDescriptor, messages[i].buffer, messages[i].length)
+            : write(bus->fileDescriptor, messages[i].buffer, messages[i].length);
+        if (result == IO_ERROR) { return false; }
+    }
+    return true;
+}
+
+/**
+ * @brief Like i2cdetect, EEPROMs are probed with a read; some take a quick
+ * write for the start of a write and lock up or corrupt data.
+*/
+static bool _isReadProbeAddress(uint8_t address) {
+    return (address >= 0x30 && address <= 0x37) || (address >= 0x50 && address <= 0x5F);
+}
+
+static bool _kernelSmbus(_KernelBus *bus, uint8_t readWrite, uint32_t size, union i2c_smbus_data *data) {
+    struct i2c_smbus_ioctl_data transaction = {
+        .read_write = readWrite,
+        .command = 0,
+        .size = size,
+        .data = data
+    };
+    return ioctl(bus->fileDescriptor, I2C_SMBUS, &transaction) != IO_ERROR;
+}
+
+static bool _kernelProbe(I2cTransport *self, void *handle, uint8_t address) {
+    _KernelBus *bus = (_KernelBus*)handle;
+    bus->selectedAddress = NO_DEVICE_SELECTED;
+    if (!_kernelSelect(bus, address)) { return false; }
+    if (bus->readByte && (!bus->quickWrite || _isReadProbeAddress(address))) {
+        union i2c_smbus_data data;
+        return _kernelSmbus(bus, I2C_SMBUS_READ, I2C_SMBUS_BYTE, &data);
+    }
+    if (bus->quickWrite) {
+        return _kernelSmbus(bus, I2C_SMBUS_WRITE, I2C_SMBUS_QUICK, NULL);
+    }
+    // Without SMBus transactions an empty write has the same effect.
+    if (!bus->combinedTransfers) {
+        // Not even that, or I2C_FUNCS failed: nothing can tell presence.
+        errno = EOPNOTSUPP;
+        return false;
+    }
+    I2cMessage message = { .buffer = NULL, .length = 0, .read = false };
+    return _kernelTransfer(self, handle, address, &message, 1);
+}
+
+static I2cTransport _kernelTransport = {
+    .open = _kernelOpen,
+    .close = _kernelClose,
+    .transfer = _kernelTransfer,
+    .probe = _kernelProbe,
+    .reopen = _kernelReopen
+};
+
+I2cTransport * i2cGetKernelTransport(void) {
+    return &_kernelTransport;
+}
+
+static void _resetError(_I2cDevice *_self) {
     _self->error->type = I2C_ERROR_NO_ERROR;
     _self->error->level = I2C_ERROR_LEVEL_INFO;
     _self->error->ioErrno = 0;
 }
 
-char * _busName(char *busName, size_t busNameLength, bool *busNameSetByUser, I2cError *error) {
+void _setIoError(I2cError *error) {
+    error->type = I2C_ERROR_IO_ERROR;
+    error->level = I2C_ERROR_LEVEL_ERROR;
+    error->ioErrno = errno;
+}
+
+char * _busName(char *busName, size_t busNameLength, Bool8 *busNameSetByUser, I2cError *error) {
     char *result;
     if (busName == NULL) {
         *busNameSetByUser = false;
@@ -71,10 +249,144 @@ char * _busName(char *busName, size_t busNameLength, bool *busNameSetByUser, I2c
         memcpy(result, busName, busNameLength);
         result[busNameLength] = '\0';
     }
+    return result;
+}
+
+bool _connectBus(_I2cBus *bus, I2cError *error) {
+    bus->handle = bus->transport->open(bus->transport, bus->busName);
+    if (bus->handle == NULL) {
+        _setIoError(error);
+        return false;
+    }
+    return true;
+}
+
+void _disconnectBus(_I2cBus *bus) {
+    if (bus->handle == NULL) { return; }
+    bus->transport->close(bus->transport, bus->handle);
+    bus->handle = NULL;
+}
+
+/**
+ * @brief Returns the shared bus for busName on the transport, opening it on first use.
+*/
+_I2cBus * _acquireBus(char *busName, I2cTransport *transport, I2cError *error) {
+    pthread_mutex_lock(&_busesLock);
+    _I2cBus *bus = _buses;
+    while (bus != NULL && (bus->transport != transport || strcmp(bus->busName, busName) != 0)) {
+        bus = bus->next;
+    }
+    if (bus != NULL) {
+        ++(bus->referenceCount);
+        pthread_mutex_unlock(&_busesLock);
+        return bus;
+    }
+
+    bus = (_I2cBus*)calloc(1, sizeof(_I2cBus));
+    if (bus == NULL || (bus->busName = strdup(busName)) == NULL) {
+        free(bus);
+        error->type = I2C_ERROR_MEMORY_ALLOCATION_FAILED;
+        error->level = I2C_ERROR_LEVEL_ERROR;
+        pthread_mutex_unlock(&_busesLock);
+        return NULL;
+    }
+    bus->transport = transport;
+    if (!_connectBus(bus, error)) {
+        free(bus->busName);
+        free(bus);
+        pthread_mutex_unlock(&_busesLock);
+        return NULL;
+    }
+    pthread_mutex_init(&bus->lock, NULL);
+    bus->referenceCount = 1;
+    bus->next = _buses;
+    _buses = bus;
+    pthread_mutex_unlock(&_busesLock);
+    return bus;
+}
+
+void _releaseBus(_I2cBus *bus) {
+    pthread_mutex_lock(&_busesLock);
+    if (--(bus->referenceCount) > 0) {
+        pthread_mutex_unlock(&_busesLock);
+        return;
+    }
+    _I2cBus **link = &_buses;
+    while (*link != bus) {
+        link = &(*link)->next;
+    }
+    *link = bus->next;
+    pthread_mutex_unlock(&_busesLock);
+
+    _disconnectBus(bus);
+    pthread_mutex_destroy(&bus->lock);
+    free(bus->busName);
+    free(bus);
+}
+
+bool _isConnectionLost(int ioErrno) {
+    return ioErrno == EBADF || ioErrno == ENODEV || ioErrno == EIO || ioErrno == ETIMEDOUT;
+}
+
+/**
+ * @brief Reopens the bus after an error that indicates a broken handle.
+ * Must hold bus->lock. Returns true if the failed transaction should be retried.
+*/
+bool _reconnectAfterError(_I2cDevice *_self) {
+    if (!_isConnectionLost(_self->error->ioErrno)) { return false; }
+    _I2cBus *bus = _self->bus;
+    if (bus->handle != NULL && bus->transport->reopen != NULL) {
+        // In place, so a reconnect during a show does not allocate.
+        // A handle that failed to reopen answers EBADF and is reopened again.
+        if (!bus->transport->reopen(bus->transport, bus->handle, bus->busName)) {
+            _setIoError(_self->error);
+            return false;
+        }
+        _resetError(_self);
+        return true;
+    }
+    _disconnectBus(bus);
+    if (!_connectBus(bus, _self->error)) { return false; }
+    _resetError(_self);
+    return true;
+}
+
+/**
+ * @brief Performs the messages as one transaction. Must hold bus->lock.
+*/
+bool _transferMessages(_I2cDevice *_self, I2cMessage *messages, size_t messageCount) {
+    _I2cBus *bus = _self->bus;
+    if (bus->handle == NULL && !_connectBus(bus, _self->error)) {
+        return false;
+    }
+    if (!bus->transport->transfer(bus->transport, bus->handle, _self->deviceAddress, messages, messageCount)) {
+        _setIoError(_self->error);
+        return false;
+    }
+    return true;
+}
+
+void _transfer(_I2cDevice *_self, I2cMessage *messages, size_t messageCount) {
+    if (_self->bus == NULL) { return; }
+    _resetError(_self);
+    if (messageCount == 0) { return; }
+    pthread_mutex_lock(&_self->bus->lock);
+    for (int attempt = 0; attempt <= RECONNECT_ATTEMPTS; ++attempt) {
+        if (_transferMessages(_self, messages, messageCount)) { break; }
+        if (attempt == RECONNECT_ATTEMPTS || !_reconnectAfterError(_self)) { break; }
+    }
+    pthread_mutex_unlock(&_self->bus->lock);
 }
 
 I2cDevice * i2cInit(char *busName, size_t busNameLength, uint8_t deviceAddress) {
-    _I2cDevice *device = (_I2cDevice*)malloc(sizeof(_I2cDevice));
+    return i2cInitWithTransport(busName, busNameLength, deviceAddress, NULL);
+}
+
+I2cDevice * i2cInitWithTransport(
+    char *busName, size_t busNameLength, uint8_t deviceAddress, I2cTransport *transport
+) {
+    // zeroed, so i2cDestroy sees no bus when the bus name cannot be set up
+    _I2cDevice *device = (_I2cDevice*)calloc(1, sizeof(_I2cDevice));
     if (device == NULL) { return NULL; }
 
     device->error = (I2cError*)malloc(sizeof(I2cError));
@@ -93,12 +405,18 @@ I2cDevice * i2cInit(char *busName, size_t busNameLength, uint8_t deviceAddress)
     }
     
     device->deviceAddress = deviceAddress;
+    device->bus = _acquireBus(
+        device->busName, transport != NULL ? transport : &_kernelTransport, device->error
+    );
 
     return (I2cDevice*)device;
 }
 
 void i2cDestroy(I2cDevice *self) {
     _I2cDevice *_self = (_I2cDevice*)self;
+    if (_self->bus != NULL) {
+        _releaseBus(_self->bus);
+    }
     if (_self->busNameSetByUser) {
         free(_self->busName);
     }
@@ -106,81 +424,284 @@ void i2cDestroy(I2cDevice *self) {
     free(_self);
 }
 
+/**
+ * @brief Probes address on an acquired bus. Must hold bus->lock.
+ * Transports without probe get an empty write. A NACK is absence, a bus
+ * that cannot probe at all (EOPNOTSUPP) is an error, so a scan fails
+ * instead of guessing.
+*/
+bool _probeAddress(_I2cBus *bus, uint8_t address, I2cError *error) {
+    if (bus->handle == NULL && !_connectBus(bus, error)) { return false; }
+    errno = 0;
+    bool present;
+    if (bus->transport->probe != NULL) {
+        present = bus->transport->probe(bus->transport, bus->handle, address);
+    } else {
+        I2cMessage message = { .buffer = NULL, .length = 0, .read = false };
+        present = bus->transport->transfer(bus->transport, bus->handle, address, &message, 1);
+    }
+    if (!present && errno == EOPNOTSUPP) {
+        _setIoError(error);
+    }
+    return present;
+}
+
+/**
+ * @brief Stores a scan without an error in the cache, replacing an older one of the bus.
+*/
+void _cacheScan(const char *busName, I2cTransport *transport, I2cScanResult *result) {
+    pthread_mutex_lock(&_scanCacheLock);
+    _ScanCacheEntry *entry = _scanCache;
+    while (entry != NULL && (entry->transport != transport || strcmp(entry->busName, busName) != 0)) {
+        entry = entry->next;
+    }
+    if (entry == NULL) {
+        entry = (_ScanCacheEntry*)malloc(sizeof(_ScanCacheEntry));
+        if (entry == NULL || (entry->busName = strdup(busName)) == NULL) {
+            // The scan stands without the cache.
+            free(entry);
+            pthread_mutex_unlock(&_scanCacheLock);
+            return;
+        }
+        entry->transport = transport;
+        entry->next = _scanCache;
+        _scanCache = entry;
+    }
+    entry->result = *result;
+    pthread_mutex_unlock(&_scanCacheLock);
+}
+
+/**
+ * @brief Probes every address of one bus, opening it once.
+*/
+void _scanBus(const char *busName, I2cTransport *transport, I2cScanResult *result) {
+    uint64_t start = _getCurrentTimeNanoseconds();
+    memset(result, 0, sizeof(I2cScanResult));
+    result->error.type = I2C_ERROR_NO_ERROR;
+    result->error.level = I2C_ERROR_LEVEL_INFO;
+
+    _I2cBus *bus = _acquireBus((char*)busName, transport, &result->error);
+    if (bus != NULL) {
+        for (uint8_t address = I2C_SCAN_FIRST_ADDRESS; address <= I2C_SCAN_LAST_ADDRESS; ++address) {
+            pthread_mutex_lock(&bus->lock);
+            bool present = _probeAddress(bus, address, &result->error);
+            pthread_mutex_unlock(&bus->lock);
+            if (result->error.level == I2C_ERROR_LEVEL_ERROR) break;
+            if (present) {
+                result->present[address] = true;
+                result->addresses[result->count++] = address;
+            }
+        }
+        _releaseBus(bus);
+    }
+    result->scanTime = _getCurrentTimeNanoseconds() - start;
+    if (result->error.level != I2C_ERROR_LEVEL_ERROR) {
+        _cacheScan(busName, transport, result);
+    }
+}
+
+static void * _scanBusThread(void *argument) {
+    _ScanJob *job = (_ScanJob*)argument;
+    _scanBus(job->busName, job->transport, job->result);
+    return NULL;
+}
+
 I2cError i2cScan(char *busName, size_t busNameLength, uint8_t *addresses, size_t *length) {
-    bool busNameSetByUser;
+    Bool8 busNameSetByUser;
     I2cError error;
     error.level = I2C_ERROR_LEVEL_INFO;
     error.type = I2C_ERROR_NO_ERROR;
     error.ioErrno = 0;
 
-    char *busName = _busName(busName, busNameLength, &busNameSetByUser, &error);
+    char *resolvedBusName = _busName(busName, busNameLength, &busNameSetByUser, &error);
     if (error.level == I2C_ERROR_LEVEL_ERROR) {
         return error;
     }
 
-    *length = 0;
+    I2cScanResult result;
+    _scanBus(resolvedBusName, &_kernelTransport, &result);
+    memcpy(addresses, result.addresses, result.count);
+    *length = result.count;
 
-    for (uint8_t msb = FIRST_I2C_MSB; msb <= LAST_I2C_MSB; ++msb) {
-        for (uint8_t lsb = 0b0000; lsb <= 0b1111; ++lsb) {
-            uint8_t address = (msb << 4) | lsb;
-            int fileDescriptor = _openBus(busName, address, &error);
-            if (fileDescriptor == IO_ERROR) { continue; }
-            _closeBus(fileDescriptor);
-            addresses[(*length)++] = address;
+    if (busNameSetByUser) {
+        free(resolvedBusName);
+    }
+
+    return result.error;
+}
+
+uint64_t i2cScanBuses(
+    const char * const *busNames, size_t busCount, I2cTransport *transport, I2cScanResult *results
+) {
+    uint64_t start = _getCurrentTimeNanoseconds();
+    if (transport == NULL) {
+        transport = &_kernelTransport;
+    }
+    _ScanJob *jobs = (_ScanJob*)calloc(busCount, sizeof(_ScanJob));
+    pthread_t *threads = (pthread_t*)calloc(busCount, sizeof(pthread_t));
+    Bool8 *started = (Bool8*)calloc(busCount, sizeof(Bool8));
+    // The first bus is scanned by the caller, the others by one thread each.
+    for (size_t i = 1; i < busCount && jobs != NULL && threads != NULL && started != NULL; ++i) {
+        jobs[i] = (_ScanJob){ .busName = busNames[i], .transport = transport, .result = &results[i] };
+        started[i] = pthread_create(&threads[i], NULL, _scanBusThread, &jobs[i]) == 0;
+    }
+    for (size_t i = 0; i < busCount; ++i) {
+        if (started == NULL || !started[i]) {
+            _scanBus(busNames[i], transport, &results[i]);
         }
     }
+    for (size_t i = 1; i < busCount && started != NULL; ++i) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+    free(jobs);
+    free(threads);
+    free(started);
+    return _getCurrentTimeNanoseconds() - start;
+}
 
-    if (busNameSetByUser) {
-        free(busName);
+bool i2cGetCachedScan(const char *busName, I2cTransport *transport, I2cScanResult *result) {
+    if (transport == NULL) {
+        transport = &_kernelTransport;
+    }
+    pthread_mutex_lock(&_scanCacheLock);
+    _ScanCacheEntry *entry = _scanCache;
+    while (entry != NULL && (entry->transport != transport || strcmp(entry->busName, busName) != 0)) {
+        entry = entry->next;
+    }
+    if (entry != NULL && result != NULL) {
+        *result = entry->result;
     }
+    pthread_mutex_unlock(&_scanCacheLock);
+    return entry != NULL;
+}
 
-    return error;
+void i2cClearScanCache(I2cTransport *transport) {
+    pthread_mutex_lock(&_scanCacheLock);
+    _ScanCacheEntry **link = &_scanCache;
+    while (*link != NULL) {
+        _ScanCacheEntry *entry = *link;
+        if (transport != NULL && entry->transport != transport) {
+            link = &entry->next;
+            continue;
+        }
+        *link = entry->next;
+        free(entry->busName);
+        free(entry);
+    }
+    pthread_mutex_unlock(&_scanCacheLock);
+}
+
+/**
+ * @brief Looks the device up in the scan of its bus. Returns false when
+ * the bus has not been scanned or the address lies outside the scan,
+ * else stores whether it answered.
+*/
+bool _lookUpScannedDevice(_I2cDevice *_self, bool *present) {
+    if (_self->deviceAddress < I2C_SCAN_FIRST_ADDRESS || _self->deviceAddress > I2C_SCAN_LAST_ADDRESS) {
+        return false;
+    }
+    pthread_mutex_lock(&_scanCacheLock);
+    _ScanCacheEntry *entry = _scanCache;
+    while (
+        entry != NULL
+        && (entry->transport != _self->bus->transport || strcmp(entry->busName, _self->busName) != 0)
+    ) {
+        entry = entry->next;
+    }
+    if (entry != NULL) {
+        *present = entry->result.present[_self->deviceAddress];
+    }
+    pthread_mutex_unlock(&_scanCacheLock);
+    return entry != NULL;
 }
 
 bool i2cTest(I2cDevice *self) {
     _I2cDevice *_self = (_I2cDevice*)self;
-    int fileDescriptor = _openBus(_self->busName, _self->deviceAddress, _self->error);
-    if (fileDescriptor == IO_ERROR) { return false; }
-    _closeBus(fileDescriptor);
-    return true;
+    if (_self->bus == NULL) { return false; }
+    _resetError(_self);
+    // The scan only rules devices out; a board may have gone since, so
+    // one it found is still probed.
+    bool present;
+    if (_lookUpScannedDevice(_self, &present) && !present) {
+        _self->error->type = I2C_ERROR_IO_ERROR;
+        _self->error->level = I2C_ERROR_LEVEL_ERROR;
+        _self->error->ioErrno = ENXIO;
+        return false;
+    }
+    pthread_mutex_lock(&_self->bus->lock);
+    // The same probe as i2cScan, so both agree on transports without one.
+    bool result = _probeAddress(_self->bus, _self->deviceAddress, _self->error);
+    if (!result && _self->error->level != I2C_ERROR_LEVEL_ERROR) {
+        _setIoError(_self->error);
+    }
+    pthread_mutex_unlock(&_self->bus->lock);
+    return result;
 }
 
 void i2cWriteByte(I2cDevice *self, uint8_t registerAddress, uint8_t value) {
+    i2cWriteBlock(self, registerAddress, &value, 1);
+}
+
+uint8_t i2cReadByte(I2cDevice *self, uint8_t registerAddress) {
+    uint8_t value = 0;
+    i2cReadBlock(self, registerAddress, &value, 1);
+    return value;
+}
+
+void i2cTransfer(I2cDevice *self, I2cMessage *messages, size_t messageCount) {
     _I2cDevice *_self = (_I2cDevice*)self;
-    int fileDescriptor = _openBus(_self->busName, _self->deviceAddress, _self->error);
-    if (fileDescriptor == IO_ERROR) { return; }
-    uint8_t buffer[2] = { registerAddress, value };
-    if (write(fileDescriptor, buffer, WRITE_REQUEST_SIZE) == IO_ERROR) {
-        _self->error->type = I2C_ERROR_IO_ERROR;
+    if (messageCount > I2C_MAX_MESSAGES) {
+        _self->error->type = I2C_ERROR_INVALID_ARGUMENT;
         _self->error->level = I2C_ERROR_LEVEL_ERROR;
-        _self->error->ioErrno = errno;
-        _closeBus(fileDescriptor);
         return;
     }
-    _closeBus(fileDescriptor);
+    _transfer(_self, messages, messageCount);
 }
 
-uint8_t i2cReadByte(I2cDevice *self, uint8_t registerAddress) {
+void i2cWriteBlock(I2cDevice *self, uint8_t registerAddress, uint8_t *values, size_t length) {
     _I2cDevice *_self = (_I2cDevice*)self;
-    int fileDescriptor = _openBus(_self->busName, _self->deviceAddress, _self->error);
-    if (fileDescriptor == IO_ERROR) { return 0; }
-    if (write(fileDescriptor, &registerAddress, READ_REQUEST_SIZE) == IO_ERROR) {
-        _self->error->type = I2C_ERROR_IO_ERROR;
+    if (length > I2C_MAX_BLOCK_LENGTH) {
+        _self->error->type = I2C_ERROR_INVALID_ARGUMENT;
         _self->error->level = I2C_ERROR_LEVEL_ERROR;
-        _self->error->ioErrno = errno;
-        _closeBus(fileDescriptor);
-        return 0;
+        return;
     }
-    uint8_t value = 0;
-    if (read(fileDescriptor, &value, READ_SIZE) == IO_ERROR) {
-        _self->error->type = I2C_ERROR_IO_ERROR;
+    // The register address and the values have to go out in one message.
+    uint8_t buffer[REGISTER_ADDRESS_SIZE + I2C_MAX_BLOCK_LENGTH];
+    buffer[0] = registerAddress;
+    memcpy(buffer + REGISTER_ADDRESS_SIZE, values, length);
+    I2cMessage message = {
+        .buffer = buffer,
+        .length = REGISTER_ADDRESS_SIZE + length,
+        .read = false
+    };
+    _transfer(_self, &message, 1);
+}
+
+void i2cReadBlock(I2cDevice *self, uint8_t registerAddress, uint8_t *values, size_t length) {
+    _I2cDevice *_self = (_I2cDevice*)self;
+    if (length > I2C_MAX_BLOCK_LENGTH) {
+        _self->error->type = I2C_ERROR_INVALID_ARGUMENT;
         _self->error->level = I2C_ERROR_LEVEL_ERROR;
-        _self->error->ioErrno = errno;
-        _closeBus(fileDescriptor);
-        return 0;
+        return;
+    }
+    I2cMessage messages[2] = {
+        {
+            .buffer = &registerAddress,
+            .length = REGISTER_ADDRESS_SIZE,
+            .read = false
+        },
+        {
+            .buffer = values,
+            .length = length,
+            .read = true
+        }
+    };
+    _transfer(_self, messages, 2);
+    if (_self->error->level == I2C_ERROR_LEVEL_ERROR) {
+        memset(values, 0, length);
     }
-    _closeBus(fileDescriptor);
-    return value;
 }
 
 I2cError * i2cGetError(I2cDevice *self) {
@@ -196,6 +717,8 @@ char * i2cGetErrorString(I2cError *error) {
             return strerror(error->ioErrno);
         case I2C_ERROR_MEMORY_ALLOCATION_FAILED:
             return "Memory allocation failed";
+        case I2C_ERROR_INVALID_ARGUMENT:
+            return "Invalid argument";
         default:
             return "Unknown error";
     }
@@ -8,7 +8,8 @@
 enum I2cErrorType {
     I2C_ERROR_NO_ERROR,
     I2C_ERROR_IO_ERROR,
-    I2C_ERROR_MEMORY_ALLOCATION_FAILED
+    I2C_ERROR_MEMORY_ALLOCATION_FAILED,
+    I2C_ERROR_INVALID_ARGUMENT
 };
 
 enum I2cErrorLevel {
@@ -23,16 +24,99 @@ typedef struct {
     int ioErrno;
 } I2cError;
 
+typedef struct {
+    uint8_t *buffer;
+    uint16_t length;
+    bool read;
+} I2cMessage;
+
+// Longest register range for i2cWriteBlock/i2cReadBlock
+#define I2C_MAX_BLOCK_LENGTH (32)
+// Most messages in one i2cTransfer, I2C_RDWR_IOCTL_MAX_MSGS of i2c-dev
+#define I2C_MAX_MESSAGES (42)
+
+/**
+ * @brief Backend that carries transactions to the devices.
+ *
+ * open returns a handle for the named bus, transfer performs all messages
+ * to one address as a single transaction and probe checks that an
+ * address answers (may be NULL, then scans and i2cTest send an empty
+ * write). reopen replaces a broken connection of
+ * a handle in place, without allocating (may be NULL, then the handle is
+ * closed and opened again). Calls on one bus are serialized by the
+ * i2c layer, calls on different buses may run concurrently. Failures
+ * return NULL/false with errno set, like the system calls of the kernel
+ * transport; a probe that cannot tell whether the address answers sets
+ * EOPNOTSUPP, which fails a scan.
+*/
+typedef struct I2cTransport I2cTransport;
+struct I2cTransport {
+    void * (*open)(I2cTransport *self, const char *busName);
+    void (*close)(I2cTransport *self, void *bus);
+    bool (*transfer)(I2cTransport *self, void *bus, uint8_t address, I2cMessage *messages, size_t messageCount);
+    bool (*probe)(I2cTransport *self, void *bus, uint8_t address);
+    bool (*reopen)(I2cTransport *self, void *bus, const char *busName);
+};
+
+// Linux i2c-dev, the transport of i2cInit
+I2cTransport * i2cGetKernelTransport(void);
+
+#define I2C_ADDRESS_COUNT (128)
+// the 7 bit addresses a scan probes, the range of i2cdetect
+#define I2C_SCAN_FIRST_ADDRESS (0x08)
+#define I2C_SCAN_LAST_ADDRESS (0x77)
+
+/**
+ * @brief Devices found on one bus.
+ *
+ * A scan opens the bus once and probes every address with a quick write
+ * (a read of one byte in the EEPROM ranges, like i2cdetect), through the
+ * transport's probe. The result of every scan without an error is cached
+ * per bus name and transport. i2cTest fails a device the scan did not
+ * find without another transaction and still probes the ones it found,
+ * which may have gone since, and addresses outside the scan. The cache
+ * does not expire: call i2cClearScanCache after changing the wiring.
+*/
+typedef struct {
+    // addresses that acknowledged, ascending
+    uint8_t addresses[I2C_ADDRESS_COUNT];
+    size_t count;
+    bool present[I2C_ADDRESS_COUNT];
+    // wall time of the scan in nanoseconds
+    uint64_t scanTime;
+    I2cError error;
+} I2cScanResult;
+
 typedef void* I2cDevice;
 
 I2cDevice * i2cInit(char *busName, size_t busNameLength, uint8_t deviceAddress);
+// NULL selects the kernel transport
+I2cDevice * i2cInitWithTransport(
+    char *busName, size_t busNameLength, uint8_t deviceAddress, I2cTransport *transport
+);
 void i2cDestroy(I2cDevice *self);
 
+// scans a bus through the kernel transport, addresses holds at least I2C_ADDRESS_COUNT
 I2cError i2cScan(char *busName, size_t busNameLength, uint8_t *addresses, size_t *length);
+// scans the buses in parallel, one thread per bus, and returns the wall
+// time of the whole scan in nanoseconds; NULL selects the kernel transport
+uint64_t i2cScanBuses(
+    const char * const *busNames, size_t busCount, I2cTransport *transport, I2cScanResult *results
+);
+// false when busName has not been scanned through transport
+bool i2cGetCachedScan(const char *busName, I2cTransport *transport, I2cScanResult *result);
+// drops the cached scans of transport, of every transport when NULL
+void i2cClearScanCache(I2cTransport *transport);
 bool i2cTest(I2cDevice *self);
 void i2cWriteByte(I2cDevice *self, uint8_t registerAddress, uint8_t value);
 uint8_t i2cReadByte(I2cDevice *self, uint8_t registerAddress);
 
+// All messages go out as one transaction with repeated starts.
+void i2cTransfer(I2cDevice *self, I2cMessage *messages, size_t messageCount);
+// Register ranges rely on the device auto-incrementing the register address.
+void i2cWriteBlock(I2cDevice *self, uint8_t registerAddress, uint8_t *values, size_t length);
+void i2cReadBlock(I2cDevice *self, uint8_t registerAddress, uint8_t *values, size_t length);
+
 I2cError * i2cGetError(I2cDevice *self);
 char * i2cGetErrorString(I2cError *error);
 
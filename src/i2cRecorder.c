@@ -0,0 +1,220 @@
+#include "i2cRecorder.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef uint8_t Bool8;
+
+#define NANOSECONDS_PER_SECOND (1000000000)
+
+typedef struct _RecordedBus {
+    void *handle;
+    uint32_t busNumber;
+    char *busName;
+    struct _RecordedBus *next;
+} _RecordedBus;
+
+typedef struct {
+    I2cTransport transport;
+    I2cTransport *inner;
+
+    I2cTransactionRecord *records;
+    size_t capacity;
+    size_t count;
+    uint64_t dropped;
+    _RecordedBus *buses;
+    uint32_t busCount;
+    pthread_mutex_t lock;
+} _I2cRecorder;
+
+static uint64_t _getCurrentTimeNanoseconds(void) {
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    return (uint64_t)currentTime.tv_sec * NANOSECONDS_PER_SECOND + currentTime.tv_nsec;
+}
+
+static void * _open(I2cTransport *self, const char *busName) {
+    _I2cRecorder *_self = (_I2cRecorder*)self;
+    _RecordedBus *bus = (_RecordedBus*)calloc(1, sizeof(_RecordedBus));
+    if (bus == NULL || (bus->busName = strdup(busName)) == NULL) {
+        free(bus);
+        errno = ENOMEM;
+        return NULL;
+    }
+    bus->handle = _self->inner->open(_self->inner, busName);
+    if (bus->handle == NULL) {
+        int openErrno = errno;
+        free(bus->busName);
+        free(bus);
+        errno = openErrno;
+        return NULL;
+    }
+    // Reconnects get a new number; the names stay until the recorder goes.
+    pthread_mutex_lock(&_self->lock);
+    bus->busNumber = _self->busCount++;
+    bus->next = _self->buses;
+    _self->buses = bus;
+    pthread_mutex_unlock(&_self->lock);
+    return bus;
+}
+
+static void _close(I2cTransport *self, void *handle) {
+    _I2cRecorder *_self = (_I2cRecorder*)self;
+    _RecordedBus *bus = (_RecordedBus*)handle;
+    _self->inner->close(_self->inner, bus->handle);
+    bus->handle = NULL;
+}
+
+static void _record(
+    _I2cRecorder *_self, _RecordedBus *bus, uint8_t address, I2cMessage *messages, size_t messageCount,
+    uint64_t start, uint64_t end, int errorNumber
+) {
+    pthread_mutex_lock(&_self->lock);
+    if (_self->count == _self->capacity) {
+        ++(_self->dropped);
+        pthread_mutex_unlock(&_self->lock);
+        return;
+    }
+    I2cTransactionRecord *record = &_self->records[_self->count++];
+    record->startTimestamp = start;
+    record->endTimestamp = end;
+    record->busNumber = bus->busNumber;
+    record->address = address;
+    record->messageCount = messageCount < I2C_RECORD_MESSAGE_COUNT ? messageCount : I2C_RECORD_MESSAGE_COUNT;
+    record->errorNumber = errorNumber;
+    for (uint8_t i = 0; i < record->messageCount; ++i) {
+        I2cMessageRecord *message = &record->messages[i];
+        message->read = messages[i].read;
+        message->length = messages[i].length;
+        memset(message->data, 0, I2C_RECORD_DATA_SIZE);
+        memcpy(
+            message->data, messages[i].buffer,
+            messages[i].length < I2C_RECORD_DATA_SIZE ? messages[i].length : I2C_RECORD_DATA_SIZE
+        );
+    }
+    pthread_mutex_unlock(&_self->lock);
+}
+
+static bool _transfer(
+    I2cTransport *self, void *handle, uint8_t address, I2cMessage *messages, size_t messageCount
+) {
+    _I2cRecorder *_self = (_I2cRecorder*)self;
+    _RecordedBus *bus = (_RecordedBus*)handle;
+    uint64_t start = _getCurrentTimeNanoseconds();
+    bool result = _self->inner->transfer(_self->inner, bus->handle, address, messages, messageCount);
+    int errorNumber = result ? 0 : errno;
+    _record(_self, bus, address, messages, messageCount, start, _getCurrentTimeNanoseconds(), errorNumber);
+    errno = errorNumber;
+    return result;
+}
+
+static bool _probe(I2cTransport *self, void *handle, uint8_t address) {
+    _I2cRecorder *_self = (_I2cRecorder*)self;
+    _RecordedBus *bus = (_RecordedBus*)handle;
+    return _self->inner->probe(_self->inner, bus->handle, address);
+}
+
+I2cTransport * i2cRecorderInit(I2cTransport *inner, size_t capacity) {
+    _I2cRecorder *_self = (_I2cRecorder*)calloc(1, sizeof(_I2cRecorder));
+    if (_self == NULL) { return NULL; }
+    _self->records = (I2cTransactionRecord*)calloc(capacity, sizeof(I2cTransactionRecord));
+    if (_self->records == NULL && capacity > 0) {
+        free(_self);
+        return NULL;
+    }
+    _self->transport.open = _open;
+    _self->transport.close = _close;
+    _self->transport.transfer = _transfer;
+    _self->inner = inner != NULL ? inner : i2cGetKernelTransport();
+    // Without a probe of its own the inner transport gets the empty write, recorded as well.
+    _self->transport.probe = _self->inner->probe != NULL ? _probe : NULL;
+    _self->capacity = capacity;
+    pthread_mutex_init(&_self->lock, NULL);
+    return (I2cTransport*)_self;
+}
+
+void i2cRecorderDestroy(I2cTransport *self) {
+    _I2cRecorder *_self = (_I2cRecorder*)self;
+    _RecordedBus *bus = _self->buses;
+    while (bus != NULL) {
+        _RecordedBus *next = bus->next;
+        free(bus->busName);
+        free(bus);
+        bus = next;
+    }
+    pthread_mutex_destroy(&_self->lock);
+    // A later transport may get the same address.
+    i2cClearScanCache(self);
+    free(_self->records);
+    free(_self);
+}
+
+size_t i2cRecorderGetCount(I2cTransport *self) {
+    _I2cRecorder *_self = (_I2cRecorder*)self;
+    pthread_mutex_lock(&_self->lock);
+    size_t count = _self->count;
+    pthread_mutex_unlock(&_self->lock);
+    return count;
+}
+
+uint64_t i2cRecorderGetDropped(I2cTransport *self) {
+    _I2cRecorder *_self = (_I2cRecorder*)self;
+    pthread_mutex_lock(&_self->lock);
+    uint64_t dropped = _self->dropped;
+    pthread_mutex_unlock(&_self->lock);
+    return dropped;
+}
+
+bool i2cRecorderGetRecord(I2cTransport *self, size_t index, I2cTransactionRecord *record) {
+    _I2cRecorder *_self = (_I2cRecorder*)self;
+    pthread_mutex_lock(&_self->lock);
+    bool found = index < _self->count;
+    if (found) {
+        *record = _self->records[index];
+    }
+    pthread_mutex_unlock(&_self->lock);
+    return found;
+}
+
+const char * i2cRecorderGetBusName(I2cTransport *self, uint32_t busNumber) {
+    _I2cRecorder *_self = (_I2cRecorder*)self;
+    pthread_mutex_lock(&_self->lock);
+    _RecordedBus *bus = _self->buses;
+    while (bus != NULL && bus->busNumber != busNumber) {
+        bus = bus->next;
+    }
+    pthread_mutex_unlock(&_self->lock);
+    return bus != NULL ? bus->busName : NULL;
+}
+
+void i2cRecorderClear(I2cTransport *self) {
+    _I2cRecorder *_self = (_I2cRecorder*)self;
+    pthread_mutex_lock(&_self->lock);
+    _self->count = 0;
+    _self->dropped = 0;
+    pthread_mutex_unlock(&_self->lock);
+}
+
+void i2cRecorderWriteCsv(I2cTransport *self, FILE *file) {
+    fprintf(file, "start,end,bus,address,direction,length,data,errno\n");
+    I2cTransactionRecord record;
+    for (size_t i = 0; i2cRecorderGetRecord(self, i, &record); ++i) {
+        const char *busName = i2cRecorderGetBusName(self, record.busNumber);
+        for (uint8_t j = 0; j < record.messageCount; ++j) {
+            I2cMessageRecord *message = &record.messages[j];
+            fprintf(
+                file, "%llu,%llu,%s,0x%02x,%c,%u,",
+                (unsigned long long)record.startTimestamp, (unsigned long long)record.endTimestamp,
+                busName, record.address, message->read ? 'r' : 'w', message->length
+            );
+            uint16_t kept = message->length < I2C_RECORD_DATA_SIZE ? message->length : I2C_RECORD_DATA_SIZE;
+            for (uint16_t k = 0; k < kept; ++k) {
+                fprintf(file, "%02x", message->data[k]);
+            }
+            fprintf(file, ",%d\n", record.errorNumber);
+        }
+    }
+}
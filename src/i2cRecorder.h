@@ -0,0 +1,56 @@
+#ifndef __I2C_RECORDER_H__
+#define __I2C_RECORDER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "i2c.h"
+
+/**
+ * @brief Transport that passes every transaction on to another transport
+ * and records it with its start and end time.
+ *
+ * Records go into a buffer allocated by i2cRecorderInit; once it is full
+ * further transactions are still performed but only counted as dropped.
+ * Bus names are stored once per opened bus and referenced by number.
+*/
+
+// payload bytes kept per message, longer messages are truncated
+#define I2C_RECORD_DATA_SIZE (8)
+// messages kept per transaction
+#define I2C_RECORD_MESSAGE_COUNT (2)
+
+typedef struct {
+    bool read;
+    uint16_t length;
+    uint8_t data[I2C_RECORD_DATA_SIZE];
+} I2cMessageRecord;
+
+typedef struct {
+    // CLOCK_MONOTONIC, in nanoseconds
+    uint64_t startTimestamp;
+    uint64_t endTimestamp;
+    uint32_t busNumber;
+    uint8_t address;
+    uint8_t messageCount;
+    I2cMessageRecord messages[I2C_RECORD_MESSAGE_COUNT];
+    // 0 when the transaction succeeded
+    int errorNumber;
+} I2cTransactionRecord;
+
+I2cTransport * i2cRecorderInit(I2cTransport *inner, size_t capacity);
+// every device on the transport has to be destroyed first
+void i2cRecorderDestroy(I2cTransport *self);
+
+size_t i2cRecorderGetCount(I2cTransport *self);
+uint64_t i2cRecorderGetDropped(I2cTransport *self);
+bool i2cRecorderGetRecord(I2cTransport *self, size_t index, I2cTransactionRecord *record);
+const char * i2cRecorderGetBusName(I2cTransport *self, uint32_t busNumber);
+void i2cRecorderClear(I2cTransport *self);
+
+// one line per message: start,end,bus,address,direction,length,data,errno
+void i2cRecorderWriteCsv(I2cTransport *self, FILE *file);
+
+#endif // __I2C_RECORDER_H__
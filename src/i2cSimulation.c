@@ -0,0 +1,284 @@
+#include "i2cSimulation.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef uint8_t Bool8;
+
+#define ADDRESS_COUNT (128)
+#define REGISTER_COUNT (256)
+#define NANOSECONDS_PER_SECOND (1000000000)
+#define PARTS_PER_MILLION (1000000)
+// START or repeated START, address byte with ACK; STOP once per transaction
+#define MESSAGE_OVERHEAD_BITS (1 + 9)
+#define BITS_PER_BYTE (9)
+#define STOP_BITS (1)
+// the last part of a wait is spun, sleeps overshoot by tens of microseconds
+#define SPIN_THRESHOLD (50000)
+
+typedef struct _SimulatedBus {
+    char *busName;
+    pthread_mutex_t lock;
+    uint8_t registers[ADDRESS_COUNT][REGISTER_COUNT];
+    uint8_t registerPointers[ADDRESS_COUNT];
+    Bool8 present[ADDRESS_COUNT];
+    uint32_t pendingFailures;
+    int pendingFailureErrno;
+    uint32_t randomState;
+    struct _SimulatedBus *next;
+} _SimulatedBus;
+
+typedef struct {
+    I2cTransport transport;
+    I2cSimulationConfiguration configuration;
+    Bool8 defaultPresent[ADDRESS_COUNT];
+    _SimulatedBus *buses;
+    pthread_mutex_t busesLock;
+
+    uint64_t transactions;
+    uint64_t failedTransactions;
+    uint64_t bytes;
+    uint64_t busyTime;
+} _I2cSimulation;
+
+static uint64_t _getCurrentTimeNanoseconds(void) {
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    return (uint64_t)currentTime.tv_sec * NANOSECONDS_PER_SECOND + currentTime.tv_nsec;
+}
+
+static void _waitUntil(uint64_t deadline) {
+    uint64_t now = _getCurrentTimeNanoseconds();
+    if (deadline > now + SPIN_THRESHOLD) {
+        uint64_t sleepUntil = deadline - SPIN_THRESHOLD;
+        struct timespec wakeTime = {
+            .tv_sec = sleepUntil / NANOSECONDS_PER_SECOND,
+            .tv_nsec = sleepUntil % NANOSECONDS_PER_SECOND
+        };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeTime, NULL) == EINTR);
+    }
+    while (_getCurrentTimeNanoseconds() < deadline);
+}
+
+/**
+ * @brief Returns the bus for busName, creating it with the configured devices.
+ * Buses live until the transport is destroyed, so register contents
+ * survive reconnects.
+*/
+static _SimulatedBus * _getBus(_I2cSimulation *_self, const char *busName) {
+    pthread_mutex_lock(&_self->busesLock);
+    _SimulatedBus *bus = _self->buses;
+    while (bus != NULL && strcmp(bus->busName, busName) != 0) {
+        bus = bus->next;
+    }
+    if (bus == NULL) {
+        bus = (_SimulatedBus*)calloc(1, sizeof(_SimulatedBus));
+        if (bus != NULL && (bus->busName = strdup(busName)) == NULL) {
+            free(bus);
+            bus = NULL;
+        }
+        if (bus != NULL) {
+            pthread_mutex_init(&bus->lock, NULL);
+            memcpy(bus->present, _self->defaultPresent, sizeof(bus->present));
+            bus->randomState = _self->configuration.seed;
+            for (const char *c = busName; *c != '\0'; ++c) {
+                bus->randomState = bus->randomState * 31 + (uint8_t)*c;
+            }
+            bus->next = _self->buses;
+            _self->buses = bus;
+        }
+    }
+    pthread_mutex_unlock(&_self->busesLock);
+    return bus;
+}
+
+static void * _open(I2cTransport *self, const char *busName) {
+    _SimulatedBus *bus = _getBus((_I2cSimulation*)self, busName);
+    if (bus == NULL) { errno = ENOMEM; }
+    return bus;
+}
+
+static void _close(I2cTransport *self, void *bus) {}
+
+static uint64_t _transactionTime(_I2cSimulation *_self, I2cMessage *messages, size_t messageCount) {
+    uint64_t time = _self->configuration.transactionLatency;
+    if (_self->configuration.clockFrequency == 0) { return time; }
+    uint64_t bits = STOP_BITS;
+    for (size_t i = 0; i < messageCount; ++i) {
+        bits += MESSAGE_OVERHEAD_BITS + (uint64_t)messages[i].length * BITS_PER_BYTE;
+    }
+    return time + bits * NANOSECONDS_PER_SECOND / _self->configuration.clockFrequency;
+}
+
+/**
+ * @brief Decides whether the transaction fails. Must hold bus->lock.
+ * Returns the errno of the failure or 0.
+*/
+static int _injectedFailure(_I2cSimulation *_self, _SimulatedBus *bus) {
+    if (bus->pendingFailures > 0) {
+        --(bus->pendingFailures);
+        return bus->pendingFailureErrno;
+    }
+    if (_self->configuration.failureRate == 0) { return 0; }
+    if ((uint32_t)rand_r(&bus->randomState) % PARTS_PER_MILLION >= _self->configuration.failureRate) {
+        return 0;
+    }
+    return _self->configuration.failureErrno != 0 ? _self->configuration.failureErrno : EIO;
+}
+
+static void _performMessage(_SimulatedBus *bus, uint8_t address, I2cMessage *message) {
+    uint8_t *registers = bus->registers[address];
+    uint8_t *registerPointer = &bus->registerPointers[address];
+    uint16_t i = 0;
+    if (!message->read && message->length > 0) {
+        *registerPointer = message->buffer[i++];
+    }
+    for (; i < message->length; ++i) {
+        if (message->read) {
+            message->buffer[i] = registers[(*registerPointer)++];
+        } else {
+            registers[(*registerPointer)++] = message->buffer[i];
+        }
+    }
+}
+
+static bool _transfer(
+    I2cTransport *self, void *handle, uint8_t address, I2cMessage *messages, size_t messageCount
+) {
+    _I2cSimulation *_self = (_I2cSimulation*)self;
+    _SimulatedBus *bus = (_SimulatedBus*)handle;
+    uint64_t start = _getCurrentTimeNanoseconds();
+    uint64_t duration = _transactionTime(_self, messages, messageCount);
+
+    int errorNumber = 0;
+    uint64_t bytes = 0;
+    pthread_mutex_lock(&bus->lock);
+    if (address >= ADDRESS_COUNT || !bus->present[address]) {
+        errorNumber = ENXIO;
+    } else if ((errorNumber = _injectedFailure(_self, bus)) == 0) {
+        for (size_t i = 0; i < messageCount; ++i) {
+            _performMessage(bus, address, &messages[i]);
+            bytes += messages[i].length;
+        }
+    }
+    pthread_mutex_unlock(&bus->lock);
+
+    _waitUntil(start + duration);
+    __atomic_fetch_add(&_self->transactions, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&_self->bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&_self->busyTime, duration, __ATOMIC_RELAXED);
+    if (errorNumber != 0) {
+        __atomic_fetch_add(&_self->failedTransactions, 1, __ATOMIC_RELAXED);
+        errno = errorNumber;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief A quick write, the address byte alone on the wire. Probes never
+ * fail at random and are not counted as transactions, so injected faults
+ * do not disturb bring-up.
+*/
+static bool _probe(I2cTransport *self, void *handle, uint8_t address) {
+    _I2cSimulation *_self = (_I2cSimulation*)self;
+    _SimulatedBus *bus = (_SimulatedBus*)handle;
+    uint64_t start = _getCurrentTimeNanoseconds();
+    I2cMessage message = { .buffer = NULL, .length = 0, .read = false };
+    pthread_mutex_lock(&bus->lock);
+    bool present = address < ADDRESS_COUNT && bus->present[address];
+    pthread_mutex_unlock(&bus->lock);
+    _waitUntil(start + _transactionTime(_self, &message, 1));
+    if (!present) { errno = ENXIO; }
+    return present;
+}
+
+I2cTransport * i2cSimulationInit(I2cSimulationConfiguration *configuration) {
+    _I2cSimulation *_self = (_I2cSimulation*)calloc(1, sizeof(_I2cSimulation));
+    if (_self == NULL) { return NULL; }
+    _self->transport.open = _open;
+    _self->transport.close = _close;
+    _self->transport.transfer = _transfer;
+    _self->transport.probe = _probe;
+    _self->configuration = *configuration;
+    pthread_mutex_init(&_self->busesLock, NULL);
+
+    if (configuration->deviceAddresses == NULL) {
+        memset(_self->defaultPresent, true, sizeof(_self->defaultPresent));
+    }
+    for (size_t i = 0; i < configuration->deviceAddressCount; ++i) {
+        if (configuration->deviceAddresses[i] < ADDRESS_COUNT) {
+            _self->defaultPresent[configuration->deviceAddresses[i]] = true;
+        }
+    }
+    // the devices are owned by the caller
+    _self->configuration.deviceAddresses = NULL;
+    _self->configuration.deviceAddressCount = 0;
+    return (I2cTransport*)_self;
+}
+
+void i2cSimulationDestroy(I2cTransport *self) {
+    _I2cSimulation *_self = (_I2cSimulation*)self;
+    _SimulatedBus *bus = _self->buses;
+    while (bus != NULL) {
+        _SimulatedBus *next = bus->next;
+        pthread_mutex_destroy(&bus->lock);
+        free(bus->busName);
+        free(bus);
+        bus = next;
+    }
+    pthread_mutex_destroy(&_self->busesLock);
+    // A later transport may get the same address.
+    i2cClearScanCache(self);
+    free(_self);
+}
+
+uint8_t i2cSimulationGetRegister(I2cTransport *self, const char *busName, uint8_t address, uint8_t registerAddress) {
+    _SimulatedBus *bus = _getBus((_I2cSimulation*)self, busName);
+    if (bus == NULL || address >= ADDRESS_COUNT) { return 0; }
+    pthread_mutex_lock(&bus->lock);
+    uint8_t value = bus->registers[address][registerAddress];
+    pthread_mutex_unlock(&bus->lock);
+    return value;
+}
+
+void i2cSimulationSetRegister(
+    I2cTransport *self, const char *busName, uint8_t address, uint8_t registerAddress, uint8_t value
+) {
+    _SimulatedBus *bus = _getBus((_I2cSimulation*)self, busName);
+    if (bus == NULL || address >= ADDRESS_COUNT) { return; }
+    pthread_mutex_lock(&bus->lock);
+    bus->registers[address][registerAddress] = value;
+    pthread_mutex_unlock(&bus->lock);
+}
+
+void i2cSimulationSetDevicePresent(I2cTransport *self, const char *busName, uint8_t address, bool present) {
+    _SimulatedBus *bus = _getBus((_I2cSimulation*)self, busName);
+    if (bus == NULL || address >= ADDRESS_COUNT) { return; }
+    pthread_mutex_lock(&bus->lock);
+    bus->present[address] = present;
+    pthread_mutex_unlock(&bus->lock);
+}
+
+void i2cSimulationFailNext(I2cTransport *self, const char *busName, uint32_t count, int errorNumber) {
+    _SimulatedBus *bus = _getBus((_I2cSimulation*)self, busName);
+    if (bus == NULL) { return; }
+    pthread_mutex_lock(&bus->lock);
+    bus->pendingFailures = count;
+    bus->pendingFailureErrno = errorNumber;
+    pthread_mutex_unlock(&bus->lock);
+}
+
+I2cSimulationStatistics i2cSimulationGetStatistics(I2cTransport *self) {
+    _I2cSimulation *_self = (_I2cSimulation*)self;
+    I2cSimulationStatistics statistics = {
+        .transactions = __atomic_load_n(&_self->transactions, __ATOMIC_RELAXED),
+        .failedTransactions = __atomic_load_n(&_self->failedTransactions, __ATOMIC_RELAXED),
+        .bytes = __atomic_load_n(&_self->bytes, __ATOMIC_RELAXED),
+        .busyTime = __atomic_load_n(&_self->busyTime, __ATOMIC_RELAXED)
+    };
+    return statistics;
+}
@@ -0,0 +1,63 @@
+#ifndef __I2C_SIMULATION_H__
+#define __I2C_SIMULATION_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "i2c.h"
+
+/**
+ * @brief In-process I2C bus for running the engine without hardware.
+ *
+ * Every bus name opened through the transport gets its own bank of
+ * register files, one per 7 bit address. Register pointers
+ * auto-increment like on the fuse controllers. A transaction holds the
+ * calling thread for the time it would occupy the wire at the configured
+ * bus clock plus a fixed per-transaction latency, so scheduling and
+ * queueing behave as they would on a real bus. Transactions can fail at
+ * random with a seeded probability or on demand with i2cSimulationFailNext.
+*/
+
+#define I2C_STANDARD_MODE_FREQUENCY (100000)
+#define I2C_FAST_MODE_FREQUENCY (400000)
+
+typedef struct {
+    // SCL frequency in Hz, 0 transfers without wire time
+    uint32_t clockFrequency;
+    // added to every transaction, in nanoseconds (driver and syscall cost)
+    uint32_t transactionLatency;
+    // chance of a transaction failing, in parts per million
+    uint32_t failureRate;
+    // errno of injected failures, EIO when 0
+    int failureErrno;
+    uint32_t seed;
+    // addresses that acknowledge on every bus, all when NULL
+    const uint8_t *deviceAddresses;
+    size_t deviceAddressCount;
+} I2cSimulationConfiguration;
+
+typedef struct {
+    uint64_t transactions;
+    uint64_t failedTransactions;
+    uint64_t bytes;
+    // wire time plus latency of all transactions, in nanoseconds
+    uint64_t busyTime;
+} I2cSimulationStatistics;
+
+I2cTransport * i2cSimulationInit(I2cSimulationConfiguration *configuration);
+// every device on the transport has to be destroyed first
+void i2cSimulationDestroy(I2cTransport *self);
+
+uint8_t i2cSimulationGetRegister(I2cTransport *self, const char *busName, uint8_t address, uint8_t registerAddress);
+void i2cSimulationSetRegister(
+    I2cTransport *self, const char *busName, uint8_t address, uint8_t registerAddress, uint8_t value
+);
+// a missing device NACKs its address, transactions to it fail with ENXIO
+void i2cSimulationSetDevicePresent(I2cTransport *self, const char *busName, uint8_t address, bool present);
+// the next count transactions on the bus fail with errorNumber
+void i2cSimulationFailNext(I2cTransport *self, const char *busName, uint32_t count, int errorNumber);
+
+I2cSimulationStatistics i2cSimulationGetStatistics(I2cTransport *self);
+
+#endif // __I2C_SIMULATION_H__
@@ -0,0 +1,265 @@
+#include "injectionQueue.h"
+#include "mpscRing.h"
+
+#include <stdlib.h>
+
+typedef uint8_t Bool8;
+
+#define BITS_PER_WORD (64)
+#define NOT_QUEUED (UINT32_MAX)
+#define ID_SLOT_MASK (0xFFFFFFFFu)
+#define ID_GENERATION_SHIFT (32)
+// an injection and a cancellation per slot
+#define MESSAGES_PER_SLOT (2)
+
+enum {
+    _MESSAGE_INJECT,
+    _MESSAGE_CANCEL
+};
+
+typedef struct {
+    uint64_t id;
+    uint64_t time;
+    uint32_t i2cDeviceIndex;
+    uint8_t fuseIndex;
+    uint8_t type;
+    Bool8 relative;
+} _Message;
+
+typedef struct {
+    size_t capacity;
+    MpscRing *messages;
+
+    // claimed by posting threads, released by the timing thread
+    uint64_t *usedSlots;
+    size_t wordCount;
+    uint32_t nextWord;
+    // bumped by the thread claiming the slot
+    uint32_t *generations;
+
+    // timing thread only
+    uint64_t *times;
+    uint32_t *i2cDeviceIndices;
+    uint8_t *fuseIndices;
+    uint32_t *heapPositions;
+    uint32_t *heap;
+    uint32_t count;
+} _InjectionQueue;
+
+#define PARENT(i) (((i) - 1) / 2)
+#define LEFT_CHILD(i) (2 * (i) + 1)
+
+InjectionQueue * injectionQueueInit(size_t capacity) {
+    _InjectionQueue *_self = (_InjectionQueue*)calloc(1, sizeof(_InjectionQueue));
+    if (_self == NULL) { return NULL; }
+    _self->capacity = capacity;
+    _self->wordCount = (capacity + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    _self->messages = mpscRingInit(capacity * MESSAGES_PER_SLOT, sizeof(_Message));
+    _self->usedSlots = (uint64_t*)calloc(_self->wordCount > 0 ? _self->wordCount : 1, sizeof(uint64_t));
+    _self->generations = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+    _self->times = (uint64_t*)calloc(capacity, sizeof(uint64_t));
+    _self->i2cDeviceIndices = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+    _self->fuseIndices = (uint8_t*)calloc(capacity, sizeof(uint8_t));
+    _self->heapPositions = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+    _self->heap = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+    if (
+        _self->messages == NULL || _self->usedSlots == NULL || _self->generations == NULL
+        || _self->times == NULL || _self->i2cDeviceIndices == NULL || _self->fuseIndices == NULL
+        || _self->heapPositions == NULL || _self->heap == NULL
+    ) {
+        injectionQueueDestroy((InjectionQueue*)_self);
+        return NULL;
+    }
+    for (size_t i = 0; i < capacity; ++i) {
+        _self->heapPositions[i] = NOT_QUEUED;
+    }
+    // The bits past capacity are never free.
+    if (capacity % BITS_PER_WORD != 0) {
+        _self->usedSlots[_self->wordCount - 1] = ~0ull << (capacity % BITS_PER_WORD);
+    }
+    return (InjectionQueue*)_self;
+}
+
+void injectionQueueDestroy(InjectionQueue *self) {
+    _InjectionQueue *_self = (_InjectionQueue*)self;
+    if (_self->messages != NULL) {
+        mpscRingDestroy(_self->messages);
+    }
+    free(_self->usedSlots);
+    free(_self->generations);
+    free(_self->times);
+    free(_self->i2cDeviceIndices);
+    free(_self->fuseIndices);
+    free(_self->heapPositions);
+    free(_self->heap);
+    free(_self);
+}
+
+/**
+ * @brief Claims a free slot, starting at a rotating word so posting
+ * threads rarely contend for the same one.
+*/
+static bool _claimSlot(_InjectionQueue *_self, uint32_t *slot) {
+    uint32_t start = __atomic_fetch_add(&_self->nextWord, 1, __ATOMIC_RELAXED);
+    for (size_t i = 0; i < _self->wordCount; ++i) {
+        size_t wordIndex = (start + i) % _self->wordCount;
+        uint64_t *word = &_self->usedSlots[wordIndex];
+        uint64_t used = __atomic_load_n(word, __ATOMIC_RELAXED);
+        while (~used != 0) {
+            uint64_t bit = 1ull << __builtin_ctzll(~used);
+            if (__atomic_compare_exchange_n(word, &used, used | bit, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                *slot = wordIndex * BITS_PER_WORD + __builtin_ctzll(bit);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void _releaseSlot(_InjectionQueue *_self, uint32_t slot) {
+    __atomic_fetch_and(&_self->usedSlots[slot / BITS_PER_WORD], ~(1ull << (slot % BITS_PER_WORD)), __ATOMIC_RELEASE);
+}
+
+bool injectionQueuePost(
+    InjectionQueue *self, uint64_t time, bool relative, uint32_t i2cDeviceIndex, uint8_t fuseIndex, uint64_t *id
+) {
+    _InjectionQueue *_self = (_InjectionQueue*)self;
+    uint32_t slot;
+    if (!_claimSlot(_self, &slot)) { return false; }
+    uint32_t generation = __atomic_add_fetch(&_self->generations[slot], 1, __ATOMIC_RELAXED);
+    _Message message = {
+        .id = (uint64_t)generation << ID_GENERATION_SHIFT | slot,
+        .time = time,
+        .i2cDeviceIndex = i2cDeviceIndex,
+        .fuseIndex = fuseIndex,
+        .type = _MESSAGE_INJECT,
+        .relative = relative
+    };
+    if (!mpscRingPush(_self->messages, &message, NULL)) {
+        _releaseSlot(_self, slot);
+        return false;
+    }
+    if (id != NULL) {
+        *id = message.id;
+    }
+    return true;
+}
+
+bool injectionQueueCancel(InjectionQueue *self, uint64_t id) {
+    _InjectionQueue *_self = (_InjectionQueue*)self;
+    _Message message = { .id = id, .type = _MESSAGE_CANCEL };
+    return mpscRingPush(_self->messages, &message, NULL);
+}
+
+static void _place(_InjectionQueue *_self, uint32_t position, uint32_t slot) {
+    _self->heap[position] = slot;
+    _self->heapPositions[slot] = position;
+}
+
+static void _siftUp(_InjectionQueue *_self, uint32_t position) {
+    uint32_t slot = _self->heap[position];
+    while (position > 0 && _self->times[_self->heap[PARENT(position)]] > _self->times[slot]) {
+        _place(_self, position, _self->heap[PARENT(position)]);
+        position = PARENT(position);
+    }
+    _place(_self, position, slot);
+}
+
+static void _siftDown(_InjectionQueue *_self, uint32_t position) {
+    uint32_t slot = _self->heap[position];
+    while (LEFT_CHILD(position) < _self->count) {
+        uint32_t child = LEFT_CHILD(position);
+        if (child + 1 < _self->count && _self->times[_self->heap[child + 1]] < _self->times[_self->heap[child]]) {
+            ++child;
+        }
+        if (_self->times[_self->heap[child]] >= _self->times[slot]) break;
+        _place(_self, position, _self->heap[child]);
+        position = child;
+    }
+    _place(_self, position, slot);
+}
+
+/**
+ * @brief Takes a slot out of the heap and frees it for the posting threads.
+*/
+static void _remove(_InjectionQueue *_self, uint32_t slot) {
+    uint32_t position = _self->heapPositions[slot];
+    _self->heapPositions[slot] = NOT_QUEUED;
+    uint32_t last = _self->heap[--(_self->count)];
+    if (last != slot) {
+        _place(_self, position, last);
+        _siftDown(_self, position);
+        _siftUp(_self, _self->heapPositions[last]);
+    }
+    _releaseSlot(_self, slot);
+}
+
+size_t injectionQueueMerge(InjectionQueue *self, uint64_t showTime) {
+    _InjectionQueue *_self = (_InjectionQueue*)self;
+    size_t cancelled = 0;
+    _Message message;
+    while (mpscRingPop(_self->messages, &message)) {
+        uint32_t slot = (uint32_t)(message.id & ID_SLOT_MASK);
+        if (message.type == _MESSAGE_INJECT) {
+            _self->times[slot] = message.relative ? showTime + message.time : message.time;
+            _self->i2cDeviceIndices[slot] = message.i2cDeviceIndex;
+            _self->fuseIndices[slot] = message.fuseIndex;
+            _place(_self, _self->count++, slot);
+            _siftUp(_self, _self->count - 1);
+            continue;
+        }
+        // The injection was merged before, its cancellation came later
+        // through the same ring; a fired cue is no longer queued.
+        if (
+            slot < _self->capacity
+            && _self->heapPositions[slot] != NOT_QUEUED
+            && __atomic_load_n(&_self->generations[slot], __ATOMIC_RELAXED) == (uint32_t)(message.id >> ID_GENERATION_SHIFT)
+        ) {
+            _remove(_self, slot);
+            ++cancelled;
+        }
+    }
+    return cancelled;
+}
+
+bool injectionQueuePeek(InjectionQueue *self, InjectedCue *cue) {
+    _InjectionQueue *_self = (_InjectionQueue*)self;
+    if (_self->count == 0) { return false; }
+    uint32_t slot = _self->heap[0];
+    cue->id = (uint64_t)__atomic_load_n(&_self->generations[slot], __ATOMIC_RELAXED) << ID_GENERATION_SHIFT | slot;
+    cue->time = _self->times[slot];
+    cue->i2cDeviceIndex = _self->i2cDeviceIndices[slot];
+    cue->fuseIndex = _self->fuseIndices[slot];
+    return true;
+}
+
+bool injectionQueuePop(InjectionQueue *self, InjectedCue *cue) {
+    _InjectionQueue *_self = (_InjectionQueue*)self;
+    if (!injectionQueuePeek(self, cue)) { return false; }
+    _remove(_self, _self->heap[0]);
+    return true;
+}
+
+size_t injectionQueueDropBefore(InjectionQueue *self, uint64_t time) {
+    _InjectionQueue *_self = (_InjectionQueue*)self;
+    size_t count = 0;
+    while (_self->count > 0 && _self->times[_self->heap[0]] < time) {
+        _remove(_self, _self->heap[0]);
+        ++count;
+    }
+    return count;
+}
+
+size_t injectionQueueClear(InjectionQueue *self) {
+    _InjectionQueue *_self = (_InjectionQueue*)self;
+    size_t count = _self->count;
+    while (_self->count > 0) {
+        _remove(_self, _self->heap[_self->count - 1]);
+    }
+    return count;
+}
+
+size_t injectionQueueGetCapacity(InjectionQueue *self) {
+    _InjectionQueue *_self = (_InjectionQueue*)self;
+    return _self->capacity;
+}
@@ -0,0 +1,54 @@
+#ifndef __INJECTION_QUEUE_H__
+#define __INJECTION_QUEUE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Cues added to a running show by any thread, ordered by show time
+ * for the timing thread.
+ *
+ * Every injected cue occupies one of capacity slots, claimed by the
+ * posting thread with a compare-and-swap on a bitmap; its id is the slot
+ * and the slot's generation, so a stale id never cancels a later cue.
+ * Injections and cancellations travel through an MPSC ring and are
+ * merged by the timing thread into a min-heap indexed by slot: inserting,
+ * cancelling and popping cost O(log n) and nothing allocates after
+ * injectionQueueInit.
+*/
+
+typedef struct {
+    uint64_t id;
+    // show time in nanoseconds
+    uint64_t time;
+    uint32_t i2cDeviceIndex;
+    uint8_t fuseIndex;
+} InjectedCue;
+
+typedef void* InjectionQueue;
+
+InjectionQueue * injectionQueueInit(size_t capacity);
+void injectionQueueDestroy(InjectionQueue *self);
+
+// any thread; relative times are added to the show time at merge,
+// false when every slot is taken or the ring is full
+bool injectionQueuePost(
+    InjectionQueue *self, uint64_t time, bool relative, uint32_t i2cDeviceIndex, uint8_t fuseIndex, uint64_t *id
+);
+// any thread, false when the ring is full
+bool injectionQueueCancel(InjectionQueue *self, uint64_t id);
+
+// timing thread only: merges the posted injections and cancellations,
+// returns how many cues were cancelled
+size_t injectionQueueMerge(InjectionQueue *self, uint64_t showTime);
+bool injectionQueuePeek(InjectionQueue *self, InjectedCue *cue);
+bool injectionQueuePop(InjectionQueue *self, InjectedCue *cue);
+// drops the merged cues before time, returns their count
+size_t injectionQueueDropBefore(InjectionQueue *self, uint64_t time);
+// drops every merged cue, returns their count
+size_t injectionQueueClear(InjectionQueue *self);
+
+size_t injectionQueueGetCapacity(InjectionQueue *self);
+
+#endif // __INJECTION_QUEUE_H__
@@ -1,32 +1,170 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
 
 #include "fuses.h"
 
+#define TRACE_CAPACITY (65536)
+#define EVENT_CAPACITY (1024)
+#define EVENT_BATCH_SIZE (64)
+// milliseconds, how often the trace is drained while no event arrives
+#define TRACE_DRAIN_INTERVAL (100)
+#define NO_TIMEOUT (-1)
+#define DEFAULT_BUS_NAME ("/dev/i2c-1")
+#define NANOSECONDS_PER_MILLISECOND (1000000.0)
+
+static void _drainTrace(FusesObject *fuses, FusesTraceEvent *events, FILE *traceFile) {
+    if (traceFile == NULL) { return; }
+    size_t count;
+    while ((count = fusesDrainTrace(fuses, events, TRACE_CAPACITY)) > 0) {
+        fwrite(events, sizeof(FusesTraceEvent), count, traceFile);
+    }
+}
+
+/**
+ * @brief Reports late cues and I2C errors, returns true once the show finished.
+*/
+static bool _handleEvents(FusesObject *fuses) {
+    FusesEvent events[EVENT_BATCH_SIZE];
+    bool finished = false;
+    size_t count;
+    while ((count = fusesReadEvents(fuses, events, EVENT_BATCH_SIZE)) > 0) {
+        for (size_t i = 0; i < count; ++i) {
+            switch (events[i].type) {
+                case FUSES_EVENT_CUE_LATE:
+                    fprintf(stderr, "cue %u fired %d us late\n", events[i].cueIndex, events[i].lateness);
+                    break;
+                case FUSES_EVENT_I2C_ERROR:
+                    fprintf(
+                        stderr, "device %u: %s\n", events[i].i2cDeviceIndex, strerror(events[i].ioErrno)
+                    );
+                    break;
+                case FUSES_EVENT_VERIFY_MISMATCH:
+                    fprintf(
+                        stderr, "cue %u: device %u fuse %u did not latch, register 0x%02x read 0x%02x, written 0x%02x\n",
+                        events[i].cueIndex, events[i].i2cDeviceIndex, events[i].fuseIndex,
+                        events[i].registerAddress, events[i].readValue, events[i].writtenValue
+                    );
+                    break;
+                case FUSES_EVENT_SHOW_FINISHED:
+                    finished = true;
+                    break;
+            }
+        }
+    }
+    return finished;
+}
+
+/**
+ * @brief Scans the buses in parallel and prints the devices found on each.
+*/
+static int _scan(const char * const *busNames, size_t busCount) {
+    static const char * const defaultBusNames[] = { DEFAULT_BUS_NAME };
+    if (busCount == 0) {
+        busNames = defaultBusNames;
+        busCount = 1;
+    }
+    I2cScanResult *results = (I2cScanResult*)malloc(busCount * sizeof(I2cScanResult));
+    if (results == NULL) { return EXIT_FAILURE; }
+    uint64_t scanTime = i2cScanBuses(busNames, busCount, NULL, results);
+    bool failed = false;
+    for (size_t i = 0; i < busCount; ++i) {
+        if (results[i].error.level == I2C_ERROR_LEVEL_ERROR) {
+            fprintf(stderr, "%s: %s\n", busNames[i], i2cGetErrorString(&results[i].error));
+            failed = true;
+            continue;
+        }
+        printf(
+            "%s: %zu devices in %.2f ms:", busNames[i], results[i].count,
+            results[i].scanTime / NANOSECONDS_PER_MILLISECOND
+        );
+        for (size_t j = 0; j < results[i].count; ++j) {
+            printf(" 0x%02x", results[i].addresses[j]);
+        }
+        printf("\n");
+    }
+    printf("scanned %zu buses in %.2f ms\n", busCount, scanTime / NANOSECONDS_PER_MILLISECOND);
+    free(results);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 int main(int argc, char *argv[]) {
-    char *filename = argv[1];
-    FILE *file = fopen(filename, "rb");
-    if (file == NULL) {
-        perror("fopen");
+    if (argc > 1 && strcmp(argv[1], "--scan") == 0) {
+        return _scan((const char * const *)&argv[2], argc - 2);
+    }
+    bool realtime = false;
+    bool stream = false;
+    bool verify = false;
+    char *showFilename = NULL;
+    char *traceFilename = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--realtime") == 0) {
+            realtime = true;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream = true;
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            verify = true;
+        } else if (showFilename == NULL) {
+            showFilename = argv[i];
+        } else {
+            traceFilename = argv[i];
+        }
+    }
+    if (showFilename == NULL) {
+        fprintf(
+            stderr, "usage: %s [--realtime] [--stream] [--verify] <show file> [trace file]\n"
+            "       %s --scan [bus ...]\n", argv[0], argv[0]
+        );
         return EXIT_FAILURE;
     }
-    size_t fileSize;
-    fseek(file, 0, SEEK_END);
-    fileSize = ftell(file);
-    fseek(file, 0, SEEK_SET);
 
     FusesConfiguration config = {
-        .rawData = malloc(fileSize),
-        .rawDataSize = fileSize,
-        .busName = "/dev/i2c-1",
+        .busName = DEFAULT_BUS_NAME,
         .busNameLength = 11,
         .fuseDuration = 200,
-        .timeResolution = 10
+        .timeResolution = 10,
+        .realtime = { .enabled = realtime, .lockMemory = true },
+        .eventCapacity = EVENT_CAPACITY,
+        .eventMask = FUSES_EVENT_MASK(FUSES_EVENT_CUE_LATE) | FUSES_EVENT_MASK(FUSES_EVENT_I2C_ERROR)
+            | FUSES_EVENT_MASK(FUSES_EVENT_VERIFY_MISMATCH) | FUSES_EVENT_MASK(FUSES_EVENT_SHOW_FINISHED),
+        .verifyWrites = verify
     };
 
-    fread(config.rawData, fileSize, 1, file);
+    // A streamed show is read while it plays, "-" streams standard input.
+    FusesError mapError;
+    if (stream) {
+        config.streamPath = strcmp(showFilename, "-") == 0 ? "/dev/stdin" : showFilename;
+    } else if (!fusesMapShow(&config, showFilename, true, &mapError)) {
+        fprintf(stderr, "%s: %s\n", showFilename, fusesGetErrorString(&mapError));
+        return EXIT_FAILURE;
+    } else if (mapError.level == FUSES_ERROR_LEVEL_WARNING) {
+        fprintf(stderr, "%s: %s\n", showFilename, fusesGetErrorString(&mapError));
+    }
+
+    // The trace is drained to the file while the show runs, see bin/traceDump.
+    FILE *traceFile = NULL;
+    FusesTraceEvent *traceEvents = NULL;
+    if (traceFilename != NULL) {
+        traceFile = fopen(traceFilename, "wb");
+        traceEvents = (FusesTraceEvent*)malloc(TRACE_CAPACITY * sizeof(FusesTraceEvent));
+        if (traceFile == NULL || traceEvents == NULL || !fusesTraceWriteHeader(traceFile)) {
+            perror(traceFilename);
+            return EXIT_FAILURE;
+        }
+        config.traceCapacity = TRACE_CAPACITY;
+    }
 
-    FusesObject fuses = fusesInit(&config);
+    FusesObject *fuses = fusesInit(&config);
+    if (fuses == NULL || fusesGetError(fuses)->level == FUSES_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "%s: %s\n", showFilename, fuses ? fusesGetErrorString(fusesGetError(fuses)) : "");
+        return EXIT_FAILURE;
+    }
+    // The show still runs, but without the guarantees asked for.
+    if (realtime) {
+        fusesPrintRealtimeReport(fuses, stderr);
+    }
 
     pthread_barrier_t barrier;
     pthread_barrier_init(&barrier, NULL, 2);
@@ -34,7 +172,24 @@ int main(int argc, char *argv[]) {
     fusesPlay(fuses, &barrier);
     pthread_barrier_wait(&barrier);
 
-    while (fusesGetIsPlaying(&fuses));
+    // Sleeps until the player has something to report.
+    struct pollfd eventDescriptor = { .fd = fusesGetEventFileDescriptor(fuses), .events = POLLIN };
+    bool finished = false;
+    while (!finished) {
+        poll(&eventDescriptor, 1, traceFile != NULL ? TRACE_DRAIN_INTERVAL : NO_TIMEOUT);
+        finished = _handleEvents(fuses);
+        _drainTrace(fuses, traceEvents, traceFile);
+    }
+    bool streamFailed = fusesGetStatistics(fuses).streamFailed;
+    if (streamFailed) {
+        fprintf(stderr, "%s: show ended early, cues could not be read\n", showFilename);
+    }
+    fusesDestroy(fuses);
+
+    if (traceFile != NULL) {
+        fclose(traceFile);
+        free(traceEvents);
+    }
 
-    return EXIT_SUCCESS;
+    return streamFailed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
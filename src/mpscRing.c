@@ -0,0 +1,96 @@
+#include "mpscRing.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_LINE_SIZE (64)
+
+// sequences[i] == position: free for the producer claiming position,
+// sequences[i] == position + 1: holds the element of position
+typedef struct {
+    // claimed by producers
+    uint64_t tail __attribute__((aligned(CACHE_LINE_SIZE)));
+
+    // owned by the consumer
+    uint64_t head __attribute__((aligned(CACHE_LINE_SIZE)));
+
+    uint64_t *sequences __attribute__((aligned(CACHE_LINE_SIZE)));
+    uint8_t *elements;
+    size_t elementSize;
+    size_t mask;
+} _MpscRing;
+
+MpscRing * mpscRingInit(size_t capacity, size_t elementSize) {
+    _MpscRing *_self = NULL;
+    if (posix_memalign((void**)&_self, CACHE_LINE_SIZE, sizeof(_MpscRing)) != 0) { return NULL; }
+    memset(_self, 0, sizeof(_MpscRing));
+
+    size_t roundedCapacity = 1;
+    while (roundedCapacity < capacity) {
+        roundedCapacity <<= 1;
+    }
+    _self->sequences = (uint64_t*)calloc(roundedCapacity, sizeof(uint64_t));
+    _self->elements = (uint8_t*)calloc(roundedCapacity, elementSize);
+    if (_self->sequences == NULL || _self->elements == NULL) {
+        free(_self->sequences);
+        free(_self->elements);
+        free(_self);
+        return NULL;
+    }
+    for (size_t i = 0; i < roundedCapacity; ++i) {
+        _self->sequences[i] = i;
+    }
+    _self->elementSize = elementSize;
+    _self->mask = roundedCapacity - 1;
+    return (MpscRing*)_self;
+}
+
+void mpscRingDestroy(MpscRing *self) {
+    _MpscRing *_self = (_MpscRing*)self;
+    free(_self->sequences);
+    free(_self->elements);
+    free(_self);
+}
+
+bool mpscRingPush(MpscRing *self, const void *element, uint64_t *position) {
+    _MpscRing *_self = (_MpscRing*)self;
+    uint64_t tail = __atomic_load_n(&_self->tail, __ATOMIC_RELAXED);
+    while (true) {
+        uint64_t sequence = __atomic_load_n(&_self->sequences[tail & _self->mask], __ATOMIC_ACQUIRE);
+        int64_t difference = (int64_t)(sequence - tail);
+        if (difference == 0) {
+            if (__atomic_compare_exchange_n(
+                &_self->tail, &tail, tail + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED
+            )) {
+                break;
+            }
+        } else if (difference < 0) {
+            // The slot still holds an element from one lap ago: full.
+            return false;
+        } else {
+            tail = __atomic_load_n(&_self->tail, __ATOMIC_RELAXED);
+        }
+    }
+    memcpy(_self->elements + (tail & _self->mask) * _self->elementSize, element, _self->elementSize);
+    __atomic_store_n(&_self->sequences[tail & _self->mask], tail + 1, __ATOMIC_RELEASE);
+    if (position != NULL) {
+        *position = tail;
+    }
+    return true;
+}
+
+bool mpscRingPop(MpscRing *self, void *element) {
+    _MpscRing *_self = (_MpscRing*)self;
+    uint64_t head = _self->head;
+    uint64_t *sequence = &_self->sequences[head & _self->mask];
+    if (__atomic_load_n(sequence, __ATOMIC_ACQUIRE) != head + 1) { return false; }
+    memcpy(element, _self->elements + (head & _self->mask) * _self->elementSize, _self->elementSize);
+    __atomic_store_n(sequence, head + _self->mask + 1, __ATOMIC_RELEASE);
+    _self->head = head + 1;
+    return true;
+}
+
+size_t mpscRingGetCapacity(MpscRing *self) {
+    _MpscRing *_self = (_MpscRing*)self;
+    return _self->mask + 1;
+}
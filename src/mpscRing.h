@@ -0,0 +1,30 @@
+#ifndef __MPSC_RING_H__
+#define __MPSC_RING_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Fixed capacity lock-free ring for any number of producer threads
+ * and one consumer thread.
+ *
+ * Producers claim a position with one compare-and-swap and never block
+ * or allocate; the consumer pops in position order. Positions count
+ * every element ever pushed, starting at 0.
+*/
+
+typedef void* MpscRing;
+
+MpscRing * mpscRingInit(size_t capacity, size_t elementSize);
+void mpscRingDestroy(MpscRing *self);
+
+// false when the ring is full, position (may be NULL) receives the
+// position of the element
+bool mpscRingPush(MpscRing *self, const void *element, uint64_t *position);
+// consumer thread only, false when the ring is empty
+bool mpscRingPop(MpscRing *self, void *element);
+
+size_t mpscRingGetCapacity(MpscRing *self);
+
+#endif // __MPSC_RING_H__
@@ -0,0 +1,48 @@
+#define _GNU_SOURCE
+#include "realtime.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define MAX_CPU_COUNT (64)
+
+bool realtimeSetPriority(pthread_t thread, int priority, int *ioErrno) {
+    struct sched_param parameters = { .sched_priority = priority };
+    int result = pthread_setschedparam(thread, SCHED_FIFO, &parameters);
+    if (result != 0) {
+        *ioErrno = result;
+        return false;
+    }
+    return true;
+}
+
+bool realtimeSetAffinity(pthread_t thread, uint64_t cpuMask, int *ioErrno) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int cpu = 0; cpu < MAX_CPU_COUNT; ++cpu) {
+        if (cpuMask & ((uint64_t)1 << cpu)) {
+            CPU_SET(cpu, &cpus);
+        }
+    }
+    int result = pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+    if (result != 0) {
+        *ioErrno = result;
+        return false;
+    }
+    return true;
+}
+
+bool realtimeLockMemory(int *ioErrno) {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        *ioErrno = errno;
+        return false;
+    }
+    return true;
+}
+
+void realtimePrefaultStack(size_t size) {
+    volatile uint8_t stack[size];
+    memset((uint8_t*)stack, 0, size);
+}
@@ -0,0 +1,27 @@
+#ifndef __REALTIME_H__
+#define __REALTIME_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/**
+ * @brief Scheduling and memory settings for the player's threads.
+ *
+ * Each call applies one setting and returns false with the errno of the
+ * failure, so callers can report exactly what could not be applied
+ * (typically EPERM without CAP_SYS_NICE / CAP_IPC_LOCK).
+*/
+
+// SCHED_FIFO at priority; the kernel also drops the timer slack of such threads
+bool realtimeSetPriority(pthread_t thread, int priority, int *ioErrno);
+// bit i of cpuMask allows CPU i
+bool realtimeSetAffinity(pthread_t thread, uint64_t cpuMask, int *ioErrno);
+// mlockall of current and future mappings, so thread stacks and buffers
+// allocated later are resident as well
+bool realtimeLockMemory(int *ioErrno);
+// touches size bytes of the calling thread's stack
+void realtimePrefaultStack(size_t size);
+
+#endif // __REALTIME_H__
@@ -0,0 +1,417 @@
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fuses.h"
+#include "fusesFormat.h"
+#include "i2cSimulation.h"
+#include "virtualClock.h"
+
+/**
+ * Plays a show on the simulated bus in virtual time and checks its
+ * firing trace: pulses of one fuse that overlap, register writes that
+ * merge the edges of one fuse or disagree with the fuses lit, I2C errors
+ * and registers not back at zero after the show. Prints the problems and
+ * PASS or FAIL, optionally writes the complete trace for bin/traceDump.
+*/
+
+#define TRACE_CAPACITY (1 << 20)
+#define EVENT_BATCH_SIZE (64)
+#define MAX_PRINTED_PROBLEMS (20)
+#define DEFAULT_FUSE_DURATION (200)
+#define MAX_V1_I2C_DEVICE_COUNT (16)
+#define BASE_DEVICE_ADDRESS (0b1100000)
+#define NO_DEVICE_ADDRESS (0x00)
+#define NO_TIMEOUT (-1)
+#define BUS_NAME_SIZE (32)
+#define NANOSECONDS_PER_MILLISECOND (1000000.0)
+#define NANOSECONDS_PER_SECOND (1000000000)
+
+enum {
+    _EDGE_NONE,
+    _EDGE_ON,
+    _EDGE_OFF
+};
+
+enum _ProblemType {
+    _PROBLEM_PULSE_OVERLAP,
+    _PROBLEM_REGISTER_CONFLICT,
+    _PROBLEM_I2C_ERROR,
+    _PROBLEM_LEFT_LIT,
+    _PROBLEM_TRACE_INCOMPLETE,
+    _PROBLEM_TYPE_COUNT
+};
+
+static const char *problemNames[_PROBLEM_TYPE_COUNT] = {
+    "pulse overlaps",
+    "register conflicts",
+    "I2C errors",
+    "fuses left lit",
+    "trace events lost"
+};
+
+typedef struct {
+    uint32_t deviceCount;
+    FusesDevice *devices;
+    // per fuse, deviceIndex * FUSES_FUSE_COUNT_PER_DEVICE + fuseIndex
+    uint32_t *litCues;
+    uint64_t *litTimestamps;
+    // edges since the last write of the fuse's register and their cues
+    uint8_t *pendingEdges;
+    uint32_t *pendingCues;
+    // per register, the value the lit fuses give
+    uint8_t *registers;
+
+    uint64_t playTimestamp;
+    uint64_t cuesIgnited;
+    uint64_t writesIssued;
+    uint64_t writesCompleted;
+    uint64_t problemCounts[_PROBLEM_TYPE_COUNT];
+    uint64_t printedProblems;
+
+    // the trace is drained by the timing thread before time moves on and
+    // by the main thread once the show finished
+    pthread_mutex_t lock;
+    FusesObject *fuses;
+    FusesTraceEvent *events;
+    FILE *traceFile;
+} _Check;
+
+static uint64_t _getCurrentTimeNanoseconds(void) {
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    return (uint64_t)currentTime.tv_sec * NANOSECONDS_PER_SECOND + currentTime.tv_nsec;
+}
+
+static void _report(_Check *check, enum _ProblemType type, const char *format, ...) {
+    ++(check->problemCounts[type]);
+    if (check->printedProblems++ >= MAX_PRINTED_PROBLEMS) { return; }
+    va_list arguments;
+    va_start(arguments, format);
+    vprintf(format, arguments);
+    va_end(arguments);
+    printf("\n");
+}
+
+static double _showTime(_Check *check, const FusesTraceEvent *event) {
+    return (double)(event->timestamp - check->playTimestamp) / NANOSECONDS_PER_MILLISECOND;
+}
+
+static uint8_t _fuseMask(uint8_t fuseIndex) {
+    return FUSES_FUSE_MASK << (2 * (fuseIndex % FUSES_FUSES_PER_REGISTER));
+}
+
+static void _checkIgnite(_Check *check, const FusesTraceEvent *event) {
+    uint32_t fuse = event->i2cDeviceIndex * FUSES_FUSE_COUNT_PER_DEVICE + event->value;
+    ++(check->cuesIgnited);
+    if (check->litCues[fuse] != FUSES_TRACE_NO_CUE) {
+        _report(
+            check, _PROBLEM_PULSE_OVERLAP,
+            "%10.3f ms  pulse overlap: cue %u lights device %u fuse %u, still lit by cue %u since %.3f ms",
+            _showTime(check, event), event->cueIndex, event->i2cDeviceIndex, event->value,
+            check->litCues[fuse], (double)(check->litTimestamps[fuse] - check->playTimestamp) / NANOSECONDS_PER_MILLISECOND
+        );
+    } else if (check->pendingEdges[fuse] == _EDGE_OFF) {
+        _report(
+            check, _PROBLEM_REGISTER_CONFLICT,
+            "%10.3f ms  register conflict: device %u fuse %u goes off for cue %u and on for cue %u in one write, the pulses merge",
+            _showTime(check, event), event->i2cDeviceIndex, event->value, check->pendingCues[fuse], event->cueIndex
+        );
+    }
+    check->litCues[fuse] = event->cueIndex;
+    check->litTimestamps[fuse] = event->timestamp;
+    check->pendingEdges[fuse] = _EDGE_ON;
+    check->pendingCues[fuse] = event->cueIndex;
+    check->registers[fuse / FUSES_FUSES_PER_REGISTER] |= _fuseMask(event->value);
+}
+
+static void _checkExtinguish(_Check *check, const FusesTraceEvent *event) {
+    uint32_t fuse = event->i2cDeviceIndex * FUSES_FUSE_COUNT_PER_DEVICE + event->value;
+    if (check->pendingEdges[fuse] == _EDGE_ON) {
+        _report(
+            check, _PROBLEM_REGISTER_CONFLICT,
+            "%10.3f ms  register conflict: device %u fuse %u goes on for cue %u and off for cue %u in one write, the pulse is lost",
+            _showTime(check, event), event->i2cDeviceIndex, event->value, check->pendingCues[fuse], event->cueIndex
+        );
+    }
+    check->litCues[fuse] = FUSES_TRACE_NO_CUE;
+    check->pendingEdges[fuse] = _EDGE_OFF;
+    check->pendingCues[fuse] = event->cueIndex;
+    check->registers[fuse / FUSES_FUSES_PER_REGISTER] &= ~_fuseMask(event->value);
+}
+
+static void _checkWrite(_Check *check, const FusesTraceEvent *event) {
+    uint8_t registerIndex = event->registerAddress - FUSES_REGISTER_BASE_ADDRESS;
+    uint32_t registerSlot = event->i2cDeviceIndex * FUSES_REGISTER_COUNT + registerIndex;
+    ++(check->writesIssued);
+    if (event->value != check->registers[registerSlot]) {
+        _report(
+            check, _PROBLEM_REGISTER_CONFLICT,
+            "%10.3f ms  register conflict: device %u register 0x%02x written as 0x%02x, its lit fuses give 0x%02x",
+            _showTime(check, event), event->i2cDeviceIndex, event->registerAddress, event->value,
+            check->registers[registerSlot]
+        );
+    }
+    uint32_t firstFuse = registerSlot * FUSES_FUSES_PER_REGISTER;
+    for (uint32_t i = 0; i < FUSES_FUSES_PER_REGISTER; ++i) {
+        check->pendingEdges[firstFuse + i] = _EDGE_NONE;
+    }
+}
+
+static void _checkEvent(_Check *check, const FusesTraceEvent *event) {
+    switch (event->type) {
+        case FUSES_TRACE_CUE_IGNITED:
+            _checkIgnite(check, event);
+            break;
+        case FUSES_TRACE_FUSE_EXTINGUISHED:
+            _checkExtinguish(check, event);
+            break;
+        case FUSES_TRACE_WRITE_ISSUED:
+            _checkWrite(check, event);
+            break;
+        case FUSES_TRACE_WRITE_COMPLETED:
+            ++(check->writesCompleted);
+            break;
+        case FUSES_TRACE_COMMAND:
+            if (event->command == FUSES_TRACE_COMMAND_PLAY) {
+                check->playTimestamp = event->timestamp;
+            }
+            break;
+        case FUSES_TRACE_I2C_ERROR:
+            _report(
+                check, _PROBLEM_I2C_ERROR, "%10.3f ms  I2C error: device %u register 0x%02x: %s",
+                _showTime(check, event), event->i2cDeviceIndex, event->registerAddress, strerror(event->argument)
+            );
+            break;
+    }
+}
+
+static void _drainTrace(void *context) {
+    _Check *check = (_Check*)context;
+    FusesObject *fuses = __atomic_load_n(&check->fuses, __ATOMIC_ACQUIRE);
+    if (fuses == NULL) { return; }
+    pthread_mutex_lock(&check->lock);
+    size_t count;
+    while ((count = fusesDrainTrace(fuses, check->events, TRACE_CAPACITY)) > 0) {
+        for (size_t i = 0; i < count; ++i) {
+            _checkEvent(check, &check->events[i]);
+        }
+        if (check->traceFile != NULL) {
+            fwrite(check->events, sizeof(FusesTraceEvent), count, check->traceFile);
+        }
+    }
+    pthread_mutex_unlock(&check->lock);
+}
+
+/**
+ * @brief Device table of the mapped show, the version 1 one as fusesInit builds it.
+*/
+static bool _readDevices(FusesConfiguration *configuration, _Check *check, uint32_t *busCount) {
+    FusesHeaderV2 *header = (FusesHeaderV2*)configuration->rawData;
+    bool v1 = memcmp(header->fusesMagic, FUSES_V1_MAGIC, FUSES_MAGIC_SIZE) == 0;
+    check->deviceCount = v1 ? MAX_V1_I2C_DEVICE_COUNT : header->deviceCount;
+    check->devices = (FusesDevice*)calloc(check->deviceCount > 0 ? check->deviceCount : 1, sizeof(FusesDevice));
+    if (check->devices == NULL) { return false; }
+    if (v1) {
+        FusesHeader *v1Header = (FusesHeader*)configuration->rawData;
+        for (uint32_t i = 0; i < check->deviceCount; ++i) {
+            check->devices[i].deviceAddress = (v1Header->i2cDeviceIndexMask & (1 << i))
+                ? BASE_DEVICE_ADDRESS | i : NO_DEVICE_ADDRESS;
+        }
+    } else {
+        size_t headerSize = header->version == FUSES_FORMAT_VERSION_3 ? sizeof(FusesHeaderV3) : sizeof(FusesHeaderV2);
+        memcpy(check->devices, (uint8_t*)configuration->rawData + headerSize, check->deviceCount * sizeof(FusesDevice));
+    }
+    *busCount = 1;
+    for (uint32_t i = 0; i < check->deviceCount; ++i) {
+        if (check->devices[i].busIndex >= *busCount) {
+            *busCount = check->devices[i].busIndex + 1;
+        }
+    }
+
+    size_t fuseCount = (size_t)check->deviceCount * FUSES_FUSE_COUNT_PER_DEVICE;
+    check->litCues = (uint32_t*)malloc((fuseCount > 0 ? fuseCount : 1) * sizeof(uint32_t));
+    check->litTimestamps = (uint64_t*)calloc(fuseCount > 0 ? fuseCount : 1, sizeof(uint64_t));
+    check->pendingEdges = (uint8_t*)calloc(fuseCount > 0 ? fuseCount : 1, sizeof(uint8_t));
+    check->pendingCues = (uint32_t*)calloc(fuseCount > 0 ? fuseCount : 1, sizeof(uint32_t));
+    check->registers = (uint8_t*)calloc(check->deviceCount > 0 ? check->deviceCount * FUSES_REGISTER_COUNT : 1, 1);
+    if (
+        check->litCues == NULL || check->litTimestamps == NULL || check->pendingEdges == NULL
+        || check->pendingCues == NULL || check->registers == NULL
+    ) {
+        return false;
+    }
+    for (size_t i = 0; i < fuseCount; ++i) {
+        check->litCues[i] = FUSES_TRACE_NO_CUE;
+    }
+    return true;
+}
+
+/**
+ * @brief Every fuse register has to be back at zero on the board and in
+ * the trace once the show finished.
+*/
+static void _checkFinalState(_Check *check, I2cTransport *simulation, char **busNames) {
+    for (uint32_t i = 0; i < check->deviceCount; ++i) {
+        if (check->devices[i].deviceAddress == NO_DEVICE_ADDRESS) continue;
+        for (uint8_t registerIndex = 0; registerIndex < FUSES_REGISTER_COUNT; ++registerIndex) {
+            uint8_t value = i2cSimulationGetRegister(
+                simulation, busNames[check->devices[i].busIndex], check->devices[i].deviceAddress,
+                FUSES_REGISTER_BASE_ADDRESS + registerIndex
+            );
+            uint8_t traced = check->registers[i * FUSES_REGISTER_COUNT + registerIndex];
+            if (value != 0 || traced != 0) {
+                _report(
+                    check, _PROBLEM_LEFT_LIT, "end of show: device %u register 0x%02x is 0x%02x on the bus, 0x%02x in the trace",
+                    i, FUSES_REGISTER_BASE_ADDRESS + registerIndex, value, traced
+                );
+            }
+        }
+    }
+}
+
+static bool _waitForShowFinished(FusesObject *fuses) {
+    struct pollfd eventDescriptor = { .fd = fusesGetEventFileDescriptor(fuses), .events = POLLIN };
+    FusesEvent events[EVENT_BATCH_SIZE];
+    while (true) {
+        poll(&eventDescriptor, 1, NO_TIMEOUT);
+        size_t count;
+        while ((count = fusesReadEvents(fuses, events, EVENT_BATCH_SIZE)) > 0) {
+            for (size_t i = 0; i < count; ++i) {
+                if (events[i].type == FUSES_EVENT_SHOW_FINISHED) { return true; }
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t speed = 0;
+    uint16_t fuseDuration = DEFAULT_FUSE_DURATION;
+    char *showFilename = NULL;
+    char *traceFilename = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            speed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--fuse-duration") == 0 && i + 1 < argc) {
+            fuseDuration = (uint16_t)strtoul(argv[++i], NULL, 10);
+        } else if (showFilename == NULL) {
+            showFilename = argv[i];
+        } else {
+            traceFilename = argv[i];
+        }
+    }
+    if (showFilename == NULL) {
+        fprintf(stderr, "usage: %s [--speed n] [--fuse-duration ms] <show file> [trace file]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FusesConfiguration configuration = {
+        .fuseDuration = fuseDuration,
+        .traceCapacity = TRACE_CAPACITY,
+        .eventCapacity = EVENT_BATCH_SIZE,
+        .eventMask = FUSES_EVENT_MASK(FUSES_EVENT_SHOW_FINISHED)
+    };
+    FusesError mapError;
+    if (!fusesMapShow(&configuration, showFilename, false, &mapError)) {
+        fprintf(stderr, "%s: %s\n", showFilename, fusesGetErrorString(&mapError));
+        return EXIT_FAILURE;
+    }
+
+    _Check check = { 0 };
+    uint32_t busCount;
+    check.events = (FusesTraceEvent*)malloc(TRACE_CAPACITY * sizeof(FusesTraceEvent));
+    if (check.events == NULL || !_readDevices(&configuration, &check, &busCount)) {
+        fprintf(stderr, "%s: out of memory\n", showFilename);
+        return EXIT_FAILURE;
+    }
+    pthread_mutex_init(&check.lock, NULL);
+    if (traceFilename != NULL) {
+        check.traceFile = fopen(traceFilename, "wb");
+        if (check.traceFile == NULL || !fusesTraceWriteHeader(check.traceFile)) {
+            perror(traceFilename);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Every bus of the show gets a simulated one without wire time.
+    char (*busNameStorage)[BUS_NAME_SIZE] = calloc(busCount, BUS_NAME_SIZE);
+    char **busNames = (char**)calloc(busCount, sizeof(char*));
+    I2cSimulationConfiguration simulationConfiguration = { .clockFrequency = 0 };
+    I2cTransport *simulation = i2cSimulationInit(&simulationConfiguration);
+    VirtualClockConfiguration clockConfiguration = {
+        .speed = speed,
+        .waitHandler = _drainTrace,
+        .waitHandlerContext = &check
+    };
+    ClockSource *clock = virtualClockInit(&clockConfiguration);
+    if (busNameStorage == NULL || busNames == NULL || simulation == NULL || clock == NULL) {
+        fprintf(stderr, "%s: out of memory\n", showFilename);
+        return EXIT_FAILURE;
+    }
+    for (uint32_t i = 0; i < busCount; ++i) {
+        snprintf(busNameStorage[i], BUS_NAME_SIZE, "/dev/i2c-sim%u", i);
+        busNames[i] = busNameStorage[i];
+    }
+    configuration.busNames = busNames;
+    configuration.busCount = busCount;
+    configuration.transport = simulation;
+    configuration.clock = clock;
+
+    FusesObject *fuses = fusesInit(&configuration);
+    if (fuses == NULL || fusesGetError(fuses)->level == FUSES_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "%s: %s\n", showFilename, fuses ? fusesGetErrorString(fusesGetError(fuses)) : "");
+        return EXIT_FAILURE;
+    }
+    __atomic_store_n(&check.fuses, fuses, __ATOMIC_RELEASE);
+
+    uint64_t start = _getCurrentTimeNanoseconds();
+    fusesPlay(fuses, NULL);
+    _waitForShowFinished(fuses);
+    uint64_t wallTime = _getCurrentTimeNanoseconds() - start;
+    _drainTrace(&check);
+
+    FusesStatistics statistics = fusesGetStatistics(fuses);
+    if (statistics.traceEventsDropped > 0) {
+        _report(
+            &check, _PROBLEM_TRACE_INCOMPLETE, "trace incomplete: %llu events lost",
+            (unsigned long long)statistics.traceEventsDropped
+        );
+    }
+    uint32_t cueCount = fusesGetCueCount(fuses);
+    uint32_t totalDuration = fusesGetTotalDuration(fuses);
+    fusesDestroy(fuses);
+    _checkFinalState(&check, simulation, busNames);
+
+    uint64_t problemCount = 0;
+    for (int i = 0; i < _PROBLEM_TYPE_COUNT; ++i) {
+        problemCount += check.problemCounts[i];
+    }
+    if (check.printedProblems > MAX_PRINTED_PROBLEMS) {
+        printf("... %llu more\n", (unsigned long long)(check.printedProblems - MAX_PRINTED_PROBLEMS));
+    }
+    printf(
+        "%s: %u cues on %u devices, %.3f s of show checked in %.3f s\n",
+        showFilename, cueCount, check.deviceCount, totalDuration / 1000.0, (double)wallTime / NANOSECONDS_PER_SECOND
+    );
+    printf(
+        "%llu cues fired, %llu register writes issued, %llu completed\n",
+        (unsigned long long)check.cuesIgnited, (unsigned long long)check.writesIssued,
+        (unsigned long long)check.writesCompleted
+    );
+    for (int i = 0; i < _PROBLEM_TYPE_COUNT; ++i) {
+        printf("%-20s %llu\n", problemNames[i], (unsigned long long)check.problemCounts[i]);
+    }
+    printf("%s\n", problemCount == 0 ? "PASS" : "FAIL");
+
+    if (check.traceFile != NULL) {
+        fclose(check.traceFile);
+    }
+    virtualClockDestroy(clock);
+    i2cSimulationDestroy(simulation);
+    fusesUnmapShow(&configuration);
+    return problemCount == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,386 @@
+#include "showCompiler.h"
+#include "fusesFormat.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t Bool8;
+
+#define MAX_LINE_LENGTH (1024)
+#define SEPARATORS (" \t,;\r\n")
+#define COMMENT_CHARACTER ('#')
+#define MAX_BUS_INDEX (255)
+#define MAX_DEVICE_ADDRESS (0x7f)
+// the general call address, never a fuse board
+#define NO_DEVICE_ADDRESS (0x00)
+#define MAX_DEVICE_COUNT (UINT16_MAX)
+#define INITIAL_CUE_CAPACITY (256)
+#define FIELD_COUNT (4)
+#define NANOSECONDS_PER_MILLISECOND (1000000)
+
+typedef struct {
+    uint64_t timestamp;
+    uint32_t busIndex;
+    uint32_t deviceAddress;
+    uint32_t fuseIndex;
+    uint32_t line;
+    // assigned by showCompilerCompile
+    uint32_t i2cDeviceIndex;
+} _Cue;
+
+typedef struct {
+    uint64_t timestamp;
+    uint32_t i2cDeviceIndex;
+    uint8_t registerIndex;
+    uint8_t setMask;
+    uint8_t clearMask;
+} _Edge;
+
+typedef struct {
+    _Cue *cues;
+    size_t cueCount;
+    size_t cueCapacity;
+
+    FusesDevice *devices;
+    uint32_t deviceCount;
+    FusesWrite *writes;
+    uint32_t writeCount;
+    uint32_t edgeCount;
+
+    uint16_t fuseDuration;
+    Bool8 compiled;
+} _ShowCompiler;
+
+ShowCompiler * showCompilerInit(uint16_t fuseDuration) {
+    _ShowCompiler *_self = (_ShowCompiler*)calloc(1, sizeof(_ShowCompiler));
+    if (_self == NULL) { return NULL; }
+    _self->fuseDuration = fuseDuration;
+    return (ShowCompiler*)_self;
+}
+
+void showCompilerDestroy(ShowCompiler *self) {
+    _ShowCompiler *_self = (_ShowCompiler*)self;
+    free(_self->cues);
+    free(_self->devices);
+    free(_self->writes);
+    free(_self);
+}
+
+bool showCompilerAddCue(
+    ShowCompiler *self, uint64_t timestamp, uint32_t busIndex, uint32_t deviceAddress, uint32_t fuseIndex,
+    uint32_t line
+) {
+    _ShowCompiler *_self = (_ShowCompiler*)self;
+    if (_self->cueCount == _self->cueCapacity) {
+        size_t capacity = _self->cueCapacity > 0 ? 2 * _self->cueCapacity : INITIAL_CUE_CAPACITY;
+        _Cue *cues = (_Cue*)realloc(_self->cues, capacity * sizeof(_Cue));
+        if (cues == NULL) { return false; }
+        _self->cues = cues;
+        _self->cueCapacity = capacity;
+    }
+    _self->cues[_self->cueCount++] = (_Cue){
+        .timestamp = timestamp,
+        .busIndex = busIndex,
+        .deviceAddress = deviceAddress,
+        .fuseIndex = fuseIndex,
+        .line = line
+    };
+    _self->compiled = false;
+    return true;
+}
+
+bool _parseUnsigned(const char *token, uint32_t *value) {
+    char *end;
+    unsigned long result = strtoul(token, &end, 0);
+    if (*end != '\0' || *token == '-' || result > UINT32_MAX) { return false; }
+    *value = (uint32_t)result;
+    return true;
+}
+
+bool _parseMilliseconds(const char *token, uint64_t *timestamp) {
+    char *end;
+    double milliseconds = strtod(token, &end);
+    // Also rejects NaN, which compares false.
+    if (end == token || *end != '\0' || !(milliseconds >= 0) || milliseconds > (double)UINT32_MAX) {
+        return false;
+    }
+    *timestamp = (uint64_t)(milliseconds * NANOSECONDS_PER_MILLISECOND + 0.5);
+    return true;
+}
+
+bool showCompilerParse(ShowCompiler *self, FILE *input, const char *name, FILE *diagnostics) {
+    char line[MAX_LINE_LENGTH];
+    uint32_t lineNumber = 0;
+    bool valid = true;
+    bool headerAllowed = true;
+    while (fgets(line, sizeof(line), input) != NULL) {
+        ++lineNumber;
+        char *comment = strchr(line, COMMENT_CHARACTER);
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        char *fields[FIELD_COUNT + 1];
+        int fieldCount = 0;
+        char *state;
+        for (
+            char *token = strtok_r(line, SEPARATORS, &state);
+            token != NULL && fieldCount <= FIELD_COUNT;
+            token = strtok_r(NULL, SEPARATORS, &state)
+        ) {
+            fields[fieldCount++] = token;
+        }
+        if (fieldCount == 0) continue;
+
+        uint64_t timestamp;
+        uint32_t busIndex, deviceAddress, fuseIndex;
+        bool timeValid = _parseMilliseconds(fields[0], &timestamp);
+        if (!timeValid && headerAllowed) {
+            headerAllowed = false;
+            continue;
+        }
+        headerAllowed = false;
+        if (
+            fieldCount != FIELD_COUNT || !timeValid
+            || !_parseUnsigned(fields[1], &busIndex)
+            || !_parseUnsigned(fields[2], &deviceAddress)
+            || !_parseUnsigned(fields[3], &fuseIndex)
+        ) {
+            fprintf(diagnostics, "%s:%u: expected <time ms> <bus> <address> <fuse>\n", name, lineNumber);
+            valid = false;
+            continue;
+        }
+        if (!showCompilerAddCue(self, timestamp, busIndex, deviceAddress, fuseIndex, lineNumber)) {
+            fprintf(diagnostics, "%s:%u: out of memory\n", name, lineNumber);
+            return false;
+        }
+    }
+    return valid;
+}
+
+static int _compareByFuse(const void *a, const void *b) {
+    const _Cue *x = (const _Cue*)a;
+    const _Cue *y = (const _Cue*)b;
+    if (x->busIndex != y->busIndex) { return x->busIndex < y->busIndex ? -1 : 1; }
+    if (x->deviceAddress != y->deviceAddress) { return x->deviceAddress < y->deviceAddress ? -1 : 1; }
+    if (x->fuseIndex != y->fuseIndex) { return x->fuseIndex < y->fuseIndex ? -1 : 1; }
+    if (x->timestamp != y->timestamp) { return x->timestamp < y->timestamp ? -1 : 1; }
+    return (x->line > y->line) - (x->line < y->line);
+}
+
+static int _compareByTime(const void *a, const void *b) {
+    const _Cue *x = (const _Cue*)a;
+    const _Cue *y = (const _Cue*)b;
+    if (x->timestamp != y->timestamp) { return x->timestamp < y->timestamp ? -1 : 1; }
+    if (x->i2cDeviceIndex != y->i2cDeviceIndex) { return x->i2cDeviceIndex < y->i2cDeviceIndex ? -1 : 1; }
+    return (x->fuseIndex > y->fuseIndex) - (x->fuseIndex < y->fuseIndex);
+}
+
+static int _compareEdges(const void *a, const void *b) {
+    const _Edge *x = (const _Edge*)a;
+    const _Edge *y = (const _Edge*)b;
+    if (x->timestamp != y->timestamp) { return x->timestamp < y->timestamp ? -1 : 1; }
+    if (x->i2cDeviceIndex != y->i2cDeviceIndex) { return x->i2cDeviceIndex < y->i2cDeviceIndex ? -1 : 1; }
+    return (x->registerIndex > y->registerIndex) - (x->registerIndex < y->registerIndex);
+}
+
+/**
+ * @brief Reports cues outside the addressable range.
+*/
+bool _checkRanges(_ShowCompiler *_self, const char *name, FILE *diagnostics) {
+    bool valid = true;
+    for (size_t i = 0; i < _self->cueCount; ++i) {
+        _Cue *cue = &_self->cues[i];
+        if (cue->busIndex > MAX_BUS_INDEX) {
+            fprintf(diagnostics, "%s:%u: bus %u out of range (0-%d)\n", name, cue->line, cue->busIndex, MAX_BUS_INDEX);
+            valid = false;
+        }
+        if (cue->deviceAddress == NO_DEVICE_ADDRESS || cue->deviceAddress > MAX_DEVICE_ADDRESS) {
+            fprintf(
+                diagnostics, "%s:%u: address 0x%x out of range (0x01-0x%02x)\n",
+                name, cue->line, cue->deviceAddress, MAX_DEVICE_ADDRESS
+            );
+            valid = false;
+        }
+        if (cue->fuseIndex >= FUSES_FUSE_COUNT_PER_DEVICE) {
+            fprintf(
+                diagnostics, "%s:%u: fuse %u out of range (0-%d)\n",
+                name, cue->line, cue->fuseIndex, FUSES_FUSE_COUNT_PER_DEVICE - 1
+            );
+            valid = false;
+        }
+    }
+    return valid;
+}
+
+/**
+ * @brief With the cues sorted by fuse, reports duplicates and pulses that
+ * overlap or touch the previous pulse of the same fuse, and numbers the
+ * devices in (bus, address) order.
+*/
+bool _checkPulses(_ShowCompiler *_self, const char *name, FILE *diagnostics) {
+    bool valid = true;
+    uint64_t fuseDuration = (uint64_t)_self->fuseDuration * NANOSECONDS_PER_MILLISECOND;
+    _self->deviceCount = 0;
+    for (size_t i = 0; i < _self->cueCount; ++i) {
+        _Cue *cue = &_self->cues[i];
+        _Cue *previous = i > 0 ? &_self->cues[i - 1] : NULL;
+        bool sameDevice = previous != NULL
+            && previous->busIndex == cue->busIndex && previous->deviceAddress == cue->deviceAddress;
+        if (!sameDevice) {
+            ++(_self->deviceCount);
+        }
+        cue->i2cDeviceIndex = _self->deviceCount - 1;
+        if (!sameDevice || previous->fuseIndex != cue->fuseIndex) continue;
+
+        if (previous->timestamp == cue->timestamp) {
+            fprintf(diagnostics, "%s:%u: duplicate of line %u\n", name, cue->line, previous->line);
+            valid = false;
+        } else if (cue->timestamp <= previous->timestamp + fuseDuration) {
+            fprintf(
+                diagnostics, "%s:%u: pulse of fuse %u overlaps the pulse of line %u\n",
+                name, cue->line, cue->fuseIndex, previous->line
+            );
+            valid = false;
+        }
+    }
+    if (_self->deviceCount > MAX_DEVICE_COUNT) {
+        fprintf(diagnostics, "%s: more than %d devices\n", name, MAX_DEVICE_COUNT);
+        valid = false;
+    }
+    return valid;
+}
+
+/**
+ * @brief Builds the device table and the merged writes from the cues
+ * sorted by fuse.
+*/
+bool _buildPlan(_ShowCompiler *_self) {
+    _self->devices = (FusesDevice*)calloc(_self->deviceCount > 0 ? _self->deviceCount : 1, sizeof(FusesDevice));
+    for (size_t i = 0; i < _self->cueCount; ++i) {
+        _Cue *cue = &_self->cues[i];
+        _self->devices[cue->i2cDeviceIndex].busIndex = cue->busIndex;
+        _self->devices[cue->i2cDeviceIndex].deviceAddress = cue->deviceAddress;
+    }
+    qsort(_self->cues, _self->cueCount, sizeof(_Cue), _compareByTime);
+
+    size_t edgeCount = 2 * _self->cueCount;
+    _Edge *edges = (_Edge*)malloc((edgeCount > 0 ? edgeCount : 1) * sizeof(_Edge));
+    _self->writes = (FusesWrite*)calloc(edgeCount > 0 ? edgeCount : 1, sizeof(FusesWrite));
+    uint8_t (*registers)[FUSES_REGISTER_COUNT] = calloc(
+        _self->deviceCount > 0 ? _self->deviceCount : 1, sizeof(*registers)
+    );
+    if (_self->devices == NULL || edges == NULL || _self->writes == NULL || registers == NULL) {
+        free(edges);
+        free(registers);
+        return false;
+    }
+
+    uint64_t fuseDuration = (uint64_t)_self->fuseDuration * NANOSECONDS_PER_MILLISECOND;
+    for (size_t i = 0; i < _self->cueCount; ++i) {
+        _Cue *cue = &_self->cues[i];
+        uint8_t mask = FUSES_FUSE_MASK << (2 * (cue->fuseIndex % FUSES_FUSES_PER_REGISTER));
+        _Edge edge = {
+            .timestamp = cue->timestamp,
+            .i2cDeviceIndex = cue->i2cDeviceIndex,
+            .registerIndex = cue->fuseIndex / FUSES_FUSES_PER_REGISTER,
+            .setMask = mask
+        };
+        edges[2 * i] = edge;
+        edge.timestamp += fuseDuration;
+        edge.setMask = 0;
+        edge.clearMask = mask;
+        edges[2 * i + 1] = edge;
+    }
+    qsort(edges, edgeCount, sizeof(_Edge), _compareEdges);
+
+    // Edges of one register and instant become one write.
+    _self->writeCount = 0;
+    for (size_t i = 0; i < edgeCount; ++i) {
+        FusesWrite *last = _self->writeCount > 0 ? &_self->writes[_self->writeCount - 1] : NULL;
+        if (
+            last == NULL || last->timestamp != edges[i].timestamp
+            || last->i2cDeviceIndex != edges[i].i2cDeviceIndex
+            || last->registerAddress != FUSES_REGISTER_BASE_ADDRESS + edges[i].registerIndex
+        ) {
+            last = &_self->writes[_self->writeCount++];
+            last->timestamp = edges[i].timestamp;
+            last->i2cDeviceIndex = edges[i].i2cDeviceIndex;
+            last->registerAddress = FUSES_REGISTER_BASE_ADDRESS + edges[i].registerIndex;
+        }
+        last->setMask |= edges[i].setMask;
+        last->clearMask |= edges[i].clearMask;
+        uint8_t *value = &registers[edges[i].i2cDeviceIndex][edges[i].registerIndex];
+        *value = (*value & ~edges[i].clearMask) | edges[i].setMask;
+        last->value = *value;
+    }
+    _self->edgeCount = edgeCount;
+    free(edges);
+    free(registers);
+    return true;
+}
+
+bool showCompilerCompile(ShowCompiler *self, const char *name, FILE *diagnostics) {
+    _ShowCompiler *_self = (_ShowCompiler*)self;
+    free(_self->devices);
+    free(_self->writes);
+    _self->devices = NULL;
+    _self->writes = NULL;
+    _self->compiled = false;
+
+    bool valid = _checkRanges(_self, name, diagnostics);
+    qsort(_self->cues, _self->cueCount, sizeof(_Cue), _compareByFuse);
+    valid = _checkPulses(_self, name, diagnostics) && valid;
+    if (!valid) { return false; }
+    if (!_buildPlan(_self)) {
+        fprintf(diagnostics, "%s: out of memory\n", name);
+        return false;
+    }
+    _self->compiled = true;
+    return true;
+}
+
+bool showCompilerWrite(ShowCompiler *self, FILE *output) {
+    _ShowCompiler *_self = (_ShowCompiler*)self;
+    if (!_self->compiled) { return false; }
+
+    size_t cueOffset = fusesFormatCueOffsetV3(_self->deviceCount);
+    FusesHeaderV3 header = {
+        .version = FUSES_FORMAT_VERSION_3,
+        .headerSize = sizeof(FusesHeaderV3),
+        .deviceCount = _self->deviceCount,
+        .dataItemCount = _self->cueCount,
+        .cueOffset = cueOffset,
+        .writeOffset = cueOffset + _self->cueCount * sizeof(FusesCue),
+        .writeCount = _self->writeCount,
+        .fuseDuration = _self->fuseDuration
+    };
+    memcpy(header.fusesMagic, FUSES_V3_MAGIC, FUSES_MAGIC_SIZE);
+    header.headerChecksum = fusesFormatChecksum(&header, FUSES_HEADER_V3_CHECKSUM_SIZE);
+
+    uint8_t padding[FUSES_CUE_ALIGNMENT] = { 0 };
+    size_t paddingSize = cueOffset - sizeof(FusesHeaderV3) - _self->deviceCount * sizeof(FusesDevice);
+    bool written = fwrite(&header, sizeof(FusesHeaderV3), 1, output) == 1
+        && fwrite(_self->devices, sizeof(FusesDevice), _self->deviceCount, output) == _self->deviceCount
+        && fwrite(padding, 1, paddingSize, output) == paddingSize;
+    for (size_t i = 0; written && i < _self->cueCount; ++i) {
+        FusesCue cue = {
+            .timestamp = _self->cues[i].timestamp,
+            .i2cDeviceIndex = _self->cues[i].i2cDeviceIndex,
+            .fuseIndex = _self->cues[i].fuseIndex
+        };
+        written = fwrite(&cue, sizeof(FusesCue), 1, output) == 1;
+    }
+    return written
+        && fwrite(_self->writes, sizeof(FusesWrite), _self->writeCount, output) == _self->writeCount;
+}
+
+ShowCompilerStatistics showCompilerGetStatistics(ShowCompiler *self) {
+    _ShowCompiler *_self = (_ShowCompiler*)self;
+    ShowCompilerStatistics statistics = {
+        .cueCount = _self->cueCount,
+        .deviceCount = _self->compiled ? _self->deviceCount : 0,
+        .writeCount = _self->compiled ? _self->writeCount : 0,
+        .edgeCount = _self->compiled ? _self->edgeCount : 0
+    };
+    return statistics;
+}
@@ -0,0 +1,52 @@
+#ifndef __SHOW_COMPILER_H__
+#define __SHOW_COMPILER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief Turns a cue list into a version 3 show with a precomputed
+ * register write plan.
+ *
+ * Cue lists are text or CSV, one cue per line: time in milliseconds
+ * (fractions allowed), bus index, device address and fuse index,
+ * separated by whitespace, commas or semicolons. '#' starts a comment, a
+ * first line that does not start with a number is taken as a header.
+ *
+ * showCompilerCompile rejects addresses and fuse indices out of range,
+ * duplicate cues and pulses of one fuse that overlap or touch, reporting
+ * every problem with its line. It then sorts the cues, numbers the
+ * devices by (bus, address) and merges all ignite and extinguish edges of
+ * one register and instant into one write.
+*/
+
+typedef struct {
+    uint32_t cueCount;
+    uint32_t deviceCount;
+    uint32_t writeCount;
+    // ignite and extinguish edges, more than writeCount when edges merged
+    uint32_t edgeCount;
+} ShowCompilerStatistics;
+
+typedef void* ShowCompiler;
+
+// fuseDuration in milliseconds
+ShowCompiler * showCompilerInit(uint16_t fuseDuration);
+void showCompilerDestroy(ShowCompiler *self);
+
+// timestamp in nanoseconds, line is reported with problems of this cue
+bool showCompilerAddCue(
+    ShowCompiler *self, uint64_t timestamp, uint32_t busIndex, uint32_t deviceAddress, uint32_t fuseIndex,
+    uint32_t line
+);
+// adds the cues of a cue list, name prefixes the diagnostics
+bool showCompilerParse(ShowCompiler *self, FILE *input, const char *name, FILE *diagnostics);
+bool showCompilerCompile(ShowCompiler *self, const char *name, FILE *diagnostics);
+// after a successful showCompilerCompile
+bool showCompilerWrite(ShowCompiler *self, FILE *output);
+
+ShowCompilerStatistics showCompilerGetStatistics(ShowCompiler *self);
+
+#endif // __SHOW_COMPILER_H__
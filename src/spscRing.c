@@ -0,0 +1,83 @@
+#include "spscRing.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_LINE_SIZE (64)
+
+typedef struct {
+    // written by the consumer
+    size_t head __attribute__((aligned(CACHE_LINE_SIZE)));
+    size_t cachedTail;
+
+    // written by the producer
+    size_t tail __attribute__((aligned(CACHE_LINE_SIZE)));
+    size_t cachedHead;
+
+    uint8_t *elements __attribute__((aligned(CACHE_LINE_SIZE)));
+    size_t elementSize;
+    size_t mask;
+} _SpscRing;
+
+SpscRing * spscRingInit(size_t capacity, size_t elementSize) {
+    _SpscRing *_self = NULL;
+    if (posix_memalign((void**)&_self, CACHE_LINE_SIZE, sizeof(_SpscRing)) != 0) { return NULL; }
+    memset(_self, 0, sizeof(_SpscRing));
+
+    size_t roundedCapacity = 1;
+    while (roundedCapacity < capacity) {
+        roundedCapacity <<= 1;
+    }
+    _self->elements = (uint8_t*)calloc(roundedCapacity, elementSize);
+    if (_self->elements == NULL) {
+        free(_self);
+        return NULL;
+    }
+    _self->elementSize = elementSize;
+    _self->mask = roundedCapacity - 1;
+    return (SpscRing*)_self;
+}
+
+void spscRingDestroy(SpscRing *self) {
+    _SpscRing *_self = (_SpscRing*)self;
+    free(_self->elements);
+    free(_self);
+}
+
+bool spscRingPush(SpscRing *self, const void *element) {
+    _SpscRing *_self = (_SpscRing*)self;
+    size_t tail = _self->tail;
+    // Only reload the consumer's index when the cached one says full.
+    if (tail - _self->cachedHead > _self->mask) {
+        _self->cachedHead = __atomic_load_n(&_self->head, __ATOMIC_ACQUIRE);
+        if (tail - _self->cachedHead > _self->mask) { return false; }
+    }
+    memcpy(_self->elements + (tail & _self->mask) * _self->elementSize, element, _self->elementSize);
+    __atomic_store_n(&_self->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool spscRingPop(SpscRing *self, void *element) {
+    _SpscRing *_self = (_SpscRing*)self;
+    size_t head = _self->head;
+    if (head == _self->cachedTail) {
+        _self->cachedTail = __atomic_load_n(&_self->tail, __ATOMIC_ACQUIRE);
+        if (head == _self->cachedTail) { return false; }
+    }
+    memcpy(element, _self->elements + (head & _self->mask) * _self->elementSize, _self->elementSize);
+    __atomic_store_n(&_self->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+size_t spscRingGetCount(SpscRing *self) {
+    _SpscRing *_self = (_SpscRing*)self;
+    // head first: the tail read afterwards can only be further ahead
+    size_t head = __atomic_load_n(&_self->head, __ATOMIC_ACQUIRE);
+    size_t tail = __atomic_load_n(&_self->tail, __ATOMIC_ACQUIRE);
+    return tail - head;
+}
+
+size_t spscRingGetCapacity(SpscRing *self) {
+    _SpscRing *_self = (_SpscRing*)self;
+    return _self->mask + 1;
+}
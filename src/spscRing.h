@@ -0,0 +1,30 @@
+#ifndef __SPSC_RING_H__
+#define __SPSC_RING_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Fixed capacity lock-free ring for one producer and one consumer thread.
+ *
+ * Elements are copied in and out by value. The capacity is rounded up to
+ * a power of two and allocated once by spscRingInit; pushing and popping
+ * never block and never allocate. spscRingPush may only be called from
+ * the producer thread and spscRingPop only from the consumer thread.
+*/
+
+typedef void* SpscRing;
+
+SpscRing * spscRingInit(size_t capacity, size_t elementSize);
+void spscRingDestroy(SpscRing *self);
+
+// false when the ring is full
+bool spscRingPush(SpscRing *self, const void *element);
+// false when the ring is empty
+bool spscRingPop(SpscRing *self, void *element);
+
+size_t spscRingGetCount(SpscRing *self);
+size_t spscRingGetCapacity(SpscRing *self);
+
+#endif // __SPSC_RING_H__
@@ -0,0 +1,99 @@
+#include "timerQueue.h"
+
+#include <stdlib.h>
+
+typedef struct {
+    TimerEvent *events;
+    size_t count;
+    size_t capacity;
+} _TimerQueue;
+
+#define PARENT(i) (((i) - 1) / 2)
+#define LEFT_CHILD(i) (2 * (i) + 1)
+
+static void _swap(TimerEvent *a, TimerEvent *b) {
+    TimerEvent temporary = *a;
+    *a = *b;
+    *b = temporary;
+}
+
+TimerQueue * timerQueueInit(size_t capacity) {
+    _TimerQueue *_self = (_TimerQueue*)calloc(1, sizeof(_TimerQueue));
+    if (_self == NULL) { return NULL; }
+
+    // calloc leaves untouched pages unmapped, so a large capacity is cheap
+    // until the queue actually fills up.
+    _self->events = (TimerEvent*)calloc(capacity > 0 ? capacity : 1, sizeof(TimerEvent));
+    if (_self->events == NULL) {
+        free(_self);
+        return NULL;
+    }
+    _self->capacity = capacity;
+    return (TimerQueue*)_self;
+}
+
+void timerQueueDestroy(TimerQueue *self) {
+    _TimerQueue *_self = (_TimerQueue*)self;
+    free(_self->events);
+    free(_self);
+}
+
+bool timerQueuePush(TimerQueue *self, TimerEvent event) {
+    _TimerQueue *_self = (_TimerQueue*)self;
+    if (_self->count == _self->capacity) { return false; }
+
+    size_t i = _self->count++;
+    _self->events[i] = event;
+    while (i > 0 && _self->events[PARENT(i)].deadline > _self->events[i].deadline) {
+        _swap(&_self->events[PARENT(i)], &_self->events[i]);
+        i = PARENT(i);
+    }
+    return true;
+}
+
+bool timerQueuePeek(TimerQueue *self, TimerEvent *event) {
+    _TimerQueue *_self = (_TimerQueue*)self;
+    if (_self->count == 0) { return false; }
+    *event = _self->events[0];
+    return true;
+}
+
+bool timerQueuePop(TimerQueue *self, TimerEvent *event) {
+    _TimerQueue *_self = (_TimerQueue*)self;
+    if (_self->count == 0) { return false; }
+
+    *event = _self->events[0];
+    _self->events[0] = _self->events[--(_self->count)];
+
+    size_t i = 0;
+    while (true) {
+        size_t smallest = i;
+        size_t left = LEFT_CHILD(i);
+        size_t right = left + 1;
+        if (left < _self->count && _self->events[left].deadline < _self->events[smallest].deadline) {
+            smallest = left;
+        }
+        if (right < _self->count && _self->events[right].deadline < _self->events[smallest].deadline) {
+            smallest = right;
+        }
+        if (smallest == i) { break; }
+        _swap(&_self->events[i], &_self->events[smallest]);
+        i = smallest;
+    }
+    return true;
+}
+
+void timerQueueClear(TimerQueue *self) {
+    _TimerQueue *_self = (_TimerQueue*)self;
+    _self->count = 0;
+}
+
+size_t timerQueueGetCount(TimerQueue *self) {
+    _TimerQueue *_self = (_TimerQueue*)self;
+    return _self->count;
+}
+
+size_t timerQueueGetCapacity(TimerQueue *self) {
+    _TimerQueue *_self = (_TimerQueue*)self;
+    return _self->capacity;
+}
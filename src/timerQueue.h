@@ -0,0 +1,37 @@
+#ifndef __TIMER_QUEUE_H__
+#define __TIMER_QUEUE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Fixed capacity binary min-heap of deadlines.
+ *
+ * The storage is allocated once by timerQueueInit; pushing and popping
+ * never allocate and cost O(log n).
+*/
+
+typedef struct {
+    // nanoseconds on the player's clock
+    uint64_t deadline;
+    uint32_t dataItemIndex;
+    // the fuse of the cue, so the event is handled without the cue
+    uint32_t i2cDeviceIndex;
+    uint8_t fuseIndex;
+} TimerEvent;
+
+typedef void* TimerQueue;
+
+TimerQueue * timerQueueInit(size_t capacity);
+void timerQueueDestroy(TimerQueue *self);
+
+bool timerQueuePush(TimerQueue *self, TimerEvent event);
+bool timerQueuePeek(TimerQueue *self, TimerEvent *event);
+bool timerQueuePop(TimerQueue *self, TimerEvent *event);
+void timerQueueClear(TimerQueue *self);
+
+size_t timerQueueGetCount(TimerQueue *self);
+size_t timerQueueGetCapacity(TimerQueue *self);
+
+#endif // __TIMER_QUEUE_H__
@@ -0,0 +1,61 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "fusesTrace.h"
+
+#define EVENT_BATCH_SIZE (1024)
+
+int main(int argc, char *argv[]) {
+    int csv = 0;
+    char *filename = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--csv") == 0) {
+            csv = 1;
+        } else {
+            filename = argv[i];
+        }
+    }
+    if (filename == NULL) {
+        fprintf(stderr, "usage: %s [--csv] <trace file>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        perror("fopen");
+        return EXIT_FAILURE;
+    }
+    if (!fusesTraceReadHeader(file)) {
+        fprintf(stderr, "%s: not a trace file\n", filename);
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+
+    if (csv) {
+        fusesTracePrintCsvHeader(stdout);
+    }
+    FusesTraceEvent events[EVENT_BATCH_SIZE];
+    // A virtual clock may start at 0, so the origin is flagged separately.
+    uint64_t origin = 0;
+    int originSet = 0;
+    size_t count;
+    while ((count = fread(events, sizeof(FusesTraceEvent), EVENT_BATCH_SIZE, file)) > 0) {
+        if (!originSet) {
+            origin = events[0].timestamp;
+            originSet = 1;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (csv) {
+                fusesTracePrintCsv(stdout, &events[i]);
+            } else {
+                fusesTracePrint(stdout, &events[i], origin);
+            }
+        }
+    }
+
+    fclose(file);
+
+    return EXIT_SUCCESS;
+}
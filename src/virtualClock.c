@@ -0,0 +1,89 @@
+#define _GNU_SOURCE
+#include "virtualClock.h"
+
+#include <poll.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NANOSECONDS_PER_SECOND (1000000000)
+#define NO_TIMEOUT (-1)
+
+typedef struct {
+    ClockSource clock;
+    VirtualClockConfiguration configuration;
+    // speed 0: the current virtual time, written by the waiting thread
+    uint64_t time;
+    // speed N: CLOCK_MONOTONIC at virtualClockInit
+    uint64_t realStartTime;
+
+    uint64_t advances;
+    uint64_t waits;
+} _VirtualClock;
+
+static uint64_t _getCurrentTimeNanoseconds(void) {
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    return (uint64_t)currentTime.tv_sec * NANOSECONDS_PER_SECOND + currentTime.tv_nsec;
+}
+
+static uint64_t _now(ClockSource *self) {
+    _VirtualClock *_self = (_VirtualClock*)self;
+    if (_self->configuration.speed == 0) {
+        return __atomic_load_n(&_self->time, __ATOMIC_ACQUIRE);
+    }
+    return _self->configuration.startTime
+        + (_getCurrentTimeNanoseconds() - _self->realStartTime) * _self->configuration.speed;
+}
+
+static bool _wait(ClockSource *self, int fileDescriptor, bool armed, uint64_t deadline) {
+    _VirtualClock *_self = (_VirtualClock*)self;
+    if (_self->configuration.waitHandler != NULL) {
+        _self->configuration.waitHandler(_self->configuration.waitHandlerContext);
+    }
+    __atomic_store_n(&_self->waits, _self->waits + 1, __ATOMIC_RELAXED);
+    struct pollfd pollDescriptor = { .fd = fileDescriptor, .events = POLLIN };
+
+    if (_self->configuration.speed == 0) {
+        // Whatever woke the thread is handled before time moves on.
+        if (poll(&pollDescriptor, 1, armed ? 0 : NO_TIMEOUT) > 0) { return true; }
+        if (armed && deadline > _self->time) {
+            __atomic_store_n(&_self->time, deadline, __ATOMIC_RELEASE);
+            __atomic_store_n(&_self->advances, _self->advances + 1, __ATOMIC_RELAXED);
+        }
+        return false;
+    }
+
+    struct timespec timeout = { 0 };
+    if (armed) {
+        uint64_t now = _now(self);
+        // Rounded up, the wait never ends before the deadline.
+        uint64_t delay = deadline > now
+            ? (deadline - now + _self->configuration.speed - 1) / _self->configuration.speed : 0;
+        timeout.tv_sec = delay / NANOSECONDS_PER_SECOND;
+        timeout.tv_nsec = delay % NANOSECONDS_PER_SECOND;
+    }
+    return ppoll(&pollDescriptor, 1, armed ? &timeout : NULL, NULL) > 0;
+}
+
+ClockSource * virtualClockInit(VirtualClockConfiguration *configuration) {
+    _VirtualClock *_self = (_VirtualClock*)calloc(1, sizeof(_VirtualClock));
+    if (_self == NULL) { return NULL; }
+    _self->clock.now = _now;
+    _self->clock.wait = _wait;
+    _self->configuration = *configuration;
+    _self->time = configuration->startTime;
+    _self->realStartTime = _getCurrentTimeNanoseconds();
+    return (ClockSource*)_self;
+}
+
+void virtualClockDestroy(ClockSource *self) {
+    free(self);
+}
+
+VirtualClockStatistics virtualClockGetStatistics(ClockSource *self) {
+    _VirtualClock *_self = (_VirtualClock*)self;
+    return (VirtualClockStatistics){
+        .advances = __atomic_load_n(&_self->advances, __ATOMIC_RELAXED),
+        .waits = __atomic_load_n(&_self->waits, __ATOMIC_RELAXED)
+    };
+}
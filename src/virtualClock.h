@@ -0,0 +1,46 @@
+#ifndef __VIRTUAL_CLOCK_H__
+#define __VIRTUAL_CLOCK_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "clockSource.h"
+
+/**
+ * @brief Clock for running whole shows faster than real time.
+ *
+ * At speed 0 time only moves when the timing thread waits: it jumps
+ * straight to the deadline waited for, after whatever woke the thread
+ * has been handled, so a show plays from event to event as fast as the
+ * player can compute it and every tick happens at its exact deadline. At
+ * speed N time runs N times as fast as CLOCK_MONOTONIC from startTime on.
+ * Pair it with the simulated bus without wire time; the bus workers take
+ * no virtual time.
+*/
+
+typedef struct {
+    // virtual nanoseconds per real nanosecond, 0 goes from event to event
+    uint32_t speed;
+    // virtual time at virtualClockInit, in nanoseconds
+    uint64_t startTime;
+    // called on the timing thread before every wait, while the bus is
+    // idle and no other thread records trace events of the player
+    void (*waitHandler)(void *context);
+    void *waitHandlerContext;
+} VirtualClockConfiguration;
+
+typedef struct {
+    // deadlines time jumped to, speed 0 only
+    uint64_t advances;
+    // waits of the timing thread
+    uint64_t waits;
+} VirtualClockStatistics;
+
+ClockSource * virtualClockInit(VirtualClockConfiguration *configuration);
+// every player using the clock has to be destroyed first
+void virtualClockDestroy(ClockSource *self);
+
+VirtualClockStatistics virtualClockGetStatistics(ClockSource *self);
+
+#endif // __VIRTUAL_CLOCK_H__